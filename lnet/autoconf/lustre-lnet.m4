@@ -917,6 +917,29 @@ AC_SUBST(KFILND)
 AC_SUBST(EXTRA_SYMBOLS)
 ]) # LN_CONFIG_KFILND
 
+#
+# LN_HAVE_SK_INCOMING_CPU
+#
+# 3.19 added sk_incoming_cpu, the CPU that processed the last
+# packet received on the socket
+#
+AC_DEFUN([LN_SRC_HAVE_SK_INCOMING_CPU], [
+	LB2_LINUX_TEST_SRC([sk_incoming_cpu], [
+		#include <net/sock.h>
+	],[
+		struct sock *sk = NULL;
+
+		(void)READ_ONCE(sk->sk_incoming_cpu);
+	],[-Werror])
+])
+AC_DEFUN([LN_HAVE_SK_INCOMING_CPU], [
+	LB2_MSG_LINUX_TEST_RESULT([if 'struct sock' has 'sk_incoming_cpu'],
+	[sk_incoming_cpu], [
+		AC_DEFINE(HAVE_SK_INCOMING_CPU, 1,
+			['struct sock' has 'sk_incoming_cpu'])
+	])
+]) # LN_HAVE_SK_INCOMING_CPU
+
 #
 # LN_CONFIG_SOCK_CREATE_KERN
 #
@@ -1024,6 +1047,57 @@ AC_DEFUN([LN_HAVE_ORACLE_OFED_EXTENSIONS], [
 	])
 ]) # LN_HAVE_ORACLE_OFED_EXTENSIONS
 
+#
+# LN_HAVE_MSG_ZEROCOPY
+#
+# 4.14 added MSG_ZEROCOPY for TCP sockets; completions are
+# reported on the socket error queue with SO_EE_ORIGIN_ZEROCOPY
+#
+AC_DEFUN([LN_SRC_HAVE_MSG_ZEROCOPY], [
+	LB2_LINUX_TEST_SRC([msg_zerocopy], [
+		#include <linux/errqueue.h>
+		#include <net/sock.h>
+	],[
+		struct sock *sk = NULL;
+		struct sock_extended_err *serr = NULL;
+
+		sock_set_flag(sk, SOCK_ZEROCOPY);
+		(void)atomic_read(&sk->sk_zckey);
+		serr->ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+		serr->ee_code = SO_EE_CODE_ZEROCOPY_COPIED;
+		(void)MSG_ZEROCOPY;
+	],[-Werror])
+])
+AC_DEFUN([LN_HAVE_MSG_ZEROCOPY], [
+	LB2_MSG_LINUX_TEST_RESULT([if MSG_ZEROCOPY is supported],
+	[msg_zerocopy], [
+		AC_DEFINE(HAVE_MSG_ZEROCOPY, 1,
+			[MSG_ZEROCOPY is supported])
+	])
+]) # LN_HAVE_MSG_ZEROCOPY
+
+#
+# LN_HAVE_HRTIMER_SOFT
+#
+# 4.16 added hrtimers that expire in softirq context
+#
+AC_DEFUN([LN_SRC_HAVE_HRTIMER_SOFT], [
+	LB2_LINUX_TEST_SRC([hrtimer_mode_rel_soft], [
+		#include <linux/hrtimer.h>
+	],[
+		enum hrtimer_mode mode = HRTIMER_MODE_REL_SOFT;
+
+		(void)mode;
+	],[-Werror])
+])
+AC_DEFUN([LN_HAVE_HRTIMER_SOFT], [
+	LB2_MSG_LINUX_TEST_RESULT([if HRTIMER_MODE_REL_SOFT is supported],
+	[hrtimer_mode_rel_soft], [
+		AC_DEFINE(HAVE_HRTIMER_SOFT, 1,
+			[HRTIMER_MODE_REL_SOFT is supported])
+	])
+]) # LN_HAVE_HRTIMER_SOFT
+
 #
 # LN_CONFIG_SOCK_GETNAME
 #
@@ -1096,6 +1170,8 @@ AC_DEFUN([LN_PROG_LINUX_SRC], [
 	LN_CONFIG_O2IB_SRC
 	# 3.15
 	LN_SRC_CONFIG_SK_DATA_READY
+	# 3.19
+	LN_SRC_HAVE_SK_INCOMING_CPU
 	# 4.x
 	LN_SRC_CONFIG_SOCK_CREATE_KERN
 	# 4.6
@@ -1103,6 +1179,9 @@ AC_DEFUN([LN_PROG_LINUX_SRC], [
 	# 4.14
 	LN_SRC_HAVE_HYPERVISOR_IS_TYPE
 	LN_SRC_HAVE_ORACLE_OFED_EXTENSIONS
+	LN_SRC_HAVE_MSG_ZEROCOPY
+	# 4.16
+	LN_SRC_HAVE_HRTIMER_SOFT
 	# 4.17
 	LN_SRC_CONFIG_SOCK_GETNAME
 	# 5.3 and 4.18.0-193.el8
@@ -1113,6 +1192,8 @@ AC_DEFUN([LN_PROG_LINUX_RESULTS], [
 	LN_CONFIG_O2IB_RESULTS
 	# 3.15
 	LN_CONFIG_SK_DATA_READY
+	# 3.19
+	LN_HAVE_SK_INCOMING_CPU
 	# 4.x
 	LN_CONFIG_SOCK_CREATE_KERN
 	# 4.6
@@ -1120,6 +1201,9 @@ AC_DEFUN([LN_PROG_LINUX_RESULTS], [
 	# 4.14
 	LN_HAVE_HYPERVISOR_IS_TYPE
 	LN_HAVE_ORACLE_OFED_EXTENSIONS
+	LN_HAVE_MSG_ZEROCOPY
+	# 4.16
+	LN_HAVE_HRTIMER_SOFT
 	# 4.17
 	LN_CONFIG_SOCK_GETNAME
 	# 5.3 and 4.18.0-193.el8
@@ -614,6 +614,8 @@ extern unsigned lnet_transaction_timeout;
 extern unsigned lnet_retry_count;
 extern unsigned int lnet_lnd_timeout;
 extern unsigned int lnet_numa_range;
+extern unsigned int lnet_latency_select;
+extern unsigned int lnet_cut_through_min;
 extern unsigned int lnet_health_sensitivity;
 extern unsigned int lnet_recovery_interval;
 extern unsigned int lnet_recovery_limit;
@@ -674,6 +676,7 @@ int  lnet_rtrpools_adjust(int tiny, int small, int large);
 int lnet_rtrpools_enable(void);
 void lnet_rtrpools_disable(void);
 void lnet_rtrpools_free(int keep_pools);
+void lnet_rtrpool_grow_locked(struct lnet_rtrbufpool *rbp);
 void lnet_rtr_transfer_to_peer(struct lnet_peer *src,
 			       struct lnet_peer *target);
 struct lnet_remotenet *lnet_find_rnet_locked(__u32 net);
@@ -778,12 +781,28 @@ void lnet_ni_recv(struct lnet_ni *ni, void *private, struct lnet_msg *msg,
 		  int delayed, unsigned int offset,
 		  unsigned int mlen, unsigned int rlen);
 void lnet_ni_send(struct lnet_ni *ni, struct lnet_msg *msg);
+void lnet_ni_recv_routed(struct lnet_ni *ni, struct lnet_msg *msg,
+			 int delayed);
+void lnet_ct_recv_done(struct lnet_msg *shadow, int status);
+bool lnet_ct_send_done(struct lnet_msg *msg, int status);
+
+/* An LND's lnd_send() was handed @msg before its payload was received; it
+ * must not read the payload until lnd_payload_ready() is called.
+ */
+static inline bool
+lnet_msg_is_cut_through(struct lnet_msg *msg)
+{
+	return test_bit(LNET_CT_TX_SENDING, &msg->msg_ct_flags);
+}
 
 struct lnet_msg *lnet_create_reply_msg(struct lnet_ni *ni,
 				       struct lnet_msg *get_msg);
 void lnet_set_reply_msg_len(struct lnet_ni *ni, struct lnet_msg *msg,
 			    unsigned int len);
 void lnet_detach_rsp_tracker(struct lnet_libmd *md, int cpt);
+bool lnet_rspt_sample(struct lnet_msg *msg, struct lnet_libmd *md,
+		      struct lnet_path_sample *ps);
+void lnet_path_sample(struct lnet_msg *msg, struct lnet_path_sample *ps);
 void lnet_clean_zombie_rstqs(void);
 
 bool lnet_md_discarded(struct lnet_libmd *md);
@@ -46,6 +46,7 @@
 #include <linux/semaphore.h>
 #include <linux/types.h>
 #include <linux/kref.h>
+#include <linux/workqueue.h>
 #include <net/genetlink.h>
 
 #include <uapi/linux/lnet/lnet-nl.h>
@@ -97,12 +98,49 @@ struct lnet_rsp_tracker {
 	int rspt_cpt;
 	/* nid of next hop */
 	struct lnet_nid rspt_next_hop_nid;
+	/* nid of the local NI the message was sent from */
+	struct lnet_nid rspt_src_nid;
+	/* when the message was handed to the next hop */
+	ktime_t rspt_sent;
+	/* payload bytes sent to the next hop */
+	unsigned int rspt_nob;
 	/* deadline of the REPLY/ACK */
 	ktime_t rspt_deadline;
 	/* parent MD */
 	struct lnet_handle_md rspt_mdh;
 };
 
+/*
+ * What a path actually delivers, sampled from the REPLY/ACK of tracked
+ * messages (including pings). Updated without locking, a lost sample
+ * only delays convergence.
+ */
+struct lnet_path_est {
+	/* smoothed round trip time in usecs, 0 until first sampled */
+	__u32			lpe_rtt;
+	/* smoothed bandwidth in bytes per usec, 0 until first sampled */
+	__u32			lpe_bw;
+};
+
+/* lnet_msg::msg_ct_flags, cut-through forwarding of a routed message.
+ * Changed under lnet_net_lock(msg_rx_cpt). */
+enum lnet_ct_bits {
+	LNET_CT_ACTIVE,		/* forwarding while the payload is received */
+	LNET_CT_RX_DONE,	/* payload received (or failed) */
+	LNET_CT_TX_PARKED,	/* send is waiting for the payload */
+	LNET_CT_TX_SENDING,	/* handed to lnd_send() before RX_DONE */
+	LNET_CT_TX_STARTED,	/* ... and accepted by the LND */
+	LNET_CT_TX_DONE,	/* send completed before RX_DONE */
+	LNET_CT_NOTIFIED,	/* lnd_payload_ready() has been called */
+};
+
+/* a path sample taken from a REPLY/ACK, see lnet_rspt_sample() */
+struct lnet_path_sample {
+	struct lnet_nid		ps_src_nid;
+	__u32			ps_usec;
+	unsigned int		ps_nob;
+};
+
 struct lnet_msg {
 	struct list_head	msg_activelist;
 	struct list_head	msg_list;	/* Q for credits/MD */
@@ -126,6 +164,8 @@ struct lnet_msg {
 	 * has not completed.
 	 */
 	ktime_t			msg_deadline;
+	/* when the message started waiting for a router buffer */
+	ktime_t			msg_rtr_wait;
 
 	/* The message health status. */
 	enum lnet_msg_hstatus	msg_health_status;
@@ -179,6 +219,15 @@ struct lnet_msg {
 	unsigned int          msg_niov;
 	struct bio_vec	     *msg_kiov;
 
+	/* cut-through forwarding state, see enum lnet_ct_bits */
+	unsigned long		msg_ct_flags;
+	int			msg_ct_rx_status;
+	int			msg_ct_tx_status;
+	/* receiving the payload of this forwarded message */
+	struct lnet_msg		*msg_ct_parent;
+	/* sending LND's handle on a cut-through send */
+	void			*msg_ct_private;
+
 	struct lnet_event	msg_ev;
 	struct lnet_hdr		msg_hdr;
 };
@@ -315,6 +364,14 @@ struct lnet_lnd {
 	int (*lnd_eager_recv)(struct lnet_ni *ni, void *private,
 			      struct lnet_msg *msg, void **new_privatep);
 
+	/* The payload of a routed message handed to lnd_send() before it was
+	 * received (lnet_msg_is_cut_through()) is now in place, or failed
+	 * with 'status' < 0.  Until this is called the LND must neither read
+	 * the payload nor complete the message.  LNDs which don't provide
+	 * it are only given the message once its payload is received. */
+	void (*lnd_payload_ready)(struct lnet_ni *ni, struct lnet_msg *msg,
+				  int status);
+
 	/* notification of peer down */
 	void (*lnd_notify_peer_down)(struct lnet_nid *peer);
 
@@ -633,6 +690,10 @@ enum lnet_net_local_ni_msg_stats_attrs {
  *							ping (NLA_U32)
  * @LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_NEXT_PING:	Number of next pings
  *							(NLA_U64)
+ * @LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_RTT:		Measured round trip
+ *							time in usecs (NLA_U32)
+ * @LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_BANDWIDTH:	Measured bandwidth
+ *							in MB/s (NLA_U32)
  */
 enum lnet_net_local_ni_health_stats_attrs {
 	LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_UNSPEC = 0,
@@ -648,6 +709,8 @@ enum lnet_net_local_ni_health_stats_attrs {
 	LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_ERROR,
 	LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_PING_COUNT,
 	LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_NEXT_PING,
+	LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_RTT,
+	LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_BANDWIDTH,
 	__LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_MAX_PLUS_ONE,
 };
 #define LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_MAX (__LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_MAX_PLUS_ONE - 1)
@@ -913,6 +976,10 @@ enum lnet_peer_ni_list_stats {
  * @LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_NEXT_PING:	timestamp for next ping
  *							sent by remote peer
  *							(NLA_S64)
+ * @LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_RTT:		measured round trip
+ *							time in usecs (NLA_U32)
+ * @LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_BANDWIDTH:	measured bandwidth in
+ *							MB/s (NLA_U32)
  */
 enum lnet_peer_ni_list_health_stats {
 	LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_UNSPEC = 0,
@@ -925,6 +992,8 @@ enum lnet_peer_ni_list_health_stats {
 	LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_NETWORK_TIMEOUT,
 	LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_PING_COUNT,
 	LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_NEXT_PING,
+	LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_RTT,
+	LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_BANDWIDTH,
 
 	__LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_MAX_PLUS_ONE,
 };
@@ -1108,6 +1177,9 @@ struct lnet_ni {
 	/* the relative selection priority of this NI */
 	__u32			ni_sel_priority;
 
+	/* measured latency and bandwidth of the paths through this NI */
+	struct lnet_path_est	ni_path;
+
 	/*
 	 * equivalent interface to use
 	 */
@@ -1253,6 +1325,8 @@ struct lnet_peer_ni {
 	struct list_head	lpni_rtr_pref_nids;
 	/* The relative selection priority of this peer NI */
 	__u32			lpni_sel_priority;
+	/* measured latency and bandwidth of the path to this peer NI */
+	struct lnet_path_est	lpni_path;
 	/* number of preferred NIDs in lnpi_pref_nids */
 	__u32			lpni_pref_nnids;
 };
@@ -1541,6 +1615,9 @@ struct lnet_remotenet {
 /** lnet message is waiting for discovery */
 #define LNET_DC_WAIT		2
 
+/* log2 usecs buckets of the time routed messages wait for a buffer */
+#define LNET_RBP_WAIT_BUCKETS	20
+
 struct lnet_rtrbufpool {
 	/* my free buffer pool */
 	struct list_head	rbp_bufs;
@@ -1556,6 +1633,15 @@ struct lnet_rtrbufpool {
 	int			rbp_credits;
 	/* low water mark */
 	int			rbp_mincredits;
+	/* configured number of buffers, elastic pools scale around it */
+	int			rbp_base_nbuffers;
+	/* CPT the pool belongs to */
+	int			rbp_cpt;
+	/* grows the pool when messages block for a buffer */
+	struct work_struct	rbp_grow_work;
+	/* wait for a buffer, bucket 0 is no wait, bucket n is
+	 * [2^(n-1), 2^n) usecs */
+	__u64			rbp_wait_hist[LNET_RBP_WAIT_BUCKETS];
 };
 
 struct lnet_rtrbuf {
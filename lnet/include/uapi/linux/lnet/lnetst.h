@@ -40,9 +40,11 @@
 
 #define LST_FEAT_NONE		(0)
 #define LST_FEAT_BULK_LEN	(1 << 0)	/* enable variable page size */
+#define LST_FEAT_PERF		(1 << 1)	/* latency/CPU stats, paced load */
 
 #define LST_FEATS_EMPTY		(LST_FEAT_NONE)
-#define LST_FEATS_MASK		(LST_FEAT_NONE | LST_FEAT_BULK_LEN)
+#define LST_FEATS_MASK		(LST_FEAT_NONE | LST_FEAT_BULK_LEN | \
+				 LST_FEAT_PERF)
 
 #define LST_NAME_SIZE		32		/* max name buffer length */
 
@@ -65,6 +67,7 @@
 #define LSTIO_TEST_ADD		0xC26		/* add test (to batch) */
 #define LSTIO_BATCH_QUERY	0xC27		/* query batch status */
 #define LSTIO_STAT_QUERY	0xC30		/* get stats */
+#define LSTIO_PERF_QUERY	0xC31		/* get latency/CPU stats */
 
 /*
  * sparse kernel source annotations
@@ -453,6 +456,30 @@ enum lst_test_type {
 	LST_TEST_PING	= 2
 };
 
+/* query latency or CPU stats of nodes */
+struct lstio_perf_args {
+	/* IN: session key */
+	int			lstio_prf_key;
+	/* IN: timeout for perf request */
+	int			lstio_prf_timeout;
+	/* IN: LST_PERF_* */
+	int			lstio_prf_type;
+	/* IN: batch name length, latency only */
+	int			lstio_prf_bat_nmlen;
+	/* IN: batch name, latency only */
+	char __user	       *lstio_prf_bat_name;
+	/* IN: group name length */
+	int			lstio_prf_nmlen;
+	/* IN: group name */
+	char __user	       *lstio_prf_namep;
+	/* IN: # of pid */
+	int			lstio_prf_count;
+	/* IN: pid */
+	struct lnet_process_id __user *lstio_prf_idsp;
+	/* OUT: list head of result buffer */
+	struct list_head __user *lstio_prf_resultp;
+};
+
 /* create a test in a batch */
 #define LST_MAX_CONCUR		1024			/* Max concurrency of test */
 
@@ -483,6 +510,9 @@ struct lstio_test_args {
 	int __user		*lstio_tes_retp;
 	/* OUT: list head of result buffer */
 	struct list_head __user *lstio_tes_resultp;
+	/* IN: RPCs per second of all units of the test, 0 for closed loop.
+	 * Must stay the last member, older tools don't pass it */
+	int			lstio_tes_rate;
 };
 
 enum lst_brw_type {
@@ -532,6 +562,30 @@ struct sfw_counters {
 	__u32 ping_errors;
 } __attribute__((packed));
 
+enum lst_perf_type {
+	/* RPC latency histogram of the test clients of a batch */
+	LST_PERF_LATENCY	= 1,
+	/* busy time of the test threads of each CPT */
+	LST_PERF_CPU		= 2,
+};
+
+/* prf_vals[i] of LST_PERF_LATENCY counts RPCs completed in
+ * [2^i, 2^(i+1)) usec, bucket 0 also counts anything faster and the
+ * last bucket anything slower. For LST_PERF_CPU prf_vals[i] is the
+ * per-CPU average of milliseconds the test threads of CPT i were busy.
+ * All values are cumulative, tools report deltas between two queries.
+ */
+#define LST_PERF_NVALS		26
+
+/* struct lst_perf_counters is sent over the wire too */
+struct lst_perf_counters {
+	/** milliseconds since current session started */
+	__u32 prf_running_ms;
+	/** # of valid entries in prf_vals */
+	__u32 prf_count;
+	__u32 prf_vals[LST_PERF_NVALS];
+} __attribute__((packed));
+
 #define LNET_SELFTEST_GENL_NAME		"lnet_selftest"
 #define LNET_SELFTEST_GENL_VERSION	0x1
 
@@ -43,6 +43,8 @@ static const struct lnet_lnd the_o2iblnd;
 
 struct kib_data kiblnd_data;
 
+static struct dentry *kiblnd_debug_dir;
+
 static __u32
 kiblnd_cksum (void *ptr, int nob)
 {
@@ -487,7 +489,7 @@ kiblnd_debug_conn(struct kib_conn *conn)
 		kiblnd_debug_tx(list_entry(tmp, struct kib_tx, tx_list));
 
 	CDEBUG(D_CONSOLE, "   rxs:\n");
-	for (i = 0; i < IBLND_RX_MSGS(conn); i++)
+	for (i = 0; conn->ibc_rxs != NULL && i < IBLND_RX_MSGS(conn); i++)
 		kiblnd_debug_rx(&conn->ibc_rxs[i]);
 
 	spin_unlock(&conn->ibc_lock);
@@ -771,6 +773,7 @@ kiblnd_create_conn(struct kib_peer_ni *peer_ni, struct rdma_cm_id *cmid,
 	struct ib_cq_init_attr  cq_attr = {};
 #endif
 	struct kib_conn	*conn;
+	struct kib_srq		*srq;
 	struct ib_cq		*cq;
 	unsigned long		flags;
 	int			cpt;
@@ -898,6 +901,10 @@ kiblnd_create_conn(struct kib_peer_ni *peer_ni, struct rdma_cm_id *cmid,
 	init_qp_attr.send_cq = cq;
 	init_qp_attr.recv_cq = cq;
 
+	srq = conn->ibc_hdev->ibh_srq;
+	if (srq != NULL)
+		init_qp_attr.srq = srq->isq_srq;
+
 	if (peer_ni->ibp_queue_depth_mod &&
 	    peer_ni->ibp_queue_depth_mod < peer_ni->ibp_queue_depth) {
 		conn->ibc_queue_depth = peer_ni->ibp_queue_depth_mod;
@@ -911,7 +918,8 @@ kiblnd_create_conn(struct kib_peer_ni *peer_ni, struct rdma_cm_id *cmid,
 		 * the maximum work requests for the device is maxed out
 		 */
 		init_qp_attr.cap.max_send_wr = kiblnd_send_wrs(conn);
-		init_qp_attr.cap.max_recv_wr = IBLND_RECV_WRS(conn);
+		init_qp_attr.cap.max_recv_wr = srq != NULL ? 0 :
+					       IBLND_RECV_WRS(conn);
 		rc = rdma_create_qp(cmid, conn->ibc_hdev->ibh_pd,
 				    &init_qp_attr);
 		if (rc != -ENOMEM || conn->ibc_queue_depth < 2)
@@ -941,6 +949,16 @@ kiblnd_create_conn(struct kib_peer_ni *peer_ni, struct rdma_cm_id *cmid,
 		peer_ni->ibp_queue_depth_mod = conn->ibc_queue_depth;
 	}
 
+	if (srq != NULL) {
+		/* Receives are posted on the HCA's SRQ and each one is
+		 * claimed by the conn it completes on.  Hold one claim of
+		 * my own until kiblnd_finalise_conn() so completions keep
+		 * being scheduled; 1 ref for caller and 1 for the claim */
+		atomic_set(&conn->ibc_refcount, 2);
+		conn->ibc_nrx = 1;
+		goto init_done;
+	}
+
 	LIBCFS_CPT_ALLOC(conn->ibc_rxs, lnet_cpt_table(), cpt,
 			 IBLND_RX_MSGS(conn) * sizeof(struct kib_rx));
 	if (conn->ibc_rxs == NULL) {
@@ -988,6 +1006,7 @@ kiblnd_create_conn(struct kib_peer_ni *peer_ni, struct rdma_cm_id *cmid,
                 }
         }
 
+init_done:
         /* Init successful! */
         LASSERT (state == IBLND_CONN_ACTIVE_CONNECT ||
                  state == IBLND_CONN_PASSIVE_WAIT);
@@ -1005,6 +1024,27 @@ kiblnd_create_conn(struct kib_peer_ni *peer_ni, struct rdma_cm_id *cmid,
         return NULL;
 }
 
+/* The QP is gone, but the receives it consumed from the SRQ may still be
+ * sitting unpolled in its CQ: give them back before the CQ is destroyed. */
+static void
+kiblnd_reclaim_srq_rxs(struct kib_conn *conn)
+{
+	struct kib_rx *rx;
+	struct ib_wc wc;
+
+	while (ib_poll_cq(conn->ibc_cq, 1, &wc) > 0) {
+		if (kiblnd_wreqid2type(wc.wr_id) != IBLND_WID_RX)
+			continue;
+
+		rx = kiblnd_wreqid2ptr(wc.wr_id);
+		LASSERT(rx->rx_srq != NULL);
+		rx->rx_nob = 0;
+
+		if (kiblnd_post_srq_rx(rx) != 0)
+			CERROR("Can't repost rx on SRQ\n");
+	}
+}
+
 void
 kiblnd_destroy_conn(struct kib_conn *conn)
 {
@@ -1040,8 +1080,11 @@ kiblnd_destroy_conn(struct kib_conn *conn)
 	if (cmid != NULL && cmid->qp != NULL)
 		rdma_destroy_qp(cmid);
 
-	if (conn->ibc_cq)
+	if (conn->ibc_cq) {
+		if (conn->ibc_hdev != NULL && conn->ibc_hdev->ibh_srq != NULL)
+			kiblnd_reclaim_srq_rxs(conn);
 		ib_destroy_cq(conn->ibc_cq);
+	}
 
 	kiblnd_txlist_done(&conn->ibc_zombie_txs, -ECONNABORTED,
 			   LNET_MSG_STATUS_OK);
@@ -1565,6 +1608,8 @@ kiblnd_destroy_fmr_pool(struct kib_fmr_pool *fpo)
 		struct kib_fast_reg_descriptor *frd, *tmp;
 		int i = 0;
 
+		list_splice_init(&fpo->fast_reg.fpo_cache_list,
+				 &fpo->fast_reg.fpo_pool_list);
 		list_for_each_entry_safe(frd, tmp, &fpo->fast_reg.fpo_pool_list,
 					 frd_list) {
 			list_del(&frd->frd_list);
@@ -1572,7 +1617,7 @@ kiblnd_destroy_fmr_pool(struct kib_fmr_pool *fpo)
 			ib_free_fast_reg_page_list(frd->frd_frpl);
 #endif
 			ib_dereg_mr(frd->frd_mr);
-			LIBCFS_FREE(frd, sizeof(*frd));
+			LIBCFS_FREE(frd, kiblnd_frd_size());
 			i++;
 		}
 		if (i < fpo->fast_reg.fpo_pool_size)
@@ -1658,16 +1703,19 @@ static int kiblnd_alloc_freg_pool(struct kib_fmr_poolset *fps,
 #endif
 
 	INIT_LIST_HEAD(&fpo->fast_reg.fpo_pool_list);
+	INIT_LIST_HEAD(&fpo->fast_reg.fpo_cache_list);
 	fpo->fast_reg.fpo_pool_size = 0;
+	fpo->fast_reg.fpo_ncached = 0;
 	for (i = 0; i < fps->fps_pool_size; i++) {
 		LIBCFS_CPT_ALLOC(frd, lnet_cpt_table(), fps->fps_cpt,
-				 sizeof(*frd));
+				 kiblnd_frd_size());
 		if (!frd) {
 			CERROR("Failed to allocate a new fast_reg descriptor\n");
 			rc = -ENOMEM;
 			goto out;
 		}
 		frd->frd_mr = NULL;
+		frd->frd_nfrags = 0;
 
 #ifndef HAVE_OFED_IB_MAP_MR_SG
 		frd->frd_frpl = ib_alloc_fast_reg_page_list(fpo->fpo_hdev->ibh_ibdev,
@@ -1729,7 +1777,7 @@ out_middle:
 	if (frd->frd_frpl)
 		ib_free_fast_reg_page_list(frd->frd_frpl);
 #endif
-	LIBCFS_FREE(frd, sizeof(*frd));
+	LIBCFS_FREE(frd, kiblnd_frd_size());
 
 out:
 	list_for_each_entry_safe(frd, tmp, &fpo->fast_reg.fpo_pool_list,
@@ -1739,7 +1787,7 @@ out:
 		ib_free_fast_reg_page_list(frd->frd_frpl);
 #endif
 		ib_dereg_mr(frd->frd_mr);
-		LIBCFS_FREE(frd, sizeof(*frd));
+		LIBCFS_FREE(frd, kiblnd_frd_size());
 	}
 
 	return rc;
@@ -1875,6 +1923,50 @@ kiblnd_map_tx_pages(struct kib_tx *tx, struct kib_rdma_desc *rd)
 }
 #endif
 
+/*
+ * A FastReg registration of the pages of a local RDMA source stays valid
+ * after the tx completes, so it can be reused as-is by the next tx that
+ * maps exactly the same DMA fragments (e.g. pinned or recycled bulk
+ * buffers) without posting another LOCAL_INV + REG_MR.  Only local
+ * registrations are cached: a key that has been sent to a peer must be
+ * invalidated as soon as the RDMA is done.
+ */
+static struct kib_fast_reg_descriptor *
+kiblnd_fastreg_cache_lookup(struct kib_fmr_pool *fpo,
+			    struct kib_rdma_desc *rd, u32 nob)
+{
+	struct kib_fast_reg_descriptor *frd;
+
+	list_for_each_entry(frd, &fpo->fast_reg.fpo_cache_list, frd_list) {
+		if (frd->frd_nob != nob || frd->frd_nfrags != rd->rd_nfrags ||
+		    memcmp(frd->frd_frags, rd->rd_frags,
+			   rd->rd_nfrags * sizeof(rd->rd_frags[0])) != 0)
+			continue;
+
+		list_del(&frd->frd_list);
+		fpo->fast_reg.fpo_ncached--;
+		return frd;
+	}
+
+	return NULL;
+}
+
+static void
+kiblnd_fastreg_cache_add(struct kib_fmr_pool *fpo,
+			 struct kib_fast_reg_descriptor *frd)
+{
+	list_add(&frd->frd_list, &fpo->fast_reg.fpo_cache_list);
+	if (++fpo->fast_reg.fpo_ncached <= *kiblnd_tunables.kib_fastreg_cache)
+		return;
+
+	/* evict the LRU, it is invalidated when reused */
+	frd = list_last_entry(&fpo->fast_reg.fpo_cache_list,
+			      struct kib_fast_reg_descriptor, frd_list);
+	frd->frd_nfrags = 0;
+	list_move_tail(&frd->frd_list, &fpo->fast_reg.fpo_pool_list);
+	fpo->fast_reg.fpo_ncached--;
+}
+
 void
 kiblnd_fmr_pool_unmap(struct kib_fmr *fmr, int status)
 {
@@ -1905,10 +1997,16 @@ kiblnd_fmr_pool_unmap(struct kib_fmr *fmr, int status)
 	{
 		struct kib_fast_reg_descriptor *frd = fmr->fmr_frd;
 		if (frd) {
+			bool posted = frd->frd_posted;
+
 			frd->frd_posted = false;
 			fmr->fmr_frd = NULL;
 			spin_lock(&fps->fps_lock);
-			list_add_tail(&frd->frd_list, &fpo->fast_reg.fpo_pool_list);
+			if (status == 0 && posted && frd->frd_nfrags > 0)
+				kiblnd_fastreg_cache_add(fpo, frd);
+			else
+				list_add_tail(&frd->frd_list,
+					      &fpo->fast_reg.fpo_pool_list);
 			spin_unlock(&fps->fps_lock);
 		}
 	}
@@ -1980,7 +2078,27 @@ again:
 		} else
 #endif /* HAVE_OFED_FMR_POOL_API */
 		{
-			if (!list_empty(&fpo->fast_reg.fpo_pool_list)) {
+			bool cache = !is_rx &&
+				     *kiblnd_tunables.kib_fastreg_cache > 0;
+
+			if (cache) {
+				struct kib_fast_reg_descriptor *frd;
+
+				frd = kiblnd_fastreg_cache_lookup(fpo, rd, nob);
+				if (frd) {
+					spin_unlock(&fps->fps_lock);
+
+					/* still registered: nothing to post */
+					fmr->fmr_key  = frd->frd_mr->lkey;
+					fmr->fmr_frd  = frd;
+					fmr->fmr_pool = fpo;
+					frd->frd_posted = true;
+					return 0;
+				}
+			}
+
+			if (!list_empty(&fpo->fast_reg.fpo_pool_list) ||
+			    !list_empty(&fpo->fast_reg.fpo_cache_list)) {
 				struct kib_fast_reg_descriptor *frd;
 #ifdef HAVE_OFED_IB_MAP_MR_SG
 				struct ib_reg_wr *wr;
@@ -1990,14 +2108,36 @@ again:
 				struct ib_fast_reg_page_list *frpl;
 #endif
 				struct ib_mr *mr;
-
-				frd = list_first_entry(
-					&fpo->fast_reg.fpo_pool_list,
-					struct kib_fast_reg_descriptor,
-					frd_list);
+				int access = IB_ACCESS_LOCAL_WRITE;
+
+				if (!list_empty(&fpo->fast_reg.fpo_pool_list)) {
+					frd = list_first_entry(
+						&fpo->fast_reg.fpo_pool_list,
+						struct kib_fast_reg_descriptor,
+						frd_list);
+				} else {
+					/* recycle the LRU cached one */
+					frd = list_last_entry(
+						&fpo->fast_reg.fpo_cache_list,
+						struct kib_fast_reg_descriptor,
+						frd_list);
+					fpo->fast_reg.fpo_ncached--;
+				}
 				list_del(&frd->frd_list);
 				spin_unlock(&fps->fps_lock);
 
+				/* a cached key is never handed to a peer */
+				if (cache) {
+					frd->frd_nob = nob;
+					frd->frd_nfrags = rd->rd_nfrags;
+					memcpy(frd->frd_frags, rd->rd_frags,
+					       rd->rd_nfrags *
+					       sizeof(rd->rd_frags[0]));
+				} else {
+					frd->frd_nfrags = 0;
+					access |= IB_ACCESS_REMOTE_WRITE;
+				}
+
 #ifndef HAVE_OFED_IB_MAP_MR_SG
 				frpl = frd->frd_frpl;
 #endif
@@ -2043,8 +2183,7 @@ again:
 				wr->wr.send_flags = 0;
 				wr->mr = mr;
 				wr->key = is_rx ? mr->rkey : mr->lkey;
-				wr->access = (IB_ACCESS_LOCAL_WRITE |
-					      IB_ACCESS_REMOTE_WRITE);
+				wr->access = access;
 #else /* HAVE_OFED_IB_MAP_MR_SG */
 				if (!tx_pages_mapped) {
 					npages = kiblnd_map_tx_pages(tx, rd);
@@ -2069,9 +2208,7 @@ again:
 				wr->wr.wr.fast_reg.length = nob;
 				wr->wr.wr.fast_reg.rkey =
 					is_rx ? mr->rkey : mr->lkey;
-				wr->wr.wr.fast_reg.access_flags =
-					(IB_ACCESS_LOCAL_WRITE |
-					 IB_ACCESS_REMOTE_WRITE);
+				wr->wr.wr.fast_reg.access_flags = access;
 #endif /* HAVE_OFED_IB_MAP_MR_SG */
 
 				fmr->fmr_key  = is_rx ? mr->rkey : mr->lkey;
@@ -2450,6 +2587,7 @@ kiblnd_create_tx_pool(struct kib_poolset *ps, int size, struct kib_pool **pp_po)
 		int	  wrq_sge = *kiblnd_tunables.kib_wrq_sge;
 
                 tx->tx_pool = tpo;
+		spin_lock_init(&tx->tx_ct_lock);
 		if (ps->ps_net->ibn_fmr_ps != NULL) {
 			LIBCFS_CPT_ALLOC(tx->tx_pages,
 					 lnet_cpt_table(), ps->ps_cpt,
@@ -2766,6 +2904,7 @@ kiblnd_hdev_get_attr(struct kib_hca_dev *hdev)
 
 	hdev->ibh_mr_size = dev_attr->max_mr_size;
 	hdev->ibh_max_qp_wr = dev_attr->max_qp_wr;
+	hdev->ibh_max_srq_wr = dev_attr->max_srq_wr;
 
 	/* Setup device Memory Registration capabilities */
 #ifdef HAVE_OFED_FMR_POOL_API
@@ -2830,12 +2969,146 @@ kiblnd_hdev_cleanup_mrs(struct kib_hca_dev *hdev)
 }
 #endif
 
+static void
+kiblnd_srq_event(struct ib_event *event, void *arg)
+{
+	struct kib_srq *srq = arg;
+
+	CERROR("%s: async SRQ event type %d\n",
+	       srq->isq_hdev->ibh_dev->ibd_ifname, event->event);
+}
+
+static void
+kiblnd_hdev_cleanup_srq(struct kib_hca_dev *hdev)
+{
+	struct kib_srq *srq = hdev->ibh_srq;
+	struct kib_rx *rx;
+	int i;
+
+	if (srq == NULL)
+		return;
+
+	/* NB all conns are gone, destroying the SRQ flushes its receives */
+	if (srq->isq_srq != NULL)
+		ib_destroy_srq(srq->isq_srq);
+
+	if (srq->isq_rx_pages != NULL) {
+		for (i = 0; i < srq->isq_nrx; i++) {
+			rx = &srq->isq_rxs[i];
+			kiblnd_dma_unmap_single(hdev->ibh_ibdev,
+						KIBLND_UNMAP_ADDR(rx,
+								  rx_msgunmap,
+								  rx->rx_msgaddr),
+						IBLND_MSG_SIZE,
+						DMA_FROM_DEVICE);
+		}
+		kiblnd_free_pages(srq->isq_rx_pages);
+	}
+
+	if (srq->isq_rxs != NULL)
+		CFS_FREE_PTR_ARRAY(srq->isq_rxs, srq->isq_nrx);
+
+	LIBCFS_FREE(srq, sizeof(*srq));
+	hdev->ibh_srq = NULL;
+}
+
+/*
+ * Receive buffers of a SRQ are shared by all the connections on the HCA,
+ * so the memory they take doesn't grow with the number of peers.
+ */
+static int
+kiblnd_hdev_setup_srq(struct kib_hca_dev *hdev)
+{
+	struct ib_srq_init_attr srq_attr = {};
+	struct ib_srq *isrq;
+	struct kib_srq *srq;
+	struct kib_rx *rx;
+	struct page *pg;
+	int pg_off;
+	int ipg;
+	int rc;
+	int i;
+
+	if (hdev->ibh_max_srq_wr <= 0)
+		return -EOPNOTSUPP;
+
+	LIBCFS_ALLOC(srq, sizeof(*srq));
+	if (srq == NULL)
+		return -ENOMEM;
+
+	hdev->ibh_srq = srq;
+	srq->isq_hdev = hdev;
+	srq->isq_nrx = min(*kiblnd_tunables.kib_srq_size,
+			   hdev->ibh_max_srq_wr);
+
+	srq_attr.event_handler = kiblnd_srq_event;
+	srq_attr.srq_context = srq;
+	srq_attr.attr.max_wr = srq->isq_nrx;
+	srq_attr.attr.max_sge = 1;
+
+	isrq = ib_create_srq(hdev->ibh_pd, &srq_attr);
+	if (IS_ERR(isrq)) {
+		rc = PTR_ERR(isrq);
+		CERROR("Can't create SRQ with %d WRs: %d\n",
+		       srq->isq_nrx, rc);
+		return rc;
+	}
+	srq->isq_srq = isrq;
+
+	CFS_ALLOC_PTR_ARRAY(srq->isq_rxs, srq->isq_nrx);
+	if (srq->isq_rxs == NULL)
+		return -ENOMEM;
+
+	/* serves peers on all CPTs, so spread the pages over all nodes */
+	rc = kiblnd_alloc_pages(&srq->isq_rx_pages, CFS_CPT_ANY,
+				DIV_ROUND_UP(srq->isq_nrx * IBLND_MSG_SIZE,
+					     PAGE_SIZE));
+	if (rc != 0)
+		return rc;
+
+	for (pg_off = ipg = i = 0; i < srq->isq_nrx; i++) {
+		pg = srq->isq_rx_pages->ibp_pages[ipg];
+		rx = &srq->isq_rxs[i];
+
+		rx->rx_srq = srq;
+		rx->rx_msg = (struct kib_msg *)(((char *)page_address(pg)) +
+						pg_off);
+		rx->rx_msgaddr = kiblnd_dma_map_single(hdev->ibh_ibdev,
+						       rx->rx_msg,
+						       IBLND_MSG_SIZE,
+						       DMA_FROM_DEVICE);
+		LASSERT(!kiblnd_dma_mapping_error(hdev->ibh_ibdev,
+						  rx->rx_msgaddr));
+		KIBLND_UNMAP_ADDR_SET(rx, rx_msgunmap, rx->rx_msgaddr);
+
+		pg_off += IBLND_MSG_SIZE;
+		if (pg_off == PAGE_SIZE) {
+			pg_off = 0;
+			ipg++;
+		}
+	}
+
+	for (i = 0; i < srq->isq_nrx; i++) {
+		rc = kiblnd_post_srq_rx(&srq->isq_rxs[i]);
+		if (rc != 0) {
+			CERROR("Can't post rx %d on SRQ: %d\n", i, rc);
+			return rc;
+		}
+	}
+
+	CDEBUG(D_NET, "%s: SRQ with %d receives\n",
+	       hdev->ibh_dev->ibd_ifname, srq->isq_nrx);
+	return 0;
+}
+
 void
 kiblnd_hdev_destroy(struct kib_hca_dev *hdev)
 {
 	if (hdev->ibh_event_handler.device != NULL)
 		ib_unregister_event_handler(&hdev->ibh_event_handler);
 
+	kiblnd_hdev_cleanup_srq(hdev);
+
 #ifdef HAVE_OFED_IB_GET_DMA_MR
         kiblnd_hdev_cleanup_mrs(hdev);
 #endif
@@ -3043,6 +3316,16 @@ kiblnd_dev_failover(struct kib_dev *dev, struct net *ns)
 	}
 #endif
 
+	if (*kiblnd_tunables.kib_use_srq) {
+		rc = kiblnd_hdev_setup_srq(hdev);
+		if (rc != 0) {
+			CWARN("%s: no shared receive queue, posting receives per connection: %d\n",
+			      dev->ibd_ifname, rc);
+			kiblnd_hdev_cleanup_srq(hdev);
+			rc = 0;
+		}
+	}
+
 	INIT_IB_EVENT_HANDLER(&hdev->ibh_event_handler,
 				hdev->ibh_ibdev, kiblnd_event_handler);
 	ib_register_event_handler(&hdev->ibh_event_handler);
@@ -3387,6 +3670,8 @@ kiblnd_shutdown(struct lnet_ni *ni)
                 LBUG();
 
 	case IBLND_INIT_ALL:
+		debugfs_remove_recursive(net->ibn_debugfs);
+
 		/* nuke all existing peers within this net */
 		kiblnd_del_peer(ni, LNET_NID_ANY);
 
@@ -3593,6 +3878,47 @@ static int kiblnd_dev_start_threads(struct kib_dev *dev, bool newdev, u32 *cpts,
 	return 0;
 }
 
+static int kiblnd_tx_latency_show(struct seq_file *s, void *unused)
+{
+	struct kib_net *net = s->private;
+	int i;
+
+	seq_printf(s, "%-12s %s\n", "usecs", "count");
+	for (i = 0; i < IBLND_LAT_BUCKETS; i++)
+		seq_printf(s, "%-12lu %lld\n", i == 0 ? 0 : BIT(i - 1),
+			   (s64)atomic64_read(&net->ibn_tx_lat[i]));
+
+	return 0;
+}
+
+static int kiblnd_tx_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kiblnd_tx_latency_show, inode->i_private);
+}
+
+/* any write clears the histogram */
+static ssize_t kiblnd_tx_latency_write(struct file *file,
+				       const char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct kib_net *net = file_inode(file)->i_private;
+	int i;
+
+	for (i = 0; i < IBLND_LAT_BUCKETS; i++)
+		atomic64_set(&net->ibn_tx_lat[i], 0);
+
+	return count;
+}
+
+static const struct file_operations kiblnd_tx_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= kiblnd_tx_latency_open,
+	.read		= seq_read,
+	.write		= kiblnd_tx_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int
 kiblnd_startup(struct lnet_ni *ni)
 {
@@ -3728,6 +4054,11 @@ kiblnd_startup(struct lnet_ni *ni)
 
 	write_unlock_irqrestore(&kiblnd_data.kib_global_lock, flags);
 
+	net->ibn_debugfs = debugfs_create_dir(libcfs_nidstr(&ni->ni_nid),
+					      kiblnd_debug_dir);
+	debugfs_create_file("tx_latency", 0644, net->ibn_debugfs, net,
+			    &kiblnd_tx_latency_fops);
+
 	net->ibn_init = IBLND_INIT_ALL;
 
 	return 0;
@@ -3752,6 +4083,7 @@ static const struct lnet_lnd the_o2iblnd = {
 	.lnd_ctl	= kiblnd_ctl,
 	.lnd_send	= kiblnd_send,
 	.lnd_recv	= kiblnd_recv,
+	.lnd_payload_ready = kiblnd_payload_ready,
 	.lnd_get_dev_prio = kiblnd_get_dev_prio,
 	.lnd_nl_get	= kiblnd_nl_get,
 	.lnd_nl_set	= kiblnd_nl_set,
@@ -3919,6 +4251,8 @@ static void ko2inlnd_assert_wire_constants(void)
 static void __exit ko2iblnd_exit(void)
 {
 	lnet_unregister_lnd(&the_o2iblnd);
+
+	debugfs_remove_recursive(kiblnd_debug_dir);
 }
 
 static int __init ko2iblnd_init(void)
@@ -3931,6 +4265,8 @@ static int __init ko2iblnd_init(void)
 	if (rc != 0)
 		return rc;
 
+	kiblnd_debug_dir = debugfs_create_dir("o2iblnd", NULL);
+
 	lnet_register_lnd(&the_o2iblnd);
 
 	return 0;
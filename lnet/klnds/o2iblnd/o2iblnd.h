@@ -86,6 +86,7 @@
 
 #include <net/sock.h>
 #include <linux/in.h>
+#include <linux/debugfs.h>
 
 #include <rdma/rdma_cm.h>
 #include <rdma/ib_cm.h>
@@ -137,6 +138,10 @@ struct kib_tunables {
 	int		 *kib_nscheds;
 	int		 *kib_wrq_sge;		/* # sg elements per wrq */
 	int		 *kib_use_fastreg_gaps; /* enable discontiguous fastreg fragment support */
+	int		 *kib_fastreg_cache;	/* # cached FastReg MRs per pool */
+	int		 *kib_use_srq;		/* shared receive queue per HCA */
+	int		 *kib_srq_size;		/* # rx posted on the SRQ */
+	int		 *kib_busy_poll;	/* CQ busy-poll budget (usecs) */
 };
 
 extern struct kib_tunables  kiblnd_tunables;
@@ -190,6 +195,12 @@ extern struct kib_tunables  kiblnd_tunables;
 /* 2 = LNet msg + Transfer chain */
 #define IBLND_CQ_ENTRIES(c) (IBLND_RECV_WRS(c) + kiblnd_send_wrs(c))
 
+/* an empty SRQ makes the sender retry until a buffer is reposted */
+#define IBLND_RNR_RETRY_INFINITE	7
+
+/* # of log2(usecs) buckets of the tx latency histogram */
+#define IBLND_LAT_BUCKETS		24
+
 struct kib_hca_dev;
 
 /* o2iblnd can run over aliased interface */
@@ -239,6 +250,8 @@ struct kib_hca_dev {
 	__u64                ibh_page_mask;     /* page mask of current HCA */
 	__u64                ibh_mr_size;       /* size of MR */
 	int		     ibh_max_qp_wr;     /* maximum work requests size */
+	int		     ibh_max_srq_wr;	/* maximum SRQ work requests */
+	struct kib_srq	    *ibh_srq;		/* shared receive queue */
 #ifdef HAVE_OFED_IB_GET_DMA_MR
 	struct ib_mr        *ibh_mrs;           /* global MR */
 #endif
@@ -264,6 +277,15 @@ struct kib_pages {
         struct page            *ibp_pages[0];           /* page array */
 };
 
+/* receive buffers shared by all the connections on a HCA */
+struct kib_srq {
+	struct ib_srq		*isq_srq;	/* IB shared receive queue */
+	struct kib_hca_dev	*isq_hdev;	/* device of this SRQ */
+	struct kib_rx		*isq_rxs;	/* the receive buffers... */
+	struct kib_pages	*isq_rx_pages;	/* ...and their memory */
+	int			 isq_nrx;	/* # receive buffers */
+};
+
 struct kib_pool;
 struct kib_poolset;
 
@@ -370,8 +392,22 @@ struct kib_fast_reg_descriptor { /* For fast registration */
 	struct ib_mr			*frd_mr;
 	bool				 frd_valid;
 	bool				 frd_posted;
+	/* # bytes and fragments still registered, 0 if not cacheable */
+	u32				 frd_nob;
+	int				 frd_nfrags;
+	/* only allocated when fastreg_cache is enabled */
+	struct kib_rdma_frag		 frd_frags[];
 };
 
+static inline int kiblnd_frd_size(void)
+{
+	if (*kiblnd_tunables.kib_fastreg_cache <= 0)
+		return sizeof(struct kib_fast_reg_descriptor);
+
+	return offsetof(struct kib_fast_reg_descriptor,
+			frd_frags[IBLND_MAX_RDMA_FRAGS]);
+}
+
 struct kib_fmr_pool {
 	struct list_head	fpo_list;	/* chain on pool list */
 	struct kib_hca_dev     *fpo_hdev;	/* device for this pool */
@@ -385,6 +421,9 @@ struct kib_fmr_pool {
 		struct { /* For fast registration */
 			struct list_head  fpo_pool_list;
 			int		  fpo_pool_size;
+			/* registrations kept for reuse, MRU first */
+			struct list_head  fpo_cache_list;
+			int		  fpo_ncached;
 		} fast_reg;
 #ifdef HAVE_OFED_FMR_POOL_API
 	};
@@ -431,6 +470,10 @@ struct kib_net {
 
 	struct kib_dev		*ibn_dev;	/* underlying IB device */
 	struct lnet_ni          *ibn_ni;        /* LNet interface */
+
+	/* tx completion latency, bucket N counts [2^(N-1), 2^N) usecs */
+	atomic64_t		ibn_tx_lat[IBLND_LAT_BUCKETS];
+	struct dentry		*ibn_debugfs;	/* per NI stats */
 };
 
 #define KIB_THREAD_SHIFT		16
@@ -499,6 +542,8 @@ struct kib_rx {					/* receive message */
 	struct list_head	rx_list;
 	/* owning conn */
 	struct kib_conn	       *rx_conn;
+	/* shared receive queue I'm posted on, NULL if rx_conn's own */
+	struct kib_srq	       *rx_srq;
 	/* # bytes received (-1 while posted) */
 	int			rx_nob;
 	/* message buffer (host vaddr) */
@@ -518,6 +563,13 @@ struct kib_rx {					/* receive message */
 #define IBLND_POSTRX_PEER_CREDIT  2             /* post: give peer_ni back 1 credit */
 #define IBLND_POSTRX_RSRVD_CREDIT 3             /* post: give myself back 1 reserved credit */
 
+/* tx_ct_state: payload of a cut-through PUT/REPLY (lnet_msg_is_cut_through()) */
+#define IBLND_CT_NONE		0	/* payload in place */
+#define IBLND_CT_WAIT		1	/* payload on its way in */
+#define IBLND_CT_ACKED		2	/* ...and PUT_ACK kept in tx_msg */
+#define IBLND_CT_DONE		3	/* ...and completion deferred */
+#define IBLND_CT_FAILED		4	/* payload failed with tx_status */
+
 struct kib_tx {					/* transmit message */
 	/* queue on idle_txs ibc_tx_queue etc. */
 	struct list_head	tx_list;
@@ -539,6 +591,8 @@ struct kib_tx {					/* transmit message */
 	enum lnet_msg_hstatus	tx_hstatus;
 	/* completion deadline */
 	ktime_t			tx_deadline;
+	/* when first queued, for the latency histogram */
+	ktime_t			tx_start;
 	/* completion cookie */
 	__u64			tx_cookie;
 	/* lnet msgs to finalize on completion */
@@ -571,6 +625,10 @@ struct kib_tx {					/* transmit message */
 	struct kib_fmr		tx_fmr;
 				/* dma direction */
 	int			tx_dmadir;
+	/* cut-through state, IBLND_CT_* */
+	int			tx_ct_state;
+	/* serialises tx_ct_state, nests inside ibc_lock */
+	spinlock_t		tx_ct_lock;
 };
 
 struct kib_connvars {
@@ -625,6 +683,8 @@ struct kib_conn {
 	unsigned int		ibc_ready:1;
 	/* time of last send */
 	ktime_t			ibc_last_send;
+	/* busy-poll the CQ rather than re-arming it until then */
+	ktime_t			ibc_poll_deadline;
 	/** link chain for kiblnd_check_conns only */
 	struct list_head	ibc_connd_list;
 	/** rxs completed before ESTABLISHED */
@@ -1200,8 +1260,11 @@ void kiblnd_pack_msg(struct lnet_ni *ni, struct kib_msg *msg, int version,
 		     int credits, lnet_nid_t dstnid, __u64 dststamp);
 int kiblnd_unpack_msg(struct kib_msg *msg, int nob);
 int kiblnd_post_rx(struct kib_rx *rx, int credit);
+int kiblnd_post_srq_rx(struct kib_rx *rx);
 
 int kiblnd_send(struct lnet_ni *ni, void *private, struct lnet_msg *lntmsg);
+void kiblnd_payload_ready(struct lnet_ni *ni, struct lnet_msg *lntmsg,
+			  int status);
 int kiblnd_recv(struct lnet_ni *ni, void *private, struct lnet_msg *lntmsg,
 		int delayed, unsigned int niov,
 		struct bio_vec *kiov, unsigned int offset, unsigned int mlen,
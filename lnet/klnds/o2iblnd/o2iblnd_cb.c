@@ -53,6 +53,15 @@ static void kiblnd_queue_tx(struct kib_tx *tx, struct kib_conn *conn);
 static void kiblnd_unmap_tx(struct kib_tx *tx);
 static void kiblnd_check_sends_locked(struct kib_conn *conn);
 
+static void
+kiblnd_tx_latency(struct kib_net *net, ktime_t start)
+{
+	s64 usecs = ktime_us_delta(ktime_get(), start);
+	int bucket = usecs > 0 ? fls64(usecs) : 0;
+
+	atomic64_inc(&net->ibn_tx_lat[min(bucket, IBLND_LAT_BUCKETS - 1)]);
+}
+
 static void
 kiblnd_tx_done(struct kib_tx *tx)
 {
@@ -66,6 +75,19 @@ kiblnd_tx_done(struct kib_tx *tx)
 	LASSERT (!tx->tx_waiting);              /* mustn't be awaiting peer_ni response */
 	LASSERT (tx->tx_pool != NULL);
 
+	/* a cut-through send completes once its payload has arrived */
+	if (tx->tx_ct_state != IBLND_CT_NONE) {
+		spin_lock(&tx->tx_ct_lock);
+		if (tx->tx_ct_state == IBLND_CT_WAIT ||
+		    tx->tx_ct_state == IBLND_CT_ACKED) {
+			tx->tx_ct_state = IBLND_CT_DONE;
+			spin_unlock(&tx->tx_ct_lock);
+			return;
+		}
+		tx->tx_ct_state = IBLND_CT_NONE;
+		spin_unlock(&tx->tx_ct_lock);
+	}
+
 	kiblnd_unmap_tx(tx);
 
 	/* tx may have up to 2 lnet msgs to finalise */
@@ -73,6 +95,13 @@ kiblnd_tx_done(struct kib_tx *tx)
 	lntmsg[1] = tx->tx_lntmsg[1]; tx->tx_lntmsg[1] = NULL;
 	rc = tx->tx_status;
 
+	if (ktime_to_ns(tx->tx_start)) {
+		if (rc == 0)
+			kiblnd_tx_latency(tx->tx_pool->tpo_pool.po_owner->ps_net,
+					  tx->tx_start);
+		tx->tx_start = ktime_set(0, 0);
+	}
+
 	if (tx->tx_conn != NULL) {
 		kiblnd_conn_decref(tx->tx_conn);
 		tx->tx_conn = NULL;
@@ -146,9 +175,8 @@ kiblnd_get_idle_tx(struct lnet_ni *ni, lnet_nid_t target)
 }
 
 static void
-kiblnd_drop_rx(struct kib_rx *rx)
+kiblnd_release_rx(struct kib_conn *conn)
 {
-	struct kib_conn *conn = rx->rx_conn;
 	struct kib_sched_info *sched = conn->ibc_sched;
 	unsigned long flags;
 
@@ -160,6 +188,70 @@ kiblnd_drop_rx(struct kib_rx *rx)
 	kiblnd_conn_decref(conn);
 }
 
+static void
+kiblnd_drop_rx(struct kib_rx *rx)
+{
+	struct kib_conn *conn = rx->rx_conn;
+
+	/* a shared rx isn't mine to drop, it goes back to the SRQ */
+	if (rx->rx_srq != NULL && kiblnd_post_srq_rx(rx) != 0)
+		CERROR("Can't repost rx on SRQ\n");
+
+	kiblnd_release_rx(conn);
+}
+
+/* Take ownership of a shared rx completed on \a conn's QP, until it is
+ * reposted or dropped. */
+static void
+kiblnd_claim_srq_rx(struct kib_conn *conn, struct kib_rx *rx)
+{
+	struct kib_sched_info *sched = conn->ibc_sched;
+	unsigned long flags;
+
+	rx->rx_conn = conn;
+	kiblnd_conn_addref(conn);
+
+	spin_lock_irqsave(&sched->ibs_lock, flags);
+	conn->ibc_nrx++;
+	spin_unlock_irqrestore(&sched->ibs_lock, flags);
+}
+
+int
+kiblnd_post_srq_rx(struct kib_rx *rx)
+{
+	struct kib_srq *srq = rx->rx_srq;
+	struct kib_hca_dev *hdev = srq->isq_hdev;
+	struct ib_recv_wr *bad_wrq = NULL;
+	int rc;
+
+#ifdef HAVE_OFED_IB_GET_DMA_MR
+	rx->rx_sge.lkey   = hdev->ibh_mrs->lkey;
+#else
+	rx->rx_sge.lkey   = hdev->ibh_pd->local_dma_lkey;
+#endif
+	rx->rx_sge.addr   = rx->rx_msgaddr;
+	rx->rx_sge.length = IBLND_MSG_SIZE;
+
+	rx->rx_wrq.next = NULL;
+	rx->rx_wrq.sg_list = &rx->rx_sge;
+	rx->rx_wrq.num_sge = 1;
+	rx->rx_wrq.wr_id = kiblnd_ptr2wreqid(rx, IBLND_WID_RX);
+
+	rx->rx_conn = NULL;			/* any conn can complete it */
+	rx->rx_nob = -1;			/* flag posted */
+
+#ifdef HAVE_OFED_IB_POST_SEND_RECV_CONST
+	rc = ib_post_srq_recv(srq->isq_srq, &rx->rx_wrq,
+			      (const struct ib_recv_wr **)&bad_wrq);
+#else
+	rc = ib_post_srq_recv(srq->isq_srq, &rx->rx_wrq, &bad_wrq);
+#endif
+	if (unlikely(rc != 0))
+		rx->rx_nob = 0;
+
+	return rc;
+}
+
 int
 kiblnd_post_rx(struct kib_rx *rx, int credit)
 {
@@ -205,12 +297,19 @@ kiblnd_post_rx(struct kib_rx *rx, int credit)
 	 * own this rx (and rx::rx_conn) anymore, LU-5678.
 	 */
 	kiblnd_conn_addref(conn);
+	if (rx->rx_srq != NULL) {
+		/* the buffer goes back to the SRQ straight away, only the
+		 * credit it returns is accounted to this conn */
+		rc = kiblnd_post_srq_rx(rx);
+		kiblnd_release_rx(conn);
+	} else {
 #ifdef HAVE_OFED_IB_POST_SEND_RECV_CONST
-	rc = ib_post_recv(conn->ibc_cmid->qp, &rx->rx_wrq,
-			  (const struct ib_recv_wr **)&bad_wrq);
+		rc = ib_post_recv(conn->ibc_cmid->qp, &rx->rx_wrq,
+				  (const struct ib_recv_wr **)&bad_wrq);
 #else
-	rc = ib_post_recv(conn->ibc_cmid->qp, &rx->rx_wrq, &bad_wrq);
+		rc = ib_post_recv(conn->ibc_cmid->qp, &rx->rx_wrq, &bad_wrq);
 #endif
+	}
 	if (unlikely(rc != 0)) {
 		CERROR("Can't post rx for %s: %d, bad_wrq: %p\n",
 		       libcfs_nid2str(conn->ibc_peer->ibp_nid), rc, bad_wrq);
@@ -222,7 +321,8 @@ kiblnd_post_rx(struct kib_rx *rx, int credit)
 
 	if (unlikely(rc != 0)) {
 		kiblnd_close_conn(conn, rc);
-		kiblnd_drop_rx(rx);	/* No more posts for this rx */
+		if (rx->rx_srq == NULL)
+			kiblnd_drop_rx(rx);	/* No more posts for this rx */
 		goto out;
 	}
 
@@ -331,6 +431,48 @@ kiblnd_send_completion(struct kib_conn *conn, int type, int status, u64 cookie)
         kiblnd_queue_tx(tx, conn);
 }
 
+static void
+kiblnd_put_done_error(struct kib_conn *conn, struct kib_tx *tx, int status,
+		      u64 cookie)
+{
+	tx->tx_status = status;
+	tx->tx_msg->ibm_u.completion.ibcm_status = status;
+	tx->tx_msg->ibm_u.completion.ibcm_cookie = cookie;
+	kiblnd_init_tx_msg(conn->ibc_peer->ibp_ni, tx, IBLND_MSG_PUT_DONE,
+			   sizeof(struct kib_completion_msg));
+}
+
+/* PUT_ACK for a cut-through send.  Returns 1 if it has been kept for
+ * kiblnd_payload_ready(), 0 if the payload is in place, or the payload's
+ * error. */
+static int
+kiblnd_ct_put_ack_locked(struct kib_tx *tx, struct kib_putack_msg *putack)
+{
+	int rc = 0;
+
+	if (tx->tx_ct_state == IBLND_CT_NONE)
+		return 0;
+
+	spin_lock(&tx->tx_ct_lock);
+	switch (tx->tx_ct_state) {
+	case IBLND_CT_WAIT:
+		/* the peer has the PUT_REQ, so tx_msg can hold this */
+		memcpy(&tx->tx_msg->ibm_u.putack, putack,
+		       offsetof(struct kib_putack_msg,
+				ibpam_rd.rd_frags[putack->ibpam_rd.rd_nfrags]));
+		tx->tx_ct_state = IBLND_CT_ACKED;
+		rc = 1;
+		break;
+	case IBLND_CT_FAILED:
+		tx->tx_ct_state = IBLND_CT_NONE;
+		rc = tx->tx_status;
+		break;
+	}
+	spin_unlock(&tx->tx_ct_lock);
+
+	return rc;
+}
+
 static void
 kiblnd_handle_rx(struct kib_rx *rx)
 {
@@ -437,8 +579,12 @@ kiblnd_handle_rx(struct kib_rx *rx)
 		spin_lock(&conn->ibc_lock);
 		tx = kiblnd_find_waiting_tx_locked(conn, IBLND_MSG_PUT_REQ,
 					msg->ibm_u.putack.ibpam_src_cookie);
-		if (tx != NULL)
-			list_del(&tx->tx_list);
+		rc2 = 0;
+		if (tx != NULL) {
+			rc2 = kiblnd_ct_put_ack_locked(tx, &msg->ibm_u.putack);
+			if (rc2 <= 0)
+				list_del(&tx->tx_list);
+		}
 		spin_unlock(&conn->ibc_lock);
 
                 if (tx == NULL) {
@@ -448,6 +594,9 @@ kiblnd_handle_rx(struct kib_rx *rx)
                         break;
                 }
 
+		if (rc2 > 0)	/* kiblnd_payload_ready() does the RDMA */
+			break;
+
                 LASSERT (tx->tx_waiting);
                 /* CAVEAT EMPTOR: I could be racing with tx_complete, but...
                  * (a) I can overwrite tx_msg since my peer_ni has received it!
@@ -455,13 +604,19 @@ kiblnd_handle_rx(struct kib_rx *rx)
 
 		tx->tx_nwrq = tx->tx_nsge = 0;	/* overwrite PUT_REQ */
 
-                rc2 = kiblnd_init_rdma(conn, tx, IBLND_MSG_PUT_DONE,
-                                       kiblnd_rd_size(&msg->ibm_u.putack.ibpam_rd),
-                                       &msg->ibm_u.putack.ibpam_rd,
-                                       msg->ibm_u.putack.ibpam_dst_cookie);
-                if (rc2 < 0)
-                        CERROR("Can't setup rdma for PUT to %s: %d\n",
-                               libcfs_nid2str(conn->ibc_peer->ibp_nid), rc2);
+		if (rc2 < 0) {
+			kiblnd_put_done_error(conn, tx, rc2,
+					msg->ibm_u.putack.ibpam_dst_cookie);
+		} else {
+			rc2 = kiblnd_init_rdma(conn, tx, IBLND_MSG_PUT_DONE,
+				kiblnd_rd_size(&msg->ibm_u.putack.ibpam_rd),
+				&msg->ibm_u.putack.ibpam_rd,
+				msg->ibm_u.putack.ibpam_dst_cookie);
+			if (rc2 < 0)
+				CERROR("Can't setup rdma for PUT to %s: %d\n",
+				       libcfs_nid2str(conn->ibc_peer->ibp_nid),
+				       rc2);
+		}
 
 		spin_lock(&conn->ibc_lock);
 		tx->tx_waiting = 0;	/* clear waiting and queue atomically */
@@ -1310,6 +1465,8 @@ kiblnd_queue_tx_locked(struct kib_tx *tx, struct kib_conn *conn)
 	timeout_ns = kiblnd_timeout() * NSEC_PER_SEC;
 	tx->tx_queued = 1;
 	tx->tx_deadline = ktime_add_ns(ktime_get(), timeout_ns);
+	if (!ktime_to_ns(tx->tx_start))
+		tx->tx_start = ktime_get();
 
         if (tx->tx_conn == NULL) {
                 kiblnd_conn_addref(conn);
@@ -1798,6 +1955,13 @@ kiblnd_send(struct lnet_ni *ni, void *private, struct lnet_msg *lntmsg)
 		/* finalise lntmsg[0,1] on completion */
 		tx->tx_lntmsg[0] = lntmsg;
 		tx->tx_waiting = 1;             /* waiting for PUT_{ACK,NAK} */
+
+		/* the payload is still being received: RDMA it once
+		 * kiblnd_payload_ready() says it's there */
+		if (lnet_msg_is_cut_through(lntmsg)) {
+			tx->tx_ct_state = IBLND_CT_WAIT;
+			lntmsg->msg_ct_private = tx;
+		}
 		kiblnd_launch_tx(ni, tx, lnet_nid_to_nid4(&target->nid));
 		return 0;
 	}
@@ -1805,6 +1969,7 @@ kiblnd_send(struct lnet_ni *ni, void *private, struct lnet_msg *lntmsg)
 	/* send IMMEDIATE */
 	LASSERT(offsetof(struct kib_msg, ibm_u.immediate.ibim_payload[payload_nob])
 		<= IBLND_MSG_SIZE);
+	LASSERT(!lnet_msg_is_cut_through(lntmsg));
 
 	ibmsg = tx->tx_msg;
 	lnet_hdr_to_nid4(hdr, &ibmsg->ibm_u.immediate.ibim_hdr);
@@ -1854,6 +2019,84 @@ kiblnd_send(struct lnet_ni *ni, void *private, struct lnet_msg *lntmsg)
 	return 0;
 }
 
+void
+kiblnd_payload_ready(struct lnet_ni *ni, struct lnet_msg *lntmsg, int status)
+{
+	struct kib_tx *tx = lntmsg->msg_ct_private;
+	struct kib_rdma_desc *rd;
+	struct kib_conn *conn;
+	u64 cookie;
+	int state;
+	int rc;
+
+	LASSERT(tx != NULL);
+
+	spin_lock(&tx->tx_ct_lock);
+	state = tx->tx_ct_state;
+	switch (state) {
+	case IBLND_CT_WAIT:
+		/* no PUT_ACK yet, it will find the payload's status */
+		if (status < 0) {
+			tx->tx_status = status;
+			tx->tx_ct_state = IBLND_CT_FAILED;
+		} else {
+			tx->tx_ct_state = IBLND_CT_NONE;
+		}
+		spin_unlock(&tx->tx_ct_lock);
+		return;
+	case IBLND_CT_DONE:
+		tx->tx_ct_state = IBLND_CT_NONE;
+		spin_unlock(&tx->tx_ct_lock);
+		kiblnd_tx_done(tx);
+		return;
+	}
+	LASSERT(state == IBLND_CT_ACKED);
+	/* tx can't complete while ACKED, so its conn is still there */
+	conn = tx->tx_conn;
+	kiblnd_conn_addref(conn);
+	spin_unlock(&tx->tx_ct_lock);
+
+	spin_lock(&conn->ibc_lock);
+	spin_lock(&tx->tx_ct_lock);
+	state = tx->tx_ct_state;
+	tx->tx_ct_state = IBLND_CT_NONE;
+	spin_unlock(&tx->tx_ct_lock);
+
+	if (state == IBLND_CT_DONE || !tx->tx_waiting) {
+		/* aborted with its conn, complete it now or leave it to
+		 * kiblnd_tx_done() */
+		spin_unlock(&conn->ibc_lock);
+		if (state == IBLND_CT_DONE)
+			kiblnd_tx_done(tx);
+		kiblnd_conn_decref(conn);
+		return;
+	}
+	list_del(&tx->tx_list);
+	spin_unlock(&conn->ibc_lock);
+
+	rd = &tx->tx_msg->ibm_u.putack.ibpam_rd;
+	cookie = tx->tx_msg->ibm_u.putack.ibpam_dst_cookie;
+	tx->tx_nwrq = tx->tx_nsge = 0;
+
+	if (status < 0) {
+		kiblnd_put_done_error(conn, tx, status, cookie);
+	} else {
+		rc = kiblnd_init_rdma(conn, tx, IBLND_MSG_PUT_DONE,
+				      kiblnd_rd_size(rd), rd, cookie);
+		if (rc < 0)
+			CERROR("Can't setup rdma for PUT to %s: %d\n",
+			       libcfs_nid2str(conn->ibc_peer->ibp_nid), rc);
+	}
+
+	spin_lock(&conn->ibc_lock);
+	tx->tx_waiting = 0;	/* clear waiting and queue atomically */
+	kiblnd_queue_tx_locked(tx, conn);
+	kiblnd_check_sends_locked(conn);
+	spin_unlock(&conn->ibc_lock);
+
+	kiblnd_conn_decref(conn);
+}
+
 static void
 kiblnd_reply(struct lnet_ni *ni, struct kib_rx *rx, struct lnet_msg *lntmsg)
 {
@@ -2292,6 +2535,11 @@ kiblnd_finalise_conn(struct kib_conn *conn)
 	 * rdma_disconnect() does this for free. */
 	kiblnd_abort_receives(conn);
 
+	/* The QP of a conn using the SRQ has no receives of its own to
+	 * flush, drop the claim taken in kiblnd_create_conn() instead. */
+	if (conn->ibc_hdev->ibh_srq != NULL)
+		kiblnd_release_rx(conn);
+
 	kiblnd_set_conn_state(conn, IBLND_CONN_DISCONNECTED);
 
 	/* Complete all tx descs not waiting for sends to complete.
@@ -2813,7 +3061,9 @@ kiblnd_passive_connect(struct rdma_cm_id *cmid, void *priv, int priv_nob)
 	cp.initiator_depth     = 0;
 	cp.flow_control        = 1;
 	cp.retry_count         = *kiblnd_tunables.kib_retry_count;
-	cp.rnr_retry_count     = *kiblnd_tunables.kib_rnr_retry_count;
+	cp.rnr_retry_count     = conn->ibc_hdev->ibh_srq != NULL ?
+				 IBLND_RNR_RETRY_INFINITE :
+				 *kiblnd_tunables.kib_rnr_retry_count;
 
 	CDEBUG(D_NET, "Accept %s conn %p\n", libcfs_nid2str(nid), conn);
 
@@ -3236,7 +3486,9 @@ kiblnd_active_connect(struct rdma_cm_id *cmid)
         cp.initiator_depth     = 0;
         cp.flow_control        = 1;
         cp.retry_count         = *kiblnd_tunables.kib_retry_count;
-        cp.rnr_retry_count     = *kiblnd_tunables.kib_rnr_retry_count;
+	cp.rnr_retry_count     = conn->ibc_hdev->ibh_srq != NULL ?
+				 IBLND_RNR_RETRY_INFINITE :
+				 *kiblnd_tunables.kib_rnr_retry_count;
 
         LASSERT(cmid->context == (void *)conn);
         LASSERT(conn->ibc_cmid == cmid);
@@ -3805,6 +4057,12 @@ kiblnd_qp_event(struct ib_event *event, void *arg)
 		atomic_set(&conn->ibc_peer->ibp_ni->ni_fatal_error_on, 0);
 		return;
 
+	case IB_EVENT_QP_LAST_WQE_REACHED:
+		/* QP on the SRQ is in error state, all its receives done */
+		CDEBUG(D_NET, "%s: last WQE reached\n",
+		       libcfs_nid2str(conn->ibc_peer->ibp_nid));
+		return;
+
 	default:
 		CERROR("%s: Async QP event type %d\n",
 		       libcfs_nid2str(conn->ibc_peer->ibp_nid), event->event);
@@ -3813,8 +4071,10 @@ kiblnd_qp_event(struct ib_event *event, void *arg)
 }
 
 static void
-kiblnd_complete (struct ib_wc *wc)
+kiblnd_complete(struct kib_conn *conn, struct ib_wc *wc)
 {
+	struct kib_rx *rx;
+
 	switch (kiblnd_wreqid2type(wc->wr_id)) {
 	default:
 		LBUG();
@@ -3840,10 +4100,13 @@ kiblnd_complete (struct ib_wc *wc)
                 kiblnd_tx_complete(kiblnd_wreqid2ptr(wc->wr_id), wc->status);
                 return;
 
-        case IBLND_WID_RX:
-                kiblnd_rx_complete(kiblnd_wreqid2ptr(wc->wr_id), wc->status,
-                                   wc->byte_len);
-                return;
+	case IBLND_WID_RX:
+		rx = kiblnd_wreqid2ptr(wc->wr_id);
+		if (rx->rx_srq != NULL)
+			kiblnd_claim_srq_rx(conn, rx);
+
+		kiblnd_rx_complete(rx, wc->status, wc->byte_len);
+		return;
         }
 }
 
@@ -3899,6 +4162,7 @@ kiblnd_scheduler(void *arg)
 	unsigned long flags;
 	struct ib_wc wc;
 	bool did_something;
+	bool busy;
 	int rc;
 
 	init_wait(&wait);
@@ -3935,9 +4199,21 @@ kiblnd_scheduler(void *arg)
 			spin_unlock_irqrestore(&sched->ibs_lock, flags);
 
 			wc.wr_id = IBLND_WID_INVAL;
+			busy = false;
 
 			rc = ib_poll_cq(conn->ibc_cq, 1, &wc);
-			if (rc == 0) {
+			if (rc > 0 && *kiblnd_tunables.kib_busy_poll > 0)
+				conn->ibc_poll_deadline =
+					ktime_add_us(ktime_get(),
+						     *kiblnd_tunables.kib_busy_poll);
+			else if (rc == 0)
+				busy = ktime_before(ktime_get(),
+						    conn->ibc_poll_deadline);
+
+			/* Completions arrived recently: keep polling instead
+			 * of taking an interrupt and a wakeup for the next
+			 * one, until the busy-poll budget runs out */
+			if (rc == 0 && !busy) {
 				rc = ib_req_notify_cq(conn->ibc_cq,
 						      IB_CQ_NEXT_COMP);
 				if (rc < 0) {
@@ -3979,7 +4255,7 @@ kiblnd_scheduler(void *arg)
 
 			spin_lock_irqsave(&sched->ibs_lock, flags);
 
-			if (rc != 0 || conn->ibc_ready) {
+			if (rc != 0 || conn->ibc_ready || busy) {
 				/* There may be another completion waiting; get
 				 * another scheduler to check while I handle
 				 * this one... */
@@ -3987,7 +4263,7 @@ kiblnd_scheduler(void *arg)
 				kiblnd_conn_addref(conn);
 				list_add_tail(&conn->ibc_sched_list,
 					      &sched->ibs_conns);
-				if (waitqueue_active(&sched->ibs_waitq))
+				if (!busy && waitqueue_active(&sched->ibs_waitq))
 					wake_up(&sched->ibs_waitq);
 			} else {
 				conn->ibc_scheduled = 0;
@@ -3995,7 +4271,7 @@ kiblnd_scheduler(void *arg)
 
 			if (rc != 0) {
 				spin_unlock_irqrestore(&sched->ibs_lock, flags);
-				kiblnd_complete(&wc);
+				kiblnd_complete(conn, &wc);
 
 				spin_lock_irqsave(&sched->ibs_lock, flags);
 			}
@@ -163,6 +163,23 @@ static int fmr_cache = 1;
 module_param(fmr_cache, int, 0444);
 MODULE_PARM_DESC(fmr_cache, "non-zero to enable FMR caching");
 
+/* NB: registrations are only kept for local (RDMA source) mappings */
+static int fastreg_cache;
+module_param(fastreg_cache, int, 0444);
+MODULE_PARM_DESC(fastreg_cache, "# of FastReg registrations kept for reuse on each pool (0 to disable)");
+
+static int use_srq;
+module_param(use_srq, int, 0444);
+MODULE_PARM_DESC(use_srq, "post receives on one shared receive queue per HCA instead of each connection");
+
+static int srq_size = 8192;
+module_param(srq_size, int, 0444);
+MODULE_PARM_DESC(srq_size, "# receive buffers posted on the shared receive queue");
+
+static int busy_poll;
+module_param(busy_poll, int, 0644);
+MODULE_PARM_DESC(busy_poll, "usecs to keep polling a CQ after its last completion before re-arming its interrupt (0 to disable)");
+
 /*
  * 0: disable failover
  * 1: enable failover if necessary
@@ -199,6 +216,10 @@ struct kib_tunables kiblnd_tunables = {
 	.kib_nscheds		    = &nscheds,
 	.kib_wrq_sge		    = &wrq_sge,
 	.kib_use_fastreg_gaps       = &use_fastreg_gaps,
+	.kib_fastreg_cache	    = &fastreg_cache,
+	.kib_use_srq		    = &use_srq,
+	.kib_srq_size		    = &srq_size,
+	.kib_busy_poll		    = &busy_poll,
 };
 
 static struct lnet_ioctl_config_o2iblnd_tunables default_tunables;
@@ -916,6 +916,16 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_conn_cb *conn_cb,
 	conn->ksnc_tx_scheduled = 0;
 	conn->ksnc_tx_carrier = NULL;
 	atomic_set (&conn->ksnc_tx_nob, 0);
+	conn->ksnc_zc_msg = 0;
+	INIT_LIST_HEAD(&conn->ksnc_zc_msg_list);
+	/* nothing released yet, the socket numbers sends from 0 */
+	conn->ksnc_zc_msg_done = (__u32)-1;
+#ifdef HAVE_HRTIMER_SOFT
+	hrtimer_init(&conn->ksnc_coalesce_timer, CLOCK_MONOTONIC,
+		     HRTIMER_MODE_REL_SOFT);
+	conn->ksnc_coalesce_timer.function = ksocknal_coalesce_timeout;
+	conn->ksnc_coalescing = 0;
+#endif
 
 	LIBCFS_ALLOC(hello, offsetof(struct ksock_hello_msg,
 				     kshm_ips[LNET_INTERFACES_NUM]));
@@ -1129,7 +1139,8 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_conn_cb *conn_cb,
 	peer_ni->ksnp_send_keepalive = 0;
 	peer_ni->ksnp_error = 0;
 
-	sched = ksocknal_choose_scheduler_locked(cpt);
+	sched = ksocknal_choose_scheduler_locked(ksocknal_lib_conn_cpt(conn,
+									cpt));
 	if (!sched) {
 		CERROR("no schedulers available. node is unhealthy\n");
 		goto failed_2;
@@ -1155,6 +1166,7 @@ ksocknal_create_conn(struct lnet_ni *ni, struct ksock_conn_cb *conn_cb,
 	ksocknal_new_packet(conn, 0);
 
 	conn->ksnc_zc_capable = ksocknal_lib_zc_capable(conn);
+	conn->ksnc_zc_msg = ksocknal_lib_zc_msg_capable(conn);
 
 	/* Take packets blocking for this connection. */
 	list_for_each_entry_safe(tx, txtmp, &peer_ni->ksnp_tx_queue, tx_list) {
@@ -1409,6 +1421,7 @@ void
 ksocknal_finalize_zcreq(struct ksock_conn *conn)
 {
 	struct ksock_peer_ni *peer_ni = conn->ksnc_peer;
+	struct ksock_sched *sched = conn->ksnc_scheduler;
 	struct ksock_tx *tx;
 	struct ksock_tx *tmp;
 	LIST_HEAD(zlist);
@@ -1433,6 +1446,15 @@ ksocknal_finalize_zcreq(struct ksock_conn *conn)
 
 	spin_unlock(&peer_ni->ksnp_lock);
 
+	/* MSG_ZEROCOPY sends the socket never reported as released */
+	spin_lock_bh(&sched->kss_lock);
+
+	list_for_each_entry(tx, &conn->ksnc_zc_msg_list, tx_zc_list)
+		tx->tx_zc_aborted = 1;
+	list_splice_tail_init(&conn->ksnc_zc_msg_list, &zlist);
+
+	spin_unlock_bh(&sched->kss_lock);
+
 	while ((tx = list_first_entry_or_null(&zlist, struct ksock_tx,
 					      tx_zc_list)) != NULL) {
 		list_del(&tx->tx_zc_list);
@@ -2174,6 +2196,7 @@ ksocknal_base_shutdown(void)
 				LASSERT(list_empty(&sched->kss_tx_conns));
 				LASSERT(list_empty(&sched->kss_rx_conns));
 				LASSERT(list_empty(&sched->kss_zombie_noop_txs));
+				LASSERT(list_empty(&sched->kss_zc_done_txs));
 				LASSERT(sched->kss_nconns == 0);
 			}
 		}
@@ -2275,6 +2298,7 @@ ksocknal_base_startup(void)
 		INIT_LIST_HEAD(&sched->kss_rx_conns);
 		INIT_LIST_HEAD(&sched->kss_tx_conns);
 		INIT_LIST_HEAD(&sched->kss_zombie_noop_txs);
+		INIT_LIST_HEAD(&sched->kss_zc_done_txs);
 		init_waitqueue_head(&sched->kss_waitq);
         }
 
@@ -33,6 +33,7 @@
 
 #include <linux/crc32.h>
 #include <linux/errno.h>
+#include <linux/hrtimer.h>
 #include <linux/if.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
@@ -102,6 +103,8 @@ struct ksock_sched {
 	struct list_head kss_tx_conns;
 	/* zombie noop tx list */
 	struct list_head kss_zombie_noop_txs;
+	/* MSG_ZEROCOPY txs released by the socket */
+	struct list_head kss_zc_done_txs;
 	/* where scheduler sleeps */
 	wait_queue_head_t kss_waitq;
 	/* # connections assigned to this scheduler */
@@ -159,6 +162,12 @@ struct ksock_tunables {
         int              *ksnd_zc_recv;         /* enable ZC receive (for Chelsio TOE) */
         int              *ksnd_zc_recv_min_nfrags; /* minimum # of fragments to enable ZC receive */
         int              *ksnd_irq_affinity;    /* enable IRQ affinity? */
+	int		 *ksnd_zc_msg;		/* ZC send with MSG_ZEROCOPY? */
+	int		 *ksnd_tx_batch;	/* # txs sent per conn per pass */
+	int		 *ksnd_coalesce_usecs;	/* max hold of small txs */
+	int		 *ksnd_coalesce_bytes;	/* max bytes of held txs */
+	int		 *ksnd_conn_affinity;	/* sched on CPT receiving conn? */
+	int		 *ksnd_rx_read_sock;	/* rx payload by tcp_read_sock? */
 #ifdef SOCKNAL_BACKOFF
         int              *ksnd_backoff_init;    /* initial TCP backoff */
         int              *ksnd_backoff_max;     /* maximum TCP backoff */
@@ -276,6 +285,9 @@ struct ksock_tx {			/* transmit packet */
 	unsigned short	tx_zc_capable:1; /* payload is large enough for ZC */
 	unsigned short	tx_zc_checked:1; /* Have I checked if I should ZC? */
 	unsigned short	tx_nonblk:1;	/* it's a non-blocking ACK */
+	unsigned short	tx_zc_msg:1;	/* send payload with MSG_ZEROCOPY */
+	unsigned short	tx_zc_sent:1;	/* MSG_ZEROCOPY send(s) in flight */
+	__u32		tx_zc_id;	/* id of last MSG_ZEROCOPY send */
 	struct bio_vec *tx_kiov;	/* packet page frags */
 	struct ksock_conn *tx_conn;	/* owning conn */
 	struct lnet_msg	*tx_lnetmsg;	/* lnet message for lnet_finalize() */
@@ -312,6 +324,8 @@ struct ksock_conn {
 							 * data_ready() cb */
 	void			*ksnc_saved_write_space; /* socket's original
 							  * write_space() cb */
+	void			*ksnc_saved_error_report; /* socket's original
+							   * error_report() cb */
 	refcount_t		ksnc_conn_refcount;	/* conn refcount */
 	refcount_t		ksnc_sock_refcount;	/* sock refcount */
 	struct ksock_sched	*ksnc_scheduler;	/* who schedules this
@@ -372,6 +386,20 @@ struct ksock_conn {
 	int			ksnc_tx_scheduled;
 	/* time stamp of the last posted TX */
 	time64_t		ksnc_tx_last_post;
+	/* ZC by MSG_ZEROCOPY, cleared if the stack copies anyway */
+	int			ksnc_zc_msg;
+	/* sent MSG_ZEROCOPY txs waiting for the socket to release their
+	 * pages, in send order, protected by kss_lock
+	 */
+	struct list_head	ksnc_zc_msg_list;
+	/* highest MSG_ZEROCOPY id released by the socket */
+	__u32			ksnc_zc_msg_done;
+#ifdef HAVE_HRTIMER_SOFT
+	/* schedules the small txs held back to be sent together */
+	struct hrtimer		ksnc_coalesce_timer;
+	/* ksnc_coalesce_timer armed, protected by kss_lock */
+	int			ksnc_coalescing;
+#endif
 };
 
 #define SOCKNAL_CONN_COUNT_MAX_BITS	8	/* max conn count bits */
@@ -662,8 +690,15 @@ int ksocknal_recv_hello(struct lnet_ni *ni, struct ksock_conn *conn,
 			__u64 *incarnation);
 extern void ksocknal_read_callback(struct ksock_conn *conn);
 extern void ksocknal_write_callback(struct ksock_conn *conn);
+extern void ksocknal_zc_msg_callback(struct ksock_conn *conn, __u32 hi,
+				     bool copied);
+#ifdef HAVE_HRTIMER_SOFT
+extern enum hrtimer_restart ksocknal_coalesce_timeout(struct hrtimer *timer);
+#endif
 
 extern int ksocknal_lib_zc_capable(struct ksock_conn *conn);
+extern int ksocknal_lib_zc_msg_capable(struct ksock_conn *conn);
+extern int ksocknal_lib_conn_cpt(struct ksock_conn *conn, int cpt);
 extern void ksocknal_lib_save_callback(struct socket *sock, struct ksock_conn *conn);
 extern void ksocknal_lib_set_callback(struct socket *sock,  struct ksock_conn *conn);
 extern void ksocknal_lib_reset_callback(struct socket *sock,
@@ -59,6 +59,8 @@ ksocknal_alloc_tx(int type, int size)
 	tx->tx_zc_aborted = 0;
 	tx->tx_zc_capable = 0;
 	tx->tx_zc_checked = 0;
+	tx->tx_zc_msg = 0;
+	tx->tx_zc_sent = 0;
 	tx->tx_hstatus = LNET_MSG_STATUS_OK;
 	tx->tx_desc_size  = size;
 
@@ -185,6 +187,27 @@ ksocknal_send_kiov(struct ksock_conn *conn, struct ksock_tx *tx,
 	return rc;
 }
 
+/*
+ * The payload of a MSG_ZEROCOPY send stays referenced by the socket until
+ * the peer has acked it, keep tx until ksocknal_zc_msg_callback() says
+ * its pages have been released.
+ */
+static void
+ksocknal_queue_zc_msg(struct ksock_conn *conn, struct ksock_tx *tx)
+{
+	struct ksock_sched *sched = conn->ksnc_scheduler;
+
+	spin_lock_bh(&sched->kss_lock);
+
+	/* released already? */
+	if ((__s32)(tx->tx_zc_id - conn->ksnc_zc_msg_done) > 0) {
+		ksocknal_tx_addref(tx);
+		list_add_tail(&tx->tx_zc_list, &conn->ksnc_zc_msg_list);
+	}
+
+	spin_unlock_bh(&sched->kss_lock);
+}
+
 static int
 ksocknal_transmit(struct ksock_conn *conn, struct ksock_tx *tx,
 		  struct kvec *scratch_iov)
@@ -247,6 +270,12 @@ ksocknal_transmit(struct ksock_conn *conn, struct ksock_tx *tx,
 
 	} while (tx->tx_resid != 0);
 
+	/* still holding the socket, so ksocknal_finalize_zcreq() can't
+	 * have run yet and will find tx if the conn closes
+	 */
+	if (tx->tx_resid == 0 && tx->tx_zc_sent)
+		ksocknal_queue_zc_msg(conn, tx);
+
 	ksocknal_connsock_decref(conn);
 	return rc;
 }
@@ -478,6 +507,14 @@ ksocknal_check_zc_req(struct ksock_tx *tx)
             !conn->ksnc_zc_capable)
                 return;
 
+	if (conn->ksnc_zc_msg) {
+		/* the socket tells us when the pages can be released, so
+		 * there is no need for a ZC-ACK from the peer_ni. See
+		 * ksocknal_zc_msg_callback() */
+		tx->tx_zc_msg = 1;
+		return;
+	}
+
         /* assign cookie and queue tx to pending list, it will be released when
          * a matching ack is received. See ksocknal_handle_zcack() */
 
@@ -511,6 +548,13 @@ ksocknal_uncheck_zc_req(struct ksock_tx *tx)
 
 	tx->tx_zc_checked = 0;
 
+	if (tx->tx_zc_msg) {
+		/* nothing is pinned to the peer_ni */
+		tx->tx_zc_msg = 0;
+		tx->tx_zc_sent = 0;
+		return;
+	}
+
 	spin_lock(&peer_ni->ksnp_lock);
 
 	if (tx->tx_msg.ksm_zc_cookies[0] == 0) {
@@ -738,6 +782,78 @@ ksocknal_tx_prep(struct ksock_conn *conn, struct ksock_tx *tx)
         tx->tx_conn = conn;
 }
 
+#ifdef HAVE_HRTIMER_SOFT
+enum hrtimer_restart
+ksocknal_coalesce_timeout(struct hrtimer *timer)
+{
+	struct ksock_conn *conn = container_of(timer, struct ksock_conn,
+					       ksnc_coalesce_timer);
+	struct ksock_sched *sched = conn->ksnc_scheduler;
+
+	spin_lock_bh(&sched->kss_lock);
+
+	conn->ksnc_coalescing = 0;
+	if (conn->ksnc_tx_ready &&
+	    !conn->ksnc_tx_scheduled &&
+	    !list_empty(&conn->ksnc_tx_queue)) {
+		/* +1 ref for scheduler */
+		ksocknal_conn_addref(conn);
+		list_add_tail(&conn->ksnc_tx_list, &sched->kss_tx_conns);
+		conn->ksnc_tx_scheduled = 1;
+		wake_up(&sched->kss_waitq);
+	}
+
+	spin_unlock_bh(&sched->kss_lock);
+
+	ksocknal_conn_decref(conn);	/* -1 ref for the timer */
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Hold small messages to a peer for up to coalesce_usecs, so that the
+ * ones queued in the meantime go out in one batch of MSG_MORE sends
+ * (i.e. as few segments as possible) rather than one segment each.
+ * Anything bigger than coalesce_bytes, or enough of them to add up to
+ * that, flushes the conn immediately.  Each message keeps its own LNet
+ * credits, only the wire is shared.  Called holding kss_lock, returns
+ * true if the conn must not be scheduled yet.
+ */
+static bool
+ksocknal_coalesce_tx_locked(struct ksock_conn *conn, struct ksock_tx *tx)
+{
+	int usecs = *ksocknal_tunables.ksnd_coalesce_usecs;
+	int bytes = *ksocknal_tunables.ksnd_coalesce_bytes;
+
+	if (usecs <= 0 || tx->tx_nob > bytes ||
+	    atomic_read(&conn->ksnc_tx_nob) >= bytes) {
+		/* if the timer is running already, it'll find the conn
+		 * scheduled and do nothing */
+		if (conn->ksnc_coalescing &&
+		    hrtimer_try_to_cancel(&conn->ksnc_coalesce_timer) == 1) {
+			conn->ksnc_coalescing = 0;
+			ksocknal_conn_decref(conn);
+		}
+		return false;
+	}
+
+	if (!conn->ksnc_coalescing) {
+		conn->ksnc_coalescing = 1;
+		ksocknal_conn_addref(conn);	/* +1 ref for the timer */
+		hrtimer_start(&conn->ksnc_coalesce_timer,
+			      ktime_set(0, usecs * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL_SOFT);
+	}
+
+	return true;
+}
+#else /* !HAVE_HRTIMER_SOFT */
+static inline bool
+ksocknal_coalesce_tx_locked(struct ksock_conn *conn, struct ksock_tx *tx)
+{
+	return false;
+}
+#endif /* HAVE_HRTIMER_SOFT */
+
 void
 ksocknal_queue_tx_locked(struct ksock_tx *tx, struct ksock_conn *conn)
 {
@@ -813,7 +929,8 @@ ksocknal_queue_tx_locked(struct ksock_tx *tx, struct ksock_conn *conn)
         }
 
 	if (conn->ksnc_tx_ready &&      /* able to send */
-	    !conn->ksnc_tx_scheduled) { /* not scheduled to send */
+	    !conn->ksnc_tx_scheduled && /* not scheduled to send */
+	    !ksocknal_coalesce_tx_locked(conn, tx)) { /* not held back */
 		/* +1 ref for scheduler */
 		ksocknal_conn_addref(conn);
 		list_add_tail(&conn->ksnc_tx_list,
@@ -1434,7 +1551,8 @@ ksocknal_sched_cansleep(struct ksock_sched *sched)
 
 	rc = (!ksocknal_data.ksnd_shuttingdown &&
 	      list_empty(&sched->kss_rx_conns) &&
-	      list_empty(&sched->kss_tx_conns));
+	      list_empty(&sched->kss_tx_conns) &&
+	      list_empty(&sched->kss_zc_done_txs));
 
 	spin_unlock_bh(&sched->kss_lock);
 	return rc;
@@ -1524,8 +1642,27 @@ int ksocknal_scheduler(void *arg)
 			did_something = true;
 		}
 
+		if (!list_empty(&sched->kss_zc_done_txs)) {
+			LIST_HEAD(zclist);
+
+			/* MSG_ZEROCOPY payloads released by the socket */
+			list_splice_init(&sched->kss_zc_done_txs, &zclist);
+			spin_unlock_bh(&sched->kss_lock);
+
+			while ((tx = list_first_entry_or_null(&zclist,
+							      struct ksock_tx,
+							      tx_zc_list))) {
+				list_del(&tx->tx_zc_list);
+				ksocknal_tx_decref(tx);
+			}
+
+			spin_lock_bh(&sched->kss_lock);
+			did_something = true;
+		}
+
 		if (!list_empty(&sched->kss_tx_conns)) {
 			LIST_HEAD(zlist);
+			int nsent = 0;
 
 			list_splice_init(&sched->kss_zombie_noop_txs, &zlist);
 
@@ -1538,43 +1675,57 @@ int ksocknal_scheduler(void *arg)
 			LASSERT(conn->ksnc_tx_ready);
 			LASSERT(!list_empty(&conn->ksnc_tx_queue));
 
-			tx = list_first_entry(&conn->ksnc_tx_queue,
-					      struct ksock_tx, tx_list);
-
-			if (conn->ksnc_tx_carrier == tx)
-				ksocknal_next_tx_carrier(conn);
-
-			/* dequeue now so empty list => more to send */
-			list_del(&tx->tx_list);
-
-			/* Clear tx_ready in case send isn't complete.  Do
-			 * it BEFORE we call process_transmit, since
-			 * write_space can set it any time after we release
-			 * kss_lock. */
-			conn->ksnc_tx_ready = 0;
-			spin_unlock_bh(&sched->kss_lock);
-
 			if (!list_empty(&zlist)) {
+				spin_unlock_bh(&sched->kss_lock);
 				/* free zombie noop txs, it's fast because
 				 * noop txs are just put in freelist */
 				ksocknal_txlist_done(NULL, &zlist, 0);
+				spin_lock_bh(&sched->kss_lock);
 			}
 
-			rc = ksocknal_process_transmit(conn, tx, scratch_iov);
+			/* Send up to tx_batch queued txs while the socket
+			 * has room, rather than requeueing the conn and
+			 * paying for the lock and wakeup round trip after
+			 * every tx. MSG_MORE is set while more is queued. */
+			do {
+				tx = list_first_entry(&conn->ksnc_tx_queue,
+						      struct ksock_tx, tx_list);
+
+				if (conn->ksnc_tx_carrier == tx)
+					ksocknal_next_tx_carrier(conn);
+
+				/* dequeue now so empty list => more to send */
+				list_del(&tx->tx_list);
+
+				/* Clear tx_ready in case send isn't complete.
+				 * Do it BEFORE we call process_transmit,
+				 * since write_space can set it any time after
+				 * we release kss_lock. */
+				conn->ksnc_tx_ready = 0;
+				spin_unlock_bh(&sched->kss_lock);
+
+				rc = ksocknal_process_transmit(conn, tx,
+							       scratch_iov);
+
+				if (rc == -ENOMEM || rc == -EAGAIN) {
+					/* Incomplete send: replace tx on HEAD
+					 * of tx_queue */
+					spin_lock_bh(&sched->kss_lock);
+					list_add(&tx->tx_list,
+						 &conn->ksnc_tx_queue);
+					break;
+				}
 
-			if (rc == -ENOMEM || rc == -EAGAIN) {
-				/* Incomplete send: replace tx on HEAD of tx_queue */
-				spin_lock_bh(&sched->kss_lock);
-				list_add(&tx->tx_list,
-					 &conn->ksnc_tx_queue);
-			} else {
 				/* Complete send; tx -ref */
 				ksocknal_tx_decref(tx);
 
 				spin_lock_bh(&sched->kss_lock);
 				/* assume space for more */
 				conn->ksnc_tx_ready = 1;
-			}
+			} while (rc == 0 &&
+				 ++nsent < *ksocknal_tunables.ksnd_tx_batch &&
+				 !list_empty(&conn->ksnc_tx_queue) &&
+				 !need_resched());
 
 			if (rc == -ENOMEM) {
 				/* Do nothing; after a short timeout, this
@@ -1669,6 +1820,50 @@ void ksocknal_write_callback(struct ksock_conn *conn)
 	spin_unlock_bh(&sched->kss_lock);
 }
 
+/*
+ * The socket has released the payload of MSG_ZEROCOPY sends up to id
+ * \a hi, hand the txs covered by it to the scheduler for completion.
+ */
+void ksocknal_zc_msg_callback(struct ksock_conn *conn, __u32 hi, bool copied)
+{
+	struct ksock_sched *sched = conn->ksnc_scheduler;
+	struct ksock_tx *tx;
+	struct ksock_tx *tmp;
+	bool wake = false;
+
+	spin_lock_bh(&sched->kss_lock);
+
+	/* TCP releases sends in order, except that a clone of a retransmit
+	 * can still be held by the driver after a later ACK; the peer_ni
+	 * has the data by then, so completing up to the newest id is safe.
+	 */
+	if ((__s32)(hi - conn->ksnc_zc_msg_done) > 0)
+		conn->ksnc_zc_msg_done = hi;
+
+	list_for_each_entry_safe(tx, tmp, &conn->ksnc_zc_msg_list,
+				 tx_zc_list) {
+		if ((__s32)(tx->tx_zc_id - conn->ksnc_zc_msg_done) > 0)
+			break;
+
+		list_move_tail(&tx->tx_zc_list, &sched->kss_zc_done_txs);
+		wake = true;
+	}
+
+	/* The stack had to copy the payload anyway (e.g. the route doesn't
+	 * support scatter/gather), stop paying for the notifications.
+	 */
+	if (copied && conn->ksnc_zc_msg) {
+		CDEBUG(D_NET, "MSG_ZEROCOPY to %pISc copied, disabled\n",
+		       &conn->ksnc_peeraddr);
+		conn->ksnc_zc_msg = 0;
+	}
+
+	if (wake)
+		wake_up(&sched->kss_waitq);
+
+	spin_unlock_bh(&sched->kss_lock);
+}
+
 static const struct ksock_proto *
 ksocknal_parse_proto_version(struct ksock_hello_msg *hello)
 {
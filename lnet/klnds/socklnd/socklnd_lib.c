@@ -29,6 +29,10 @@
  * This file is part of Lustre, http://www.lustre.org/
  */
 
+#ifdef HAVE_MSG_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
+
 #include "socklnd.h"
 
 int
@@ -68,6 +72,51 @@ ksocknal_lib_zc_capable(struct ksock_conn *conn)
 	return ((caps & NETIF_F_SG) != 0 && (caps & NETIF_F_CSUM_MASK) != 0);
 }
 
+int
+ksocknal_lib_zc_msg_capable(struct ksock_conn *conn)
+{
+#ifdef HAVE_MSG_ZEROCOPY
+	if (!*ksocknal_tunables.ksnd_zc_msg || !conn->ksnc_zc_capable)
+		return 0;
+
+	/* completions come back on the error queue, see
+	 * ksocknal_error_report() */
+	sock_set_flag(conn->ksnc_sock->sk, SOCK_ZEROCOPY);
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * With several connections to a peer, RSS hashes each of them to its own
+ * NIC receive queue.  Return the CPU partition of the CPU that serviced
+ * the last packet received on \a conn (the HELLO), so the connection can
+ * be handled by the schedulers of that partition, or \a cpt if unknown.
+ * Sending from those CPUs also lets XPS pick the matching transmit queue.
+ */
+int
+ksocknal_lib_conn_cpt(struct ksock_conn *conn, int cpt)
+{
+#ifdef HAVE_SK_INCOMING_CPU
+	int cpu_cpt;
+	int cpu;
+
+	if (!*ksocknal_tunables.ksnd_conn_affinity)
+		return cpt;
+
+	cpu = READ_ONCE(conn->ksnc_sock->sk->sk_incoming_cpu);
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return cpt;
+
+	cpu_cpt = cfs_cpt_of_cpu(lnet_cpt_table(), cpu);
+
+	return cpu_cpt < 0 ? cpt : cpu_cpt;
+#else
+	return cpt;
+#endif
+}
+
 int
 ksocknal_lib_send_hdr(struct ksock_conn *conn, struct ksock_tx *tx,
 		      struct kvec *scratchiov)
@@ -140,6 +189,51 @@ ksocknal_lib_send_kiov(struct ksock_conn *conn, struct ksock_tx *tx,
 
 		rc = sk->sk_prot->sendpage(sk, page,
 					   offset, fragsize, msgflg);
+#ifdef HAVE_MSG_ZEROCOPY
+	} else if (tx->tx_zc_msg) {
+		/* Zero copy by MSG_ZEROCOPY, pin all the frags at once */
+		struct msghdr msg = {
+			.msg_flags = MSG_DONTWAIT | MSG_ZEROCOPY
+		};
+		int i;
+
+		for (nob = i = 0; i < tx->tx_nkiov; i++)
+			nob += kiov[i].bv_len;
+
+		if (!list_empty(&conn->ksnc_tx_queue) ||
+		    nob < tx->tx_resid)
+			msg.msg_flags |= MSG_MORE;
+
+#ifdef HAVE_IOV_ITER_TYPE
+		iov_iter_bvec(&msg.msg_iter, WRITE, kiov, tx->tx_nkiov, nob);
+#else
+		iov_iter_bvec(&msg.msg_iter, ITER_BVEC | WRITE,
+			      kiov, tx->tx_nkiov, nob);
+#endif
+		rc = sock_sendmsg(sock, &msg);
+		if (rc > 0) {
+			/* the socket numbers each MSG_ZEROCOPY send and
+			 * reports the ranges it has released */
+			tx->tx_zc_id = atomic_read(&sock->sk->sk_zckey) - 1;
+			tx->tx_zc_sent = 1;
+		} else if (rc == -ENOBUFS) {
+			/* The socket is over its optmem limit and cannot
+			 * track another zero copy send, nothing was sent.
+			 * Copy the frags instead of failing the conn.
+			 */
+			CDEBUG(D_NET, "MSG_ZEROCOPY send to %s: rc = %d, copying\n",
+			       libcfs_idstr(&conn->ksnc_peer->ksnp_id), rc);
+			msg.msg_flags &= ~MSG_ZEROCOPY;
+#ifdef HAVE_IOV_ITER_TYPE
+			iov_iter_bvec(&msg.msg_iter, WRITE, kiov,
+				      tx->tx_nkiov, nob);
+#else
+			iov_iter_bvec(&msg.msg_iter, ITER_BVEC | WRITE,
+				      kiov, tx->tx_nkiov, nob);
+#endif
+			rc = sock_sendmsg(sock, &msg);
+		}
+#endif
 	} else {
 #if SOCKNAL_SINGLE_FRAG_TX || !SOCKNAL_RISK_KMAP_DEADLOCK
 		struct kvec	scratch;
@@ -289,6 +383,105 @@ ksocknal_lib_kiov_vmap(struct bio_vec *kiov, int niov,
 	return addr;
 }
 
+/* where ksocknal_lib_read_actor() has got to in the rx page frags */
+struct ksock_rx_cursor {
+	struct ksock_conn	*krc_conn;
+	struct bio_vec		*krc_kiov;
+	unsigned int		 krc_nkiov;
+	unsigned int		 krc_offset;	/* in krc_kiov */
+};
+
+/* Copy straight from the frags of a received skb into the rx pages */
+static int
+ksocknal_lib_read_actor(read_descriptor_t *desc, struct sk_buff *skb,
+			unsigned int offset, size_t len)
+{
+	struct ksock_rx_cursor *krc = desc->arg.data;
+	struct ksock_conn *conn = krc->krc_conn;
+	size_t used = 0;
+
+	while (used < len && desc->count > 0) {
+		struct bio_vec *kiov = krc->krc_kiov;
+		unsigned int fragnob;
+		void *base;
+		int rc;
+
+		LASSERT(krc->krc_nkiov > 0);
+
+		fragnob = min_t(size_t, len - used,
+				kiov->bv_len - krc->krc_offset);
+		fragnob = min_t(size_t, fragnob, desc->count);
+
+		base = kmap(kiov->bv_page) + kiov->bv_offset +
+		       krc->krc_offset;
+		rc = skb_copy_bits(skb, offset + used, base, fragnob);
+		if (rc == 0 && conn->ksnc_msg.ksm_csum != 0)
+			conn->ksnc_rx_csum = ksocknal_csum(conn->ksnc_rx_csum,
+							   base, fragnob);
+		kunmap(kiov->bv_page);
+
+		if (rc != 0) {
+			desc->error = rc;
+			break;
+		}
+
+		used += fragnob;
+		desc->count -= fragnob;
+		krc->krc_offset += fragnob;
+		if (krc->krc_offset == kiov->bv_len) {
+			krc->krc_kiov++;
+			krc->krc_nkiov--;
+			krc->krc_offset = 0;
+		}
+	}
+
+	return used;
+}
+
+/*
+ * Receive into the page frags by walking the socket's receive queue with
+ * tcp_read_sock(), so the payload is copied once from the skbs into its
+ * destination without building an iovec or mapping every frag up front,
+ * and the socket is locked once for everything that has arrived.
+ */
+static int
+ksocknal_lib_recv_kiov_read_sock(struct ksock_conn *conn)
+{
+	struct sock *sk = conn->ksnc_sock->sk;
+	struct ksock_rx_cursor krc = {
+		.krc_conn	= conn,
+		.krc_kiov	= conn->ksnc_rx_kiov,
+		.krc_nkiov	= conn->ksnc_rx_nkiov,
+	};
+	read_descriptor_t desc = {
+		.arg.data	= &krc,
+	};
+	int rc;
+	int i;
+
+	for (i = 0; i < conn->ksnc_rx_nkiov; i++)
+		desc.count += conn->ksnc_rx_kiov[i].bv_len;
+
+	LASSERT(desc.count <= conn->ksnc_rx_nob_wanted);
+
+	lock_sock(sk);
+	rc = tcp_read_sock(sk, &desc, ksocknal_lib_read_actor);
+	if (rc == 0) {
+		/* nothing read, tell EOF from an empty queue like
+		 * kernel_recvmsg() would */
+		if (sk->sk_err)
+			rc = sock_error(sk);
+		else if (!(sk->sk_shutdown & RCV_SHUTDOWN))
+			rc = -EAGAIN;
+	}
+	release_sock(sk);
+
+	if (rc == 0 && desc.error != 0)
+		rc = desc.error;
+
+	return rc;
+}
+
 int
 ksocknal_lib_recv_kiov(struct ksock_conn *conn, struct page **pages,
 		       struct kvec *scratchiov)
@@ -317,6 +510,9 @@ ksocknal_lib_recv_kiov(struct ksock_conn *conn, struct page **pages,
         int          fragnob;
 	int n;
 
+	if (*ksocknal_tunables.ksnd_rx_read_sock)
+		return ksocknal_lib_recv_kiov_read_sock(conn);
+
         /* NB we can't trust socket ops to either consume our iovs
          * or leave them alone. */
 	if ((addr = ksocknal_lib_kiov_vmap(kiov, niov, scratchiov, pages)) != NULL) {
@@ -638,11 +834,54 @@ ksocknal_write_space (struct sock *sk)
 	read_unlock(&ksocknal_data.ksnd_global_lock);
 }
 
+#ifdef HAVE_MSG_ZEROCOPY
+static void
+ksocknal_error_report(struct sock *sk)
+{
+	struct ksock_conn *conn;
+	struct sock_exterr_skb *serr;
+	struct sk_buff *skb;
+
+	/* interleave correctly with closing sockets... */
+	LASSERT(!in_irq());
+	read_lock(&ksocknal_data.ksnd_global_lock);
+
+	conn = sk->sk_user_data;
+	if (conn == NULL) {	/* raced with ksocknal_terminate_conn */
+		LASSERT(sk->sk_error_report != &ksocknal_error_report);
+		sk->sk_error_report(sk);
+
+		read_unlock(&ksocknal_data.ksnd_global_lock);
+		return;
+	}
+
+	/* Only MSG_ZEROCOPY completions are expected on the error queue,
+	 * neither timestamping nor IP_RECVERR is enabled on our sockets.
+	 * Don't use sock_dequeue_err_skb(), it calls back in here for every
+	 * remaining skb.
+	 */
+	while ((skb = skb_dequeue(&sk->sk_error_queue)) != NULL) {
+		serr = SKB_EXT_ERR(skb);
+		if (serr->ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY &&
+		    serr->ee.ee_errno == 0)
+			ksocknal_zc_msg_callback(conn, serr->ee.ee_data,
+				serr->ee.ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+		kfree_skb(skb);
+	}
+
+	/* socket errors are still reported to whoever else is waiting */
+	((void (*)(struct sock *))conn->ksnc_saved_error_report)(sk);
+
+	read_unlock(&ksocknal_data.ksnd_global_lock);
+}
+#endif
+
 void
 ksocknal_lib_save_callback(struct socket *sock, struct ksock_conn *conn)
 {
         conn->ksnc_saved_data_ready = sock->sk->sk_data_ready;
         conn->ksnc_saved_write_space = sock->sk->sk_write_space;
+	conn->ksnc_saved_error_report = sock->sk->sk_error_report;
 }
 
 void
@@ -651,6 +890,10 @@ ksocknal_lib_set_callback(struct socket *sock,  struct ksock_conn *conn)
         sock->sk->sk_user_data = conn;
         sock->sk->sk_data_ready = ksocknal_data_ready;
         sock->sk->sk_write_space = ksocknal_write_space;
+#ifdef HAVE_MSG_ZEROCOPY
+	if (conn->ksnc_zc_msg)
+		sock->sk->sk_error_report = ksocknal_error_report;
+#endif
 }
 
 void
@@ -661,6 +904,7 @@ ksocknal_lib_reset_callback(struct socket *sock, struct ksock_conn *conn)
          * since the socket could survive past this module being unloaded!! */
         sock->sk->sk_data_ready = conn->ksnc_saved_data_ready;
         sock->sk->sk_write_space = conn->ksnc_saved_write_space;
+	sock->sk->sk_error_report = conn->ksnc_saved_error_report;
 
         /* A callback could be in progress already; they hold a read lock
          * on ksnd_global_lock (to serialise with me) and NOOP if
@@ -140,6 +140,30 @@ static unsigned int zc_min_payload = (16 << 10);
 module_param(zc_min_payload, int, 0644);
 MODULE_PARM_DESC(zc_min_payload, "minimum payload size to zero copy");
 
+static int zc_msg;
+module_param(zc_msg, int, 0644);
+MODULE_PARM_DESC(zc_msg, "zero copy by MSG_ZEROCOPY, completed by the local socket instead of a ZC-ACK from the peer");
+
+static int tx_batch = 8;
+module_param(tx_batch, int, 0644);
+MODULE_PARM_DESC(tx_batch, "max # of messages sent on a connection per scheduler pass");
+
+static int coalesce_usecs;
+module_param(coalesce_usecs, int, 0644);
+MODULE_PARM_DESC(coalesce_usecs, "usecs small messages to a peer are held to be sent together (0 to disable)");
+
+static int coalesce_bytes = 8192;
+module_param(coalesce_bytes, int, 0644);
+MODULE_PARM_DESC(coalesce_bytes, "max bytes of small messages held on a connection before sending them");
+
+static int conn_affinity;
+module_param(conn_affinity, int, 0644);
+MODULE_PARM_DESC(conn_affinity, "schedule each connection on the CPU partition that receives its traffic");
+
+static int rx_read_sock;
+module_param(rx_read_sock, int, 0644);
+MODULE_PARM_DESC(rx_read_sock, "receive payload straight from the socket buffers");
+
 static unsigned int zc_recv = 0;
 module_param(zc_recv, int, 0644);
 MODULE_PARM_DESC(zc_recv, "enable ZC recv for Chelsio driver");
@@ -299,6 +323,12 @@ int ksocknal_tunables_init(void)
 	ksocknal_tunables.ksnd_inject_csum_error  = &inject_csum_error;
 	ksocknal_tunables.ksnd_nonblk_zcack       = &nonblk_zcack;
 	ksocknal_tunables.ksnd_zc_min_payload     = &zc_min_payload;
+	ksocknal_tunables.ksnd_zc_msg             = &zc_msg;
+	ksocknal_tunables.ksnd_tx_batch           = &tx_batch;
+	ksocknal_tunables.ksnd_coalesce_usecs     = &coalesce_usecs;
+	ksocknal_tunables.ksnd_coalesce_bytes     = &coalesce_bytes;
+	ksocknal_tunables.ksnd_conn_affinity      = &conn_affinity;
+	ksocknal_tunables.ksnd_rx_read_sock       = &rx_read_sock;
 	ksocknal_tunables.ksnd_zc_recv            = &zc_recv;
 	ksocknal_tunables.ksnd_zc_recv_min_nfrags = &zc_recv_min_nfrags;
 	if (conns_per_peer > ((1 << SOCKNAL_CONN_COUNT_MAX_BITS)-1)) {
@@ -127,6 +127,16 @@ module_param_call(lnet_recovery_interval, recovery_interval_set, param_get_int,
 MODULE_PARM_DESC(lnet_recovery_interval,
 		"DEPRECATED - Interval to recover unhealthy interfaces in seconds");
 
+unsigned int lnet_latency_select;
+module_param(lnet_latency_select, uint, 0644);
+MODULE_PARM_DESC(lnet_latency_select,
+		 "Weight Multi-Rail selection by measured path latency and bandwidth (0 to disable)");
+
+unsigned int lnet_cut_through_min;
+module_param(lnet_cut_through_min, uint, 0644);
+MODULE_PARM_DESC(lnet_cut_through_min,
+		 "Forward routed messages of at least this many bytes while their payload is received (0 to disable)");
+
 unsigned int lnet_recovery_limit;
 module_param(lnet_recovery_limit, uint, 0644);
 MODULE_PARM_DESC(lnet_recovery_limit,
@@ -5011,6 +5021,14 @@ static const struct ln_key_list local_ni_health_stats_list = {
 			.lkp_value	= "next_ping",
 			.lkp_data_type	= NLA_U64
 		},
+		[LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_RTT] = {
+			.lkp_value	= "rtt_usec",
+			.lkp_data_type	= NLA_U32
+		},
+		[LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_BANDWIDTH] = {
+			.lkp_value	= "bandwidth_MBps",
+			.lkp_data_type	= NLA_U32
+		},
 	},
 };
 
@@ -5388,6 +5406,10 @@ skip_udsp:
 				nla_put_u64_64bit(msg, LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_NEXT_PING,
 						  ni->ni_next_ping,
 						  LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_PAD);
+				nla_put_u32(msg, LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_RTT,
+					    READ_ONCE(ni->ni_path.lpe_rtt));
+				nla_put_u32(msg, LNET_NET_LOCAL_NI_HEALTH_STATS_ATTR_BANDWIDTH,
+					    READ_ONCE(ni->ni_path.lpe_bw));
 				nla_nest_end(msg, health_attr);
 				nla_nest_end(msg, health_stats);
 skip_msg_stats:
@@ -6914,6 +6936,14 @@ static const struct ln_key_list lnet_peer_ni_list_health = {
 			.lkp_value			= "next_ping",
 			.lkp_data_type			= NLA_S64,
 		},
+		[LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_RTT]	= {
+			.lkp_value			= "rtt_usec",
+			.lkp_data_type			= NLA_U32,
+		},
+		[LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_BANDWIDTH]	= {
+			.lkp_value			= "bandwidth_MBps",
+			.lkp_data_type			= NLA_U32,
+		},
 	},
 };
 
@@ -7181,6 +7211,12 @@ static int lnet_peer_ni_show_dump(struct sk_buff *msg,
 					    LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_NEXT_PING,
 					    lpni->lpni_next_ping,
 					    LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_PAD);
+				nla_put_u32(msg,
+					    LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_RTT,
+					    READ_ONCE(lpni->lpni_path.lpe_rtt));
+				nla_put_u32(msg,
+					    LNET_PEER_NI_LIST_HEALTH_STATS_ATTR_BANDWIDTH,
+					    READ_ONCE(lpni->lpni_path.lpe_bw));
 				nla_nest_end(msg, health_stats);
 				nla_nest_end(msg, health_list);
 			}
@@ -728,6 +728,63 @@ lnet_prep_send(struct lnet_msg *msg, int type, struct lnet_processid *target,
 	msg->msg_hdr.payload_length = len;
 }
 
+/*
+ * Cut-through forwarding: a large routed message is sent on as soon as its
+ * header has been parsed.  The payload is received into the router buffer
+ * through a shadow message, so next hop selection, credits and the sending
+ * LND's handshake overlap the inbound transfer.  The sending LND is told
+ * when the payload is in place with lnd_payload_ready(); LNDs without it
+ * are handed the message once it has been received.  The message is
+ * finalized when both directions have completed.
+ */
+static bool
+lnet_ct_send(struct lnet_ni *ni, struct lnet_msg *msg)
+{
+	struct lnet_lnd *lnd = ni->ni_net->net_lnd;
+	int cpt = msg->msg_rx_cpt;
+	bool notify;
+	int rc;
+
+	lnet_net_lock(cpt);
+	if (test_bit(LNET_CT_RX_DONE, &msg->msg_ct_flags)) {
+		lnet_net_unlock(cpt);
+		goto received;
+	}
+
+	if (!lnd->lnd_payload_ready) {
+		/* lnet_ct_recv_done() sends it */
+		set_bit(LNET_CT_TX_PARKED, &msg->msg_ct_flags);
+		lnet_net_unlock(cpt);
+		return true;
+	}
+	set_bit(LNET_CT_TX_SENDING, &msg->msg_ct_flags);
+	lnet_net_unlock(cpt);
+
+	rc = lnd->lnd_send(ni, msg->msg_private, msg);
+	if (rc < 0) {
+		lnet_finalize(msg, rc);
+		return true;
+	}
+
+	/* the LND won't complete msg before it has been notified */
+	lnet_net_lock(cpt);
+	set_bit(LNET_CT_TX_STARTED, &msg->msg_ct_flags);
+	notify = test_bit(LNET_CT_RX_DONE, &msg->msg_ct_flags) &&
+		 !test_and_set_bit(LNET_CT_NOTIFIED, &msg->msg_ct_flags);
+	lnet_net_unlock(cpt);
+
+	if (notify)
+		lnd->lnd_payload_ready(ni, msg, msg->msg_ct_rx_status);
+	return true;
+
+received:
+	if (msg->msg_ct_rx_status == 0)
+		return false;
+
+	lnet_finalize(msg, msg->msg_ct_rx_status);
+	return true;
+}
+
 void
 lnet_ni_send(struct lnet_ni *ni, struct lnet_msg *msg)
 {
@@ -738,6 +795,10 @@ lnet_ni_send(struct lnet_ni *ni, struct lnet_msg *msg)
 	LASSERT(nid_is_lo0(&ni->ni_nid) ||
 		(msg->msg_txcredit && msg->msg_peertxcredit));
 
+	if (test_bit(LNET_CT_ACTIVE, &msg->msg_ct_flags) &&
+	    lnet_ct_send(ni, msg))
+		return;
+
 	rc = (ni->ni_net->net_lnd->lnd_send)(ni, priv, msg);
 	if (rc < 0) {
 		msg->msg_no_resend = true;
@@ -745,6 +806,111 @@ lnet_ni_send(struct lnet_ni *ni, struct lnet_msg *msg)
 	}
 }
 
+/* The payload of a cut-through message has been received into the router
+ * buffer, or failed.  Called by lnet_finalize() on the shadow message. */
+void
+lnet_ct_recv_done(struct lnet_msg *shadow, int status)
+{
+	struct lnet_msg *msg = shadow->msg_ct_parent;
+	int cpt = msg->msg_rx_cpt;
+	bool finalize = false;
+	bool parked = false;
+	bool notify = false;
+
+	lnet_msg_free(shadow);
+
+	lnet_net_lock(cpt);
+	msg->msg_ct_rx_status = status;
+	set_bit(LNET_CT_RX_DONE, &msg->msg_ct_flags);
+	if (test_bit(LNET_CT_TX_DONE, &msg->msg_ct_flags)) {
+		clear_bit(LNET_CT_ACTIVE, &msg->msg_ct_flags);
+		finalize = true;
+	} else if (test_and_clear_bit(LNET_CT_TX_PARKED, &msg->msg_ct_flags)) {
+		parked = true;
+	} else if (test_bit(LNET_CT_TX_STARTED, &msg->msg_ct_flags)) {
+		notify = !test_and_set_bit(LNET_CT_NOTIFIED,
+					   &msg->msg_ct_flags);
+	}
+	lnet_net_unlock(cpt);
+
+	/* otherwise the send side has yet to see RX_DONE */
+	if (finalize)
+		lnet_finalize(msg, msg->msg_ct_tx_status);
+	else if (parked)
+		lnet_ni_send(msg->msg_txni, msg);
+	else if (notify)
+		msg->msg_txni->ni_net->net_lnd->lnd_payload_ready(msg->msg_txni,
+								  msg, status);
+}
+
+/* The send of a cut-through message completed.  Returns true if it is to
+ * be finalized now, false if that waits for the receive to complete. */
+bool
+lnet_ct_send_done(struct lnet_msg *msg, int status)
+{
+	int cpt = msg->msg_rx_cpt;
+	bool done;
+
+	lnet_net_lock(cpt);
+	msg->msg_ct_tx_status = status;
+	set_bit(LNET_CT_TX_DONE, &msg->msg_ct_flags);
+	done = test_bit(LNET_CT_RX_DONE, &msg->msg_ct_flags);
+	if (done)
+		clear_bit(LNET_CT_ACTIVE, &msg->msg_ct_flags);
+	lnet_net_unlock(cpt);
+
+	return done;
+}
+
+/* Receive the payload of a message being forwarded, cutting through to the
+ * next hop if it is large enough. */
+void
+lnet_ni_recv_routed(struct lnet_ni *ni, struct lnet_msg *msg, int delayed)
+{
+	struct lnet_msg *shadow = NULL;
+	int rc;
+
+	LASSERT(msg->msg_routing);
+
+	if (lnet_cut_through_min && msg->msg_len >= lnet_cut_through_min &&
+	    msg->msg_len > PAGE_SIZE && ni->ni_net->net_lnd->lnd_payload_ready)
+		shadow = lnet_msg_alloc();
+
+	if (!shadow) {
+		lnet_ni_recv(ni, msg->msg_private, msg, delayed,
+			     0, msg->msg_len, msg->msg_len);
+		return;
+	}
+
+	shadow->msg_ct_parent = msg;
+	shadow->msg_type = msg->msg_type;
+	shadow->msg_hdr = msg->msg_hdr;
+	shadow->msg_routing = 1;
+	shadow->msg_receiving = 1;
+	shadow->msg_rx_cpt = msg->msg_rx_cpt;
+	shadow->msg_rxni = msg->msg_rxni;
+	shadow->msg_rxpeer = msg->msg_rxpeer;
+	shadow->msg_private = msg->msg_private;
+	shadow->msg_len = msg->msg_len;
+	shadow->msg_wanted = msg->msg_len;
+	shadow->msg_offset = 0;
+	shadow->msg_niov = msg->msg_niov;
+	shadow->msg_kiov = msg->msg_kiov;
+
+	/* the router buffer can't be resent from once it's been released */
+	msg->msg_receiving = 0;
+	msg->msg_no_resend = true;
+	set_bit(LNET_CT_ACTIVE, &msg->msg_ct_flags);
+
+	lnet_ni_recv(ni, msg->msg_private, shadow, delayed,
+		     0, msg->msg_len, msg->msg_len);
+
+	/* msg is only finalized once the send has completed too */
+	rc = lnet_send(NULL, msg, NULL);
+	if (rc < 0)
+		lnet_finalize(msg, rc);
+}
+
 static int
 lnet_ni_eager_recv(struct lnet_ni *ni, struct lnet_msg *msg)
 {
@@ -1038,7 +1204,9 @@ lnet_post_routed_recv_locked(struct lnet_msg *msg, int do_recv)
 			/* must have checked eager_recv before here */
 			LASSERT(msg->msg_rx_ready_delay);
 			msg->msg_rx_delayed = 1;
+			msg->msg_rtr_wait = ktime_get();
 			list_add_tail(&msg->msg_list, &rbp->rbp_msgs);
+			lnet_rtrpool_grow_locked(rbp);
 			return LNET_CREDIT_WAIT;
 		}
 	}
@@ -1047,6 +1215,17 @@ lnet_post_routed_recv_locked(struct lnet_msg *msg, int do_recv)
 	rb = list_first_entry(&rbp->rbp_bufs, struct lnet_rtrbuf, rb_list);
 	list_del(&rb->rb_list);
 
+	if (ktime_to_ns(msg->msg_rtr_wait)) {
+		s64 wait = ktime_us_delta(ktime_get(), msg->msg_rtr_wait);
+
+		msg->msg_rtr_wait = 0;
+		rbp->rbp_wait_hist[wait <= 0 ? 1 :
+				   min_t(int, fls64(wait),
+					 LNET_RBP_WAIT_BUCKETS - 1)]++;
+	} else {
+		rbp->rbp_wait_hist[0]++;
+	}
+
 	msg->msg_niov = rbp->rbp_npages;
 	msg->msg_kiov = &rb->rb_kiov[0];
 
@@ -1057,8 +1236,7 @@ lnet_post_routed_recv_locked(struct lnet_msg *msg, int do_recv)
 		int cpt = msg->msg_rx_cpt;
 
 		lnet_net_unlock(cpt);
-		lnet_ni_recv(msg->msg_rxni, msg->msg_private, msg, 1,
-			     0, msg->msg_len, msg->msg_len);
+		lnet_ni_recv_routed(msg->msg_rxni, msg, 1);
 		lnet_net_lock(cpt);
 	}
 	return LNET_CREDIT_OK;
@@ -1303,6 +1481,131 @@ routing_off:
 	}
 }
 
+/* only exchanges this small are used to sample the round trip time */
+#define LNET_PATH_RTT_MAX_NOB	(4 << 10)
+/* smaller transfers say little about the bandwidth of a path */
+#define LNET_PATH_BW_MIN_NOB	(64 << 10)
+
+/*
+ * Latency is sampled from small exchanges only, so that it doesn't
+ * include the transfer time lnet_path_cost() adds from the bandwidth.
+ * The bandwidth of a large transfer is sampled from the time it took
+ * beyond the round trip time.
+ */
+static void
+lnet_path_est_update(struct lnet_path_est *est, u32 usec, unsigned int nob)
+{
+	u32 old = READ_ONCE(est->lpe_rtt);
+	u32 bw;
+
+	if (nob <= LNET_PATH_RTT_MAX_NOB) {
+		/* smooth by 1/8, as TCP does for its srtt */
+		WRITE_ONCE(est->lpe_rtt,
+			   old ? old - old / 8 + usec / 8 : usec);
+		return;
+	}
+
+	if (nob < LNET_PATH_BW_MIN_NOB)
+		return;
+
+	bw = nob / (usec > old ? usec - old : 1);
+	old = READ_ONCE(est->lpe_bw);
+	WRITE_ONCE(est->lpe_bw, old ? old - old / 8 + bw / 8 : bw);
+}
+
+/**
+ * Take the path sample of a tracked message from its REPLY/ACK \a msg,
+ * once the payload has been received. Only responses coming back through
+ * the peer NI the message was sent to are used, so that the sample
+ * belongs to that path.
+ *
+ * Called from lnet_msg_detach_md() with the resource lock of \a md held,
+ * the sample is applied by lnet_path_sample() once it is dropped.
+ *
+ * \retval true if \a ps was filled
+ */
+bool
+lnet_rspt_sample(struct lnet_msg *msg, struct lnet_libmd *md,
+		 struct lnet_path_sample *ps)
+{
+	struct lnet_rsp_tracker *rspt = md->md_rspt_ptr;
+	struct lnet_peer_ni *lpni = msg->msg_rxpeer;
+	s64 usec;
+
+	if (msg->msg_type != LNET_MSG_REPLY && msg->msg_type != LNET_MSG_ACK)
+		return false;
+
+	if (!rspt || !lpni || !ktime_to_ns(rspt->rspt_sent) ||
+	    !nid_same(&rspt->rspt_next_hop_nid, &lpni->lpni_nid))
+		return false;
+
+	usec = ktime_us_delta(ktime_get(), rspt->rspt_sent);
+	if (usec <= 0)
+		usec = 1;
+	else if (usec > U32_MAX)
+		return false;
+
+	ps->ps_src_nid = rspt->rspt_src_nid;
+	ps->ps_usec = usec;
+	ps->ps_nob = rspt->rspt_nob + msg->msg_wanted;
+
+	return true;
+}
+
+/*
+ * Account \a ps to the peer NI the REPLY/ACK \a msg came from and to the
+ * local NI the tracked message was sent from.
+ */
+void
+lnet_path_sample(struct lnet_msg *msg, struct lnet_path_sample *ps)
+{
+	struct lnet_ni *ni;
+	int cpt;
+
+	lnet_path_est_update(&msg->msg_rxpeer->lpni_path, ps->ps_usec,
+			     ps->ps_nob);
+
+	cpt = lnet_net_lock_current();
+	ni = lnet_nid_to_ni_locked(&ps->ps_src_nid, cpt);
+	if (ni)
+		lnet_path_est_update(&ni->ni_path, ps->ps_usec, ps->ps_nob);
+	lnet_net_unlock(cpt);
+}
+
+/*
+ * Estimated usecs for \a nob bytes to make it across a path, 0 if the
+ * path hasn't been measured yet.
+ */
+static inline u64
+lnet_path_cost(struct lnet_path_est *est, long nob)
+{
+	u32 rtt = READ_ONCE(est->lpe_rtt);
+	u32 bw = READ_ONCE(est->lpe_bw);
+
+	if (!rtt)
+		return 0;
+
+	return rtt + (bw && nob > 0 ? nob / bw : 0);
+}
+
+/*
+ * Compare the costs of two paths: < 0 if \a c1 is cheaper, > 0 if it
+ * is dearer. Paths not measured yet and differences within 1/8 are
+ * treated as equal, so that selection doesn't flap on noise.
+ */
+static inline int
+lnet_path_cost_cmp(u64 c1, u64 c2)
+{
+	if (!lnet_latency_select || !c1 || !c2)
+		return 0;
+
+	if (c1 + c1 / 8 < c2)
+		return -1;
+	if (c2 + c2 / 8 < c1)
+		return 1;
+	return 0;
+}
+
 static struct lnet_peer_ni *
 lnet_select_peer_ni(struct lnet_ni *best_ni, struct lnet_nid *dst_nid,
 		    struct lnet_peer *peer,
@@ -1322,9 +1625,14 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, struct lnet_nid *dst_nid,
 		INT_MIN;
 	int best_lpni_healthv = (best_lpni) ?
 		atomic_read(&best_lpni->lpni_healthv) : 0;
+	u64 best_lpni_cost = (best_lpni) ?
+		lnet_path_cost(&best_lpni->lpni_path,
+			       best_lpni->lpni_txqnob) : 0;
 	bool best_lpni_is_preferred = false;
 	bool lpni_is_preferred;
 	int lpni_healthv;
+	u64 lpni_cost;
+	int rc;
 	__u32 lpni_sel_prio;
 	__u32 best_sel_prio = LNET_MAX_SELECTION_PRIORITY;
 
@@ -1345,13 +1653,16 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, struct lnet_nid *dst_nid,
 
 		lpni_healthv = atomic_read(&lpni->lpni_healthv);
 		lpni_sel_prio = lpni->lpni_sel_priority;
+		lpni_cost = lnet_path_cost(&lpni->lpni_path,
+					   lpni->lpni_txqnob);
 
 		if (best_lpni)
-			CDEBUG(D_NET, "n:[%s, %s] h:[%d, %d] p:[%d, %d] c:[%d, %d] s:[%d, %d]\n",
+			CDEBUG(D_NET, "n:[%s, %s] h:[%d, %d] p:[%d, %d] l:[%llu, %llu] c:[%d, %d] s:[%d, %d]\n",
 				libcfs_nidstr(&lpni->lpni_nid),
 				libcfs_nidstr(&best_lpni->lpni_nid),
 				lpni_healthv, best_lpni_healthv,
 				lpni_sel_prio, best_sel_prio,
+				lpni_cost, best_lpni_cost,
 				lpni->lpni_txcredits, best_lpni_credits,
 				lpni->lpni_seq, best_lpni->lpni_seq);
 		else
@@ -1374,6 +1685,13 @@ lnet_select_peer_ni(struct lnet_ni *best_ni, struct lnet_nid *dst_nid,
 		else if (best_lpni_is_preferred && !lpni_is_preferred)
 			continue;
 
+		/* prefer the path that delivers sooner */
+		rc = lnet_path_cost_cmp(lpni_cost, best_lpni_cost);
+		if (rc > 0)
+			continue;
+		else if (rc < 0)
+			goto select_lpni;
+
 		if (lpni->lpni_txcredits < best_lpni_credits)
 			/* We already have a peer that has more credits
 			 * available than this one. No need to consider
@@ -1393,6 +1711,7 @@ select_lpni:
 		best_lpni_is_preferred = lpni_is_preferred;
 		best_lpni_healthv = lpni_healthv;
 		best_sel_prio = lpni_sel_prio;
+		best_lpni_cost = lpni_cost;
 		best_lpni = lpni;
 		best_lpni_credits = lpni->lpni_txcredits;
 	}
@@ -1633,6 +1952,7 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 	__u32 best_sel_prio;
 	unsigned int best_dev_prio;
 	int best_ni_fatal;
+	u64 best_cost;
 	unsigned int dev_idx = UINT_MAX;
 	bool gpu = md ? (md->md_flags & LNET_MD_FLAG_GPU) : false;
 
@@ -1656,6 +1976,7 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 		best_credits = INT_MIN;
 		best_healthv = 0;
 		best_ni_fatal = true;
+		best_cost = 0;
 	} else {
 		best_dev_prio = lnet_dev_prio_of_md(best_ni, dev_idx);
 		shortest_distance = cfs_cpt_distance(lnet_cpt_table(), md_cpt,
@@ -1664,6 +1985,7 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 		best_healthv = atomic_read(&best_ni->ni_healthv);
 		best_sel_prio = best_ni->ni_sel_priority;
 		best_ni_fatal = atomic_read(&best_ni->ni_fatal_error_on);
+		best_cost = lnet_path_cost(&best_ni->ni_path, msg->msg_len);
 	}
 
 	while ((ni = lnet_get_next_ni_locked(local_net, ni))) {
@@ -1673,11 +1995,14 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 		int ni_fatal;
 		__u32 ni_sel_prio;
 		unsigned int ni_dev_prio;
+		u64 ni_cost;
+		int rc;
 
 		ni_credits = atomic_read(&ni->ni_tx_credits);
 		ni_healthv = atomic_read(&ni->ni_healthv);
 		ni_fatal = atomic_read(&ni->ni_fatal_error_on);
 		ni_sel_prio = ni->ni_sel_priority;
+		ni_cost = lnet_path_cost(&ni->ni_path, msg->msg_len);
 
 		/*
 		 * calculate the distance from the CPT on which
@@ -1699,19 +2024,22 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 
 		/*
 		 * Select on health, selection policy, direct dma prio,
-		 * shorter distance, available credits, then round-robin.
+		 * shorter distance, measured latency, available credits,
+		 * then round-robin.
 		 */
 		if (best_ni)
-			CDEBUG(D_NET, "compare ni %s [f:%s, c:%d, d:%d, s:%d, p:%u, g:%u, h:%d] with best_ni %s [f:%s, c:%d, d:%d, s:%d, p:%u, g:%u, h:%d]\n",
+			CDEBUG(D_NET, "compare ni %s [f:%s, c:%d, d:%d, s:%d, p:%u, g:%u, h:%d, l:%llu] with best_ni %s [f:%s, c:%d, d:%d, s:%d, p:%u, g:%u, h:%d, l:%llu]\n",
 			       libcfs_nidstr(&ni->ni_nid),
 			       ni_fatal ? "y" : "n", ni_credits, distance,
 			       ni->ni_seq, ni_sel_prio, ni_dev_prio, ni_healthv,
+			       ni_cost,
 			       (best_ni) ? libcfs_nidstr(&best_ni->ni_nid)
 			       : "not selected",
 			       best_ni_fatal ? "y" : "n", best_credits,
 			       shortest_distance,
 			       (best_ni) ? best_ni->ni_seq : 0,
-			       best_sel_prio, best_dev_prio, best_healthv);
+			       best_sel_prio, best_dev_prio, best_healthv,
+			       best_cost);
 		else
 			goto select_ni;
 
@@ -1740,6 +2068,12 @@ lnet_get_best_ni(struct lnet_net *local_net, struct lnet_ni *best_ni,
 		else if (distance < shortest_distance)
 			goto select_ni;
 
+		rc = lnet_path_cost_cmp(ni_cost, best_cost);
+		if (rc > 0)
+			continue;
+		else if (rc < 0)
+			goto select_ni;
+
 		if (ni_credits < best_credits)
 			continue;
 		else if (ni_credits > best_credits)
@@ -1756,6 +2090,7 @@ select_ni:
 		best_ni = ni;
 		best_credits = ni_credits;
 		best_ni_fatal = ni_fatal;
+		best_cost = ni_cost;
 	}
 
 	CDEBUG(D_NET, "selected best_ni %s\n",
@@ -1981,6 +2316,9 @@ lnet_handle_send(struct lnet_send_data *sd)
 		if (rspt) {
 			rspt->rspt_next_hop_nid =
 				msg->msg_txpeer->lpni_nid;
+			rspt->rspt_src_nid = msg->msg_txni->ni_nid;
+			rspt->rspt_sent = ktime_get();
+			rspt->rspt_nob = msg->msg_len;
 			CDEBUG(D_NET, "rspt_next_hop_nid = %s\n",
 			       libcfs_nidstr(&rspt->rspt_next_hop_nid));
 		}
@@ -5006,10 +5344,8 @@ lnet_parse(struct lnet_ni *ni, struct lnet_hdr *hdr,
 		if (rc < 0)
 			goto free_drop;
 
-		if (rc == LNET_CREDIT_OK) {
-			lnet_ni_recv(ni, msg->msg_private, msg, 0,
-				     0, payload_length, payload_length);
-		}
+		if (rc == LNET_CREDIT_OK)
+			lnet_ni_recv_routed(ni, msg, 0);
 		return 0;
 	}
 
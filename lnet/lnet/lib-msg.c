@@ -960,6 +960,8 @@ lnet_msg_detach_md(struct lnet_msg *msg, int status)
 	struct lnet_libmd *md = msg->msg_md;
 	lnet_handler_t handler = NULL;
 	int cpt = lnet_cpt_of_cookie(md->md_lh.lh_cookie);
+	struct lnet_path_sample ps;
+	bool sampled = false;
 	int unlink;
 
 	lnet_res_lock(cpt);
@@ -987,6 +989,10 @@ lnet_msg_detach_md(struct lnet_msg *msg, int status)
 			md->md_flags |= LNET_MD_FLAG_HANDLING;
 	}
 
+	/* the REPLY/ACK has been received in full by now */
+	if (!status)
+		sampled = lnet_rspt_sample(msg, md, &ps);
+
 	if (unlink || (md->md_refcount == 0 &&
 		       md->md_threshold == LNET_MD_THRESH_INF))
 		lnet_detach_rsp_tracker(md, cpt);
@@ -997,6 +1003,9 @@ lnet_msg_detach_md(struct lnet_msg *msg, int status)
 
 	lnet_res_unlock(cpt);
 
+	if (sampled)
+		lnet_path_sample(msg, &ps);
+
 	if (handler) {
 		handler(&msg->msg_ev);
 		if (!unlink) {
@@ -1117,6 +1126,16 @@ lnet_finalize(struct lnet_msg *msg, int status)
 	if (msg == NULL)
 		return;
 
+	/* receive side of a cut-through forwarded message */
+	if (msg->msg_ct_parent) {
+		lnet_ct_recv_done(msg, status);
+		return;
+	}
+
+	if (test_bit(LNET_CT_ACTIVE, &msg->msg_ct_flags) &&
+	    !lnet_ct_send_done(msg, status))
+		return;
+
 	msg->msg_ev.status = status;
 
 	if (lnet_is_health_check(msg)) {
@@ -717,8 +717,7 @@ delayed_msg_process(struct list_head *msg_list, bool drop)
 
 			switch (rc) {
 			case LNET_CREDIT_OK:
-				lnet_ni_recv(ni, msg->msg_private, msg, 0,
-					     0, msg->msg_len, msg->msg_len);
+				lnet_ni_recv_routed(ni, msg, 0);
 				fallthrough;
 			case LNET_CREDIT_WAIT:
 				continue;
@@ -48,6 +48,9 @@ MODULE_PARM_DESC(small_router_buffers, "# of small (1 page) messages to buffer i
 static int large_router_buffers;
 module_param(large_router_buffers, int, 0444);
 MODULE_PARM_DESC(large_router_buffers, "# of large messages to buffer in the router");
+static int elastic_router_buffers;
+module_param(elastic_router_buffers, int, 0644);
+MODULE_PARM_DESC(elastic_router_buffers, "factor router buffer pools may grow by under load and shrink by under memory pressure (0 to disable)");
 static int peer_buffer_credits;
 module_param(peer_buffer_credits, int, 0444);
 MODULE_PARM_DESC(peer_buffer_credits, "# router buffer credits per peer");
@@ -1369,13 +1372,197 @@ failed:
 	return -ENOMEM;
 }
 
+/* configure a pool with \a nbufs buffers, elastic pools scale around it */
+static int
+lnet_rtrpool_config_bufs(struct lnet_rtrbufpool *rbp, int nbufs, int cpt)
+{
+	lnet_net_lock(cpt);
+	rbp->rbp_base_nbuffers = nbufs;
+	lnet_net_unlock(cpt);
+
+	return lnet_rtrpool_adjust_bufs(rbp, nbufs, cpt);
+}
+
+static void
+lnet_rtrpool_grow(struct work_struct *work)
+{
+	struct lnet_rtrbufpool *rbp = container_of(work,
+						   struct lnet_rtrbufpool,
+						   rbp_grow_work);
+	int cpt = rbp->rbp_cpt;
+	int factor = elastic_router_buffers;
+	int nbufs;
+
+	lnet_net_lock(cpt);
+	if (!the_lnet.ln_routing || factor <= 1 ||
+	    list_empty(&rbp->rbp_msgs)) {
+		lnet_net_unlock(cpt);
+		return;
+	}
+
+	/* enough for everybody waiting, and at least 1/8 more so that a
+	 * burst doesn't grow the pool one buffer at a time */
+	nbufs = rbp->rbp_nbuffers + max3(-rbp->rbp_credits,
+					 rbp->rbp_nbuffers / 8, 1);
+	nbufs = min(nbufs, rbp->rbp_base_nbuffers * factor);
+	if (nbufs <= rbp->rbp_nbuffers) {
+		lnet_net_unlock(cpt);
+		return;
+	}
+	lnet_net_unlock(cpt);
+
+	CDEBUG(D_NET, "growing %d page router buffers on CPT %d to %d\n",
+	       rbp->rbp_npages, cpt, nbufs);
+	lnet_rtrpool_adjust_bufs(rbp, nbufs, cpt);
+}
+
+/* called with messages blocked on \a rbp, may grow it */
+void
+lnet_rtrpool_grow_locked(struct lnet_rtrbufpool *rbp)
+{
+	if (elastic_router_buffers > 1 &&
+	    rbp->rbp_nbuffers < rbp->rbp_base_nbuffers * elastic_router_buffers)
+		schedule_work(&rbp->rbp_grow_work);
+}
+
+/* # free buffers the shrinker may take from \a rbp */
+static int
+lnet_rtrpool_shrinkable(struct lnet_rtrbufpool *rbp)
+{
+	int floor;
+
+	if (elastic_router_buffers <= 1)
+		return 0;
+
+	floor = max(rbp->rbp_base_nbuffers / elastic_router_buffers, 1);
+	return max(min(rbp->rbp_credits, rbp->rbp_nbuffers - floor), 0);
+}
+
+static unsigned long
+lnet_rtrpools_shrink_count(struct shrinker *s, struct shrink_control *sc)
+{
+	struct lnet_rtrbufpool *rtrp;
+	unsigned long count = 0;
+	int idx;
+	int i;
+
+	/* a little race here is fine */
+	if (!the_lnet.ln_rtrpools)
+		return 0;
+
+	cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
+		for (idx = 0; idx < LNET_NRBPOOLS; idx++)
+			count += lnet_rtrpool_shrinkable(&rtrp[idx]) *
+				 max(rtrp[idx].rbp_npages, 1);
+	}
+
+	return count;
+}
+
+/* release free buffers above the floor, large ones first */
+static unsigned long
+lnet_rtrpools_shrink_scan(struct shrinker *s, struct shrink_control *sc)
+{
+	struct lnet_rtrbufpool *rtrp;
+	struct lnet_rtrbufpool *rbp;
+	struct lnet_rtrbuf *rb;
+	unsigned long freed = 0;
+	LIST_HEAD(tmp);
+	int idx;
+	int i;
+
+	if (!the_lnet.ln_rtrpools)
+		return 0;
+
+	for (idx = LNET_NRBPOOLS - 1; idx >= 0; idx--) {
+		cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
+			int nbufs;
+
+			rbp = &rtrp[idx];
+
+			lnet_net_lock(i);
+			nbufs = lnet_rtrpool_shrinkable(rbp);
+			while (nbufs-- > 0 && freed < sc->nr_to_scan) {
+				rb = list_first_entry(&rbp->rbp_bufs,
+						      struct lnet_rtrbuf,
+						      rb_list);
+				list_move(&rb->rb_list, &tmp);
+				rbp->rbp_credits--;
+				rbp->rbp_nbuffers--;
+				freed += max(rbp->rbp_npages, 1);
+			}
+			/* don't let returned buffers refill the pool */
+			rbp->rbp_req_nbuffers = min(rbp->rbp_req_nbuffers,
+						    rbp->rbp_nbuffers);
+			lnet_net_unlock(i);
+
+			while ((rb = list_first_entry_or_null(&tmp,
+							      struct lnet_rtrbuf,
+							      rb_list))) {
+				list_del(&rb->rb_list);
+				lnet_destroy_rtrbuf(rb, rbp->rbp_npages);
+			}
+		}
+	}
+
+	CDEBUG(D_NET, "released %lu router buffer pages\n", freed);
+	return freed;
+}
+
+#ifdef HAVE_SHRINKER_COUNT
+static struct shrinker lnet_rtrpools_shrinker = {
+	.count_objects	= lnet_rtrpools_shrink_count,
+	.scan_objects	= lnet_rtrpools_shrink_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+#else
+static int lnet_rtrpools_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	if (sc->nr_to_scan)
+		lnet_rtrpools_shrink_scan(shrinker, sc);
+
+	return lnet_rtrpools_shrink_count(shrinker, sc);
+}
+
+static struct shrinker lnet_rtrpools_shrinker = {
+	.shrink		= lnet_rtrpools_shrink,
+	.seeks		= DEFAULT_SEEKS,
+};
+#endif /* HAVE_SHRINKER_COUNT */
+
+static bool lnet_rtrpools_shrinker_registered;
+
+static void
+lnet_rtrpools_register_shrinker(void)
+{
+	int rc;
+
+#ifdef HAVE_REGISTER_SHRINKER_FORMAT_NAMED
+	rc = register_shrinker(&lnet_rtrpools_shrinker, "lnet_rtrpools");
+#elif defined(HAVE_REGISTER_SHRINKER_RET)
+	rc = register_shrinker(&lnet_rtrpools_shrinker);
+#else
+	register_shrinker(&lnet_rtrpools_shrinker);
+	rc = 0;
+#endif
+	/* the pools just won't shrink */
+	if (rc)
+		CWARN("lnet: cannot register router buffer shrinker: rc = %d\n",
+		      rc);
+	else
+		lnet_rtrpools_shrinker_registered = true;
+}
+
 static void
-lnet_rtrpool_init(struct lnet_rtrbufpool *rbp, int npages)
+lnet_rtrpool_init(struct lnet_rtrbufpool *rbp, int npages, int cpt)
 {
 	INIT_LIST_HEAD(&rbp->rbp_msgs);
 	INIT_LIST_HEAD(&rbp->rbp_bufs);
+	INIT_WORK(&rbp->rbp_grow_work, lnet_rtrpool_grow);
 
 	rbp->rbp_npages = npages;
+	rbp->rbp_cpt = cpt;
 	rbp->rbp_credits = 0;
 	rbp->rbp_mincredits = 0;
 }
@@ -1384,18 +1571,27 @@ void
 lnet_rtrpools_free(int keep_pools)
 {
 	struct lnet_rtrbufpool *rtrp;
+	int		  idx;
 	int		  i;
 
 	if (the_lnet.ln_rtrpools == NULL) /* uninitialized or freed */
 		return;
 
 	cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
+		/* pools are left zeroed if allocation failed before them */
+		for (idx = 0; idx < LNET_NRBPOOLS; idx++)
+			if (rtrp[idx].rbp_grow_work.func)
+				cancel_work_sync(&rtrp[idx].rbp_grow_work);
 		lnet_rtrpool_free_bufs(&rtrp[LNET_TINY_BUF_IDX], i);
 		lnet_rtrpool_free_bufs(&rtrp[LNET_SMALL_BUF_IDX], i);
 		lnet_rtrpool_free_bufs(&rtrp[LNET_LARGE_BUF_IDX], i);
 	}
 
 	if (!keep_pools) {
+		if (lnet_rtrpools_shrinker_registered) {
+			unregister_shrinker(&lnet_rtrpools_shrinker);
+			lnet_rtrpools_shrinker_registered = false;
+		}
 		cfs_percpt_free(the_lnet.ln_rtrpools);
 		the_lnet.ln_rtrpools = NULL;
 	}
@@ -1521,27 +1717,29 @@ lnet_rtrpools_alloc(int im_a_router)
 	}
 
 	cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
-		lnet_rtrpool_init(&rtrp[LNET_TINY_BUF_IDX], 0);
-		rc = lnet_rtrpool_adjust_bufs(&rtrp[LNET_TINY_BUF_IDX],
+		lnet_rtrpool_init(&rtrp[LNET_TINY_BUF_IDX], 0, i);
+		rc = lnet_rtrpool_config_bufs(&rtrp[LNET_TINY_BUF_IDX],
 					      nrb_tiny, i);
 		if (rc)
 			goto failed;
 
 		lnet_rtrpool_init(&rtrp[LNET_SMALL_BUF_IDX],
-				  LNET_NRB_SMALL_PAGES);
-		rc = lnet_rtrpool_adjust_bufs(&rtrp[LNET_SMALL_BUF_IDX],
+				  LNET_NRB_SMALL_PAGES, i);
+		rc = lnet_rtrpool_config_bufs(&rtrp[LNET_SMALL_BUF_IDX],
 					      nrb_small, i);
 		if (rc)
 			goto failed;
 
 		lnet_rtrpool_init(&rtrp[LNET_LARGE_BUF_IDX],
-				  LNET_NRB_LARGE_PAGES);
-		rc = lnet_rtrpool_adjust_bufs(&rtrp[LNET_LARGE_BUF_IDX],
+				  LNET_NRB_LARGE_PAGES, i);
+		rc = lnet_rtrpool_config_bufs(&rtrp[LNET_LARGE_BUF_IDX],
 					      nrb_large, i);
 		if (rc)
 			goto failed;
 	}
 
+	lnet_rtrpools_register_shrinker();
+
 	lnet_net_lock(LNET_LOCK_EX);
 	the_lnet.ln_routing = 1;
 	lnet_net_unlock(LNET_LOCK_EX);
@@ -1567,7 +1765,7 @@ lnet_rtrpools_adjust_helper(int tiny, int small, int large)
 		tiny_router_buffers = tiny;
 		nrb = lnet_nrb_tiny_calculate();
 		cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
-			rc = lnet_rtrpool_adjust_bufs(&rtrp[LNET_TINY_BUF_IDX],
+			rc = lnet_rtrpool_config_bufs(&rtrp[LNET_TINY_BUF_IDX],
 						      nrb, i);
 			if (rc != 0)
 				return rc;
@@ -1577,7 +1775,7 @@ lnet_rtrpools_adjust_helper(int tiny, int small, int large)
 		small_router_buffers = small;
 		nrb = lnet_nrb_small_calculate();
 		cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
-			rc = lnet_rtrpool_adjust_bufs(&rtrp[LNET_SMALL_BUF_IDX],
+			rc = lnet_rtrpool_config_bufs(&rtrp[LNET_SMALL_BUF_IDX],
 						      nrb, i);
 			if (rc != 0)
 				return rc;
@@ -1587,7 +1785,7 @@ lnet_rtrpools_adjust_helper(int tiny, int small, int large)
 		large_router_buffers = large;
 		nrb = lnet_nrb_large_calculate();
 		cfs_percpt_for_each(rtrp, i, the_lnet.ln_rtrpools) {
-			rc = lnet_rtrpool_adjust_bufs(&rtrp[LNET_LARGE_BUF_IDX],
+			rc = lnet_rtrpool_config_bufs(&rtrp[LNET_LARGE_BUF_IDX],
 						      nrb, i);
 			if (rc != 0)
 				return rc;
@@ -595,6 +595,85 @@ static int proc_lnet_buffers(struct ctl_table *table, int write,
 	return rc;
 }
 
+static int proc_lnet_buffer_waits(struct ctl_table *table, int write,
+				  void __user *buffer, size_t *lenp,
+				  loff_t *ppos)
+{
+	size_t nob = *lenp;
+	loff_t pos = *ppos;
+	char		*s;
+	char		*tmpstr;
+	int		tmpsiz;
+	int		idx;
+	int		len;
+	int		rc;
+	int		i;
+	int		j;
+
+	if (write) {
+		struct lnet_rtrbufpool *rbp;
+
+		if (the_lnet.ln_rtrpools == NULL)
+			return 0;
+
+		lnet_net_lock(LNET_LOCK_EX);
+		cfs_percpt_for_each(rbp, i, the_lnet.ln_rtrpools)
+			for (idx = 0; idx < LNET_NRBPOOLS; idx++)
+				memset(rbp[idx].rbp_wait_hist, 0,
+				       sizeof(rbp[idx].rbp_wait_hist));
+		lnet_net_unlock(LNET_LOCK_EX);
+		return 0;
+	}
+
+	/* 2 %d and LNET_RBP_WAIT_BUCKETS %llu per pool and CPT */
+	tmpsiz = (12 + 21 * LNET_RBP_WAIT_BUCKETS) *
+		 (LNET_NRBPOOLS * LNET_CPT_NUMBER + 1);
+	LIBCFS_ALLOC(tmpstr, tmpsiz);
+	if (tmpstr == NULL)
+		return -ENOMEM;
+
+	s = tmpstr; /* points to current position in tmpstr[] */
+
+	/* columns are the upper bound of each bucket in usecs */
+	s += scnprintf(s, tmpstr + tmpsiz - s, "%3s %5s %s", "cpt", "pages",
+		       "0");
+	for (j = 1; j < LNET_RBP_WAIT_BUCKETS; j++)
+		s += scnprintf(s, tmpstr + tmpsiz - s, " %lu", 1UL << j);
+	s += scnprintf(s, tmpstr + tmpsiz - s, "\n");
+	LASSERT(tmpstr + tmpsiz - s > 0);
+
+	if (the_lnet.ln_rtrpools == NULL)
+		goto out; /* I'm not a router */
+
+	for (idx = 0; idx < LNET_NRBPOOLS; idx++) {
+		struct lnet_rtrbufpool *rbp;
+
+		lnet_net_lock(LNET_LOCK_EX);
+		cfs_percpt_for_each(rbp, i, the_lnet.ln_rtrpools) {
+			s += scnprintf(s, tmpstr + tmpsiz - s, "%3d %5d", i,
+				       rbp[idx].rbp_npages);
+			for (j = 0; j < LNET_RBP_WAIT_BUCKETS; j++)
+				s += scnprintf(s, tmpstr + tmpsiz - s, " %llu",
+					       rbp[idx].rbp_wait_hist[j]);
+			s += scnprintf(s, tmpstr + tmpsiz - s, "\n");
+			LASSERT(tmpstr + tmpsiz - s > 0);
+		}
+		lnet_net_unlock(LNET_LOCK_EX);
+	}
+
+ out:
+	len = s - tmpstr;
+
+	if (pos >= min_t(int, len, strlen(tmpstr)))
+		rc = 0;
+	else
+		rc = cfs_trace_copyout_string(buffer, nob,
+					      tmpstr + pos, NULL);
+
+	LIBCFS_FREE(tmpstr, tmpsiz);
+	return rc;
+}
+
 static int
 proc_lnet_nis(struct ctl_table *table, int write, void __user *buffer,
 	      size_t *lenp, loff_t *ppos)
@@ -871,6 +950,11 @@ static struct ctl_table lnet_table[] = {
 		.mode		= 0444,
 		.proc_handler	= &proc_lnet_buffers,
 	},
+	{
+		.procname	= "buffer_waits",
+		.mode		= 0644,
+		.proc_handler	= &proc_lnet_buffer_waits,
+	},
 	{
 		.procname	= "nis",
 		.mode		= 0644,
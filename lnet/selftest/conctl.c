@@ -534,7 +534,7 @@ lst_stat_query_ioctl(struct lstio_stat_args *args)
 			return -EINVAL;
 
 		rc = lstcon_nodes_stat(args->lstio_sta_count,
-				       args->lstio_sta_idsp,
+				       args->lstio_sta_idsp, NULL,
 				       args->lstio_sta_timeout,
 				       args->lstio_sta_resultp);
 	} else if (args->lstio_sta_namep != NULL) {
@@ -549,7 +549,8 @@ lst_stat_query_ioctl(struct lstio_stat_args *args)
 		rc = copy_from_user(name, args->lstio_sta_namep,
 				    args->lstio_sta_nmlen);
 		if (rc == 0)
-			rc = lstcon_group_stat(name, args->lstio_sta_timeout,
+			rc = lstcon_group_stat(name, NULL,
+					       args->lstio_sta_timeout,
 					       args->lstio_sta_resultp);
 		else
 			rc = -EFAULT;
@@ -563,15 +564,101 @@ lst_stat_query_ioctl(struct lstio_stat_args *args)
 	return rc;
 }
 
-static int lst_test_add_ioctl(struct lstio_test_args *args)
+static int
+lst_perf_query_ioctl(struct lstio_perf_args *args)
+{
+	struct lstcon_perf_qry qry;
+	char *batch_name = NULL;
+	char *name = NULL;
+	int rc;
+
+	if (args->lstio_prf_key != console_session.ses_key)
+		return -EACCES;
+
+	if (args->lstio_prf_resultp == NULL)
+		return -EINVAL;
+
+	if (args->lstio_prf_bat_name != NULL) {
+		if (args->lstio_prf_bat_nmlen <= 0 ||
+		    args->lstio_prf_bat_nmlen > LST_NAME_SIZE)
+			return -EINVAL;
+
+		LIBCFS_ALLOC(batch_name, args->lstio_prf_bat_nmlen + 1);
+		if (batch_name == NULL)
+			return -ENOMEM;
+
+		if (copy_from_user(batch_name, args->lstio_prf_bat_name,
+				   args->lstio_prf_bat_nmlen)) {
+			rc = -EFAULT;
+			goto out;
+		}
+	}
+
+	rc = lstcon_perf_qry_init(batch_name, args->lstio_prf_type, &qry);
+	if (rc != 0)
+		goto out;
+
+	if (args->lstio_prf_idsp != NULL) {
+		if (args->lstio_prf_count <= 0) {
+			rc = -EINVAL;
+			goto out;
+		}
+
+		rc = lstcon_nodes_stat(args->lstio_prf_count,
+				       args->lstio_prf_idsp, &qry,
+				       args->lstio_prf_timeout,
+				       args->lstio_prf_resultp);
+	} else if (args->lstio_prf_namep != NULL) {
+		if (args->lstio_prf_nmlen <= 0 ||
+		    args->lstio_prf_nmlen > LST_NAME_SIZE) {
+			rc = -EINVAL;
+			goto out;
+		}
+
+		LIBCFS_ALLOC(name, args->lstio_prf_nmlen + 1);
+		if (name == NULL) {
+			rc = -ENOMEM;
+			goto out;
+		}
+
+		rc = copy_from_user(name, args->lstio_prf_namep,
+				    args->lstio_prf_nmlen);
+		if (rc == 0)
+			rc = lstcon_group_stat(name, &qry,
+					       args->lstio_prf_timeout,
+					       args->lstio_prf_resultp);
+		else
+			rc = -EFAULT;
+	} else {
+		rc = -EINVAL;
+	}
+out:
+	if (name != NULL)
+		LIBCFS_FREE(name, args->lstio_prf_nmlen + 1);
+	if (batch_name != NULL)
+		LIBCFS_FREE(batch_name, args->lstio_prf_bat_nmlen + 1);
+	return rc;
+}
+
+static int lst_test_add_ioctl(struct lstio_test_args *args, int len)
 {
 	char *batch_name;
 	char *src_name = NULL;
 	char *dst_name = NULL;
 	void *param = NULL;
+	int rate = 0;
 	int ret = 0;
 	int rc = -ENOMEM;
 
+	/* lstio_tes_rate is missing from the arguments of older tools */
+	if (len >= offsetofend(struct lstio_test_args, lstio_tes_rate))
+		rate = args->lstio_tes_rate;
+	else if (len < offsetof(struct lstio_test_args, lstio_tes_rate))
+		return -EINVAL;
+
+	if (rate < 0)
+		return -EINVAL;
+
 	if (args->lstio_tes_resultp == NULL ||
 	    args->lstio_tes_retp == NULL ||
 	    args->lstio_tes_bat_name == NULL || /* no specified batch */
@@ -633,7 +720,7 @@ static int lst_test_add_ioctl(struct lstio_test_args *args)
 	rc = lstcon_test_add(batch_name,
 			     args->lstio_tes_type,
 			     args->lstio_tes_loop,
-			     args->lstio_tes_concur,
+			     args->lstio_tes_concur, rate,
 			     args->lstio_tes_dist, args->lstio_tes_span,
 			     src_name, dst_name, param,
 			     args->lstio_tes_param_len,
@@ -759,11 +846,15 @@ lstcon_ioctl_entry(struct notifier_block *nb,
 		rc = lst_batch_info_ioctl((struct lstio_batch_info_args *)buf);
 		break;
 	case LSTIO_TEST_ADD:
-		rc = lst_test_add_ioctl((struct lstio_test_args *)buf);
+		rc = lst_test_add_ioctl((struct lstio_test_args *)buf,
+					data->ioc_plen1);
 		break;
 	case LSTIO_STAT_QUERY:
 		rc = lst_stat_query_ioctl((struct lstio_stat_args *)buf);
 		break;
+	case LSTIO_PERF_QUERY:
+		rc = lst_perf_query_ioctl((struct lstio_perf_args *)buf);
+		break;
 	default:
 		rc = -EINVAL;
 		goto out;
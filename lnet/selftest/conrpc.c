@@ -223,6 +223,9 @@ lstcon_rpc_trans_name(int transop)
         if (transop == LST_TRANS_STATQRY)
                 return "STATQRY";
 
+	if (transop == LST_TRANS_PERFQRY)
+		return "PERFQRY";
+
         return "Unknown";
 }
 
@@ -705,6 +708,31 @@ lstcon_statrpc_prep(struct lstcon_node *nd, unsigned int feats,
         return 0;
 }
 
+int
+lstcon_perfrpc_prep(struct lstcon_node *nd, unsigned int feats,
+		    struct lstcon_perf_qry *qry, struct lstcon_rpc **crpc)
+{
+	struct srpc_perf_reqst *prq;
+	int rc;
+
+	if ((feats & LST_FEAT_PERF) == 0)
+		return -EOPNOTSUPP;
+
+	rc = lstcon_rpc_prep(nd, SRPC_SERVICE_QUERY_PERF, feats, 0, 0, crpc);
+	if (rc != 0)
+		return rc;
+
+	prq = &(*crpc)->crp_rpc->crpc_reqstmsg.msg_body.perf_reqst;
+
+	prq->prf_sid.ses_stamp = console_session.ses_id.ses_stamp;
+	prq->prf_sid.ses_nid =
+		lnet_nid_to_nid4(&console_session.ses_id.ses_nid);
+	prq->prf_bid = qry->pq_bid;
+	prq->prf_type = qry->pq_type;
+
+	return 0;
+}
+
 static struct lnet_process_id_packed *
 lstcon_next_id(int idx, int nkiov, struct bio_vec *kiov)
 {
@@ -832,6 +860,11 @@ lstcon_testrpc_prep(struct lstcon_node *nd, int transop, unsigned int feats,
 	int nob = 0;
 	int rc = 0;
 
+	if (test->tes_rate != 0 && (feats & LST_FEAT_PERF) == 0) {
+		CERROR("Test nodes can't run a test at a fixed rate\n");
+		return -EOPNOTSUPP;
+	}
+
 	if (transop == LST_TRANS_TSBCLIADD) {
 		npg = sfw_id_pages(test->tes_span);
 		nob = (feats & LST_FEAT_BULK_LEN) == 0 ?
@@ -901,6 +934,7 @@ lstcon_testrpc_prep(struct lstcon_node *nd, int transop, unsigned int feats,
         trq->tsr_concur     = test->tes_concur;
         trq->tsr_is_client  = (transop == LST_TRANS_TSBCLIADD) ? 1 : 0;
         trq->tsr_stop_onerr = !!test->tes_stop_onerr;
+	trq->tsr_rate	    = test->tes_rate;
 
         switch (test->tes_type) {
 	case LST_TEST_PING: {
@@ -990,6 +1024,7 @@ lstcon_rpc_stat_reply(struct lstcon_rpc_trans *trans, struct srpc_msg *msg,
 	struct srpc_batch_reply *bat_rep;
 	struct srpc_test_reply *test_rep;
 	struct srpc_stat_reply *stat_rep;
+	struct srpc_perf_reply *perf_rep;
 	int rc = 0;
 
 	switch (trans->tas_opc) {
@@ -1091,6 +1126,18 @@ lstcon_rpc_stat_reply(struct lstcon_rpc_trans *trans, struct srpc_msg *msg,
                 rc = stat_rep->str_status;
                 break;
 
+	case LST_TRANS_PERFQRY:
+		perf_rep = &msg->msg_body.perf_reply;
+
+		if (perf_rep->prf_status == 0) {
+			lstcon_statqry_stat_success(stat, 1);
+			return;
+		}
+
+		lstcon_statqry_stat_failure(stat, 1);
+		rc = perf_rep->prf_status;
+		break;
+
         default:
                 LBUG();
         }
@@ -1162,6 +1209,11 @@ lstcon_rpc_trans_ndlist(struct list_head *ndlist,
 		case LST_TRANS_STATQRY:
 			rc = lstcon_statrpc_prep(nd, feats, &rpc);
                         break;
+		case LST_TRANS_PERFQRY:
+			rc = lstcon_perfrpc_prep(nd, feats,
+						 (struct lstcon_perf_qry *)arg,
+						 &rpc);
+			break;
                 default:
                         rc = -EINVAL;
                         break;
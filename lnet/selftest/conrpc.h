@@ -103,6 +103,13 @@ struct lstcon_rpc_trans {
 #define LST_TRANS_TSBSRVQRY     0x16
 
 #define LST_TRANS_STATQRY       0x21
+#define LST_TRANS_PERFQRY	0x22
+
+/* argument of LST_TRANS_PERFQRY */
+struct lstcon_perf_qry {
+	struct lst_bid		pq_bid;		/* batch of LST_PERF_LATENCY */
+	int			pq_type;	/* enum lst_perf_type */
+};
 
 typedef int (*lstcon_rpc_cond_func_t)(int, struct lstcon_node *, void *);
 typedef int (*lstcon_rpc_readent_func_t)(int, struct srpc_msg *,
@@ -118,6 +125,8 @@ int  lstcon_testrpc_prep(struct lstcon_node *nd, int transop, unsigned version,
 			 struct lstcon_test *test, struct lstcon_rpc **crpc);
 int  lstcon_statrpc_prep(struct lstcon_node *nd, unsigned version,
 			 struct lstcon_rpc **crpc);
+int  lstcon_perfrpc_prep(struct lstcon_node *nd, unsigned int feats,
+			 struct lstcon_perf_qry *qry, struct lstcon_rpc **crpc);
 void lstcon_rpc_put(struct lstcon_rpc *crpc);
 int  lstcon_rpc_trans_prep(struct list_head *translist,
 			   int transop, struct lstcon_rpc_trans **transpp);
@@ -1252,7 +1252,7 @@ lstcon_verify_group(const char *name, struct lstcon_group **grp)
 
 int
 lstcon_test_add(char *batch_name, int type, int loop,
-		int concur, int dist, int span,
+		int concur, int rate, int dist, int span,
 		char *src_name, char *dst_name,
 		void *param, int paramlen, int *retp,
 		struct list_head __user *result_up)
@@ -1297,6 +1297,7 @@ lstcon_test_add(char *batch_name, int type, int loop,
 	test->tes_oneside	= 0; /* TODO */
 	test->tes_loop		= loop;
 	test->tes_concur	= concur;
+	test->tes_rate		= rate;
 	test->tes_stop_onerr	= 1; /* TODO */
 	test->tes_span		= span;
 	test->tes_dist		= dist;
@@ -1464,15 +1465,33 @@ lstcon_statrpc_readent(int transop, struct srpc_msg *msg,
 }
 
 static int
-lstcon_ndlist_stat(struct list_head *ndlist,
+lstcon_perfrpc_readent(int transop, struct srpc_msg *msg,
+		       struct lstcon_rpc_ent __user *ent_up)
+{
+	struct srpc_perf_reply *rep = &msg->msg_body.perf_reply;
+
+	if (rep->prf_status != 0)
+		return 0;
+
+	if (copy_to_user(&ent_up->rpe_payload[0], &rep->prf_cnt,
+			 sizeof(rep->prf_cnt)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int
+lstcon_ndlist_stat(struct list_head *ndlist, struct lstcon_perf_qry *qry,
 		   int timeout, struct list_head __user *result_up)
 {
 	LIST_HEAD(head);
 	struct lstcon_rpc_trans *trans;
 	int rc;
 
-        rc = lstcon_rpc_trans_ndlist(ndlist, &head,
-                                     LST_TRANS_STATQRY, NULL, NULL, &trans);
+	rc = lstcon_rpc_trans_ndlist(ndlist, &head,
+				     qry ? LST_TRANS_PERFQRY :
+					   LST_TRANS_STATQRY,
+				     qry, NULL, &trans);
         if (rc != 0) {
                 CERROR("Can't create transaction: %d\n", rc);
                 return rc;
@@ -1480,15 +1499,41 @@ lstcon_ndlist_stat(struct list_head *ndlist,
 
         lstcon_rpc_trans_postwait(trans, LST_VALIDATE_TIMEOUT(timeout));
 
-        rc = lstcon_rpc_trans_interpreter(trans, result_up,
-                                          lstcon_statrpc_readent);
+	rc = lstcon_rpc_trans_interpreter(trans, result_up,
+					  qry ? lstcon_perfrpc_readent :
+						lstcon_statrpc_readent);
         lstcon_rpc_trans_destroy(trans);
 
         return rc;
 }
 
 int
-lstcon_group_stat(char *grp_name, int timeout,
+lstcon_perf_qry_init(char *bat_name, int type, struct lstcon_perf_qry *qry)
+{
+	struct lstcon_batch *bat;
+	int rc;
+
+	memset(qry, 0, sizeof(*qry));
+	qry->pq_type = type;
+
+	if (type == LST_PERF_CPU)
+		return 0;
+
+	if (type != LST_PERF_LATENCY || bat_name == NULL)
+		return -EINVAL;
+
+	rc = lstcon_batch_find(bat_name, &bat);
+	if (rc != 0) {
+		CDEBUG(D_NET, "Can't find batch %s\n", bat_name);
+		return rc;
+	}
+
+	qry->pq_bid = bat->bat_hdr.tsb_id;
+	return 0;
+}
+
+int
+lstcon_group_stat(char *grp_name, struct lstcon_perf_qry *qry, int timeout,
 		  struct list_head __user *result_up)
 {
 	struct lstcon_group *grp;
@@ -1500,7 +1545,7 @@ lstcon_group_stat(char *grp_name, int timeout,
                 return rc;
         }
 
-        rc = lstcon_ndlist_stat(&grp->grp_ndl_list, timeout, result_up);
+	rc = lstcon_ndlist_stat(&grp->grp_ndl_list, qry, timeout, result_up);
 
 	lstcon_group_decref(grp);
 
@@ -1509,7 +1554,8 @@ lstcon_group_stat(char *grp_name, int timeout,
 
 int
 lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
-		  int timeout, struct list_head __user *result_up)
+		  struct lstcon_perf_qry *qry, int timeout,
+		  struct list_head __user *result_up)
 {
 	struct lstcon_ndlink *ndl;
 	struct lstcon_group *tmp;
@@ -1544,7 +1590,7 @@ lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
                 return rc;
         }
 
-        rc = lstcon_ndlist_stat(&tmp->grp_ndl_list, timeout, result_up);
+	rc = lstcon_ndlist_stat(&tmp->grp_ndl_list, qry, timeout, result_up);
 
 	lstcon_group_decref(tmp);
 
@@ -126,6 +126,7 @@ struct lstcon_test {
         int                   tes_oneside;    /* one-sided test */
         int                   tes_concur;     /* concurrency */
         int                   tes_loop;       /* loop count */
+	int			tes_rate;	/* RPCs/sec, 0 for closed loop */
         int                   tes_dist;       /* nodes distribution of target group */
         int                   tes_span;       /* nodes span of target group */
         int                   tes_cliidx;     /* client index, used for RPC creating */
@@ -242,12 +243,15 @@ extern int lstcon_batch_info(char *name,
 			     int server, int testidx, int *index_p,
 			     int *ndent_p,
 			     struct lstcon_node_ent __user *dents_up);
-extern int lstcon_group_stat(char *grp_name, int timeout,
-			     struct list_head __user *result_up);
-extern int lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
+extern int lstcon_perf_qry_init(char *bat_name, int type,
+				struct lstcon_perf_qry *qry);
+extern int lstcon_group_stat(char *grp_name, struct lstcon_perf_qry *qry,
 			     int timeout, struct list_head __user *result_up);
+extern int lstcon_nodes_stat(int count, struct lnet_process_id __user *ids_up,
+			     struct lstcon_perf_qry *qry, int timeout,
+			     struct list_head __user *result_up);
 extern int lstcon_test_add(char *batch_name, int type, int loop,
-			   int concur, int dist, int span,
+			   int concur, int rate, int dist, int span,
 			   char *src_name, char *dst_name,
 			   void *param, int paramlen, int *retp,
 			   struct list_head __user *result_up);
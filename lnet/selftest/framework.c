@@ -95,6 +95,16 @@ do {                                    \
 	__swab64s(&(lc).lcc_route_length);  \
 } while (0)
 
+#define sfw_unpack_perf_counters(pc)			\
+do {							\
+	int __i;					\
+							\
+	__swab32s(&(pc).prf_running_ms);		\
+	__swab32s(&(pc).prf_count);			\
+	for (__i = 0; __i < LST_PERF_NVALS; __i++)	\
+		__swab32s(&(pc).prf_vals[__i]);		\
+} while (0)
+
 #define sfw_test_active(t)      (atomic_read(&(t)->tsi_nactive) != 0)
 #define sfw_batch_active(b)     (atomic_read(&(b)->bat_nactive) != 0)
 
@@ -420,6 +430,71 @@ sfw_get_stats(struct srpc_stat_reqst *request, struct srpc_stat_reply *reply)
 	return 0;
 }
 
+static int
+sfw_get_perf(struct srpc_perf_reqst *request, struct srpc_perf_reply *reply)
+{
+	struct sfw_session *sn = sfw_data.fw_session;
+	struct lst_perf_counters *cnt = &reply->prf_cnt;
+	struct sfw_test_instance *tsi;
+	struct sfw_batch *bat;
+	int i;
+
+	reply->prf_sid = get_old_sid(sn);
+	memset(cnt, 0, sizeof(*cnt));
+
+	if (request->prf_sid.ses_nid == LNET_NID_ANY) {
+		reply->prf_status = EINVAL;
+		return 0;
+	}
+
+	if (sn == NULL || !sfw_sid_equal(request->prf_sid, sn->sn_id)) {
+		reply->prf_status = ESRCH;
+		return 0;
+	}
+
+	cnt->prf_running_ms = ktime_ms_delta(ktime_get(), sn->sn_started);
+
+	switch (request->prf_type) {
+	case LST_PERF_LATENCY:
+		bat = sfw_find_batch(request->prf_bid);
+		if (bat == NULL) {
+			reply->prf_status = ENOENT;
+			return 0;
+		}
+
+		/* servers of the batch have nothing to add */
+		cnt->prf_count = LST_PERF_NVALS;
+		list_for_each_entry(tsi, &bat->bat_tests, tsi_list) {
+			if (!tsi->tsi_is_client)
+				continue;
+
+			spin_lock(&tsi->tsi_lock);
+			for (i = 0; i < LST_PERF_NVALS; i++)
+				cnt->prf_vals[i] += tsi->tsi_lat_hist[i];
+			spin_unlock(&tsi->tsi_lock);
+		}
+		break;
+
+	case LST_PERF_CPU:
+		cnt->prf_count = min_t(int, LST_PERF_NVALS,
+				       cfs_cpt_number(lnet_cpt_table()));
+		for (i = 0; i < cnt->prf_count; i++) {
+			int ncpus = cfs_cpt_weight(lnet_cpt_table(), i);
+
+			cnt->prf_vals[i] = div_u64(atomic64_read(&lst_cpt_busy[i]),
+						   max(ncpus, 1) * NSEC_PER_MSEC);
+		}
+		break;
+
+	default:
+		reply->prf_status = EINVAL;
+		return 0;
+	}
+
+	reply->prf_status = 0;
+	return 0;
+}
+
 int
 sfw_make_session(struct srpc_mksn_reqst *request, struct srpc_mksn_reply *reply)
 {
@@ -647,6 +722,7 @@ sfw_destroy_test_instance(struct sfw_test_instance *tsi)
 		tsu = list_first_entry(&tsi->tsi_units,
 				       struct sfw_test_unit, tsu_list);
 		list_del(&tsu->tsu_list);
+		hrtimer_cancel(&tsu->tsu_timer);
 		LIBCFS_FREE(tsu, sizeof(*tsu));
 	}
 
@@ -744,6 +820,42 @@ sfw_unpack_addtest_req(struct srpc_msg *msg)
 	LBUG();
 }
 
+static enum hrtimer_restart
+sfw_test_unit_wakeup(struct hrtimer *timer)
+{
+	struct sfw_test_unit *tsu = container_of(timer, struct sfw_test_unit,
+						 tsu_timer);
+
+	swi_schedule_workitem(&tsu->tsu_worker);
+	return HRTIMER_NORESTART;
+}
+
+/* In open loop the next RPC of a unit is due at a fixed time regardless
+ * of how long the previous one took; a unit which has fallen behind
+ * sends right away.
+ */
+static void
+sfw_test_unit_schedule(struct sfw_test_unit *tsu)
+{
+	struct sfw_test_instance *tsi = tsu->tsu_instance;
+
+	if (tsi->tsi_rate != 0 && ktime_after(tsu->tsu_next, ktime_get())) {
+		/* sfw_stop_batch() cancels the timers under tsi_lock, don't
+		 * arm one once it has run
+		 */
+		spin_lock(&tsi->tsi_lock);
+		if (!tsi->tsi_stopping) {
+			hrtimer_start(&tsu->tsu_timer, tsu->tsu_next,
+				      HRTIMER_MODE_ABS);
+			spin_unlock(&tsi->tsi_lock);
+			return;
+		}
+		spin_unlock(&tsi->tsi_lock);
+	}
+
+	swi_schedule_workitem(&tsu->tsu_worker);
+}
+
 static int
 sfw_add_test_instance(struct sfw_batch *tsb, struct srpc_server_rpc *rpc)
 {
@@ -776,6 +888,8 @@ sfw_add_test_instance(struct sfw_batch *tsb, struct srpc_server_rpc *rpc)
         tsi->tsi_service       = req->tsr_service;
         tsi->tsi_is_client     = !!(req->tsr_is_client);
         tsi->tsi_stoptsu_onerr = !!(req->tsr_stop_onerr);
+	if ((msg->msg_ses_feats & LST_FEAT_PERF) != 0)
+		tsi->tsi_rate = req->tsr_rate;
 
         rc = sfw_load_test(tsi);
         if (rc != 0) {
@@ -823,10 +937,19 @@ sfw_add_test_instance(struct sfw_batch *tsb, struct srpc_server_rpc *rpc)
 			tsu->tsu_dest.pid = id.pid;
 			tsu->tsu_instance = tsi;
 			tsu->tsu_private  = NULL;
+			hrtimer_init(&tsu->tsu_timer, CLOCK_MONOTONIC,
+				     HRTIMER_MODE_ABS);
+			tsu->tsu_timer.function = sfw_test_unit_wakeup;
 			list_add_tail(&tsu->tsu_list, &tsi->tsi_units);
 		}
 	}
 
+	/* each unit keeps at most one RPC in flight, so the rate is
+	 * shared out evenly between them */
+	if (tsi->tsi_rate != 0)
+		tsi->tsi_interval_ns = div_u64((u64)ndest * tsi->tsi_concur *
+					       NSEC_PER_SEC, tsi->tsi_rate);
+
 	rc = tsi->tsi_ops->tso_init(tsi);
 	if (rc == 0) {
 		list_add_tail(&tsi->tsi_list, &tsb->bat_tests);
@@ -845,12 +968,18 @@ sfw_test_unit_done(struct sfw_test_unit *tsu)
 	struct sfw_test_instance *tsi = tsu->tsu_instance;
 	struct sfw_batch *tsb = tsi->tsi_batch;
 	struct sfw_session *sn = tsb->bat_session;
+	struct sfw_test_unit *unit;
 
         LASSERT (sfw_test_active(tsi));
 
 	if (!atomic_dec_and_test(&tsi->tsi_nactive))
                 return;
 
+	/* all RPCs have drained, make sure no unit timer is left armed */
+	if (tsi->tsi_rate != 0)
+		list_for_each_entry(unit, &tsi->tsi_units, tsu_list)
+			hrtimer_cancel(&unit->tsu_timer);
+
         /* the test instance is done */
 	spin_lock(&tsi->tsi_lock);
 
@@ -886,6 +1015,7 @@ sfw_test_rpc_done(struct srpc_client_rpc *rpc)
 {
 	struct sfw_test_unit *tsu = rpc->crpc_priv;
 	struct sfw_test_instance *tsi = tsu->tsu_instance;
+	s64 usec = ktime_us_delta(ktime_get(), tsu->tsu_start);
         int                  done = 0;
 
         tsi->tsi_ops->tso_done_rpc(tsu, rpc);
@@ -897,6 +1027,11 @@ sfw_test_rpc_done(struct srpc_client_rpc *rpc)
 
 	list_del_init(&rpc->crpc_list);
 
+	if (rpc->crpc_status == 0)
+		tsi->tsi_lat_hist[usec < 2 ? 0 :
+				  min_t(int, ilog2(usec),
+					LST_PERF_NVALS - 1)]++;
+
         /* batch is stopping or loop is done or get error */
         if (tsi->tsi_stopping ||
             tsu->tsu_loop == 0 ||
@@ -909,7 +1044,7 @@ sfw_test_rpc_done(struct srpc_client_rpc *rpc)
 	spin_unlock(&tsi->tsi_lock);
 
         if (!done) {
-                swi_schedule_workitem(&tsu->tsu_worker);
+		sfw_test_unit_schedule(tsu);
                 return;
         }
 
@@ -991,6 +1126,16 @@ sfw_run_test(struct swi_workitem *wi)
 	if (tsu->tsu_loop > 0)
 		tsu->tsu_loop--;
 
+	/* in open loop latency counts from when the RPC was due, so time
+	 * spent waiting behind a slow RPC isn't hidden */
+	if (tsi->tsi_rate != 0) {
+		tsu->tsu_start = tsu->tsu_next;
+		tsu->tsu_next = ktime_add_ns(tsu->tsu_next,
+					     tsi->tsi_interval_ns);
+	} else {
+		tsu->tsu_start = ktime_get();
+	}
+
 	list_add_tail(&rpc->crpc_list, &tsi->tsi_active_rpcs);
 	wi->swi_state = SWI_STATE_RUNNING;
 	spin_unlock(&tsi->tsi_lock);
@@ -1018,6 +1163,8 @@ sfw_run_batch(struct sfw_batch *tsb)
 	struct swi_workitem *wi;
 	struct sfw_test_unit *tsu;
 	struct sfw_test_instance *tsi;
+	ktime_t now = ktime_get();
+	u64 i;
 
         if (sfw_batch_active(tsb)) {
 		CDEBUG(D_NET, "Batch already active: %llu (%d)\n",
@@ -1034,15 +1181,21 @@ sfw_run_batch(struct sfw_batch *tsb)
 
 		atomic_inc(&tsb->bat_nactive);
 
+		i = 0;
 		list_for_each_entry(tsu, &tsi->tsi_units, tsu_list) {
 			atomic_inc(&tsi->tsi_nactive);
 			tsu->tsu_loop = tsi->tsi_loop;
+			/* spread the first RPCs of an open loop test */
+			if (tsi->tsi_rate != 0)
+				tsu->tsu_next = ktime_add_ns(now,
+					div_u64(i++ * NSEC_PER_SEC,
+						tsi->tsi_rate));
 			wi = &tsu->tsu_worker;
 			swi_init_workitem(wi, sfw_run_test,
 					  lst_test_wq[lnet_cpt_of_nid(
 							      tsu->tsu_dest.nid,
 							      NULL)]);
-			swi_schedule_workitem(wi);
+			sfw_test_unit_schedule(tsu);
 		}
 	}
 
@@ -1054,6 +1207,7 @@ sfw_stop_batch(struct sfw_batch *tsb, int force)
 {
 	struct sfw_test_instance *tsi;
 	struct srpc_client_rpc *rpc;
+	struct sfw_test_unit *tsu;
 
         if (!sfw_batch_active(tsb)) {
 		CDEBUG(D_NET, "Batch %llu inactive\n", tsb->bat_id.bat_id);
@@ -1071,6 +1225,14 @@ sfw_stop_batch(struct sfw_batch *tsb, int force)
 
 		tsi->tsi_stopping = 1;
 
+		/* don't wait for units sleeping until their next RPC */
+		if (tsi->tsi_rate != 0) {
+			list_for_each_entry(tsu, &tsi->tsi_units, tsu_list) {
+				if (hrtimer_try_to_cancel(&tsu->tsu_timer) == 1)
+					swi_schedule_workitem(&tsu->tsu_worker);
+			}
+		}
+
 		if (!force) {
 			spin_unlock(&tsi->tsi_lock);
 			continue;
@@ -1326,6 +1488,11 @@ sfw_handle_server_rpc(struct srpc_server_rpc *rpc)
                                    &reply->msg_body.stat_reply);
                 break;
 
+	case SRPC_SERVICE_QUERY_PERF:
+		rc = sfw_get_perf(&request->msg_body.perf_reqst,
+				  &reply->msg_body.perf_reply);
+		break;
+
         case SRPC_SERVICE_DEBUG:
                 rc = sfw_debug_session(&request->msg_body.dbg_reqst,
                                        &reply->msg_body.dbg_reply);
@@ -1472,6 +1639,25 @@ sfw_unpack_message(struct srpc_msg *msg)
                 return;
         }
 
+	if (msg->msg_type == SRPC_MSG_PERF_REQST) {
+		struct srpc_perf_reqst *req = &msg->msg_body.perf_reqst;
+
+		__swab64s(&req->prf_rpyid);
+		sfw_unpack_sid(req->prf_sid);
+		__swab64s(&req->prf_bid.bat_id);
+		__swab32s(&req->prf_type);
+		return;
+	}
+
+	if (msg->msg_type == SRPC_MSG_PERF_REPLY) {
+		struct srpc_perf_reply *rep = &msg->msg_body.perf_reply;
+
+		__swab32s(&rep->prf_status);
+		sfw_unpack_sid(rep->prf_sid);
+		sfw_unpack_perf_counters(rep->prf_cnt);
+		return;
+	}
+
         if (msg->msg_type == SRPC_MSG_MKSN_REQST) {
 		struct srpc_mksn_reqst *req = &msg->msg_body.mksn_reqst;
 
@@ -1553,6 +1739,7 @@ sfw_unpack_message(struct srpc_msg *msg)
                 __swab32s(&req->tsr_ndest);
                 __swab32s(&req->tsr_concur);
                 __swab32s(&req->tsr_service);
+		__swab32s(&req->tsr_rate);
                 sfw_unpack_sid(req->tsr_sid);
                 __swab64s(&req->tsr_bid.bat_id);
                 return;
@@ -1616,6 +1803,7 @@ sfw_post_rpc(struct srpc_client_rpc *rpc)
 static struct srpc_service sfw_services[] = {
 	{ .sv_id = SRPC_SERVICE_DEBUG,		.sv_name = "debug", },
 	{ .sv_id = SRPC_SERVICE_QUERY_STAT,	.sv_name = "query stats", },
+	{ .sv_id = SRPC_SERVICE_QUERY_PERF,	.sv_name = "query perf", },
 	{ .sv_id = SRPC_SERVICE_MAKE_SESSION,	.sv_name = "make session", },
 	{ .sv_id = SRPC_SERVICE_REMOVE_SESSION,	.sv_name = "remove session", },
 	{ .sv_id = SRPC_SERVICE_BATCH,		.sv_name = "batch service", },
@@ -47,6 +47,7 @@ static int lst_init_step = LST_INIT_NONE;
 
 struct workqueue_struct *lst_serial_wq;
 struct workqueue_struct **lst_test_wq;
+atomic64_t *lst_cpt_busy;
 
 static void
 lnet_selftest_exit(void)
@@ -73,6 +74,11 @@ lnet_selftest_exit(void)
 		CFS_FREE_PTR_ARRAY(lst_test_wq,
 				   cfs_cpt_number(lnet_cpt_table()));
 		lst_test_wq = NULL;
+		if (lst_cpt_busy) {
+			CFS_FREE_PTR_ARRAY(lst_cpt_busy,
+					   cfs_cpt_number(lnet_cpt_table()));
+			lst_cpt_busy = NULL;
+		}
 		fallthrough;
 	case LST_INIT_WI_SERIAL:
 		destroy_workqueue(lst_serial_wq);
@@ -107,6 +113,12 @@ lnet_selftest_init(void)
 	}
 
 	lst_init_step = LST_INIT_WI_TEST;
+	CFS_ALLOC_PTR_ARRAY(lst_cpt_busy, nscheds);
+	if (!lst_cpt_busy) {
+		rc = -ENOMEM;
+		goto error;
+	}
+
 	for (i = 0; i < nscheds; i++) {
 		int nthrs = cfs_cpt_weight(lnet_cpt_table(), i);
 
@@ -58,6 +58,8 @@ enum srpc_msg_type {
         SRPC_MSG_PING_REPLY     = 15,
         SRPC_MSG_JOIN_REQST     = 16,
         SRPC_MSG_JOIN_REPLY     = 17,
+	SRPC_MSG_PERF_REQST	= 18,
+	SRPC_MSG_PERF_REPLY	= 19,
 };
 
 /* CAVEAT EMPTOR:
@@ -163,6 +165,19 @@ struct srpc_stat_reply {
 	struct lnet_counters_common str_lnet;
 } __packed;
 
+struct srpc_perf_reqst {
+	__u64			prf_rpyid;	/* reply buffer matchbits */
+	struct lst_sid		prf_sid;	/* session id */
+	struct lst_bid		prf_bid;	/* batch id, LST_PERF_LATENCY */
+	__u32			prf_type;	/* enum lst_perf_type */
+} __packed;
+
+struct srpc_perf_reply {
+	__u32			prf_status;
+	struct lst_sid		prf_sid;
+	struct lst_perf_counters prf_cnt;
+} __packed;
+
 struct test_bulk_req {
         __u32                   blk_opc;        /* bulk operation code */
         __u32                   blk_npg;        /* # of pages */
@@ -203,6 +218,8 @@ struct srpc_test_reqst {
 		struct test_bulk_req	bulk_v0;
 		struct test_bulk_req_v1	bulk_v1;
 	} tsr_u;
+	/* RPCs per second of the test, 0 for closed loop, LST_FEAT_PERF */
+	__u32			tsr_rate;
 } __packed;
 
 struct srpc_test_reply {
@@ -269,6 +286,8 @@ struct srpc_msg {
 		struct srpc_test_reply		tes_reply;
 		struct srpc_join_reqst		join_reqst;
 		struct srpc_join_reply		join_reply;
+		struct srpc_perf_reqst		perf_reqst;
+		struct srpc_perf_reply		perf_reply;
 
 		struct srpc_ping_reqst		ping_reqst;
 		struct srpc_ping_reply		ping_reply;
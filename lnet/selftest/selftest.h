@@ -156,6 +156,7 @@ struct sfw_test_instance;
 #define SRPC_SERVICE_TEST               4
 #define SRPC_SERVICE_QUERY_STAT         5
 #define SRPC_SERVICE_JOIN               6
+#define SRPC_SERVICE_QUERY_PERF		7
 #define SRPC_FRAMEWORK_SERVICE_MAX_ID   10
 /* other services start from SRPC_FRAMEWORK_SERVICE_MAX_ID+1 */
 #define SRPC_SERVICE_BRW                11
@@ -200,6 +201,9 @@ srpc_service2request (int service)
 
         case SRPC_SERVICE_JOIN:
                 return SRPC_MSG_JOIN_REQST;
+
+	case SRPC_SERVICE_QUERY_PERF:
+		return SRPC_MSG_PERF_REQST;
         }
 }
 
@@ -463,6 +467,10 @@ struct sfw_test_instance {
 	unsigned int		tsi_stoptsu_onerr:1; /* stop tsu on error */
         int                     tsi_concur;          /* concurrency */
         int                     tsi_loop;            /* loop count */
+	/* RPCs per second of all units, 0 for closed loop */
+	unsigned int		tsi_rate;
+	/* gap between two RPCs of the same unit in open loop */
+	u64			tsi_interval_ns;
 
 	/* status of test instance */
 	spinlock_t		tsi_lock;	/* serialize */
@@ -471,6 +479,8 @@ struct sfw_test_instance {
 	struct list_head	tsi_units;	/* test units */
 	struct list_head	tsi_free_rpcs;	/* free rpcs */
 	struct list_head	tsi_active_rpcs;/* active rpcs */
+	/* latency histogram of successful RPCs, under tsi_lock */
+	__u32			tsi_lat_hist[LST_PERF_NVALS];
 
 	union {
 		struct test_ping_req	ping;	  /* ping parameter */
@@ -493,6 +503,12 @@ struct sfw_test_unit {
 	struct sfw_test_instance *tsu_instance;	/* pointer to test instance */
 	void			*tsu_private;	/* private data */
 	struct swi_workitem	 tsu_worker;	/* workitem of the test unit */
+	/* when the RPC in flight was started, or was due in open loop */
+	ktime_t			tsu_start;
+	/* when the next RPC is due in open loop */
+	ktime_t			tsu_next;
+	/* wakes the unit up when the next RPC is due */
+	struct hrtimer		tsu_timer;
 };
 
 struct sfw_test_case {
@@ -543,6 +559,8 @@ void srpc_get_counters(struct srpc_counters *cnt);
 
 extern struct workqueue_struct *lst_serial_wq;
 extern struct workqueue_struct **lst_test_wq;
+/* per-CPT nanoseconds spent running test work items */
+extern atomic64_t *lst_cpt_busy;
 
 static inline int
 srpc_serv_is_framework(struct srpc_service *svc)
@@ -554,9 +572,18 @@ static void
 swi_wi_action(struct work_struct *wi)
 {
 	struct swi_workitem *swi;
+	struct workqueue_struct *wq;
+	ktime_t start;
 
 	swi = container_of(wi, struct swi_workitem, swi_work);
+	/* the action may free the workitem */
+	wq = swi->swi_wq;
+	start = ktime_get();
 	swi->swi_action(swi);
+
+	if (wq != lst_serial_wq)
+		atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+			     &lst_cpt_busy[lnet_cpt_current()]);
 }
 
 static inline void
@@ -2178,12 +2178,37 @@ lst_stat_ioctl(char *name, int count, struct lnet_process_id *idsp,
 	return lst_ioctl(LSTIO_STAT_QUERY, &args, sizeof(args));
 }
 
+static int
+lst_perf_ioctl(char *name, int count, struct lnet_process_id *idsp,
+	       char *batch, int type, int timeout, struct list_head *resultp)
+{
+	struct lstio_perf_args args = { 0 };
+
+	args.lstio_prf_key	 = session_key;
+	args.lstio_prf_timeout	 = timeout;
+	args.lstio_prf_type	 = type;
+	if (batch != NULL) {
+		args.lstio_prf_bat_nmlen = strlen(batch);
+		args.lstio_prf_bat_name	 = batch;
+	}
+	args.lstio_prf_nmlen	 = strlen(name);
+	args.lstio_prf_namep	 = name;
+	args.lstio_prf_count	 = count;
+	args.lstio_prf_idsp	 = idsp;
+	args.lstio_prf_resultp	 = resultp;
+
+	return lst_ioctl(LSTIO_PERF_QUERY, &args, sizeof(args));
+}
+
 typedef struct {
 	struct list_head              srp_link;
         int                     srp_count;
         char                   *srp_name;
 	struct lnet_process_id      *srp_ids;
 	struct list_head              srp_result[2];
+	/* results of LST_PERF_LATENCY and LST_PERF_CPU queries */
+	struct list_head	srp_lat[2];
+	struct list_head	srp_cpu[2];
 } lst_stat_req_param_t;
 
 static void
@@ -2191,8 +2216,11 @@ lst_stat_req_param_free(lst_stat_req_param_t *srp)
 {
         int     i;
 
-        for (i = 0; i < 2; i++)
-                lst_free_rpcent(&srp->srp_result[i]);
+	for (i = 0; i < 2; i++) {
+		lst_free_rpcent(&srp->srp_result[i]);
+		lst_free_rpcent(&srp->srp_lat[i]);
+		lst_free_rpcent(&srp->srp_cpu[i]);
+	}
 
         if (srp->srp_ids != NULL)
                 free(srp->srp_ids);
@@ -2201,7 +2229,8 @@ lst_stat_req_param_free(lst_stat_req_param_t *srp)
 }
 
 static int
-lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
+lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old,
+			 int latency, int cpu)
 {
         lst_stat_req_param_t *srp = NULL;
         int                   count = save_old ? 2 : 1;
@@ -2213,8 +2242,11 @@ lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
                 return -ENOMEM;
 
         memset(srp, 0, sizeof(*srp));
-	INIT_LIST_HEAD(&srp->srp_result[0]);
-	INIT_LIST_HEAD(&srp->srp_result[1]);
+	for (i = 0; i < 2; i++) {
+		INIT_LIST_HEAD(&srp->srp_result[i]);
+		INIT_LIST_HEAD(&srp->srp_lat[i]);
+		INIT_LIST_HEAD(&srp->srp_cpu[i]);
+	}
 
         rc = lst_get_node_count(LST_OPC_GROUP, name,
                                 &srp->srp_count, NULL);
@@ -2239,6 +2271,12 @@ lst_stat_req_param_alloc(char *name, lst_stat_req_param_t **srpp, int save_old)
 				      sizeof(struct sfw_counters)  +
 				      sizeof(struct srpc_counters) +
 				      sizeof(struct lnet_counters_common));
+		if (rc == 0 && latency)
+			rc = lst_alloc_rpcent(&srp->srp_lat[i], srp->srp_count,
+					      sizeof(struct lst_perf_counters));
+		if (rc == 0 && cpu)
+			rc = lst_alloc_rpcent(&srp->srp_cpu[i], srp->srp_count,
+					      sizeof(struct lst_perf_counters));
 		if (rc != 0) {
 			fprintf(stderr, "Out of memory\n");
 			break;
@@ -2370,6 +2408,32 @@ lst_cal_lnet_stat(float delta, struct lnet_counters_common *lnet_new,
 					    lnet_stat_result.lnet_stat_count;
 }
 
+static void
+lst_yaml_lnet_stat(int mbs)
+{
+	static const char * const rw[] = { "read", "write" };
+	static const char * const val[] = { "avg", "min", "max" };
+	int i;
+	int j;
+	int k;
+
+	if (lnet_stat_result.lnet_stat_count == 0)
+		return;
+
+	fprintf(stdout, "  lnet:\n");
+	fprintf(stdout, "    bw_units: %s\n", mbs ? "MB/s" : "MiB/s");
+	for (i = 0; i <= 1; i++) {
+		for (j = 0; j <= 1; j++) {
+			for (k = 0; k <= 2; k++) {
+				fprintf(stdout, i == 0 ? "    %s_rate_%s: %.0f\n" :
+							 "    %s_bw_%s: %.2f\n",
+					rw[j], val[k],
+					lst_lnet_stat_value(i, j, k));
+			}
+		}
+	}
+}
+
 static void
 lst_print_lnet_stat(char *name, int bwrt, int rdwr, int type, int mbs)
 {
@@ -2431,7 +2495,7 @@ lst_print_lnet_stat(char *name, int bwrt, int rdwr, int type, int mbs)
 static void
 lst_print_stat(char *name, struct list_head *resultp,
 	       int idx, int lnet, int bwrt, int rdwr, int type,
-	       int mbs)
+	       int mbs, int yaml)
 {
 	struct list_head tmp[2];
 	struct lstcon_rpc_ent *new;
@@ -2514,13 +2578,227 @@ lst_print_stat(char *name, struct list_head *resultp,
 	list_splice(&tmp[idx], &resultp[idx]);
 	list_splice(&tmp[1 - idx], &resultp[1 - idx]);
 
-	if (errcount > 0)
+	if (yaml)
+		fprintf(stdout, "  failed_nodes: %d\n", errcount);
+	else if (errcount > 0)
 		fprintf(stdout, "Failed to stat on %d nodes\n", errcount);
 
 	if (!lnet)  /* TODO */
 		return;
 
-	lst_print_lnet_stat(name, bwrt, rdwr, type, mbs);
+	if (yaml)
+		lst_yaml_lnet_stat(mbs);
+	else
+		lst_print_lnet_stat(name, bwrt, rdwr, type, mbs);
+}
+
+typedef void (*lst_perf_delta_t)(struct lst_perf_counters *new,
+				 struct lst_perf_counters *old, void *data);
+
+/* Walk the two latest results of a perf query node by node, as
+ * lst_print_stat() does. Returns the # of nodes which failed, or -1 if
+ * there aren't two comparable results yet.
+ */
+static int
+lst_perf_walk(struct list_head *resultp, int idx, lst_perf_delta_t delta,
+	      void *data)
+{
+	struct list_head tmp[2];
+	struct lstcon_rpc_ent *new;
+	struct lstcon_rpc_ent *old;
+	int errcount = 0;
+	int nnodes = 0;
+
+	INIT_LIST_HEAD(&tmp[0]);
+	INIT_LIST_HEAD(&tmp[1]);
+
+	while (!list_empty(&resultp[idx])) {
+		if (list_empty(&resultp[1 - idx]))
+			break;
+
+		new = list_first_entry(&resultp[idx], struct lstcon_rpc_ent,
+				       rpe_link);
+		old = list_first_entry(&resultp[1 - idx], struct lstcon_rpc_ent,
+				       rpe_link);
+
+		if (new->rpe_peer.nid == LNET_NID_ANY ||
+		    new->rpe_peer.nid != old->rpe_peer.nid ||
+		    new->rpe_peer.pid != old->rpe_peer.pid)
+			break;
+
+		list_move_tail(&new->rpe_link, &tmp[idx]);
+		list_move_tail(&old->rpe_link, &tmp[1 - idx]);
+		nnodes++;
+
+		if (new->rpe_rpc_errno != 0 || new->rpe_fwk_errno != 0 ||
+		    old->rpe_rpc_errno != 0 || old->rpe_fwk_errno != 0) {
+			errcount++;
+			continue;
+		}
+
+		delta((struct lst_perf_counters *)&new->rpe_payload[0],
+		      (struct lst_perf_counters *)&old->rpe_payload[0], data);
+	}
+
+	list_splice(&tmp[idx], &resultp[idx]);
+	list_splice(&tmp[1 - idx], &resultp[1 - idx]);
+
+	return nnodes == 0 ? -1 : errcount;
+}
+
+static void
+lst_latency_delta(struct lst_perf_counters *new,
+		  struct lst_perf_counters *old, void *data)
+{
+	__u64 *hist = data;
+	int i;
+
+	/* a node could have restarted the session in between */
+	if (new->prf_running_ms < old->prf_running_ms)
+		return;
+
+	for (i = 0; i < LST_PERF_NVALS && i < new->prf_count; i++)
+		hist[i] += (__u32)(new->prf_vals[i] - old->prf_vals[i]);
+}
+
+/* bucket i of the histogram holds latencies of [2^i, 2^(i+1)) usec,
+ * assume they are spread evenly within the bucket */
+static double
+lst_latency_percentile(__u64 *hist, __u64 total, double pct)
+{
+	double target = total * pct / 100;
+	double lo;
+	double hi;
+	__u64 sum = 0;
+	int i;
+
+	for (i = 0; i < LST_PERF_NVALS; i++) {
+		if (hist[i] == 0)
+			continue;
+
+		if (sum + hist[i] >= target) {
+			lo = i == 0 ? 0 : (double)(1ULL << i);
+			hi = (double)(1ULL << (i + 1));
+			return lo + (hi - lo) * (target - sum) / hist[i];
+		}
+		sum += hist[i];
+	}
+
+	return 0;
+}
+
+static void
+lst_print_latency(char *name, char *batch, struct list_head *resultp,
+		  int idx, int yaml)
+{
+	static const double pcts[] = { 50, 90, 99, 99.9 };
+	static const char * const keys[] = { "p50", "p90", "p99", "p999" };
+	__u64 hist[LST_PERF_NVALS] = { 0 };
+	__u64 total = 0;
+	double max = 0;
+	int errcount;
+	int i;
+
+	errcount = lst_perf_walk(resultp, idx, lst_latency_delta, hist);
+	if (errcount < 0)
+		return;
+
+	for (i = 0; i < LST_PERF_NVALS; i++) {
+		total += hist[i];
+		if (hist[i] != 0)
+			max = (double)(1ULL << (i + 1));
+	}
+
+	if (yaml) {
+		fprintf(stdout, "  latency:\n");
+		fprintf(stdout, "    batch: %s\n", batch);
+		fprintf(stdout, "    failed_nodes: %d\n", errcount);
+		fprintf(stdout, "    samples: %llu\n",
+			(unsigned long long)total);
+		for (i = 0; i < 4; i++)
+			fprintf(stdout, "    %s_us: %.0f\n", keys[i],
+				lst_latency_percentile(hist, total, pcts[i]));
+		fprintf(stdout, "    max_us: %.0f\n", max);
+		return;
+	}
+
+	if (errcount > 0)
+		fprintf(stdout, "Failed to query latency on %d nodes\n",
+			errcount);
+
+	fprintf(stdout, "[Latency of %s, batch %s]\n", name, batch);
+	fprintf(stdout, "RPCs: %llu ", (unsigned long long)total);
+	for (i = 0; i < 4; i++)
+		fprintf(stdout, "%s: %.0f us ", keys[i],
+			lst_latency_percentile(hist, total, pcts[i]));
+	fprintf(stdout, "max: < %.0f us\n", max);
+}
+
+struct lst_cpu_result {
+	double	cr_total[LST_PERF_NVALS];
+	double	cr_max[LST_PERF_NVALS];
+	int	cr_nodes[LST_PERF_NVALS];
+};
+
+static void
+lst_cpu_delta(struct lst_perf_counters *new,
+	      struct lst_perf_counters *old, void *data)
+{
+	struct lst_cpu_result *res = data;
+	__u32 delta = new->prf_running_ms - old->prf_running_ms;
+	double util;
+	int i;
+
+	if (new->prf_running_ms <= old->prf_running_ms)
+		return;
+
+	for (i = 0; i < LST_PERF_NVALS && i < new->prf_count; i++) {
+		util = (double)(__u32)(new->prf_vals[i] - old->prf_vals[i]) *
+		       100 / delta;
+		res->cr_total[i] += util;
+		res->cr_nodes[i]++;
+		if (util > res->cr_max[i])
+			res->cr_max[i] = util;
+	}
+}
+
+static void
+lst_print_cpu(char *name, struct list_head *resultp, int idx, int yaml)
+{
+	struct lst_cpu_result res;
+	int errcount;
+	int i;
+
+	memset(&res, 0, sizeof(res));
+	errcount = lst_perf_walk(resultp, idx, lst_cpu_delta, &res);
+	if (errcount < 0)
+		return;
+
+	if (yaml) {
+		fprintf(stdout, "  cpu:\n");
+		fprintf(stdout, "    failed_nodes: %d\n", errcount);
+		fprintf(stdout, "    cpts:\n");
+	} else {
+		if (errcount > 0)
+			fprintf(stdout, "Failed to query CPU on %d nodes\n",
+				errcount);
+		fprintf(stdout, "[CPU of %s]\n", name);
+	}
+
+	for (i = 0; i < LST_PERF_NVALS; i++) {
+		if (res.cr_nodes[i] == 0)
+			continue;
+
+		if (yaml)
+			fprintf(stdout,
+				"      - cpt: %d\n        avg_pct: %.1f\n        max_pct: %.1f\n",
+				i, res.cr_total[i] / res.cr_nodes[i],
+				res.cr_max[i]);
+		else
+			fprintf(stdout, "CPT %d avg: %.1f%% max: %.1f%%\n", i,
+				res.cr_total[i] / res.cr_nodes[i],
+				res.cr_max[i]);
+	}
 }
 
 static int
@@ -2541,6 +2819,10 @@ jt_lst_stat(int argc, char **argv)
 	int		      rc;
 	int		      c;
 	int		      mbs     = 0; /* report as MB/s */
+	int		      cpu     = 0;
+	int		      yaml    = 0;
+	int		      first   = 1;
+	char		     *latency = NULL; /* batch to get latency of */
 
 	static const struct option stat_opts[] = {
 		{ .name = "timeout", .has_arg = required_argument, .val = 't' },
@@ -2556,6 +2838,9 @@ jt_lst_stat(int argc, char **argv)
 		{ .name = "min",     .has_arg = no_argument,       .val = 'n' },
 		{ .name = "max",     .has_arg = no_argument,       .val = 'x' },
 		{ .name = "mbs",     .has_arg = no_argument,       .val = 'm' },
+		{ .name = "latency", .has_arg = required_argument, .val = 'L' },
+		{ .name = "cpu",     .has_arg = no_argument,       .val = 'u' },
+		{ .name = "yaml",    .has_arg = no_argument,       .val = 'y' },
 		{ .name = NULL } };
 
         if (session_key == 0) {
@@ -2565,7 +2850,7 @@ jt_lst_stat(int argc, char **argv)
         }
 
         while (1) {
-		c = getopt_long(argc, argv, "t:d:lcbarwgnxm", stat_opts,
+		c = getopt_long(argc, argv, "t:d:lcbarwgnxmL:uy", stat_opts,
 				&optidx);
 
                 if (c == -1)
@@ -2623,6 +2908,15 @@ jt_lst_stat(int argc, char **argv)
 		case 'm':
 			mbs = 1;
 			break;
+		case 'L':
+			latency = optarg;
+			break;
+		case 'u':
+			cpu = 1;
+			break;
+		case 'y':
+			yaml = 1;
+			break;
 
 		default:
 			lst_print_usage(argv[0]);
@@ -2652,7 +2946,8 @@ jt_lst_stat(int argc, char **argv)
 	INIT_LIST_HEAD(&head);
 
         while (optind < argc) {
-                rc = lst_stat_req_param_alloc(argv[optind++], &srp, 1);
+		rc = lst_stat_req_param_alloc(argv[optind++], &srp, 1,
+					      latency != NULL, cpu);
                 if (rc != 0)
                         goto out;
 
@@ -2678,13 +2973,59 @@ jt_lst_stat(int argc, char **argv)
                                 goto out;
                         }
 
+			if (latency != NULL) {
+				rc = lst_perf_ioctl(srp->srp_name,
+						    srp->srp_count, srp->srp_ids,
+						    latency, LST_PERF_LATENCY,
+						    timeout, &srp->srp_lat[idx]);
+				if (rc == -1) {
+					lst_print_error("stat", "Failed to get latency of %s: %s\n",
+							srp->srp_name,
+							strerror(errno));
+					goto out;
+				}
+			}
+
+			if (cpu) {
+				rc = lst_perf_ioctl(srp->srp_name,
+						    srp->srp_count, srp->srp_ids,
+						    NULL, LST_PERF_CPU,
+						    timeout, &srp->srp_cpu[idx]);
+				if (rc == -1) {
+					lst_print_error("stat", "Failed to get CPU usage of %s: %s\n",
+							srp->srp_name,
+							strerror(errno));
+					goto out;
+				}
+			}
+
+			/* the first round only provides a base for deltas */
+			if (yaml && first) {
+				lst_reset_rpcent(&srp->srp_result[1 - idx]);
+				lst_reset_rpcent(&srp->srp_lat[1 - idx]);
+				lst_reset_rpcent(&srp->srp_cpu[1 - idx]);
+				continue;
+			}
+
+			if (yaml)
+				fprintf(stdout, "- group: %s\n", srp->srp_name);
+
 			lst_print_stat(srp->srp_name, srp->srp_result,
-				       idx, lnet, bwrt, rdwr, type, mbs);
+				       idx, lnet, bwrt, rdwr, type, mbs, yaml);
+			if (latency != NULL)
+				lst_print_latency(srp->srp_name, latency,
+						  srp->srp_lat, idx, yaml);
+			if (cpu)
+				lst_print_cpu(srp->srp_name, srp->srp_cpu, idx,
+					      yaml);
 
 			lst_reset_rpcent(&srp->srp_result[1 - idx]);
+			lst_reset_rpcent(&srp->srp_lat[1 - idx]);
+			lst_reset_rpcent(&srp->srp_cpu[1 - idx]);
 		}
 
 		idx = 1 - idx;
+		first = 0;
 
 		if (count > 0)
 			count--;
@@ -2750,7 +3091,7 @@ jt_lst_show_error(int argc, char **argv)
 	INIT_LIST_HEAD(&head);
 
         while (optind < argc) {
-                rc = lst_stat_req_param_alloc(argv[optind++], &srp, 0);
+		rc = lst_stat_req_param_alloc(argv[optind++], &srp, 0, 0, 0);
                 if (rc != 0)
                         goto out;
 
@@ -3723,7 +4064,7 @@ lst_get_test_param(char *test, int argc, char **argv, void **param, int *plen)
 }
 
 static int
-lst_add_test_ioctl(char *batch, int type, int loop, int concur,
+lst_add_test_ioctl(char *batch, int type, int loop, int concur, int rate,
                    int dist, int span, char *sgrp, char *dgrp,
 		   void *param, int plen, int *retp, struct list_head *resultp)
 {
@@ -3746,6 +4087,7 @@ lst_add_test_ioctl(char *batch, int type, int loop, int concur,
         args.lstio_tes_param      = param;
         args.lstio_tes_retp       = retp;
         args.lstio_tes_resultp    = resultp;
+	args.lstio_tes_rate	  = rate;
 
         return lst_ioctl(LSTIO_TEST_ADD, &args, sizeof(args));
 }
@@ -3762,6 +4104,7 @@ jt_lst_add_test(int argc, char **argv)
 	void *param  = NULL;
 	int   optidx = 0;
 	int   concur = 1;
+	int   rate   = 0;
 	int   loop   = -1;
 	int   dist   = 1;
 	int   span   = 1;
@@ -3780,6 +4123,7 @@ jt_lst_add_test(int argc, char **argv)
 	{ .name = "from",	 .has_arg = required_argument, .val = 'f' },
 	{ .name = "to",		 .has_arg = required_argument, .val = 't' },
 	{ .name = "loop",	 .has_arg = required_argument, .val = 'l' },
+	{ .name = "rate",	 .has_arg = required_argument, .val = 'r' },
 	{ .name = NULL } };
 
         if (session_key == 0) {
@@ -3789,8 +4133,8 @@ jt_lst_add_test(int argc, char **argv)
         }
 
         while (1) {
-                c = getopt_long(argc, argv, "b:c:d:f:l:t:",
-                                add_test_opts, &optidx);
+		c = getopt_long(argc, argv, "b:c:d:f:l:r:t:",
+				add_test_opts, &optidx);
 
                 /* Detect the end of the options. */
                 if (c == -1)
@@ -3812,6 +4156,9 @@ jt_lst_add_test(int argc, char **argv)
                 case 'l':
                         loop = atoi(optarg);
                         break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
                 case 't':
                         to = optarg;
                         break;
@@ -3831,6 +4178,11 @@ jt_lst_add_test(int argc, char **argv)
                 return -1;
         }
 
+	if (rate < 0) {
+		fprintf(stderr, "Invalid rate of test: %d\n", rate);
+		return -1;
+	}
+
         if (batch == NULL)
                 batch = LST_DEFAULT_BATCH;
 
@@ -3875,8 +4227,8 @@ jt_lst_add_test(int argc, char **argv)
                 goto out;
         }
 
-        rc = lst_add_test_ioctl(batch, type, loop, concur,
-                                dist, span, from, to, param, plen, &ret, &head);
+	rc = lst_add_test_ioctl(batch, type, loop, concur, rate,
+				dist, span, from, to, param, plen, &ret, &head);
 
         if (rc == 0) {
                 fprintf(stdout, "Test was added successfully\n");
@@ -3924,7 +4276,8 @@ static command_t lst_cmdlist[] = {
           "Usage: lst list_group [--active] [--busy] [--down] [--unknown] GROUP ..."    },
 	{"stat",                jt_lst_stat,            NULL,
 	 "Usage: lst stat [--bw] [--rate] [--read] [--write] [--max] [--min] [--avg] "
-	 " [--mbs] [--timeout #] [--delay #] [--count #] GROUP [GROUP]"                 },
+	 " [--mbs] [--latency BATCH] [--cpu] [--yaml] [--timeout #] [--delay #] "
+	 " [--count #] GROUP [GROUP]"							},
         {"show_error",          jt_lst_show_error,      NULL,
          "Usage: lst show_error NAME | IDS ..."                                         },
         {"add_batch",           jt_lst_add_batch,       NULL,
@@ -3939,7 +4292,7 @@ static command_t lst_cmdlist[] = {
          "Usage: lst query [--test ID] [--server] [--timeout TIME] NAME"                },
         {"add_test",            jt_lst_add_test,        NULL,
          "Usage: lst add_test [--batch BATCH] [--loop #] [--concurrency #] "
-         " [--distribute #:#] [--from GROUP] [--to GROUP] TEST..."                      },
+	 " [--rate #] [--distribute #:#] [--from GROUP] [--to GROUP] TEST..."		},
         {0,                     0,                      0,      NULL                    }
 };
 
@@ -58,6 +58,14 @@ Options:
 	   The number of stat RPCs to issue. Default is 1.
 	-o <offset>
 	   Add off=<offset> to brw tests.
+	-P
+	   Also report the RPC latency percentiles of the test clients and the
+	   CPU usage of the test threads on each CPU partition. Requires test
+	   nodes which support LST_FEAT_PERF.
+	-R rate
+	   Issue the RPCs of each test at a fixed rate (RPCs per second, over
+	   all clients) instead of as fast as the concurrency allows. Latency is then measured from when
+	   each RPC was due, so queueing delay shows up in the percentiles.
 	-s iosize
 	   I/O size in bytes, kilobytes, or Megabytes (i.e., -s 1024, -s 4K,
 	   -s 1M). The default is 1 Megabyte.
@@ -80,6 +88,8 @@ Options:
 	   list of hostnames.
 	   PDSH-style expressions are supported for NID arguments, but not for
 	   host mode ('-H').
+	-Y
+	   Print the stats as YAML.
 EOF
 	exit
 }
@@ -160,7 +170,10 @@ BW_UNITS="--mbs"
 HOST_MODE=false
 LOAD_MODULES=false
 BRW_OFFSET=""
-while getopts "b:C:c:d:D:ef:g:hHl:Lm:Mn:o:s:S:t:" flag ; do
+PROFILE=false
+RATE=""
+STAT_YAML=false
+while getopts "b:C:c:d:D:ef:g:hHl:Lm:Mn:o:PR:s:S:t:Y" flag ; do
 	case $flag in
 		b) BATCH_NAME="$OPTARG";;
 		c) CONCURRENCY="$OPTARG";;
@@ -178,9 +191,12 @@ while getopts "b:C:c:d:D:ef:g:hHl:Lm:Mn:o:s:S:t:" flag ; do
 		M) BW_UNITS="";;
 		n) COUNT="$OPTARG";;
 		o) BRW_OFFSET="$OPTARG";;
+		P) PROFILE=true;;
+		R) RATE="$OPTARG";;
 		s) IOSIZE="$OPTARG";;
 		S) STAT_OPTS="$OPTARG";;
 		t) SERVERS="$OPTARG";;
+		Y) STAT_YAML=true;;
 		*) echo "Unrecognized option '-$flag'"
 		   exit 1;;
 	esac
@@ -204,6 +220,9 @@ elif [[ -z $(which lst 2>/dev/null) ]]; then
 elif ${LOAD_MODULES} && ! ${HOST_MODE}; then
 	echo "Module loading ('-L') is only available in host mode ('-H')"
 	exit 1
+elif [[ -n $RATE ]] && ! [[ $RATE =~ ^[0-9]+$ ]]; then
+	echo "Rate must be a number of RPCs per second. Found \"${RATE}\""
+	exit 1
 fi
 
 for stat_opt in ${STAT_OPTS}; do
@@ -344,6 +363,8 @@ test_opts+=( --batch "${BATCH_NAME}" --concurrency "${CONCURRENCY}" )
 test_opts+=( --from clients --to servers --distribute "${DISTRIBUTION}" )
 [[ -n ${LOOPS} ]] &&
 	test_opts+=( --loop "${LOOPS}" )
+[[ -n ${RATE} ]] &&
+	test_opts+=( --rate "${RATE}" )
 
 if [[ $MODE == ping ]]; then
 	test_opts+=( ping )
@@ -381,6 +402,14 @@ else
 	stat_opts+=( --bw "${BW_UNITS}" )
 fi
 
+if ${PROFILE}; then
+	stat_opts+=( --latency "${BATCH_NAME}" --cpu )
+fi
+
+if ${STAT_YAML}; then
+	stat_opts+=( --yaml )
+fi
+
 for g in ${STAT_GROUP}; do
 	stat_opts+=( "${g}" )
 done
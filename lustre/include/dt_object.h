@@ -113,6 +113,17 @@ struct dt_txn_commit_cb {
 	char			dcb_name[MAX_COMMIT_CB_STR_LEN];
 };
 
+/**
+ * Completion of data IO that the OSD finishes after the transaction which
+ * submitted it was stopped, see thandle::th_io_cb.
+ */
+struct dt_io_cb {
+	/** called from a work queue once the IO is done */
+	void			(*dic_done)(struct dt_io_cb *cb, int rc);
+	/** set by the OSD if it took the IO over and will call dic_done() */
+	bool			dic_deferred;
+};
+
 /**
  * Operations on dt device.
  */
@@ -2015,6 +2026,15 @@ struct thandle {
 	 * this value is used in recovery */
 	__s32             th_result;
 
+	/** if set, the OSD may leave the data IO of this transaction in
+	 * flight when it is stopped, the pages are then released by
+	 * dt_bufs_put() only once the IO completes */
+	struct dt_io_cb		*th_io_cb;
+
+	/** bytes the writer is expected to append to the object right after
+	 * this write, the OSD may reserve contiguous space for them */
+	__u64			th_write_reserve;
+
 	/** whether we need sync commit */
 	unsigned int		th_sync:1,
 	/* local transation, no need to inform other layers */
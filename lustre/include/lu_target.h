@@ -76,6 +76,7 @@ struct distribute_txn_replay_req_sub {
 };
 
 struct target_distribute_txn_data;
+struct distribute_txn_cancel_thread;
 typedef int (*distribute_txn_replay_handler_t)(struct lu_env *env,
 				       struct target_distribute_txn_data *tdtd,
 				       struct distribute_txn_replay_req *dtrq);
@@ -101,6 +102,14 @@ struct target_distribute_txn_data {
 	atomic_t		tdtd_refcount;
 	struct lu_env		tdtd_env;
 
+	/* Threads cancelling update records of committed transactions,
+	 * each handles all the records of one target at a time */
+	struct distribute_txn_cancel_thread *tdtd_cancel_threads;
+	int			tdtd_cancel_nthreads;
+	spinlock_t		tdtd_cancel_lock;
+	struct list_head	tdtd_cancel_list;
+	atomic_t		tdtd_cancel_pending;
+
 	/* recovery update */
 	distribute_txn_replay_handler_t	tdtd_replay_handler;
 	struct list_head		tdtd_replay_list;
@@ -174,7 +183,11 @@ struct lu_target {
 				 lut_no_reconstruct:1,
 				 /* enforce recovery for local clients */
 				 lut_local_recovery:1,
-				 lut_cksum_t10pi_enforce:1;
+				 lut_cksum_t10pi_enforce:1,
+				 /* reply to BRW writes on IO completion */
+				 lut_brw_async_reply:1;
+	/* BRW writes waiting for their IO to complete to be replied */
+	atomic_t		 lut_brw_async_count;
 	/* checksum types supported on this node */
 	enum cksum_types	 lut_cksum_types_supported;
 	/** last_rcvd file */
@@ -201,6 +214,15 @@ struct lu_target {
 	struct dt_object	*lut_reply_data;
 	/** Bitmap of used slots in the reply data file */
 	unsigned long		**lut_reply_bitmap;
+	/** Per-CPU caches of reply data slots reserved in the bitmap */
+	struct tgt_reply_slot_cache __percpu *lut_reply_slot_cache;
+	/** Bitmap of the slots in the per-CPU caches */
+	unsigned long		**lut_reply_cached;
+	/** Slots below this one are likely in use */
+	atomic_t		 lut_reply_slot_hint;
+	/** Latency of reply data slot allocations in ns */
+	struct obd_hist_pcpu	 lut_reply_slot_hist;
+	ktime_t			 lut_reply_slot_init;
 	/** target sync count, used for debug & test */
 	atomic_t		 lut_sync_count;
 
@@ -225,6 +247,18 @@ struct lu_target {
 /* number of slots in reply bitmap */
 #define LUT_REPLY_SLOTS_PER_CHUNK (1<<20)
 #define LUT_REPLY_SLOTS_MAX_CHUNKS 16
+/* number of slots reserved at once for a per-CPU cache */
+#define LUT_REPLY_SLOTS_CACHE	32
+
+struct tgt_reply_slot_cache {
+	spinlock_t	trsc_lock;
+	int		trsc_count;
+	int		trsc_slots[LUT_REPLY_SLOTS_CACHE];
+	/* statistics */
+	__u64		trsc_allocs;
+	__u64		trsc_refills;
+	__u64		trsc_recycled;
+};
 
 #define TRD_INDEX_MEMORY -1
 
@@ -301,6 +335,11 @@ struct tgt_session_info {
 	bool			tsi_mult_trans;
 	int			tsi_has_trans;
 
+	/* BRW write IO the OSD may complete after the handler returns */
+	struct dt_io_cb		*tsi_brw_cb;
+	/* the handler left the reply to be sent by someone else */
+	bool			 tsi_reply_deferred;
+
 	/* Batched RPC replay */
 	bool			 tsi_batch_env;
 	/* Sub request index in the batched RPC. */
@@ -482,6 +521,7 @@ int tgt_extent_lock(const struct lu_env *env, struct ldlm_namespace *ns,
 void tgt_data_unlock(struct lustre_handle *lh, enum ldlm_mode mode);
 int tgt_brw_read(struct tgt_session_info *tsi);
 int tgt_brw_write(struct tgt_session_info *tsi);
+void tgt_brw_async_drain(struct lu_target *lut);
 int tgt_lseek(struct tgt_session_info *tsi);
 int tgt_hpreq_handler(struct ptlrpc_request *req);
 void tgt_register_lfsck_in_notify_local(int (*notify)(const struct lu_env *,
@@ -542,6 +582,10 @@ int tgt_mk_reply_data(const struct lu_env *env, struct lu_target *tgt,
 		      __u64 transno);
 struct tg_reply_data *tgt_lookup_reply_by_xid(struct tg_export_data *ted,
 					       __u64 xid);
+int tgt_txn_join_start(const struct lu_env *env, struct lu_context *ses,
+		       struct lu_target *tgt, struct thandle *th);
+int tgt_txn_join_stop(const struct lu_env *env, struct lu_context *ses,
+		      struct lu_target *tgt, struct thandle *th, int result);
 int tgt_tunables_init(struct lu_target *lut);
 void tgt_tunables_fini(struct lu_target *lut);
 void tgt_mask_cksum_types(struct lu_target *lut, enum cksum_types *cksum_types);
@@ -567,6 +611,7 @@ void tgt_grant_prepare_write(const struct lu_env *env, struct obd_export *exp,
 			     struct obdo *oa, struct niobuf_remote *rnb,
 			     int niocount);
 void tgt_grant_commit(struct obd_export *exp, unsigned long grant_used, int rc);
+u64 tgt_grant_write_reserve(struct obd_export *exp, u64 max);
 int tgt_grant_commit_cb_add(struct thandle *th, struct obd_export *exp,
 			    unsigned long grant);
 long tgt_grant_create(const struct lu_env *env, struct obd_export *exp,
@@ -69,6 +69,8 @@ extern struct kset *ldlm_svc_kset;
 #define LDLM_DEFAULT_PARALLEL_AST_LIMIT 1024
 #define LDLM_DEFAULT_LRU_SHRINK_BATCH (16)
 #define LDLM_DEFAULT_SLV_RECALC_PCT (10)
+/* maximum number of LRU second chances a reused lock can accumulate */
+#define LDLM_LRU_REUSE_MAX_CREDITS (4)
 
 /**
  * LDLM non-error return states
@@ -195,7 +197,7 @@ static inline int lockmode_compat(enum ldlm_mode exist_mode,
  * lr_lock
  *
  * lr_lock
- *     waiting_locks_spinlock
+ *     ldlm_waiting_locks::wl_lock
  *
  * lr_lock
  *     led_lock
@@ -385,6 +387,22 @@ enum ldlm_namespace_flags {
 	LDLM_LRU_CANCEL = 0
 };
 
+/**
+ * Client LRU lock reuse statistics, used to tune the reuse-aware LRU
+ * cancel policy. \see ldlm_lru_reuse_tally()
+ */
+struct ldlm_lru_reuse_stats {
+	/** time (log2 ms) a lock spent in the LRU before being reused */
+	struct obd_histogram	lrs_interval_hist;
+	/** number of reuses (log2) a lock had when cancelled from LRU */
+	struct obd_histogram	lrs_evict_hist;
+	/** number of times a lock was requeued instead of cancelled */
+	atomic_t		lrs_second_chance;
+	ktime_t			lrs_init;
+};
+
+struct ldlm_contention_table;
+
 /**
  * LDLM Namespace.
  *
@@ -483,11 +501,26 @@ struct ldlm_namespace {
 	 */
 	ktime_t			ns_max_age;
 
+	/**
+	 * If set, locks which are predicted to be reused soon are moved to
+	 * the LRU tail instead of being cancelled, so that cold locks are
+	 * cancelled first.
+	 */
+	unsigned int		ns_lru_reuse_policy;
+
+	/** LRU lock reuse statistics */
+	struct ldlm_lru_reuse_stats ns_lru_reuse;
+
 	/**
 	 * Server only: number of times we evicted clients due to lack of reply
 	 * to ASTs.
 	 */
 	unsigned int		ns_timeouts;
+	/**
+	 * Server only: table of the most contended resources in this
+	 * namespace, \see ldlm_contention_wait().
+	 */
+	struct ldlm_contention_table *ns_contention;
 	/**
 	 * Number of seconds since the file change time after which
 	 * the MDT will return an UPDATE lock along with a LOOKUP lock.
@@ -912,6 +945,31 @@ struct ldlm_lock {
 	 */
 	ktime_t			l_last_used;
 
+	union {
+		/**
+		 * Client LRU reuse tracking, protected by lr_lock.
+		 * l_lru_reuse_ms is a moving average of the time in ms the
+		 * lock spent unused in the LRU before being referenced again,
+		 * l_lru_hits is the number of such reuses, and l_lru_credits
+		 * is the number of second chances left before the lock is
+		 * cancelled from LRU. l_lru_last_ref is the time the lock was
+		 * last put in the LRU after a real use; unlike l_last_used it
+		 * is not refreshed when the lock is given a second chance.
+		 */
+		struct {
+			ktime_t	l_lru_last_ref;
+			__u32	l_lru_reuse_ms;
+			__u16	l_lru_hits;
+			__u16	l_lru_credits;
+		};
+		/**
+		 * Server only: time a sampled lock was put on the resource
+		 * waiting queue because of a conflict, zero otherwise. Used
+		 * for contention statistics only.
+		 */
+		ktime_t		l_wait_start;
+	};
+
 	/** Originally requested extent for the extent lock. */
 	struct ldlm_extent	l_req_extent;
 
@@ -958,9 +1016,9 @@ struct ldlm_lock {
 	/**
 	 * List item for locks waiting for cancellation from clients.
 	 * The lists this could be linked into are:
-	 * waiting_locks_list (protected by waiting_locks_spinlock),
-	 * then if the lock timed out, it is moved to
-	 * expired_lock_list for further processing.
+	 * the waiting list of the lock's waiting locks shard (protected by
+	 * the shard's wl_lock), then if the lock timed out, it is moved to
+	 * the shard's expired list for further processing.
 	 */
 	struct list_head	l_pending_chain;
 
@@ -1097,6 +1155,8 @@ struct ldlm_resource {
 	 * List of locks that could not be granted due to conflicts and
 	 * that are waiting for conflicts to go away */
 	struct list_head	lr_waiting;
+	/** Server only: number of locks on lr_waiting, for contention stats */
+	unsigned int		lr_waiting_count;
 	/** @} */
 
 	/** Resource name */
@@ -173,6 +173,8 @@ struct obd_import {
 	struct lustre_handle      imp_dlm_handle; /* client's ldlm export */
 	/** Currently active connection */
 	struct ptlrpc_connection *imp_connection;
+	/** Local NI device CPT of \a imp_connection, for ptlrpcd steering */
+	int			  imp_dev_cpt;
         /** PortalRPC client structure for this import */
         struct ptlrpc_client     *imp_client;
 	/** List element for linking into pinger chain */
@@ -536,6 +536,8 @@ struct ptlrpc_connection {
 	struct rhash_head	c_hash;
 	/** Our own lnet nid for this connection */
 	struct lnet_nid		c_self;
+	/** CPT of the local NI device for \a c_self, CFS_CPT_ANY if unknown */
+	int			c_dev_cpt;
 	/** Remote side nid for this connection */
 	struct lnet_processid	c_peer;
 	/** UUID of the other side */
@@ -2112,6 +2114,10 @@ int ptlrpc_add_rqs_to_pool(struct ptlrpc_request_pool *pool, int num_rq);
 struct ptlrpc_request_pool *
 ptlrpc_init_rq_pool(int, int,
 		    int (*populate_pool)(struct ptlrpc_request_pool *, int));
+/* free message buffers kept per size class in each CPT */
+#define PTLRPC_MSGBUF_CACHE_MAX	32
+void *ptlrpc_msgbuf_alloc(int size);
+void ptlrpc_msgbuf_free(void *buf, int size);
 
 void ptlrpc_at_set_req_timeout(struct ptlrpc_request *req);
 struct ptlrpc_request *ptlrpc_request_alloc(struct obd_import *imp,
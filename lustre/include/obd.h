@@ -461,6 +461,8 @@ struct niobuf_local {
 	__u16		lnb_guard_disk:1;
 	/* separate unlock for read path to allow shared access */
 	__u16		lnb_locked:1;
+	/* page taken from the OSD bulk read pool */
+	__u16		lnb_pooled:1;
 };
 
 struct tgt_thread_big_cache {
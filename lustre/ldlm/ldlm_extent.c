@@ -654,6 +654,7 @@ ldlm_extent_compat_queue(struct list_head *queue, struct ldlm_lock *req,
 
 	RETURN(compat);
 destroylock:
+	ldlm_res_waiting_del(req);
 	list_del_init(&req->l_res_link);
 	ldlm_lock_destroy_nolock(req);
 	RETURN(compat);
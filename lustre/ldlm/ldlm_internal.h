@@ -112,6 +112,73 @@ void ldlm_resource_insert_lock_after(struct ldlm_lock *original,
 void ldlm_resource_insert_lock_before(struct ldlm_lock *original,
 				      struct ldlm_lock *new);
 
+#ifdef HAVE_SERVER_SUPPORT
+/* Number of resources kept in the per-namespace contention table */
+#define LDLM_CONTENTION_TOP_N		32
+/* Number of distinct holder NIDs remembered per contended resource */
+#define LDLM_CONTENTION_NIDS		4
+/* Number of log2(ms) grant latency buckets, the last one is open-ended */
+#define LDLM_CONTENTION_HIST		20
+/* Default sampling rate of contention events, 1 in N */
+#define LDLM_CONTENTION_SAMPLE_DEF	16
+
+/**
+ * One contended resource in the namespace top-N table.
+ *
+ * The table is maintained with the "space-saving" algorithm: a resource
+ * which is not yet in the table replaces the least contended one and
+ * inherits its count as lce_error, so lce_waits is an upper bound and
+ * lce_waits - lce_error a lower bound of the real number of waits.
+ */
+struct ldlm_contention_entry {
+	struct ldlm_res_id	lce_name;
+	enum ldlm_type		lce_type;
+	/** enqueues which had to wait on this resource (scaled by sampling) */
+	__u64			lce_waits;
+	__u64			lce_error;
+	/** blocking ASTs sent to holders of this resource */
+	__u64			lce_asts;
+	/** deepest waiting queue seen */
+	unsigned int		lce_max_queue;
+	time64_t		lce_last_seen;
+	/** grant latency of waiting locks, log2(ms) buckets */
+	unsigned long		lce_grant_hist[LDLM_CONTENTION_HIST];
+	/** most recent holders which were sent a blocking AST */
+	struct lnet_nid		lce_holders[LDLM_CONTENTION_NIDS];
+	unsigned int		lce_nr_holders;
+};
+
+struct ldlm_contention_table {
+	spinlock_t		lct_lock;
+	/** sample 1 in lct_sample contention events, 0 disables tracking */
+	unsigned int		lct_sample;
+	ktime_t			lct_init;
+	struct ldlm_contention_entry lct_entries[LDLM_CONTENTION_TOP_N];
+};
+
+void ldlm_contention_wait(struct ldlm_lock *lock);
+void ldlm_contention_granted(struct ldlm_lock *lock);
+void ldlm_contention_bl_ast(struct ldlm_lock *lock);
+#endif /* HAVE_SERVER_SUPPORT */
+
+/*
+ * lr_waiting_count is only kept for server namespaces, flock locks are
+ * moved between the lists directly and are not accounted.
+ */
+static inline bool ldlm_res_count_waiting(struct ldlm_resource *res)
+{
+	return res->lr_type != LDLM_FLOCK && !ns_is_client(ldlm_res_to_ns(res));
+}
+
+static inline void ldlm_res_waiting_del(struct ldlm_lock *lock)
+{
+	struct ldlm_resource *res = lock->l_resource;
+
+	if (!list_empty(&lock->l_res_link) && !ldlm_is_granted(lock) &&
+	    ldlm_res_count_waiting(res) && res->lr_waiting_count > 0)
+		res->lr_waiting_count--;
+}
+
 /* ldlm_lock.c */
 
 typedef enum {
@@ -159,6 +226,8 @@ int ldlm_lock_remove_from_lru_check(struct ldlm_lock *lock, ktime_t last_use);
 int ldlm_lock_remove_from_lru_nolock(struct ldlm_lock *lock);
 void ldlm_lock_add_to_lru_nolock(struct ldlm_lock *lock);
 void ldlm_lock_touch_in_lru(struct ldlm_lock *lock);
+void ldlm_lru_evict_tally(struct ldlm_lock *lock);
+bool ldlm_lock_lru_second_chance(struct ldlm_lock *lock, ktime_t last_use);
 void ldlm_lock_destroy_nolock(struct ldlm_lock *lock);
 
 int ldlm_export_cancel_blocked_locks(struct obd_export *exp);
@@ -309,6 +309,7 @@ void ldlm_lock_add_to_lru_nolock(struct ldlm_lock *lock)
 	struct ldlm_namespace *ns = ldlm_lock_to_ns(lock);
 
 	lock->l_last_used = ktime_get();
+	lock->l_lru_last_ref = lock->l_last_used;
 	LASSERT(list_empty(&lock->l_lru));
 	LASSERT(lock->l_resource->lr_type != LDLM_FLOCK);
 	list_add_tail(&lock->l_lru, &ns->ns_unused_list);
@@ -355,6 +356,94 @@ void ldlm_lock_touch_in_lru(struct ldlm_lock *lock)
 	EXIT;
 }
 
+/**
+ * Account a reuse of LDLM lock \a lock that was just taken off the LRU by a
+ * new reference. Updates the lock's predicted reuse interval and grants it
+ * one more LRU second chance. Assumes lr_lock is held.
+ */
+static void ldlm_lru_reuse_tally(struct ldlm_lock *lock)
+{
+	struct ldlm_lru_reuse_stats *lrs = &ldlm_lock_to_ns(lock)->ns_lru_reuse;
+	s64 idle_ms = ktime_ms_delta(ktime_get(), lock->l_lru_last_ref);
+	u32 idle = idle_ms < 0 ? 0 : min_t(s64, idle_ms, U32_MAX);
+
+	lprocfs_oh_tally_log2(&lrs->lrs_interval_hist, idle);
+
+	/* weight history 3:1 so a single outlier does not reset prediction */
+	if (lock->l_lru_hits == 0)
+		lock->l_lru_reuse_ms = idle;
+	else
+		lock->l_lru_reuse_ms = ((u64)lock->l_lru_reuse_ms * 3 + idle) >> 2;
+
+	if (lock->l_lru_hits < U16_MAX)
+		lock->l_lru_hits++;
+	if (lock->l_lru_credits < LDLM_LRU_REUSE_MAX_CREDITS)
+		lock->l_lru_credits++;
+}
+
+/**
+ * Account LDLM lock \a lock being cancelled from the namespace LRU.
+ */
+void ldlm_lru_evict_tally(struct ldlm_lock *lock)
+{
+	struct ldlm_lru_reuse_stats *lrs = &ldlm_lock_to_ns(lock)->ns_lru_reuse;
+
+	lprocfs_oh_tally_log2(&lrs->lrs_evict_hist, lock->l_lru_hits);
+}
+
+/**
+ * Decide whether unused LDLM lock \a lock selected for LRU cancel is
+ * likely to be referenced again soon, and if so, move it to the LRU tail
+ * instead of cancelling it.
+ *
+ * A lock is predicted to be reused if it has been reused from the LRU
+ * before, has second chances left, and has not yet been idle for more than
+ * twice its average reuse interval. Locks idle for longer than the namespace
+ * lru_max_age since their last real use are never kept.
+ *
+ * The requeued lock gets a fresh l_last_used so that the LRU stays sorted
+ * by l_last_used, which the aged and LRUR policies rely on to stop at the
+ * first young lock. Its real idle time is still counted from
+ * l_lru_last_ref, so it is cancelled no later than one lru_max_age after
+ * its last second chance.
+ *
+ * Assumes lr_lock is held.
+ *
+ * \retval true the lock was requeued and must not be cancelled
+ * \retval false the lock should be cancelled
+ */
+bool ldlm_lock_lru_second_chance(struct ldlm_lock *lock, ktime_t last_use)
+{
+	struct ldlm_namespace *ns = ldlm_lock_to_ns(lock);
+	s64 idle_ms;
+	bool requeued = false;
+
+	if (!ns->ns_lru_reuse_policy || lock->l_lru_credits == 0)
+		return false;
+
+	idle_ms = ktime_ms_delta(ktime_get(), lock->l_lru_last_ref);
+	if (idle_ms >= ktime_to_ms(ns->ns_max_age) ||
+	    idle_ms >= 2 * (s64)lock->l_lru_reuse_ms)
+		return false;
+
+	spin_lock(&ns->ns_lock);
+	if (!list_empty(&lock->l_lru) &&
+	    !ktime_compare(last_use, lock->l_last_used)) {
+		if (ns->ns_last_pos == &lock->l_lru)
+			ns->ns_last_pos = lock->l_lru.prev;
+		list_move_tail(&lock->l_lru, &ns->ns_unused_list);
+		lock->l_last_used = ktime_get();
+		lock->l_lru_credits--;
+		requeued = true;
+	}
+	spin_unlock(&ns->ns_lock);
+
+	if (requeued)
+		atomic_inc(&ns->ns_lru_reuse.lrs_second_chance);
+
+	return requeued;
+}
+
 /**
  * Helper to destroy a locked lock.
  *
@@ -753,7 +842,8 @@ EXPORT_SYMBOL(ldlm_lock_addref);
 void ldlm_lock_addref_internal_nolock(struct ldlm_lock *lock,
 				      enum ldlm_mode mode)
 {
-	ldlm_lock_remove_from_lru(lock);
+	if (ldlm_lock_remove_from_lru(lock))
+		ldlm_lru_reuse_tally(lock);
 	if (mode & (LCK_NL | LCK_CR | LCK_PR)) {
 		lock->l_readers++;
 		lu_ref_add_atomic(&lock->l_reference, "reader", lock);
@@ -1139,6 +1229,10 @@ void ldlm_grant_lock(struct ldlm_lock *lock, struct list_head *work_list)
 		LBUG();
 	}
 
+#ifdef HAVE_SERVER_SUPPORT
+	if (!ns_is_client(ldlm_res_to_ns(res)))
+		ldlm_contention_granted(lock);
+#endif
         ldlm_pool_add(&ldlm_res_to_ns(res)->ns_pool, lock);
         EXIT;
 }
@@ -2063,6 +2157,7 @@ int ldlm_handle_conflict_lock(struct ldlm_lock *lock, __u64 *flags,
 	 * re-ordered!  Causes deadlock, because ASTs aren't sent! */
 	if (list_empty(&lock->l_res_link))
 		ldlm_resource_add_lock(res, &res->lr_waiting, lock);
+	ldlm_contention_wait(lock);
 	unlock_res(res);
 
 	rc = ldlm_run_ast_work(ldlm_res_to_ns(res), rpc_list,
@@ -123,24 +123,30 @@ struct ldlm_bl_work_item {
 #ifdef HAVE_SERVER_SUPPORT
 
 /**
- * Protects both waiting_locks_list and expired_lock_thread.
- */
-static DEFINE_SPINLOCK(waiting_locks_spinlock); /* BH lock (timer) */
-
-/**
- * List for contended locks.
+ * Locks waiting for cancellation by clients.
  *
- * As soon as a lock is contended, it gets placed on this list and
- * expected time to get a response is filled in the lock. A special
- * thread walks the list looking for locks that should be released and
- * schedules client evictions for those that have not been released in
- * time.
+ * As soon as a lock is contended, it gets placed on a waiting list and
+ * expected time to get a response is filled in the lock. A timer walks the
+ * list looking for locks that should be released and moves those that have
+ * not been released in time to the expired list, from which a special thread
+ * schedules client evictions.
  *
- * All access to it should be under waiting_locks_spinlock.
+ * To avoid a global choke point during mass lock revocation, the lists are
+ * sharded per CPT, each shard having its own BH spinlock and timer. A lock
+ * always maps to the same shard, see ldlm_waiting_locks_shard(). All access
+ * to a lock's l_pending_chain must be under its shard's wl_lock.
  */
-static LIST_HEAD(waiting_locks_list);
-static void waiting_locks_callback(TIMER_DATA_TYPE unused);
-static CFS_DEFINE_TIMER(waiting_locks_timer, waiting_locks_callback, 0, 0);
+struct ldlm_waiting_locks {
+	/** BH lock (timer), protects both lists below */
+	spinlock_t		wl_lock;
+	/** locks with blocking AST sent, FIFO */
+	struct list_head	wl_waiting;
+	/** locks whose callback timed out or AST failed */
+	struct list_head	wl_expired;
+	struct timer_list	wl_timer;
+};
+
+static struct ldlm_waiting_locks **waiting_locks;
 
 enum elt_state {
 	ELT_STOPPED,
@@ -151,31 +157,135 @@ enum elt_state {
 static DECLARE_WAIT_QUEUE_HEAD(expired_lock_wait_queue);
 static enum elt_state expired_lock_thread_state = ELT_STOPPED;
 static int expired_lock_dump;
-static LIST_HEAD(expired_lock_list);
 
 static int ldlm_lock_busy(struct ldlm_lock *lock);
 static int ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout);
-static int __ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout);
+static int __ldlm_add_waiting_lock(struct ldlm_waiting_locks *wl,
+				   struct ldlm_lock *lock, timeout_t timeout);
+
+static inline struct ldlm_waiting_locks *
+ldlm_waiting_locks_shard(struct ldlm_lock *lock)
+{
+	/* the handle cookie is random and never changes for a lock */
+	return waiting_locks[(unsigned int)lock->l_handle.h_cookie %
+			     cfs_percpt_number(waiting_locks)];
+}
 
 static inline int have_expired_locks(void)
 {
-	int need_to_run;
+	struct ldlm_waiting_locks *wl;
+	int need_to_run = 0;
+	int i;
 
 	ENTRY;
-	spin_lock_bh(&waiting_locks_spinlock);
-	need_to_run = !list_empty(&expired_lock_list);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	cfs_percpt_for_each(wl, i, waiting_locks) {
+		spin_lock_bh(&wl->wl_lock);
+		need_to_run = !list_empty(&wl->wl_expired);
+		spin_unlock_bh(&wl->wl_lock);
+		if (need_to_run)
+			break;
+	}
 
 	RETURN(need_to_run);
 }
 
 /**
- * Check expired lock list for expired locks and time them out.
+ * Time out the expired locks of one waiting locks shard.
+ *
+ * \retval number of evictions that asked for a debug log dump
+ */
+static int expired_lock_process(struct ldlm_waiting_locks *wl)
+{
+	struct list_head *expired = &wl->wl_expired;
+	int do_dump = 0;
+
+	spin_lock_bh(&wl->wl_lock);
+	while (!list_empty(expired)) {
+		struct obd_export *export;
+		struct ldlm_lock *lock;
+
+		lock = list_first_entry(expired, struct ldlm_lock,
+					l_pending_chain);
+		if ((void *)lock < LP_POISON + PAGE_SIZE &&
+		    (void *)lock >= LP_POISON) {
+			spin_unlock_bh(&wl->wl_lock);
+			CERROR("free lock on elt list %p\n", lock);
+			LBUG();
+		}
+		list_del_init(&lock->l_pending_chain);
+		if ((void *)lock->l_export <
+		     LP_POISON + PAGE_SIZE &&
+		    (void *)lock->l_export >= LP_POISON) {
+			CERROR("lock with free export on elt list %p\n",
+			       lock->l_export);
+			lock->l_export = NULL;
+			LDLM_ERROR(lock, "free export");
+			/*
+			 * release extra ref grabbed by
+			 * ldlm_add_waiting_lock() or
+			 * ldlm_failed_ast()
+			 */
+			LDLM_LOCK_RELEASE(lock);
+			continue;
+		}
+
+		if (ldlm_is_destroyed(lock)) {
+			/*
+			 * release the lock refcount where
+			 * waiting_locks_callback() founds
+			 */
+			LDLM_LOCK_RELEASE(lock);
+			continue;
+		}
+		export = class_export_lock_get(lock->l_export, lock);
+		spin_unlock_bh(&wl->wl_lock);
+
+		/* Check if we need to prolong timeout */
+		if (!CFS_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_TIMEOUT) &&
+		    lock->l_callback_timestamp != 0 && /* not AST error */
+		    ldlm_lock_busy(lock)) {
+			LDLM_DEBUG(lock, "prolong the busy lock");
+			lock_res_and_lock(lock);
+			ldlm_add_waiting_lock(lock,
+					ldlm_bl_timeout(lock) >> 1);
+			unlock_res_and_lock(lock);
+		} else {
+			spin_lock_bh(&export->exp_bl_list_lock);
+			list_del_init(&lock->l_exp_list);
+			spin_unlock_bh(&export->exp_bl_list_lock);
+
+			LDLM_ERROR(lock,
+				   "lock callback timer expired after %llds: evicting client at %s ",
+				   ktime_get_seconds() -
+				   lock->l_blast_sent,
+				   obd_export_nid2str(export));
+			ldlm_lock_to_ns(lock)->ns_timeouts++;
+			if (do_dump_on_eviction(export->exp_obd))
+				do_dump++;
+			class_fail_export(export);
+		}
+		class_export_lock_put(export, lock);
+		/*
+		 * release extra ref grabbed by ldlm_add_waiting_lock()
+		 * or ldlm_failed_ast()
+		 */
+		LDLM_LOCK_RELEASE(lock);
+
+		spin_lock_bh(&wl->wl_lock);
+	}
+	spin_unlock_bh(&wl->wl_lock);
+
+	return do_dump;
+}
+
+/**
+ * Check expired lock lists for expired locks and time them out.
  */
 static int expired_lock_main(void *arg)
 {
-	struct list_head *expired = &expired_lock_list;
+	struct ldlm_waiting_locks *wl;
 	int do_dump;
+	int i;
 
 	ENTRY;
 
@@ -187,93 +297,13 @@ static int expired_lock_main(void *arg)
 				have_expired_locks() ||
 				expired_lock_thread_state == ELT_TERMINATE);
 
-		spin_lock_bh(&waiting_locks_spinlock);
-		if (expired_lock_dump) {
-			spin_unlock_bh(&waiting_locks_spinlock);
-
+		if (xchg(&expired_lock_dump, 0))
 			/* from waiting_locks_callback, but not in timer */
 			libcfs_debug_dumplog();
 
-			spin_lock_bh(&waiting_locks_spinlock);
-			expired_lock_dump = 0;
-		}
-
 		do_dump = 0;
-
-		while (!list_empty(expired)) {
-			struct obd_export *export;
-			struct ldlm_lock *lock;
-
-			lock = list_first_entry(expired, struct ldlm_lock,
-						l_pending_chain);
-			if ((void *)lock < LP_POISON + PAGE_SIZE &&
-			    (void *)lock >= LP_POISON) {
-				spin_unlock_bh(&waiting_locks_spinlock);
-				CERROR("free lock on elt list %p\n", lock);
-				LBUG();
-			}
-			list_del_init(&lock->l_pending_chain);
-			if ((void *)lock->l_export <
-			     LP_POISON + PAGE_SIZE &&
-			    (void *)lock->l_export >= LP_POISON) {
-				CERROR("lock with free export on elt list %p\n",
-				       lock->l_export);
-				lock->l_export = NULL;
-				LDLM_ERROR(lock, "free export");
-				/*
-				 * release extra ref grabbed by
-				 * ldlm_add_waiting_lock() or
-				 * ldlm_failed_ast()
-				 */
-				LDLM_LOCK_RELEASE(lock);
-				continue;
-			}
-
-			if (ldlm_is_destroyed(lock)) {
-				/*
-				 * release the lock refcount where
-				 * waiting_locks_callback() founds
-				 */
-				LDLM_LOCK_RELEASE(lock);
-				continue;
-			}
-			export = class_export_lock_get(lock->l_export, lock);
-			spin_unlock_bh(&waiting_locks_spinlock);
-
-			/* Check if we need to prolong timeout */
-			if (!CFS_FAIL_CHECK(OBD_FAIL_PTLRPC_HPREQ_TIMEOUT) &&
-			    lock->l_callback_timestamp != 0 && /* not AST error */
-			    ldlm_lock_busy(lock)) {
-				LDLM_DEBUG(lock, "prolong the busy lock");
-				lock_res_and_lock(lock);
-				ldlm_add_waiting_lock(lock,
-						ldlm_bl_timeout(lock) >> 1);
-				unlock_res_and_lock(lock);
-			} else {
-				spin_lock_bh(&export->exp_bl_list_lock);
-				list_del_init(&lock->l_exp_list);
-				spin_unlock_bh(&export->exp_bl_list_lock);
-
-				LDLM_ERROR(lock,
-					   "lock callback timer expired after %llds: evicting client at %s ",
-					   ktime_get_seconds() -
-					   lock->l_blast_sent,
-					   obd_export_nid2str(export));
-				ldlm_lock_to_ns(lock)->ns_timeouts++;
-				if (do_dump_on_eviction(export->exp_obd))
-					do_dump++;
-				class_fail_export(export);
-			}
-			class_export_lock_put(export, lock);
-			/*
-			 * release extra ref grabbed by ldlm_add_waiting_lock()
-			 * or ldlm_failed_ast()
-			 */
-			LDLM_LOCK_RELEASE(lock);
-
-			spin_lock_bh(&waiting_locks_spinlock);
-		}
-		spin_unlock_bh(&waiting_locks_spinlock);
+		cfs_percpt_for_each(wl, i, waiting_locks)
+			do_dump += expired_lock_process(wl);
 
 		if (do_dump) {
 			CERROR("dump the log upon eviction\n");
@@ -317,14 +347,15 @@ static int ldlm_lock_busy(struct ldlm_lock *lock)
 }
 
 /* This is called from within a timer interrupt and cannot schedule */
-static void waiting_locks_callback(TIMER_DATA_TYPE unused)
+static void waiting_locks_callback(cfs_timer_cb_arg_t data)
 {
+	struct ldlm_waiting_locks *wl = cfs_from_timer(wl, data, wl_timer);
 	struct ldlm_lock *lock;
 	int need_dump = 0;
 
-	spin_lock_bh(&waiting_locks_spinlock);
-	while (!list_empty(&waiting_locks_list)) {
-		lock = list_first_entry(&waiting_locks_list, struct ldlm_lock,
+	spin_lock_bh(&wl->wl_lock);
+	while (!list_empty(&wl->wl_waiting)) {
+		lock = list_first_entry(&wl->wl_waiting, struct ldlm_lock,
 					l_pending_chain);
 		if (lock->l_callback_timestamp > ktime_get_seconds() ||
 		    lock->l_req_mode == LCK_GROUP)
@@ -332,14 +363,14 @@ static void waiting_locks_callback(TIMER_DATA_TYPE unused)
 
 		/*
 		 * no needs to take an extra ref on the lock since it was in
-		 * the waiting_locks_list and ldlm_add_waiting_lock()
-		 * already grabbed a ref
+		 * the waiting list and ldlm_add_waiting_lock() already
+		 * grabbed a ref
 		 */
-		list_move(&lock->l_pending_chain, &expired_lock_list);
+		list_move(&lock->l_pending_chain, &wl->wl_expired);
 		need_dump = 1;
 	}
 
-	if (!list_empty(&expired_lock_list)) {
+	if (!list_empty(&wl->wl_expired)) {
 		if (obd_dump_on_timeout && need_dump)
 			expired_lock_dump = __LINE__;
 
@@ -350,18 +381,17 @@ static void waiting_locks_callback(TIMER_DATA_TYPE unused)
 	 * Make sure the timer will fire again if we have any locks
 	 * left.
 	 */
-	if (!list_empty(&waiting_locks_list)) {
+	if (!list_empty(&wl->wl_waiting)) {
 		time64_t now = ktime_get_seconds();
 		timeout_t delta = 0;
 
-		lock = list_first_entry(&waiting_locks_list, struct ldlm_lock,
+		lock = list_first_entry(&wl->wl_waiting, struct ldlm_lock,
 					l_pending_chain);
 		if (lock->l_callback_timestamp - now > 0)
 			delta = lock->l_callback_timestamp - now;
-		mod_timer(&waiting_locks_timer,
-			  jiffies + cfs_time_seconds(delta));
+		mod_timer(&wl->wl_timer, jiffies + cfs_time_seconds(delta));
 	}
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&wl->wl_lock);
 }
 
 /**
@@ -374,9 +404,10 @@ static void waiting_locks_callback(TIMER_DATA_TYPE unused)
  * As done by ldlm_add_waiting_lock(), the caller must grab a lock reference
  * if it has been added to the waiting list (1 is returned).
  *
- * Called with the namespace lock held.
+ * Called with the shard lock \a wl->wl_lock held.
  */
-static int __ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t delay)
+static int __ldlm_add_waiting_lock(struct ldlm_waiting_locks *wl,
+				   struct ldlm_lock *lock, timeout_t delay)
 {
 	unsigned long timeout_jiffies = jiffies;
 	time64_t deadline;
@@ -399,16 +430,16 @@ static int __ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t delay)
 			  0, delay);
 	timeout_jiffies += cfs_time_seconds(timeout);
 
-	if (time_before(timeout_jiffies, waiting_locks_timer.expires) ||
-	    !timer_pending(&waiting_locks_timer))
-		mod_timer(&waiting_locks_timer, timeout_jiffies);
+	if (time_before(timeout_jiffies, wl->wl_timer.expires) ||
+	    !timer_pending(&wl->wl_timer))
+		mod_timer(&wl->wl_timer, timeout_jiffies);
 
 	/*
 	 * if the new lock has a shorter timeout than something earlier on
 	 * the list, we'll wait the longer amount of time; no big deal.
 	 */
 	/* FIFO */
-	list_add_tail(&lock->l_pending_chain, &waiting_locks_list);
+	list_add_tail(&lock->l_pending_chain, &wl->wl_waiting);
 	return 1;
 }
 
@@ -438,6 +469,7 @@ static void ldlm_add_blocked_lock(struct ldlm_lock *lock)
 
 static int ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 {
+	struct ldlm_waiting_locks *wl = ldlm_waiting_locks_shard(lock);
 	struct obd_device *obd = NULL;
 	int at_off, ret;
 
@@ -456,16 +488,16 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 			return 0;
 	}
 
-	spin_lock_bh(&waiting_locks_spinlock);
+	spin_lock_bh(&wl->wl_lock);
 	if (ldlm_is_cancel(lock)) {
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&wl->wl_lock);
 		return 0;
 	}
 
 	if (ldlm_is_destroyed(lock)) {
 		static time64_t next;
 
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&wl->wl_lock);
 		LDLM_ERROR(lock, "not waiting on destroyed lock (b=5653)");
 		if (ktime_get_seconds() > next) {
 			next = ktime_get_seconds() + 14400;
@@ -475,7 +507,7 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 	}
 
 	ldlm_set_waited(lock);
-	ret = __ldlm_add_waiting_lock(lock, timeout);
+	ret = __ldlm_add_waiting_lock(wl, lock, timeout);
 	if (ret) {
 		/*
 		 * grab ref on the lock if it has been added to the
@@ -483,7 +515,7 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 		 */
 		LDLM_LOCK_GET(lock);
 	}
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&wl->wl_lock);
 
 	if (ret)
 		ldlm_add_blocked_lock(lock);
@@ -502,9 +534,10 @@ static int ldlm_add_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
  * As done by ldlm_del_waiting_lock(), the caller must release the lock
  * reference when the lock is removed from any list (1 is returned).
  *
- * Called with namespace lock held.
+ * Called with the shard lock \a wl->wl_lock held.
  */
-static int __ldlm_del_waiting_lock(struct ldlm_lock *lock)
+static int __ldlm_del_waiting_lock(struct ldlm_waiting_locks *wl,
+				   struct ldlm_lock *lock)
 {
 	struct list_head *list_next;
 
@@ -512,11 +545,11 @@ static int __ldlm_del_waiting_lock(struct ldlm_lock *lock)
 		return 0;
 
 	list_next = lock->l_pending_chain.next;
-	if (lock->l_pending_chain.prev == &waiting_locks_list) {
+	if (lock->l_pending_chain.prev == &wl->wl_waiting) {
 		/* Removing the head of the list, adjust timer. */
-		if (list_next == &waiting_locks_list) {
+		if (list_next == &wl->wl_waiting) {
 			/* No more, just cancel. */
-			timer_delete(&waiting_locks_timer);
+			timer_delete(&wl->wl_timer);
 		} else {
 			time64_t now = ktime_get_seconds();
 			struct ldlm_lock *next;
@@ -525,9 +558,9 @@ static int __ldlm_del_waiting_lock(struct ldlm_lock *lock)
 			next = list_entry(list_next, struct ldlm_lock,
 					  l_pending_chain);
 			if (next->l_callback_timestamp - now > 0)
-				delta = lock->l_callback_timestamp - now;
+				delta = next->l_callback_timestamp - now;
 
-			mod_timer(&waiting_locks_timer,
+			mod_timer(&wl->wl_timer,
 				  jiffies + cfs_time_seconds(delta));
 		}
 	}
@@ -538,6 +571,7 @@ static int __ldlm_del_waiting_lock(struct ldlm_lock *lock)
 
 int ldlm_del_waiting_lock(struct ldlm_lock *lock)
 {
+	struct ldlm_waiting_locks *wl;
 	int ret;
 
 	if (lock->l_export == NULL) {
@@ -546,10 +580,11 @@ int ldlm_del_waiting_lock(struct ldlm_lock *lock)
 		return 0;
 	}
 
-	spin_lock_bh(&waiting_locks_spinlock);
-	ret = __ldlm_del_waiting_lock(lock);
+	wl = ldlm_waiting_locks_shard(lock);
+	spin_lock_bh(&wl->wl_lock);
+	ret = __ldlm_del_waiting_lock(wl, lock);
 	ldlm_clear_waited(lock);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&wl->wl_lock);
 
 	/* remove the lock out of export blocking list */
 	spin_lock_bh(&lock->l_export->exp_bl_list_lock);
@@ -575,6 +610,8 @@ int ldlm_del_waiting_lock(struct ldlm_lock *lock)
  */
 int ldlm_refresh_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 {
+	struct ldlm_waiting_locks *wl;
+
 	if (lock->l_export == NULL) {
 		/* We don't have a "waiting locks list" on clients. */
 		LDLM_DEBUG(lock, "client lock: no-op");
@@ -587,10 +624,11 @@ int ldlm_refresh_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 		return 0;
 	}
 
-	spin_lock_bh(&waiting_locks_spinlock);
+	wl = ldlm_waiting_locks_shard(lock);
+	spin_lock_bh(&wl->wl_lock);
 
 	if (list_empty(&lock->l_pending_chain)) {
-		spin_unlock_bh(&waiting_locks_spinlock);
+		spin_unlock_bh(&wl->wl_lock);
 		LDLM_DEBUG(lock, "wasn't waiting");
 		return 0;
 	}
@@ -599,9 +637,9 @@ int ldlm_refresh_waiting_lock(struct ldlm_lock *lock, timeout_t timeout)
 	 * we remove/add the lock to the waiting list, so no needs to
 	 * release/take a lock reference
 	 */
-	__ldlm_del_waiting_lock(lock);
-	__ldlm_add_waiting_lock(lock, timeout);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	__ldlm_del_waiting_lock(wl, lock);
+	__ldlm_add_waiting_lock(wl, lock, timeout);
+	spin_unlock_bh(&wl->wl_lock);
 
 	LDLM_DEBUG(lock, "refreshed to %ds", timeout);
 	return 1;
@@ -711,6 +749,8 @@ EXPORT_SYMBOL(ldlm_bl_timeout_by_rpc);
 static void ldlm_failed_ast(struct ldlm_lock *lock, int rc,
 			    const char *ast_type)
 {
+	struct ldlm_waiting_locks *wl = ldlm_waiting_locks_shard(lock);
+
 	LCONSOLE_ERROR_MSG(0x138,
 			   "%s: A client on nid %s was evicted due to a lock %s callback time out: rc %d\n",
 			   lock->l_export->exp_obd->obd_name,
@@ -718,8 +758,8 @@ static void ldlm_failed_ast(struct ldlm_lock *lock, int rc,
 
 	if (obd_dump_on_timeout)
 		libcfs_debug_dumplog();
-	spin_lock_bh(&waiting_locks_spinlock);
-	if (__ldlm_del_waiting_lock(lock) == 0)
+	spin_lock_bh(&wl->wl_lock);
+	if (__ldlm_del_waiting_lock(wl, lock) == 0)
 		/*
 		 * the lock was not in any list, grab an extra ref before adding
 		 * the lock to the expired list
@@ -727,9 +767,9 @@ static void ldlm_failed_ast(struct ldlm_lock *lock, int rc,
 		LDLM_LOCK_GET(lock);
 	/* differentiate it from expired locks */
 	lock->l_callback_timestamp = 0;
-	list_add(&lock->l_pending_chain, &expired_lock_list);
+	list_add(&lock->l_pending_chain, &wl->wl_expired);
 	wake_up(&expired_lock_wait_queue);
-	spin_unlock_bh(&waiting_locks_spinlock);
+	spin_unlock_bh(&wl->wl_lock);
 }
 
 /**
@@ -1012,6 +1052,7 @@ int ldlm_server_blocking_ast(struct ldlm_lock *lock,
 	body->lock_flags |= ldlm_flags_to_wire(lock->l_flags & LDLM_FL_AST_MASK);
 
 	LDLM_DEBUG(lock, "server preparing blocking AST");
+	ldlm_contention_bl_ast(lock);
 
 	ptlrpc_request_set_replen(req);
 	ldlm_set_cbpending(lock);
@@ -2163,7 +2204,8 @@ static void ldlm_handle_gl_callback(struct ptlrpc_request *req,
 	if (lock->l_granted_mode == LCK_PW &&
 	    !lock->l_readers && !lock->l_writers &&
 	    ktime_after(ktime_get(),
-			ktime_add(lock->l_last_used, ns->ns_dirty_age_limit))) {
+			ktime_add(lock->l_lru_last_ref,
+				  ns->ns_dirty_age_limit))) {
 		unlock_res_and_lock(lock);
 
 		/* For MDS glimpse it is always DOM lock, set corresponding
@@ -3264,6 +3306,7 @@ static int ldlm_setup(void)
 	static struct ptlrpc_service_conf	conf;
 	struct ldlm_bl_pool		       *blp = NULL;
 #ifdef HAVE_SERVER_SUPPORT
+	struct ldlm_waiting_locks *wl;
 	struct task_struct *task;
 #endif /* HAVE_SERVER_SUPPORT */
 	int i;
@@ -3414,6 +3457,18 @@ static int ldlm_setup(void)
 	}
 
 #ifdef HAVE_SERVER_SUPPORT
+	waiting_locks = cfs_percpt_alloc(cfs_cpt_tab, sizeof(*wl));
+	if (waiting_locks == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	cfs_percpt_for_each(wl, i, waiting_locks) {
+		spin_lock_init(&wl->wl_lock);
+		INIT_LIST_HEAD(&wl->wl_waiting);
+		INIT_LIST_HEAD(&wl->wl_expired);
+		cfs_timer_setup(&wl->wl_timer, waiting_locks_callback,
+				(unsigned long)wl, 0);
+	}
+
 	task = kthread_run(expired_lock_main, NULL, "ldlm_elt");
 	if (IS_ERR(task)) {
 		rc = PTR_ERR(task);
@@ -3502,6 +3557,16 @@ static int ldlm_cleanup(void)
 		wait_event(expired_lock_wait_queue,
 			   expired_lock_thread_state == ELT_STOPPED);
 	}
+
+	if (waiting_locks != NULL) {
+		struct ldlm_waiting_locks *wl;
+		int i;
+
+		cfs_percpt_for_each(wl, i, waiting_locks)
+			timer_delete_sync(&wl->wl_timer);
+		cfs_percpt_free(waiting_locks);
+		waiting_locks = NULL;
+	}
 #endif
 
 	OBD_FREE(ldlm_state, sizeof(*ldlm_state));
@@ -1922,6 +1922,9 @@ ldlm_cancel_lru_policy(struct ldlm_namespace *ns, enum ldlm_lru_flags lru_flags)
  *
  * Locks are cancelled according to the LRU resize policy (SLV from server)
  * if LRU resize is enabled; otherwise, the "aged policy" is used;
+ * if the namespace lru_reuse_policy is enabled, locks selected by the policy
+ * which are predicted to be reused soon are moved to the LRU tail instead,
+ * see ldlm_lock_lru_second_chance();
  *
  * LRU flags:
  * ----------------------------------------
@@ -2041,6 +2044,19 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 		}
 
 		lock_res_and_lock(lock);
+		/*
+		 * Give locks which are likely to be reused soon another round
+		 * in the LRU, so that colder locks are cancelled first.
+		 */
+		if (!(lru_flags & LDLM_LRU_FLAG_CLEANUP) &&
+		    !ldlm_is_canceling(lock) &&
+		    ldlm_lock_lru_second_chance(lock, last_use)) {
+			unlock_res_and_lock(lock);
+			lu_ref_del(&lock->l_reference, __func__, current);
+			LDLM_LOCK_RELEASE(lock);
+			continue;
+		}
+
 		/* Check flags again under the lock. */
 		if (ldlm_is_canceling(lock) ||
 		    ldlm_lock_remove_from_lru_check(lock, last_use) == 0) {
@@ -2093,6 +2109,7 @@ static int ldlm_prepare_lru_list(struct ldlm_namespace *ns,
 		 */
 		LASSERT(list_empty(&lock->l_bl_ast));
 		list_add(&lock->l_bl_ast, cancels);
+		ldlm_lru_evict_tally(lock);
 		unlock_res_and_lock(lock);
 		lu_ref_del(&lock->l_reference, __FUNCTION__, current);
 		added++;
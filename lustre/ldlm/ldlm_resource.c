@@ -35,6 +35,7 @@
  */
 
 #define DEBUG_SUBSYSTEM S_LDLM
+#include <linux/sort.h>
 #include <lustre_dlm.h>
 #include <lustre_fid.h>
 #include <obd_class.h>
@@ -465,6 +466,34 @@ static ssize_t lru_max_age_store(struct kobject *kobj, struct attribute *attr,
 }
 LUSTRE_RW_ATTR(lru_max_age);
 
+static ssize_t lru_reuse_policy_show(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	return sprintf(buf, "%u\n", ns->ns_lru_reuse_policy);
+}
+
+static ssize_t lru_reuse_policy_store(struct kobject *kobj,
+				      struct attribute *attr,
+				      const char *buffer, size_t count)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	bool val;
+	int rc;
+
+	rc = kstrtobool(buffer, &val);
+	if (rc)
+		return rc;
+
+	ns->ns_lru_reuse_policy = val;
+
+	return count;
+}
+LUSTRE_RW_ATTR(lru_reuse_policy);
+
 static ssize_t early_lock_cancel_show(struct kobject *kobj,
 				      struct attribute *attr,
 				      char *buf)
@@ -671,6 +700,328 @@ static ssize_t max_parallel_ast_store(struct kobject *kobj,
 }
 LUSTRE_RW_ATTR(max_parallel_ast);
 
+static ssize_t contention_sample_show(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+
+	if (!ns->ns_contention)
+		return -EOPNOTSUPP;
+
+	return sprintf(buf, "%u\n", ns->ns_contention->lct_sample);
+}
+
+static ssize_t contention_sample_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buffer, size_t count)
+{
+	struct ldlm_namespace *ns = container_of(kobj, struct ldlm_namespace,
+						 ns_kobj);
+	unsigned int tmp;
+	int err;
+
+	if (!ns->ns_contention)
+		return -EOPNOTSUPP;
+
+	err = kstrtouint(buffer, 10, &tmp);
+	if (err != 0)
+		return -EINVAL;
+
+	WRITE_ONCE(ns->ns_contention->lct_sample, tmp);
+
+	return count;
+}
+LUSTRE_RW_ATTR(contention_sample);
+
+/*
+ * Resource contention tracking.
+ *
+ * Each server namespace keeps a small table of the most contended
+ * resources. A contention event is an enqueue which has to wait for
+ * conflicting locks; locks are sampled 1 in lct_sample and accounted with
+ * the space-saving top-N algorithm. Blocking ASTs and grant latencies of
+ * sampled locks are only accounted for resources already in the table, so
+ * the common uncontended path costs nothing but a NULL/zero check.
+ *
+ * All the functions below are called with the resource lock held.
+ */
+static struct ldlm_contention_entry *
+ldlm_contention_find(struct ldlm_contention_table *lct,
+		     const struct ldlm_res_id *name)
+{
+	int i;
+
+	for (i = 0; i < LDLM_CONTENTION_TOP_N; i++) {
+		struct ldlm_contention_entry *lce = &lct->lct_entries[i];
+
+		if (lce->lce_waits != 0 &&
+		    memcmp(&lce->lce_name, name, sizeof(*name)) == 0)
+			return lce;
+	}
+
+	return NULL;
+}
+
+/*
+ * Locks are sampled by their handle cookie, so the wait, grant and blocking
+ * AST events of one lock are either all accounted or all skipped, and a lock
+ * which waits again after a reprocess is not counted twice.
+ */
+static inline bool ldlm_contention_sampled(struct ldlm_lock *lock,
+					   unsigned int sample)
+{
+	if (sample == 0)
+		return false;
+
+	return sample == 1 || lock->l_handle.h_cookie % sample == 0;
+}
+
+/**
+ * Account that \a lock has to wait on its resource because of conflicts.
+ */
+void ldlm_contention_wait(struct ldlm_lock *lock)
+{
+	struct ldlm_resource *res = lock->l_resource;
+	struct ldlm_contention_table *lct = ldlm_res_to_ns(res)->ns_contention;
+	struct ldlm_contention_entry *lce;
+	unsigned int depth = res->lr_waiting_count;
+	unsigned int sample;
+	int i;
+
+	if (!lct || ktime_to_ns(lock->l_wait_start) != 0)
+		return;
+
+	sample = READ_ONCE(lct->lct_sample);
+	if (!ldlm_contention_sampled(lock, sample))
+		return;
+
+	lock->l_wait_start = ktime_get();
+
+	spin_lock(&lct->lct_lock);
+	lce = ldlm_contention_find(lct, &res->lr_name);
+	if (!lce) {
+		__u64 error;
+
+		/* replace the least contended resource */
+		lce = &lct->lct_entries[0];
+		for (i = 1; i < LDLM_CONTENTION_TOP_N; i++)
+			if (lct->lct_entries[i].lce_waits < lce->lce_waits)
+				lce = &lct->lct_entries[i];
+
+		error = lce->lce_waits;
+		memset(lce, 0, sizeof(*lce));
+		lce->lce_name = res->lr_name;
+		lce->lce_type = res->lr_type;
+		lce->lce_waits = error;
+		lce->lce_error = error;
+	}
+	lce->lce_waits += sample;
+	if (depth > lce->lce_max_queue)
+		lce->lce_max_queue = depth;
+	lce->lce_last_seen = ktime_get_real_seconds();
+	spin_unlock(&lct->lct_lock);
+}
+
+/**
+ * Account the grant latency of \a lock if it had to wait.
+ */
+void ldlm_contention_granted(struct ldlm_lock *lock)
+{
+	struct ldlm_resource *res = lock->l_resource;
+	struct ldlm_contention_table *lct = ldlm_res_to_ns(res)->ns_contention;
+	struct ldlm_contention_entry *lce;
+	s64 wait_ms;
+	int bucket = 0;
+
+	/* l_wait_start shares storage with the client LRU fields */
+	if (!lct || ktime_to_ns(lock->l_wait_start) == 0)
+		return;
+
+	wait_ms = ktime_ms_delta(ktime_get(), lock->l_wait_start);
+	lock->l_wait_start = ktime_set(0, 0);
+
+	if (wait_ms > 0)
+		bucket = min_t(int, fls64(wait_ms), LDLM_CONTENTION_HIST - 1);
+
+	spin_lock(&lct->lct_lock);
+	lce = ldlm_contention_find(lct, &res->lr_name);
+	if (lce)
+		lce->lce_grant_hist[bucket]++;
+	spin_unlock(&lct->lct_lock);
+}
+
+/**
+ * Account a blocking AST sent to the holder of granted \a lock.
+ */
+void ldlm_contention_bl_ast(struct ldlm_lock *lock)
+{
+	struct ldlm_resource *res = lock->l_resource;
+	struct ldlm_contention_table *lct = ldlm_res_to_ns(res)->ns_contention;
+	struct ldlm_contention_entry *lce;
+	struct lnet_nid *nid = NULL;
+	unsigned int sample;
+	unsigned int i;
+
+	if (!lct)
+		return;
+
+	sample = READ_ONCE(lct->lct_sample);
+	if (!ldlm_contention_sampled(lock, sample))
+		return;
+
+	if (lock->l_export && lock->l_export->exp_connection)
+		nid = &lock->l_export->exp_connection->c_peer.nid;
+
+	spin_lock(&lct->lct_lock);
+	lce = ldlm_contention_find(lct, &res->lr_name);
+	if (!lce)
+		goto out;
+
+	lce->lce_asts += sample;
+	if (!nid)
+		goto out;
+
+	for (i = 0; i < lce->lce_nr_holders; i++)
+		if (nid_same(&lce->lce_holders[i], nid))
+			goto out;
+
+	if (lce->lce_nr_holders < LDLM_CONTENTION_NIDS)
+		lce->lce_holders[lce->lce_nr_holders++] = *nid;
+	else
+		lce->lce_holders[lce->lce_asts % LDLM_CONTENTION_NIDS] = *nid;
+out:
+	spin_unlock(&lct->lct_lock);
+}
+
+static int ldlm_contention_cmp(const void *a, const void *b)
+{
+	const struct ldlm_contention_entry *lce_a = a;
+	const struct ldlm_contention_entry *lce_b = b;
+
+	if (lce_a->lce_waits > lce_b->lce_waits)
+		return -1;
+	if (lce_a->lce_waits < lce_b->lce_waits)
+		return 1;
+	return 0;
+}
+
+static int ldlm_contention_seq_show(struct seq_file *m, void *v)
+{
+	struct ldlm_namespace *ns = m->private;
+	struct ldlm_contention_table *lct = ns->ns_contention;
+	struct ldlm_contention_entry *entries;
+	int i, j;
+
+	OBD_ALLOC_PTR_ARRAY_LARGE(entries, LDLM_CONTENTION_TOP_N);
+	if (!entries)
+		return -ENOMEM;
+
+	spin_lock(&lct->lct_lock);
+	memcpy(entries, lct->lct_entries,
+	       sizeof(*entries) * LDLM_CONTENTION_TOP_N);
+	spin_unlock(&lct->lct_lock);
+
+	sort(entries, LDLM_CONTENTION_TOP_N, sizeof(*entries),
+	     ldlm_contention_cmp, NULL);
+
+	lprocfs_stats_header(m, ktime_get_real(), lct->lct_init, 25, ":",
+			     true, "");
+	seq_printf(m, "sample_rate: %u\n", READ_ONCE(lct->lct_sample));
+	seq_puts(m, "resources:\n");
+	for (i = 0; i < LDLM_CONTENTION_TOP_N; i++) {
+		struct ldlm_contention_entry *lce = &entries[i];
+		const char *sep = "";
+
+		if (lce->lce_waits == 0)
+			break;
+
+		seq_printf(m, "  - resource: \""DLDLMRES"\"\n",
+			   lce->lce_name.name[0], lce->lce_name.name[1],
+			   lce->lce_name.name[2], lce->lce_name.name[3]);
+		seq_printf(m, "    type: %s\n", ldlm_typename[lce->lce_type]);
+		seq_printf(m, "    waits: %llu\n", lce->lce_waits);
+		seq_printf(m, "    waits_error: %llu\n", lce->lce_error);
+		seq_printf(m, "    bl_asts: %llu\n", lce->lce_asts);
+		seq_printf(m, "    max_waiting: %u\n", lce->lce_max_queue);
+		seq_printf(m, "    last_seen: %lld\n", lce->lce_last_seen);
+		seq_puts(m, "    holders: [ ");
+		for (j = 0; j < lce->lce_nr_holders; j++) {
+			seq_printf(m, "%s%s", sep,
+				   libcfs_nidstr(&lce->lce_holders[j]));
+			sep = ", ";
+		}
+		seq_puts(m, " ]\n");
+		seq_puts(m, "    grant_latency_ms: { ");
+		sep = "";
+		for (j = 0; j < LDLM_CONTENTION_HIST; j++) {
+			if (lce->lce_grant_hist[j] == 0)
+				continue;
+			seq_printf(m, "%s%u: %lu", sep,
+				   j == 0 ? 0 : 1U << (j - 1),
+				   lce->lce_grant_hist[j]);
+			sep = ", ";
+		}
+		seq_puts(m, " }\n");
+	}
+
+	OBD_FREE_PTR_ARRAY_LARGE(entries, LDLM_CONTENTION_TOP_N);
+
+	return 0;
+}
+
+static ssize_t ldlm_contention_seq_write(struct file *file,
+					 const char __user *buffer,
+					 size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct ldlm_namespace *ns = m->private;
+	struct ldlm_contention_table *lct = ns->ns_contention;
+
+	spin_lock(&lct->lct_lock);
+	memset(lct->lct_entries, 0, sizeof(lct->lct_entries));
+	lct->lct_init = ktime_get_real();
+	spin_unlock(&lct->lct_lock);
+
+	return count;
+}
+LDEBUGFS_SEQ_FOPS(ldlm_contention);
+
+static int ldlm_contention_init(struct ldlm_namespace *ns)
+{
+	struct ldlm_contention_table *lct;
+
+	if (ns_is_client(ns))
+		return 0;
+
+	OBD_ALLOC_PTR(lct);
+	if (!lct)
+		return -ENOMEM;
+
+	spin_lock_init(&lct->lct_lock);
+	lct->lct_sample = LDLM_CONTENTION_SAMPLE_DEF;
+	lct->lct_init = ktime_get_real();
+	ns->ns_contention = lct;
+
+	return 0;
+}
+
+static void ldlm_contention_fini(struct ldlm_namespace *ns)
+{
+	if (ns->ns_contention) {
+		OBD_FREE_PTR(ns->ns_contention);
+		ns->ns_contention = NULL;
+	}
+}
+#else /* !HAVE_SERVER_SUPPORT */
+static inline int ldlm_contention_init(struct ldlm_namespace *ns)
+{
+	return 0;
+}
+
+static inline void ldlm_contention_fini(struct ldlm_namespace *ns)
+{
+}
 #endif /* HAVE_SERVER_SUPPORT */
 
 /* These are for namespaces in /sys/fs/lustre/ldlm/namespaces/ */
@@ -682,6 +1033,7 @@ static struct attribute *ldlm_ns_attrs[] = {
 	&lustre_attr_lru_size.attr,
 	&lustre_attr_lru_cancel_batch.attr,
 	&lustre_attr_lru_max_age.attr,
+	&lustre_attr_lru_reuse_policy.attr,
 	&lustre_attr_early_lock_cancel.attr,
 	&lustre_attr_dirty_age_limit.attr,
 #ifdef HAVE_SERVER_SUPPORT
@@ -691,6 +1043,7 @@ static struct attribute *ldlm_ns_attrs[] = {
 	&lustre_attr_contention_seconds.attr,
 	&lustre_attr_contended_locks.attr,
 	&lustre_attr_max_parallel_ast.attr,
+	&lustre_attr_contention_sample.attr,
 #endif
 	NULL,
 };
@@ -710,6 +1063,73 @@ static struct kobj_type ldlm_ns_ktype = {
 	.release	= ldlm_ns_release,
 };
 
+static void ldlm_lru_reuse_hist_show(struct seq_file *m, const char *name,
+				     struct obd_histogram *oh)
+{
+	unsigned long tot = lprocfs_oh_sum(oh);
+	unsigned long cum = 0;
+	int i;
+
+	seq_printf(m, "\n%-20s locks   %% cum %%\n", name);
+	for (i = 0; i < OBD_HIST_MAX && cum < tot; i++) {
+		unsigned long c = oh->oh_buckets[i];
+
+		cum += c;
+		seq_printf(m, "%u:\t\t%10lu %3u %3u\n",
+			   i == 0 ? 0 : 1 << (i - 1), c, pct(c, tot),
+			   pct(cum, tot));
+	}
+}
+
+static int ldlm_lru_reuse_stats_seq_show(struct seq_file *m, void *v)
+{
+	struct ldlm_namespace *ns = m->private;
+	struct ldlm_lru_reuse_stats *lrs = &ns->ns_lru_reuse;
+	unsigned long hits = lprocfs_oh_sum(&lrs->lrs_interval_hist);
+	unsigned long evicts = lprocfs_oh_sum(&lrs->lrs_evict_hist);
+
+	lprocfs_stats_header(m, ktime_get_real(), lrs->lrs_init, 25, ":",
+			     true, "");
+	seq_printf(m, "lru_reuse_policy:        %u\n", ns->ns_lru_reuse_policy);
+	seq_printf(m, "lru_hits:                %lu\n", hits);
+	seq_printf(m, "lru_cancels:             %lu\n", evicts);
+	seq_printf(m, "lru_hit_pct:             %u\n", pct(hits, hits + evicts));
+	seq_printf(m, "lru_second_chances:      %u\n",
+		   atomic_read(&lrs->lrs_second_chance));
+
+	ldlm_lru_reuse_hist_show(m, "reuse interval (ms)",
+				 &lrs->lrs_interval_hist);
+	ldlm_lru_reuse_hist_show(m, "reuses at cancel",
+				 &lrs->lrs_evict_hist);
+
+	return 0;
+}
+
+static ssize_t ldlm_lru_reuse_stats_seq_write(struct file *file,
+					      const char __user *buffer,
+					      size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct ldlm_namespace *ns = m->private;
+	struct ldlm_lru_reuse_stats *lrs = &ns->ns_lru_reuse;
+
+	lprocfs_oh_clear(&lrs->lrs_interval_hist);
+	lprocfs_oh_clear(&lrs->lrs_evict_hist);
+	atomic_set(&lrs->lrs_second_chance, 0);
+	lrs->lrs_init = ktime_get_real();
+
+	return count;
+}
+LDEBUGFS_SEQ_FOPS(ldlm_lru_reuse_stats);
+
+static void ldlm_lru_reuse_stats_init(struct ldlm_lru_reuse_stats *lrs)
+{
+	spin_lock_init(&lrs->lrs_interval_hist.oh_lock);
+	spin_lock_init(&lrs->lrs_evict_hist.oh_lock);
+	atomic_set(&lrs->lrs_second_chance, 0);
+	lrs->lrs_init = ktime_get_real();
+}
+
 static void ldlm_namespace_debugfs_unregister(struct ldlm_namespace *ns)
 {
 	if (IS_ERR_OR_NULL(ns->ns_debugfs_entry))
@@ -764,6 +1184,15 @@ static int ldlm_namespace_debugfs_register(struct ldlm_namespace *ns)
 		ns->ns_debugfs_entry = ns_entry;
 	}
 
+	if (ns_is_client(ns))
+		debugfs_create_file("lru_reuse_stats", 0644, ns_entry, ns,
+				    &ldlm_lru_reuse_stats_fops);
+#ifdef HAVE_SERVER_SUPPORT
+	if (ns->ns_contention)
+		debugfs_create_file("contention", 0644, ns_entry, ns,
+				    &ldlm_contention_fops);
+#endif
+
 	return 0;
 }
 #undef MAX_STRING_SIZE
@@ -978,6 +1407,15 @@ struct ldlm_namespace *ldlm_namespace_new(struct obd_device *obd, char *name,
 	ns->ns_reclaim_start	  = 0;
 	ns->ns_last_pos		  = &ns->ns_unused_list;
 	ns->ns_flags		  = 0;
+	ns->ns_lru_reuse_policy	  = 0;
+	ldlm_lru_reuse_stats_init(&ns->ns_lru_reuse);
+
+	rc = ldlm_contention_init(ns);
+	if (rc) {
+		CERROR("%s: cannot initialize contention table: rc = %d\n",
+		       name, rc);
+		GOTO(out_hash, rc);
+	}
 
 	rc = ldlm_namespace_sysfs_register(ns);
 	if (rc) {
@@ -1006,6 +1444,7 @@ out_sysfs:
 	ldlm_namespace_sysfs_unregister(ns);
 	ldlm_namespace_cleanup(ns, 0);
 out_hash:
+	ldlm_contention_fini(ns);
 	OBD_FREE_PTR_ARRAY_LARGE(ns->ns_rs_buckets, 1 << ns->ns_bucket_bits);
 	kfree(ns->ns_name);
 	cfs_hash_putref(ns->ns_rs_hash);
@@ -1272,6 +1711,7 @@ void ldlm_namespace_free_post(struct ldlm_namespace *ns)
 
 	ldlm_namespace_debugfs_unregister(ns);
 	ldlm_namespace_sysfs_unregister(ns);
+	ldlm_contention_fini(ns);
 	cfs_hash_putref(ns->ns_rs_hash);
 	OBD_FREE_PTR_ARRAY_LARGE(ns->ns_rs_buckets, 1 << ns->ns_bucket_bits);
 	kfree(ns->ns_name);
@@ -1645,6 +2085,9 @@ static void __ldlm_resource_add_lock(struct ldlm_resource *res,
 	else
 		list_add(&lock->l_res_link, head);
 
+	if (!ldlm_is_granted(lock) && ldlm_res_count_waiting(res))
+		res->lr_waiting_count++;
+
 	if (res->lr_type == LDLM_IBITS)
 		ldlm_inodebits_add_lock(res, head, lock, tail);
 
@@ -1710,6 +2153,7 @@ void ldlm_resource_unlink_lock(struct ldlm_lock *lock)
 		ldlm_inodebits_unlink_lock(lock);
 		break;
 	}
+	ldlm_res_waiting_del(lock);
 	list_del_init(&lock->l_res_link);
 }
 EXPORT_SYMBOL(ldlm_resource_unlink_lock);
@@ -444,7 +444,8 @@ static int ll_md_need_convert(struct ldlm_lock *lock)
 	/* is lock is too old to be converted? */
 	lock_res_and_lock(lock);
 	if (ktime_after(ktime_get(),
-			ktime_add(lock->l_last_used, ns->ns_dirty_age_limit))) {
+			ktime_add(lock->l_lru_last_ref,
+				  ns->ns_dirty_age_limit))) {
 		unlock_res_and_lock(lock);
 		return 0;
 	}
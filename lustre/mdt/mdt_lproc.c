@@ -145,6 +145,89 @@ mdt_rename_stats_seq_write(struct file *file, const char __user *buf,
 }
 LPROC_SEQ_FOPS(mdt_rename_stats);
 
+/*
+ * reply_slot_stats shows the reply data slot allocator of the MDT:
+ * allocations, refills of the per-CPU slot caches from the bitmap, slots
+ * recycled through the caches and slots cached now, followed by the log2
+ * histogram of the allocation latency in nanoseconds.
+ */
+static int mdt_reply_slot_stats_seq_show(struct seq_file *seq, void *v)
+{
+	struct mdt_device *mdt = seq->private;
+	struct lu_target *lut = &mdt->mdt_lut;
+	struct obd_hist_pcpu *hist = &lut->lut_reply_slot_hist;
+	__u64 allocs = 0, refills = 0, recycled = 0, cached = 0;
+	unsigned long tot, cnt, cum = 0;
+	int cpu, i;
+
+	if (lut->lut_reply_slot_cache == NULL)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct tgt_reply_slot_cache *trsc;
+
+		trsc = per_cpu_ptr(lut->lut_reply_slot_cache, cpu);
+		spin_lock(&trsc->trsc_lock);
+		allocs += trsc->trsc_allocs;
+		refills += trsc->trsc_refills;
+		recycled += trsc->trsc_recycled;
+		cached += trsc->trsc_count;
+		spin_unlock(&trsc->trsc_lock);
+	}
+
+	seq_puts(seq, "reply_slot_stats:\n");
+	lprocfs_stats_header(seq, ktime_get_real(), lut->lut_reply_slot_init,
+			     15, ":", false, "- ");
+	seq_printf(seq, "- %-15s %llu\n", "allocs:", allocs);
+	seq_printf(seq, "- %-15s %llu\n", "cache_refills:", refills);
+	seq_printf(seq, "- %-15s %llu\n", "recycled:", recycled);
+	seq_printf(seq, "- %-15s %llu\n", "cached:", cached);
+
+	tot = lprocfs_oh_sum_pcpu(hist);
+	seq_printf(seq, "- %-15s { samples: %lu }\n", "latency_ns:", tot);
+	for (i = 0; i < OBD_HIST_MAX && cum < tot; i++) {
+		cnt = lprocfs_oh_counter_pcpu(hist, i);
+		cum += cnt;
+		if (cum == 0)
+			continue;
+
+		seq_printf(seq, "%6s%lu:", " ", BIT(i));
+		seq_printf(seq, " { sample: %3lu, pct: %3u, cum_pct: %3u }\n",
+			   cnt, pct(cnt, tot), pct(cum, tot));
+	}
+
+	return 0;
+}
+
+static ssize_t
+mdt_reply_slot_stats_seq_write(struct file *file, const char __user *buf,
+			       size_t len, loff_t *off)
+{
+	struct seq_file *seq = file->private_data;
+	struct mdt_device *mdt = seq->private;
+	struct lu_target *lut = &mdt->mdt_lut;
+	int cpu;
+
+	if (lut->lut_reply_slot_cache == NULL)
+		return len;
+
+	for_each_possible_cpu(cpu) {
+		struct tgt_reply_slot_cache *trsc;
+
+		trsc = per_cpu_ptr(lut->lut_reply_slot_cache, cpu);
+		spin_lock(&trsc->trsc_lock);
+		trsc->trsc_allocs = 0;
+		trsc->trsc_refills = 0;
+		trsc->trsc_recycled = 0;
+		spin_unlock(&trsc->trsc_lock);
+	}
+	lprocfs_oh_clear_pcpu(&lut->lut_reply_slot_hist);
+	lut->lut_reply_slot_init = ktime_get_real();
+
+	return len;
+}
+LPROC_SEQ_FOPS(mdt_reply_slot_stats);
+
 static int lproc_mdt_attach_rename_seqstat(struct mdt_device *mdt)
 {
 	int i;
@@ -1906,6 +1989,12 @@ int mdt_tunables_init(struct mdt_device *mdt, const char *name)
 		CERROR("%s: MDT can not create rename stats rc = %d\n",
 		       mdt_obd_name(mdt), rc);
 
+	rc = lprocfs_obd_seq_create(obd, "reply_slot_stats", 0644,
+				    &mdt_reply_slot_stats_fops, mdt);
+	if (rc)
+		CERROR("%s: MDT can not create reply slot stats rc = %d\n",
+		       mdt_obd_name(mdt), rc);
+
 	RETURN(rc);
 }
 
@@ -1160,6 +1160,7 @@ struct obd_import *class_new_import(struct obd_device *obd)
 	imp->imp_replay_cursor = &imp->imp_committed_list;
 	spin_lock_init(&imp->imp_lock);
 	imp->imp_last_success_conn = 0;
+	imp->imp_dev_cpt = CFS_CPT_ANY;
 	imp->imp_state = LUSTRE_IMP_NEW;
 	imp->imp_obd = class_incref(obd, "import", imp);
 	rwlock_init(&imp->imp_sec_lock);
@@ -425,6 +425,66 @@ static ssize_t sync_journal_store(struct kobject *kobj, struct attribute *attr,
 }
 LUSTRE_RW_ATTR(sync_journal);
 
+/**
+ * Show the maximum space reserved after a sequential write.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to show
+ * \param[in] buf	buffer for data
+ *
+ * \retval		number of bytes written to \a buf
+ */
+static ssize_t alloc_reserve_max_show(struct kobject *kobj,
+				      struct attribute *attr, char *buf)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct ofd_device *ofd = ofd_dev(obd->obd_lu_dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", ofd->ofd_alloc_reserve_max);
+}
+
+/**
+ * Set the maximum space reserved after a sequential write.
+ *
+ * When a write extends an object, the OSD can allocate unwritten blocks
+ * right after it for the data the client still has in its cache, so the
+ * next writes to the object are contiguous on disk even when many objects
+ * are written concurrently. The reservation is limited by the client dirty
+ * cache and the space not granted to clients. Blocks left unused stay
+ * allocated to the object until it is truncated or destroyed.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to set
+ * \param[in] buffer	size in bytes, with an optional unit suffix,
+ *			0 disables the reservation
+ * \param[in] count	\a buffer length
+ *
+ * \retval		\a count on success
+ * \retval		negative number on error
+ */
+static ssize_t alloc_reserve_max_store(struct kobject *kobj,
+				       struct attribute *attr,
+				       const char *buffer, size_t count)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct ofd_device *ofd = ofd_dev(obd->obd_lu_dev);
+	u64 val;
+	int rc;
+
+	rc = sysfs_memparse(buffer, count, &val, "B");
+	if (rc < 0)
+		return rc;
+
+	if (val > PTLRPC_MAX_BRW_SIZE)
+		return -ERANGE;
+
+	ofd->ofd_alloc_reserve_max = val;
+	return count;
+}
+LUSTRE_RW_ATTR(alloc_reserve_max);
+
 static int ofd_brw_size_seq_show(struct seq_file *m, void *data)
 {
 	struct obd_device	*obd = m->private;
@@ -893,6 +953,142 @@ static ssize_t checksum_t10pi_enforce_store(struct kobject *kobj,
 }
 LUSTRE_RW_ATTR(checksum_t10pi_enforce);
 
+/**
+ * Show if BRW write replies are sent on IO completion.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to show
+ * \param[in] buf	buffer for data
+ *
+ * \retval		number of bytes written to \a buf
+ */
+static ssize_t brw_async_reply_show(struct kobject *kobj,
+				    struct attribute *attr, char *buf)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct lu_target *lut = obd2obt(obd)->obt_lut;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", lut->lut_brw_async_reply);
+}
+
+/**
+ * Enable or disable sending BRW write replies on IO completion.
+ *
+ * When enabled, an ost_io thread doesn't wait for the data of a write
+ * to reach the disk. It goes on with the next request and the reply is
+ * sent once the IO is complete, so the number of writes in flight to the
+ * disk is no longer bound by the number of ost_io threads.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to set
+ * \param[in] buffer	string which represents mode
+ *			1: reply on IO completion
+ *			0: reply from the service thread
+ * \param[in] count	\a buffer length
+ *
+ * \retval		\a count on success
+ * \retval		negative number on error
+ */
+static ssize_t brw_async_reply_store(struct kobject *kobj,
+				     struct attribute *attr,
+				     const char *buffer, size_t count)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct lu_target *lut = obd2obt(obd)->obt_lut;
+	bool enable;
+	int rc;
+
+	rc = kstrtobool(buffer, &enable);
+	if (rc)
+		return rc;
+
+	spin_lock(&lut->lut_flags_lock);
+	lut->lut_brw_async_reply = enable;
+	spin_unlock(&lut->lut_flags_lock);
+	return count;
+}
+LUSTRE_RW_ATTR(brw_async_reply);
+
+/**
+ * Show the maximum size of writes committed in a shared transaction.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to show
+ * \param[in] buf	buffer for data
+ *
+ * \retval		number of bytes written to \a buf
+ */
+static ssize_t brw_batch_pages_show(struct kobject *kobj,
+				    struct attribute *attr, char *buf)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct ofd_device *ofd = ofd_dev(obd->obd_lu_dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", ofd->ofd_brw_batch_pages);
+}
+
+/**
+ * Set the maximum size of writes committed in a shared transaction.
+ *
+ * Concurrent asynchronous writes of up to this many pages are committed
+ * together, up to OFD_BRW_BATCH_MAX of them in one transaction, instead of
+ * each starting and stopping its own. Each write still gets its own transno
+ * and reply.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to set
+ * \param[in] buffer	number of pages, 0 disables batching
+ * \param[in] count	\a buffer length
+ *
+ * \retval		\a count on success
+ * \retval		negative number on error
+ */
+static ssize_t brw_batch_pages_store(struct kobject *kobj,
+				     struct attribute *attr,
+				     const char *buffer, size_t count)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct ofd_device *ofd = ofd_dev(obd->obd_lu_dev);
+	unsigned int val;
+	int rc;
+
+	rc = kstrtouint(buffer, 0, &val);
+	if (rc)
+		return rc;
+
+	if (val > PTLRPC_MAX_BRW_PAGES)
+		return -ERANGE;
+
+	ofd->ofd_brw_batch_pages = val;
+	return count;
+}
+LUSTRE_RW_ATTR(brw_batch_pages);
+
+/**
+ * Show how many writes were committed in a transaction shared with others.
+ *
+ * \param[in] kobj	kobject
+ * \param[in] attr	attribute to show
+ * \param[in] buf	buffer for data
+ *
+ * \retval		number of bytes written to \a buf
+ */
+static ssize_t brw_batched_show(struct kobject *kobj, struct attribute *attr,
+				char *buf)
+{
+	struct obd_device *obd = container_of(kobj, struct obd_device,
+					      obd_kset.kobj);
+	struct ofd_device *ofd = ofd_dev(obd->obd_lu_dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%lld\n",
+			 (s64)atomic64_read(&ofd->ofd_brw_batched));
+}
+LUSTRE_RO_ATTR(brw_batched);
+
 LPROC_SEQ_FOPS_RO_TYPE(ofd, recovery_status);
 LUSTRE_RW_ATTR(recovery_time_hard);
 LUSTRE_RW_ATTR(recovery_time_soft);
@@ -1021,6 +1217,10 @@ static struct attribute *ofd_attrs[] = {
 	&lustre_attr_access_log_size.attr,
 	&lustre_attr_job_cleanup_interval.attr,
 	&lustre_attr_checksum_t10pi_enforce.attr,
+	&lustre_attr_brw_async_reply.attr,
+	&lustre_attr_alloc_reserve_max.attr,
+	&lustre_attr_brw_batch_pages.attr,
+	&lustre_attr_brw_batched.attr,
 	&lustre_attr_at_min.attr,
 	&lustre_attr_at_max.attr,
 	&lustre_attr_at_history.attr,
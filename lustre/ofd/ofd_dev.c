@@ -2976,6 +2976,10 @@ static int ofd_init0(const struct lu_env *env, struct ofd_device *m,
 	spin_lock_init(&m->ofd_batch_lock);
 	init_rwsem(&m->ofd_lastid_rwsem);
 
+	spin_lock_init(&m->ofd_brw_batch_lock);
+	INIT_LIST_HEAD(&m->ofd_brw_batch_list);
+	atomic64_set(&m->ofd_brw_batched, 0);
+
 	m->ofd_dt_dev.dd_lu_dev.ld_ops = &ofd_lu_ops;
 	m->ofd_dt_dev.dd_lu_dev.ld_obd = obd;
 	/* set this lu_device to obd, because error handling need it */
@@ -3117,6 +3121,8 @@ static void ofd_fini(const struct lu_env *env, struct ofd_device *m)
 	struct lu_device	*d   = &m->ofd_dt_dev.dd_lu_dev;
 	struct lfsck_stop	 stop;
 
+	tgt_brw_async_drain(&m->ofd_lut);
+
 	stop.ls_status = LS_PAUSED;
 	stop.ls_flags = 0;
 	lfsck_stop(env, m->ofd_osd, &stop);
@@ -52,6 +52,11 @@
 
 #define OFD_SOFT_SYNC_LIMIT_DEFAULT 16
 
+/* writes committed in one transaction, each may charge a user, a group and
+ * a project quota ID which are all tracked by the transaction
+ */
+#define OFD_BRW_BATCH_MAX	(QUOTA_MAX_TRANSIDS / LL_MAXQUOTAS)
+
 /*
  * update atime if on-disk value older than client's one
  * by OFD_ATIME_DIFF or more
@@ -147,6 +152,17 @@ struct ofd_device {
 	struct seq_server_site	 ofd_seq_site;
 	/* the limit of SOFT_SYNC RPCs that will trigger a soft sync */
 	unsigned int		 ofd_soft_sync_limit;
+	/* max space reserved after a sequential write, 0 to disable */
+	unsigned int		 ofd_alloc_reserve_max;
+	/* group commit of small writes, see ofd_brw_batch_commit() */
+	spinlock_t		 ofd_brw_batch_lock;
+	struct list_head	 ofd_brw_batch_list;
+	unsigned int		 ofd_brw_batch_queued;
+	/* a thread is committing writes and takes the queued ones next */
+	bool			 ofd_brw_batch_busy;
+	/* max pages of a batched write, 0 to disable */
+	unsigned int		 ofd_brw_batch_pages;
+	atomic64_t		 ofd_brw_batched;
 	/* Protect ::ofd_lastid_rebuilding */
 	struct rw_semaphore	 ofd_lastid_rwsem;
 	__u64			 ofd_lastid_gen;
@@ -1198,6 +1198,341 @@ static int ofd_soft_sync_cb_add(struct thandle *th, struct obd_export *exp)
 	return rc;
 }
 
+/* state of a write queued for group commit */
+enum ofd_brw_batch_state {
+	OFD_BRW_BATCH_QUEUED,
+	/* the thread commits the next batch */
+	OFD_BRW_BATCH_LEADER,
+	OFD_BRW_BATCH_DONE,
+};
+
+/**
+ * Small write committed together with the writes of other threads.
+ *
+ * The item lives on the stack of the thread handling the request, the
+ * thread committing the batch only uses it until it sets the item done.
+ */
+struct ofd_brw_batch_item {
+	struct list_head	 obi_list;
+	/* session of the request, for its last_rcvd update */
+	struct lu_context	*obi_ses;
+	struct obd_export	*obi_exp;
+	struct ofd_object	*obi_fo;
+	const struct lu_fid	*obi_fid;
+	struct lu_attr		*obi_la;
+	struct obdo		*obi_oa;
+	struct niobuf_local	*obi_lnb;
+	int			 obi_niocount;
+	unsigned long		 obi_granted;
+	__u64			 obi_xid;
+	bool			 obi_soft_sync;
+	/* -EAGAIN if the thread has to commit the write alone */
+	int			 obi_rc;
+	enum ofd_brw_batch_state obi_state;
+};
+
+/**
+ * Check whether a write can be committed with the writes of other requests.
+ *
+ * Only small asynchronous writes are batched, the others gain little from
+ * sharing a transaction or have to wait for its commit anyway. The echo
+ * client has no request to update last_rcvd for.
+ *
+ * \param[in] env	execution environment
+ * \param[in] ofd	OFD device
+ * \param[in] exp	OBD export of client
+ * \param[in] lnb	local buffers
+ * \param[in] niocount	number of local buffers
+ *
+ * \retval		true if the write can be batched
+ */
+static bool ofd_brw_batch_allowed(const struct lu_env *env,
+				  struct ofd_device *ofd,
+				  struct obd_export *exp,
+				  struct niobuf_local *lnb, int niocount)
+{
+	struct tgt_session_info *tsi;
+	int i;
+
+	if (niocount > ofd->ofd_brw_batch_pages)
+		return false;
+
+	if (ofd->ofd_sync_journal || exp->exp_need_sync)
+		return false;
+
+	if (env->le_ses == NULL)
+		return false;
+
+	tsi = tgt_ses_info(env);
+	if (tsi->tsi_exp == NULL || tgt_ses_req(tsi) == NULL)
+		return false;
+
+	for (i = 0; i < niocount; i++) {
+		if (!(lnb[i].lnb_flags & OBD_BRW_ASYNC))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Commit a batch of writes in a single transaction.
+ *
+ * The first item is the write of the calling thread. The transaction is run
+ * without its session, so the transaction hooks don't update last_rcvd for
+ * a write which is not in it. All the requests, the calling one included,
+ * join the transaction with tgt_txn_join_start() and tgt_txn_join_stop()
+ * instead. Grant and soft sync commit callbacks are added for each write as
+ * ofd_commitrw_write() does.
+ *
+ * A write which can't be done in the batch, because of an error or when the
+ * transaction has to be restarted, gets -EAGAIN and its thread commits it
+ * again alone, so errors and retries are handled as before. Data written
+ * by the batch is then written again, which is harmless.
+ *
+ * \param[in] env	execution environment
+ * \param[in] ofd	OFD device
+ * \param[in] items	writes to commit
+ * \param[in] count	number of \a items
+ */
+static void ofd_brw_batch_run(const struct lu_env *env, struct ofd_device *ofd,
+			      struct ofd_brw_batch_item **items, int count)
+{
+	struct lu_env *benv = (struct lu_env *)env;
+	struct lu_context *ses = benv->le_ses;
+	struct ofd_brw_batch_item *item;
+	struct ofd_object *fo;
+	struct dt_object *o;
+	struct lu_attr *la;
+	struct thandle *th;
+	int committed = 0;
+	int rc, i;
+
+	ENTRY;
+
+	for (i = 0; i < count; i++)
+		items[i]->obi_rc = -EAGAIN;
+
+	/* each request updates last_rcvd only if it joined, see above */
+	benv->le_ses = NULL;
+
+	th = ofd_trans_create(env, ofd);
+	if (IS_ERR(th))
+		GOTO(out_ses, rc = PTR_ERR(th));
+
+	for (i = 0; i < count; i++) {
+		item = items[i];
+		fo = item->obi_fo;
+		o = ofd_object_child(fo);
+		la = item->obi_la;
+
+		rc = dt_declare_write_commit(env, o, item->obi_lnb,
+					     item->obi_niocount, th);
+		if (rc)
+			continue;
+
+		/* don't update atime on disk if it is older */
+		if (la->la_valid & LA_ATIME &&
+		    la->la_atime <= fo->ofo_atime_ondisk)
+			la->la_valid &= ~LA_ATIME;
+
+		if (la->la_valid) {
+			rc = dt_declare_attr_set(env, o, la, th);
+			if (rc)
+				continue;
+		}
+
+		/* the version of the object was set by the request thread */
+		rc = tgt_txn_join_start(env, item->obi_ses, &ofd->ofd_lut, th);
+		if (rc)
+			continue;
+		item->obi_rc = 0;
+	}
+
+	rc = ofd_trans_start(env, ofd, NULL, th);
+	if (rc) {
+		for (i = 0; i < count; i++)
+			items[i]->obi_rc = -EAGAIN;
+		GOTO(out_stop, rc);
+	}
+
+	for (i = 0; i < count; i++) {
+		item = items[i];
+		if (item->obi_rc)
+			continue;
+
+		/* the transaction is out of credits, retry the rest alone */
+		if (th->th_restart_tran) {
+			item->obi_rc = -EAGAIN;
+			continue;
+		}
+
+		fo = item->obi_fo;
+		o = ofd_object_child(fo);
+		la = item->obi_la;
+
+		ofd_read_lock(env, fo);
+		if (!ofd_object_exists(fo))
+			GOTO(unlock, rc = -EAGAIN);
+
+		/* Don't update timestamps if this write is older than a
+		 * setattr which modifies the timestamps. b=10150 */
+		if (la->la_valid &&
+		    tgt_fmd_check(item->obi_exp, item->obi_fid,
+				  item->obi_xid)) {
+			rc = dt_attr_set(env, o, la, th);
+			if (rc)
+				GOTO(unlock, rc = -EAGAIN);
+			if (la->la_valid & LA_ATIME)
+				fo->ofo_atime_ondisk = la->la_atime;
+		}
+
+		rc = dt_write_commit(env, o, item->obi_lnb, item->obi_niocount,
+				     th, item->obi_oa->o_size);
+		/* a write without pages doesn't make the batch local */
+		th->th_local = 0;
+		if (rc) {
+			/* force commit to make deleted blocks reusable */
+			if (rc == -ENOSPC)
+				th->th_sync = 1;
+			GOTO(unlock, rc = -EAGAIN);
+		}
+
+		/* get attr to return */
+		rc = dt_attr_get(env, o, la);
+unlock:
+		ofd_read_unlock(env, fo);
+		item->obi_rc = rc;
+	}
+
+out_stop:
+	for (i = 0; i < count; i++) {
+		item = items[i];
+		if (item->obi_rc == -EAGAIN)
+			continue;
+
+		if (!th->th_sync && item->obi_soft_sync)
+			ofd_soft_sync_cb_add(th, item->obi_exp);
+
+		if (item->obi_rc == 0 && item->obi_granted > 0 &&
+		    tgt_grant_commit_cb_add(th, item->obi_exp,
+					    item->obi_granted) == 0)
+			item->obi_granted = 0;
+
+		rc = tgt_txn_join_stop(env, item->obi_ses, &ofd->ofd_lut, th,
+				       item->obi_rc);
+		if (item->obi_rc == 0)
+			item->obi_rc = rc;
+		committed++;
+	}
+
+	rc = ofd_trans_stop(env, ofd, th, 0);
+	for (i = 0; i < count; i++) {
+		if (rc && items[i]->obi_rc == 0)
+			items[i]->obi_rc = rc;
+	}
+
+	if (committed > 1)
+		atomic64_add(committed, &ofd->ofd_brw_batched);
+out_ses:
+	benv->le_ses = ses;
+
+	EXIT;
+}
+
+/**
+ * Commit a small write, possibly in the transaction of another request.
+ *
+ * Group commit of concurrent small writes: the first thread to arrive
+ * commits its write while the next ones queue up, then it hands the queue
+ * over to the first queued thread which commits all of them in a single
+ * transaction, and so on. When the queue is full, the arriving thread
+ * commits the queued writes itself, so several batches can be in progress.
+ * Each request keeps its own transno, reply and commit callbacks.
+ *
+ * \param[in] env	execution environment
+ * \param[in] ofd	OFD device
+ * \param[in] self	write of the calling thread
+ *
+ * \retval		0 on successful commit
+ * \retval		-EAGAIN if the write has to be committed alone
+ * \retval		negative value on other errors
+ */
+static int ofd_brw_batch_commit(const struct lu_env *env,
+				struct ofd_device *ofd,
+				struct ofd_brw_batch_item *self)
+{
+	struct ofd_brw_batch_item *items[OFD_BRW_BATCH_MAX];
+	struct ofd_brw_batch_item *next = NULL;
+	bool busy = false;
+	int count = 1;
+	int i;
+
+	items[0] = self;
+	INIT_LIST_HEAD(&self->obi_list);
+
+	spin_lock(&ofd->ofd_brw_batch_lock);
+	if (!ofd->ofd_brw_batch_busy) {
+		ofd->ofd_brw_batch_busy = true;
+		busy = true;
+	} else if (ofd->ofd_brw_batch_queued < OFD_BRW_BATCH_MAX - 1) {
+		self->obi_state = OFD_BRW_BATCH_QUEUED;
+		list_add_tail(&self->obi_list, &ofd->ofd_brw_batch_list);
+		ofd->ofd_brw_batch_queued++;
+		spin_unlock(&ofd->ofd_brw_batch_lock);
+
+		wait_var_event(&self->obi_state,
+			       smp_load_acquire(&self->obi_state) !=
+			       OFD_BRW_BATCH_QUEUED);
+		if (self->obi_state == OFD_BRW_BATCH_DONE)
+			return self->obi_rc;
+
+		/* ofd_brw_batch_busy was passed on to this thread */
+		busy = true;
+		spin_lock(&ofd->ofd_brw_batch_lock);
+	}
+
+	while (count < OFD_BRW_BATCH_MAX &&
+	       !list_empty(&ofd->ofd_brw_batch_list)) {
+		items[count] = list_first_entry(&ofd->ofd_brw_batch_list,
+						struct ofd_brw_batch_item,
+						obi_list);
+		list_del_init(&items[count]->obi_list);
+		ofd->ofd_brw_batch_queued--;
+		count++;
+	}
+	spin_unlock(&ofd->ofd_brw_batch_lock);
+
+	ofd_brw_batch_run(env, ofd, items, count);
+
+	/* the thread holding ofd_brw_batch_busy passes it on */
+	if (busy) {
+		spin_lock(&ofd->ofd_brw_batch_lock);
+		if (list_empty(&ofd->ofd_brw_batch_list)) {
+			ofd->ofd_brw_batch_busy = false;
+		} else {
+			next = list_first_entry(&ofd->ofd_brw_batch_list,
+						struct ofd_brw_batch_item,
+						obi_list);
+			list_del_init(&next->obi_list);
+			ofd->ofd_brw_batch_queued--;
+		}
+		spin_unlock(&ofd->ofd_brw_batch_lock);
+	}
+
+	for (i = 1; i < count; i++) {
+		smp_store_release(&items[i]->obi_state, OFD_BRW_BATCH_DONE);
+		wake_up_var(&items[i]->obi_state);
+	}
+
+	if (next != NULL) {
+		smp_store_release(&next->obi_state, OFD_BRW_BATCH_LEADER);
+		wake_up_var(&next->obi_state);
+	}
+
+	return self->obi_rc;
+}
+
 /**
  * Commit bulk IO buffers to the storage.
  *
@@ -1215,6 +1550,8 @@ static int ofd_soft_sync_cb_add(struct thandle *th, struct obd_export *exp)
  * \param[in] lnb	local buffers
  * \param[in] granted	grant space consumed for the bulk I/O
  * \param[in] old_rc	result of processing at this point
+ * \param[in] io_cb	if not NULL, the OSD may complete the data IO after
+ *			this returns and then call it, see struct dt_io_cb
  *
  * \retval		0 on successful commit
  * \retval		negative value on error
@@ -1224,7 +1561,7 @@ ofd_commitrw_write(const struct lu_env *env, struct obd_export *exp,
 		   struct ofd_device *ofd, const struct lu_fid *fid,
 		   struct lu_attr *la, struct obdo *oa, int objcount,
 		   int niocount, struct niobuf_local *lnb,
-		   unsigned long granted, int old_rc)
+		   unsigned long granted, int old_rc, struct dt_io_cb *io_cb)
 {
 	struct ofd_thread_info *info = ofd_info(env);
 	struct filter_export_data *fed = &exp->exp_filter_data;
@@ -1238,6 +1575,7 @@ ofd_commitrw_write(const struct lu_env *env, struct obd_export *exp,
 	bool soft_sync = false;
 	bool cb_registered = false;
 	bool fake_write = false;
+	__u64 reserve = 0;
 
 	ENTRY;
 
@@ -1288,6 +1626,43 @@ ofd_commitrw_write(const struct lu_env *env, struct obd_export *exp,
 		fake_write = true;
 	}
 
+	/* let the OSD allocate ahead for the data the client still caches */
+	if (ofd->ofd_alloc_reserve_max != 0)
+		reserve = tgt_grant_write_reserve(exp,
+						  ofd->ofd_alloc_reserve_max);
+
+	if (ofd->ofd_brw_batch_pages != 0 && !fake_write && io_cb == NULL &&
+	    reserve == 0 &&
+	    ofd_brw_batch_allowed(env, ofd, exp, lnb, niocount)) {
+		struct ofd_brw_batch_item item = {
+			.obi_ses	= env->le_ses,
+			.obi_exp	= exp,
+			.obi_fo		= fo,
+			.obi_fid	= fid,
+			.obi_la		= la,
+			.obi_oa		= oa,
+			.obi_lnb	= lnb,
+			.obi_niocount	= niocount,
+			.obi_granted	= granted,
+			.obi_xid	= info->fti_xid,
+		};
+
+		for (i = 0; i < niocount; i++) {
+			if (lnb[i].lnb_flags & OBD_BRW_SOFT_SYNC)
+				item.obi_soft_sync = true;
+		}
+
+		/* version change is required for this object */
+		tgt_vbr_obj_set(env, o);
+		rc = ofd_brw_batch_commit(env, ofd, &item);
+		granted = item.obi_granted;
+		if (rc != -EAGAIN) {
+			soft_sync = item.obi_soft_sync;
+			GOTO(out_soft_sync, rc);
+		}
+		rc = 0;
+	}
+
 retry:
 	CFS_FAIL_TIMEOUT(OBD_FAIL_OFD_COMMITRW_DELAY, cfs_fail_val);
 
@@ -1295,6 +1670,8 @@ retry:
 	if (IS_ERR(th))
 		GOTO(out, rc = PTR_ERR(th));
 
+	th->th_io_cb = io_cb;
+	th->th_write_reserve = reserve;
 	th->th_sync |= ofd->ofd_sync_journal;
 	if (th->th_sync == 0) {
 		for (i = 0; i < niocount; i++) {
@@ -1396,6 +1773,7 @@ out_stop:
 		       retries);
 		goto retry;
 	}
+out_soft_sync:
 	if (!soft_sync)
 		/* reset fed_soft_sync_count upon non-SOFT_SYNC RPC */
 		atomic_set(&fed->fed_soft_sync_count, 0);
@@ -1444,6 +1822,7 @@ int ofd_commitrw(const struct lu_env *env, int cmd, struct obd_export *exp,
 	const struct lu_fid *fid = &oa->o_oi.oi_fid;
 	struct ldlm_namespace *ns = ofd->ofd_namespace;
 	struct ldlm_resource *rs = NULL;
+	struct dt_io_cb *io_cb;
 	char *jobid;
 	__u64 valid;
 	int rc = 0;
@@ -1453,8 +1832,10 @@ int ofd_commitrw(const struct lu_env *env, int cmd, struct obd_export *exp,
 
 	if (tgt_ses_req(tsi) == NULL) { /* echo client case */
 		jobid = NULL;
+		io_cb = NULL;
 	} else {
 		jobid = tsi->tsi_jobid;
+		io_cb = tsi->tsi_brw_cb;
 	}
 
 	if (cmd == OBD_BRW_WRITE) {
@@ -1507,7 +1888,7 @@ int ofd_commitrw(const struct lu_env *env, int cmd, struct obd_export *exp,
 
 		rc = ofd_commitrw_write(env, exp, ofd, fid, &info->fti_attr,
 					oa, objcount, npages, lnb,
-					oa->o_grant_used, old_rc);
+					oa->o_grant_used, old_rc, io_cb);
 		if (rc == 0)
 			obdo_from_la(oa, &info->fti_attr,
 				     OFD_VALID_FLAGS | LA_GID | LA_UID |
@@ -462,6 +462,7 @@ static struct lu_object *osd_object_alloc(const struct lu_env *env,
 		init_rwsem(&mo->oo_ext_idx_sem);
 		spin_lock_init(&mo->oo_guard);
 		INIT_LIST_HEAD(&mo->oo_xattr_list);
+		INIT_LIST_HEAD(&mo->oo_reserve_link);
 		return l;
 	}
 	return NULL;
@@ -1899,7 +1900,7 @@ static struct thandle *osd_trans_create(const struct lu_env *env,
 					struct dt_device *d)
 {
 	struct osd_thread_info *oti = osd_oti_get(env);
-	struct osd_iobuf *iobuf = &oti->oti_iobuf;
+	struct osd_iobuf *iobuf = oti->oti_iobuf;
 	struct osd_thandle *oh;
 	struct thandle *th;
 
@@ -1931,9 +1932,11 @@ static struct thandle *osd_trans_create(const struct lu_env *env,
 	th->th_result = 0;
 	oh->ot_credits = 0;
 	oh->oh_declared_ext = 0;
+	oh->oh_reserve_blocks = 0;
 	INIT_LIST_HEAD(&oh->ot_commit_dcb_list);
 	INIT_LIST_HEAD(&oh->ot_stop_dcb_list);
 	INIT_LIST_HEAD(&oh->ot_trunc_locks);
+	INIT_LIST_HEAD(&oh->ot_iobufs);
 	INIT_LIST_HEAD(&oh->ot_declare_list);
 	osd_th_alloced(oh);
 
@@ -2146,17 +2149,22 @@ static int osd_trans_stop(const struct lu_env *env, struct dt_device *dt,
 {
 	struct osd_thread_info *oti = osd_oti_get(env);
 	struct osd_thandle *oh;
-	struct osd_iobuf *iobuf = &oti->oti_iobuf;
+	struct osd_iobuf *iobuf = oti->oti_iobuf;
 	struct osd_device *osd = osd_dt_dev(th->th_dev);
 	struct qsd_instance *qsd = osd_def_qsd(osd);
 	struct lquota_trans *qtrans;
+	struct dt_io_cb *io_cb;
 	LIST_HEAD(truncates);
+	LIST_HEAD(iobufs);
 	int rc = 0, remove_agents = 0;
 
 	ENTRY;
 
 	oh = container_of(th, struct osd_thandle, ot_super);
 
+	/* a restarted write is redone with the same iobuf */
+	io_cb = th->th_restart_tran ? NULL : th->th_io_cb;
+
 	remove_agents = oh->ot_remove_agents;
 
 	qtrans = oh->ot_quota_trans;
@@ -2166,6 +2174,7 @@ static int osd_trans_stop(const struct lu_env *env, struct dt_device *dt,
 
 	/* move locks to local list, stop tx, execute truncates */
 	list_splice(&oh->ot_trunc_locks, &truncates);
+	list_splice(&oh->ot_iobufs, &iobufs);
 
 	if (oh->ot_handle != NULL) {
 		int rc2;
@@ -2227,15 +2236,27 @@ static int osd_trans_stop(const struct lu_env *env, struct dt_device *dt,
 	 * no-op for them.
 	 *
 	 * IMPORTANT: we have to wait till any IO submited by the thread is
-	 * completed otherwise iobuf may be corrupted by different request
+	 * completed otherwise iobuf may be corrupted by different request,
+	 * unless the caller lets the IO complete in the background, then
+	 * the thread continues with a new iobuf.
 	 */
-	wait_event(iobuf->dr_wait,
-		       atomic_read(&iobuf->dr_numreqs) == 0);
+	if (rc != 0 || io_cb == NULL || !osd_iobuf_defer(oti, io_cb)) {
+		wait_event(iobuf->dr_wait,
+			   atomic_read(&iobuf->dr_numreqs) == 0);
 
-	if (!rc)
-		rc = iobuf->dr_error;
+		if (!rc)
+			rc = iobuf->dr_error;
 
-	osd_fini_iobuf(osd, iobuf);
+		osd_fini_iobuf(osd, iobuf);
+	}
+
+	/* IO of the earlier writes of the transaction */
+	if (!list_empty(&iobufs)) {
+		int rc2 = osd_iobufs_wait(osd, &iobufs);
+
+		if (!rc)
+			rc = rc2;
+	}
 
 	if (unlikely(remove_agents != 0))
 		osd_process_scheduled_agent_removals(env, osd);
@@ -8041,8 +8062,14 @@ static void *osd_key_init(const struct lu_context *ctx,
 	if (info->oti_hlock == NULL)
 		goto out_free_ea;
 
+	OBD_ALLOC_PTR(info->oti_iobuf);
+	if (info->oti_iobuf == NULL)
+		goto out_free_hlock;
+
 	return info;
 
+out_free_hlock:
+	ldiskfs_htree_lock_free(info->oti_hlock);
 out_free_ea:
 	OBD_FREE(info->oti_it_ea_buf, OSD_IT_EA_BUFSIZE);
 out_free_info:
@@ -8078,8 +8105,9 @@ static void osd_key_fini(const struct lu_context *ctx,
 	if (info->oti_hlock != NULL)
 		ldiskfs_htree_lock_free(info->oti_hlock);
 	OBD_FREE(info->oti_it_ea_buf, OSD_IT_EA_BUFSIZE);
-	lu_buf_free(&info->oti_iobuf.dr_bl_buf);
-	lu_buf_free(&info->oti_iobuf.dr_lnb_buf);
+	lu_buf_free(&info->oti_iobuf->dr_bl_buf);
+	lu_buf_free(&info->oti_iobuf->dr_lnb_buf);
+	OBD_FREE_PTR(info->oti_iobuf);
 	lu_buf_free(&info->oti_big_buf);
 	if (idc != NULL) {
 		LASSERT(info->oti_ins_cache_size > 0);
@@ -8105,6 +8133,7 @@ static void osd_key_exit(const struct lu_context *ctx,
 	LASSERT(info->oti_txns    == 0);
 	LASSERTF(info->oti_dio_pages_used == 0, "%d\n",
 		 info->oti_dio_pages_used);
+	LASSERT(info->oti_iobuf_deferred == NULL);
 }
 
 /* type constructor/destructor: osd_type_init, osd_type_fini */
@@ -8176,6 +8205,10 @@ static int osd_shutdown(const struct lu_env *env, struct osd_device *o)
 {
 	ENTRY;
 
+	/* deferred writes hold inodes and call back into osd_device */
+	osd_iobuf_drain(o);
+	osd_reserve_fini(env, o);
+
 	/* shutdown quota slave instance associated with the device */
 	if (o->od_quota_slave_md != NULL) {
 		struct qsd_instance *qsd = o->od_quota_slave_md;
@@ -8192,6 +8225,7 @@ static int osd_shutdown(const struct lu_env *env, struct osd_device *o)
 	}
 
 	osd_fid_fini(env, o);
+	osd_oi_cache_stop(o);
 	osd_scrub_cleanup(env, o);
 
 	RETURN(0);
@@ -8489,6 +8523,7 @@ static int osd_device_init0(const struct lu_env *env,
 	INIT_LIST_HEAD(&o->od_index_backup_list);
 	INIT_LIST_HEAD(&o->od_index_restore_list);
 	spin_lock_init(&o->od_lock);
+	osd_reserve_init(o);
 	o->od_index_backup_policy = LIBP_NONE;
 	o->od_t10_type = 0;
 	init_waitqueue_head(&o->od_commit_cb_done);
@@ -8525,6 +8560,9 @@ static int osd_device_init0(const struct lu_env *env,
 	/* Can only check block device after mount */
 	o->od_nonrotational =
 		blk_queue_nonrot(bdev_get_queue(osd_sb(o)->s_bdev));
+	/* on flash, the per-page work costs more than the IO itself */
+	if (o->od_nonrotational)
+		o->od_bulk_read_min_iosize = OSD_BULK_READ_MIN_IO_MB << 20;
 
 	rc = osd_obj_map_init(env, o);
 	if (rc != 0)
@@ -8943,9 +8981,24 @@ static int __init osd_init(void)
 	if (rc)
 		return rc;
 
+	rc = osd_iobuf_wq_init();
+	if (rc) {
+		lu_kmem_fini(ldiskfs_caches);
+		return rc;
+	}
+
+	rc = osd_bulk_pool_init();
+	if (rc) {
+		osd_iobuf_wq_fini();
+		lu_kmem_fini(ldiskfs_caches);
+		return rc;
+	}
+
 	rc = class_register_type(&osd_obd_device_ops, NULL, true,
 				 LUSTRE_OSD_LDISKFS_NAME, &osd_device_type);
 	if (rc) {
+		osd_bulk_pool_fini();
+		osd_iobuf_wq_fini();
 		lu_kmem_fini(ldiskfs_caches);
 		return rc;
 	}
@@ -8981,6 +9034,8 @@ static void __exit osd_exit(void)
 		kobject_put(kobj);
 	}
 	class_unregister_type(LUSTRE_OSD_LDISKFS_NAME);
+	osd_bulk_pool_fini();
+	osd_iobuf_wq_fini();
 	lu_kmem_fini(ldiskfs_caches);
 }
 
@@ -164,6 +164,10 @@ struct osd_object {
 	struct list_head	oo_xattr_list;
 	struct lu_object_header *oo_header;
 	__u64			oo_dirent_count;
+
+	/* on od_reserve_list, and when blocks were last reserved */
+	struct list_head	oo_reserve_link;
+	time64_t		oo_reserve_time;
 };
 
 struct osd_obj_seq {
@@ -319,9 +323,15 @@ struct osd_device {
 	 * served bypassing pagecache unless already cached */
 	unsigned long		od_writethrough_max_iosize;
 
+	/* uncached reads >= od_bulk_read_min_iosize are served with the
+	 * pages of the per-CPT bulk pool, 0 to disable */
+	unsigned long		od_bulk_read_min_iosize;
+
 	struct brw_stats	od_brw_stats;
 	atomic_t		od_r_in_flight;
 	atomic_t		od_w_in_flight;
+	/* writes completed in the background, see osd_iobuf_defer() */
+	atomic_t		od_iobuf_deferred;
 
 	struct mutex		 od_otable_mutex;
 	struct osd_otable_it	*od_otable_it;
@@ -364,6 +374,17 @@ struct osd_device {
 	atomic_t		 od_commit_cb_in_flight;
 	wait_queue_head_t	 od_commit_cb_done;
 	unsigned int __percpu	*od_extent_bytes_percpu;
+	/* FID to inode mappings of the OI files */
+	struct osd_oi_cache	*od_oi_cache;
+	/* block allocations of writes, reported in alloc_stats */
+	atomic64_t		 od_alloc_extents;
+	atomic64_t		 od_alloc_discontig;
+	atomic64_t		 od_alloc_reserved;
+	/* objects with blocks reserved past EOF, see osd_reserve_track() */
+	spinlock_t		 od_reserve_lock;
+	struct list_head	 od_reserve_list;
+	unsigned int		 od_reserve_count;
+	struct delayed_work	 od_reserve_work;
 };
 
 static inline struct qsd_instance *osd_def_qsd(struct osd_device *osd)
@@ -437,6 +458,8 @@ struct osd_thandle {
 	struct lu_ref_link      ot_dev_link;
 	unsigned int		ot_credits;
 	unsigned int		oh_declared_ext;
+	/* blocks to reserve after the write, see th_write_reserve */
+	unsigned int		oh_reserve_blocks;
 
 	/* quota IDs related to the transaction */
 	unsigned short		ot_id_cnt;
@@ -445,7 +468,9 @@ struct osd_thandle {
 	uid_t			ot_id_array[OSD_MAX_UGID_CNT];
 	struct lquota_trans    *ot_quota_trans;
 
-	unsigned int		ot_remove_agents:1;
+	unsigned int		ot_remove_agents:1,
+	/* the thread iobuf holds a write of this transaction */
+				ot_iobuf_write:1;
 #if OSD_THANDLE_STATS
         /** time when this handle was allocated */
 	ktime_t oth_alloced;
@@ -454,6 +479,8 @@ struct osd_thandle {
 	ktime_t oth_started;
 #endif
 	struct list_head	ot_trunc_locks;
+	/* iobufs of the earlier writes, waited for by osd_trans_stop() */
+	struct list_head	ot_iobufs;
 	/*
 	 * list of declarations, used for large transactions to check
 	 * for duplicates, like llogs
@@ -506,6 +533,9 @@ enum {
         LPROC_OSD_THANDLE_CLOSING,
 #endif
 	LPROC_OSD_TOO_MANY_CREDITS,
+	LPROC_OSD_OI_CACHE_HIT,
+	LPROC_OSD_OI_CACHE_MISS,
+	LPROC_OSD_BULK_READ,
         LPROC_OSD_LAST,
 };
 #endif
@@ -612,6 +642,13 @@ struct osd_iobuf {
 	/* Already written blocks of the start page */
 	unsigned int	   dr_start_pg_wblks;
 	struct inode 	  *dr_inode;
+	/* IO completed in the background, see osd_iobuf_defer() */
+	struct dt_io_cb	  *dr_cb;
+	struct page	 **dr_held_pages;
+	int		   dr_held_npages;
+	struct work_struct dr_work;
+	/* on osd_thandle::ot_iobufs, see osd_write_commit() */
+	struct list_head   dr_link;
 };
 
 #define osd_dirty_inode(inode, flag)  (inode)->i_sb->s_op->dirty_inode((inode), flag)
@@ -735,7 +772,9 @@ struct osd_thread_info {
 		struct filter_fid	oti_ff;
 	};
 	/** 0-copy IO */
-	struct osd_iobuf		oti_iobuf;
+	struct osd_iobuf		*oti_iobuf;
+	/* written by this thread, handed over by osd_bufs_put() */
+	struct osd_iobuf		*oti_iobuf_deferred;
 	/* used to access objects in /O */
 	struct inode			*oti_inode;
 #define OSD_FID_REC_SZ 32
@@ -1088,6 +1127,7 @@ static inline int osd_invariant(const struct osd_object *obj)
 #define OSD_MAX_CACHE_SIZE OBD_OBJECT_EOF
 #define OSD_READCACHE_MAX_IO_MB		8
 #define OSD_WRITECACHE_MAX_IO_MB	8
+#define OSD_BULK_READ_MIN_IO_MB		4
 
 extern const struct dt_index_operations osd_otable_ops;
 
@@ -1536,6 +1576,15 @@ static inline struct buffer_head *__ldiskfs_bread(handle_t *handle,
 #endif /* HAVE_EXT4_INC_DEC_COUNT_2ARGS */
 
 void osd_fini_iobuf(struct osd_device *d, struct osd_iobuf *iobuf);
+bool osd_iobuf_defer(struct osd_thread_info *oti, struct dt_io_cb *cb);
+void osd_iobuf_drain(struct osd_device *osd);
+int osd_iobufs_wait(struct osd_device *osd, struct list_head *iobufs);
+void osd_reserve_init(struct osd_device *osd);
+void osd_reserve_fini(const struct lu_env *env, struct osd_device *osd);
+int osd_iobuf_wq_init(void);
+void osd_iobuf_wq_fini(void);
+int osd_bulk_pool_init(void);
+void osd_bulk_pool_fini(void);
 
 static inline int
 osd_index_register(struct osd_device *osd, const struct lu_fid *fid,
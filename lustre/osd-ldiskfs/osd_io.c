@@ -64,6 +64,8 @@
 #endif
 
 struct kmem_cache *biop_cachep;
+/* completes the writes left in flight by osd_iobuf_defer() */
+static struct workqueue_struct *osd_iobuf_wq;
 
 #ifdef HAVE_BIO_ENDIO_USES_ONE_ARG
 static void dio_complete_routine(struct bio *bio);
@@ -273,8 +275,12 @@ static void dio_complete_routine(struct bio *bio, int error)
 		iobuf->dr_elapsed = ktime_sub(now, iobuf->dr_start_time);
 		iobuf->dr_elapsed_valid = 1;
 	}
-	if (atomic_dec_and_test(&iobuf->dr_numreqs))
-		wake_up(&iobuf->dr_wait);
+	if (atomic_dec_and_test(&iobuf->dr_numreqs)) {
+		if (iobuf->dr_cb != NULL)
+			queue_work(osd_iobuf_wq, &iobuf->dr_work);
+		else
+			wake_up(&iobuf->dr_wait);
+	}
 
 	/* Completed bios used to be chained off iobuf->dr_bios and freed in
 	 * filter_clear_dreq().  It was then possible to exhaust the biovec-256
@@ -285,6 +291,428 @@ static void dio_complete_routine(struct bio *bio, int error)
 	osd_bio_fini(bio);
 }
 
+int osd_iobuf_wq_init(void)
+{
+	osd_iobuf_wq = alloc_workqueue("osd_iobuf", WQ_UNBOUND, 0);
+
+	return osd_iobuf_wq == NULL ? -ENOMEM : 0;
+}
+
+void osd_iobuf_wq_fini(void)
+{
+	destroy_workqueue(osd_iobuf_wq);
+}
+
+/*
+ * Per-CPT pool of the pages used by the large uncached reads. The pages
+ * are kept locked and marked PagePrivate2 like the per-thread DIO pages,
+ * they are never inserted in the page cache.
+ */
+struct osd_bulk_pool {
+	spinlock_t		obp_lock;
+	struct list_head	obp_free;
+	unsigned int		obp_count;
+};
+
+static struct osd_bulk_pool **osd_bulk_pools;
+
+static unsigned int osd_bulk_pool_pages = 32 << (20 - PAGE_SHIFT);
+module_param(osd_bulk_pool_pages, uint, 0644);
+MODULE_PARM_DESC(osd_bulk_pool_pages, "Max free pages kept per CPT for the large uncached reads");
+
+static void osd_bulk_page_free(struct page *page)
+{
+	ClearPagePrivate2(page);
+	unlock_page(page);
+	__free_page(page);
+}
+
+/**
+ * Release the pooled pages of \a lnb to the pool of the current CPT, or
+ * free them if the pool is full.
+ */
+static void osd_bulk_pages_put(struct niobuf_local *lnb, int npages)
+{
+	struct osd_bulk_pool *obp;
+	struct page *page, *tmp;
+	LIST_HEAD(extra);
+	int i;
+
+	obp = osd_bulk_pools[cfs_cpt_current(cfs_cpt_tab, 0)];
+	spin_lock(&obp->obp_lock);
+	for (i = 0; i < npages; i++) {
+		page = lnb[i].lnb_page;
+		if (page == NULL || !lnb[i].lnb_pooled)
+			continue;
+
+		lnb[i].lnb_page = NULL;
+		lnb[i].lnb_pooled = 0;
+		if (obp->obp_count < osd_bulk_pool_pages) {
+			list_add(&page->lru, &obp->obp_free);
+			obp->obp_count++;
+		} else {
+			list_add(&page->lru, &extra);
+		}
+	}
+	spin_unlock(&obp->obp_lock);
+
+	list_for_each_entry_safe(page, tmp, &extra, lru) {
+		list_del(&page->lru);
+		osd_bulk_page_free(page);
+	}
+}
+
+/**
+ * Fill \a lnb with the pages of the pool of the current CPT, taken in one
+ * go, the missing ones are allocated on the memory node of the CPT.
+ */
+static int osd_bulk_pages_get(struct niobuf_local *lnb, int npages,
+			      gfp_t gfp_mask)
+{
+	int cpt = cfs_cpt_current(cfs_cpt_tab, 0);
+	struct osd_bulk_pool *obp = osd_bulk_pools[cpt];
+	struct page *page;
+	LIST_HEAD(pages);
+	int got = 0;
+	int i;
+
+	spin_lock(&obp->obp_lock);
+	while (got < npages && !list_empty(&obp->obp_free)) {
+		list_move_tail(obp->obp_free.next, &pages);
+		obp->obp_count--;
+		got++;
+	}
+	spin_unlock(&obp->obp_lock);
+
+	for (i = 0; i < npages; i++) {
+		if (!list_empty(&pages)) {
+			page = list_first_entry(&pages, struct page, lru);
+			list_del_init(&page->lru);
+		} else {
+			page = cfs_page_cpt_alloc(cfs_cpt_tab, cpt, gfp_mask);
+			if (page == NULL) {
+				osd_bulk_pages_put(lnb, i);
+				return -ENOMEM;
+			}
+			SetPagePrivate2(page);
+			lock_page(page);
+		}
+
+		ClearPageUptodate(page);
+		page->index = lnb[i].lnb_file_offset >> PAGE_SHIFT;
+		lnb[i].lnb_page = page;
+		lnb[i].lnb_locked = 1;
+		lnb[i].lnb_pooled = 1;
+	}
+
+	return npages;
+}
+
+static unsigned long osd_bulk_pool_shrink_count(struct shrinker *s,
+						struct shrink_control *sc)
+{
+	struct osd_bulk_pool *obp;
+	unsigned long count = 0;
+	int i;
+
+	/* a little race here is fine */
+	cfs_percpt_for_each(obp, i, osd_bulk_pools)
+		count += obp->obp_count;
+
+	return count;
+}
+
+/* Free the pooled pages under memory pressure, they are reallocated on
+ * demand by osd_bulk_pages_get().
+ */
+static unsigned long osd_bulk_pool_shrink_scan(struct shrinker *s,
+					       struct shrink_control *sc)
+{
+	struct osd_bulk_pool *obp;
+	struct page *page, *tmp;
+	unsigned long freed = 0;
+	LIST_HEAD(pages);
+	int i;
+
+	cfs_percpt_for_each(obp, i, osd_bulk_pools) {
+		spin_lock(&obp->obp_lock);
+		while (freed < sc->nr_to_scan && !list_empty(&obp->obp_free)) {
+			list_move(obp->obp_free.next, &pages);
+			obp->obp_count--;
+			freed++;
+		}
+		spin_unlock(&obp->obp_lock);
+		if (freed >= sc->nr_to_scan)
+			break;
+	}
+
+	list_for_each_entry_safe(page, tmp, &pages, lru) {
+		list_del(&page->lru);
+		osd_bulk_page_free(page);
+	}
+
+	return freed;
+}
+
+#ifdef HAVE_SHRINKER_COUNT
+static struct shrinker osd_bulk_pool_shrinker = {
+	.count_objects	= osd_bulk_pool_shrink_count,
+	.scan_objects	= osd_bulk_pool_shrink_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+#else
+static int osd_bulk_pool_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	if (sc->nr_to_scan != 0)
+		osd_bulk_pool_shrink_scan(shrinker, sc);
+
+	return osd_bulk_pool_shrink_count(shrinker, sc);
+}
+
+static struct shrinker osd_bulk_pool_shrinker = {
+	.shrink  = osd_bulk_pool_shrink,
+	.seeks   = DEFAULT_SEEKS,
+};
+#endif /* HAVE_SHRINKER_COUNT */
+
+int osd_bulk_pool_init(void)
+{
+	struct osd_bulk_pool *obp;
+	int i, rc;
+
+	osd_bulk_pools = cfs_percpt_alloc(cfs_cpt_tab, sizeof(*obp));
+	if (osd_bulk_pools == NULL)
+		return -ENOMEM;
+
+	cfs_percpt_for_each(obp, i, osd_bulk_pools) {
+		spin_lock_init(&obp->obp_lock);
+		INIT_LIST_HEAD(&obp->obp_free);
+	}
+
+	rc = register_shrinker(&osd_bulk_pool_shrinker);
+	if (rc) {
+		cfs_percpt_free(osd_bulk_pools);
+		osd_bulk_pools = NULL;
+	}
+
+	return rc;
+}
+
+void osd_bulk_pool_fini(void)
+{
+	struct osd_bulk_pool *obp;
+	struct page *page;
+	int i;
+
+	if (osd_bulk_pools == NULL)
+		return;
+
+	unregister_shrinker(&osd_bulk_pool_shrinker);
+
+	cfs_percpt_for_each(obp, i, osd_bulk_pools) {
+		while (!list_empty(&obp->obp_free)) {
+			page = list_first_entry(&obp->obp_free, struct page,
+						lru);
+			list_del(&page->lru);
+			osd_bulk_page_free(page);
+		}
+	}
+	cfs_percpt_free(osd_bulk_pools);
+	osd_bulk_pools = NULL;
+}
+
+static void osd_iobuf_free(struct osd_iobuf *iobuf)
+{
+	if (iobuf->dr_held_pages != NULL)
+		OBD_FREE_PTR_ARRAY_LARGE(iobuf->dr_held_pages,
+					 iobuf->dr_max_pages);
+	lu_buf_free(&iobuf->dr_bl_buf);
+	lu_buf_free(&iobuf->dr_lnb_buf);
+	OBD_FREE_PTR(iobuf);
+}
+
+/* The last reference to a deferred iobuf is gone, either the one of the
+ * last bio or the one of the thread in osd_iobuf_handoff(): release the
+ * pages and report the IO to the caller.
+ */
+static void osd_iobuf_complete(struct osd_iobuf *iobuf)
+{
+	struct osd_device *osd = iobuf->dr_dev;
+	struct dt_io_cb *cb = iobuf->dr_cb;
+	int rc = iobuf->dr_error;
+	int i;
+
+	if (!iobuf->dr_elapsed_valid) {
+		iobuf->dr_elapsed = ktime_sub(ktime_get(),
+					      iobuf->dr_start_time);
+		iobuf->dr_elapsed_valid = 1;
+	}
+	osd_brw_stats_update(iobuf->dr_dev, iobuf);
+	osd_fini_iobuf(iobuf->dr_dev, iobuf);
+
+	for (i = 0; i < iobuf->dr_held_npages; i++) {
+		struct page *page = iobuf->dr_held_pages[i];
+
+		if (PagePrivate2(page)) {
+			/* taken from the DIO pool of the thread */
+			ClearPagePrivate2(page);
+			unlock_page(page);
+			__free_page(page);
+		} else {
+			unlock_page(page);
+			put_page(page);
+		}
+	}
+	iput(iobuf->dr_inode);
+	osd_iobuf_free(iobuf);
+
+	cb->dic_done(cb, rc);
+
+	if (atomic_dec_and_test(&osd->od_iobuf_deferred))
+		wake_up_var(&osd->od_iobuf_deferred);
+}
+
+static void osd_iobuf_work(struct work_struct *work)
+{
+	osd_iobuf_complete(container_of(work, struct osd_iobuf, dr_work));
+}
+
+/**
+ * Let the writes of the current thread complete in the background.
+ *
+ * Called when a transaction is stopped with thandle::th_io_cb set and
+ * bios still in flight. Rather than waiting for the bios, the thread
+ * switches to a new iobuf, and the pages are given to the in-flight one
+ * by osd_bufs_put(). \a cb is called once both happened.
+ *
+ * \retval true		\a cb will be called
+ * \retval false	the IO has to be waited for as usual
+ */
+bool osd_iobuf_defer(struct osd_thread_info *oti, struct dt_io_cb *cb)
+{
+	struct osd_iobuf *iobuf = oti->oti_iobuf;
+	struct osd_iobuf *next;
+
+	LASSERT(oti->oti_iobuf_deferred == NULL);
+
+	if (iobuf->dr_rw != 1 || atomic_read(&iobuf->dr_numreqs) == 0)
+		return false;
+
+	/* allocate everything now so osd_bufs_put() can't fail */
+	OBD_ALLOC_PTR(next);
+	if (next == NULL)
+		return false;
+
+	OBD_ALLOC_PTR_ARRAY_LARGE(iobuf->dr_held_pages, iobuf->dr_max_pages);
+	if (iobuf->dr_held_pages == NULL)
+		goto out_free;
+
+	if (igrab(iobuf->dr_inode) == NULL)
+		goto out_free;
+
+	/* the thread's reference, dropped by osd_iobuf_handoff() */
+	if (!atomic_inc_not_zero(&iobuf->dr_numreqs)) {
+		iput(iobuf->dr_inode);
+		goto out_free;
+	}
+
+	iobuf->dr_cb = cb;
+	iobuf->dr_held_npages = 0;
+	INIT_WORK(&iobuf->dr_work, osd_iobuf_work);
+	cb->dic_deferred = true;
+	atomic_inc(&iobuf->dr_dev->od_iobuf_deferred);
+
+	oti->oti_iobuf_deferred = iobuf;
+	oti->oti_iobuf = next;
+
+	return true;
+
+out_free:
+	if (iobuf->dr_held_pages != NULL) {
+		OBD_FREE_PTR_ARRAY_LARGE(iobuf->dr_held_pages,
+					 iobuf->dr_max_pages);
+		iobuf->dr_held_pages = NULL;
+	}
+	OBD_FREE_PTR(next);
+	return false;
+}
+
+/**
+ * Wait for the deferred writes of \a osd to complete.
+ *
+ * Called at device shutdown, once the target no longer defers writes.
+ * The completions run from osd_iobuf_wq, flush it so none of them still
+ * references \a osd after its last wakeup.
+ */
+void osd_iobuf_drain(struct osd_device *osd)
+{
+	wait_var_event(&osd->od_iobuf_deferred,
+		       atomic_read(&osd->od_iobuf_deferred) == 0);
+	flush_workqueue(osd_iobuf_wq);
+}
+
+/**
+ * Wait for the IO of the iobufs which held the earlier writes of a
+ * transaction, and free them.
+ *
+ * \retval 0		all the IO succeeded
+ * \retval negative	error of the first failed IO
+ */
+int osd_iobufs_wait(struct osd_device *osd, struct list_head *iobufs)
+{
+	struct osd_iobuf *iobuf, *next;
+	int rc = 0;
+
+	list_for_each_entry_safe(iobuf, next, iobufs, dr_link) {
+		list_del(&iobuf->dr_link);
+		wait_event(iobuf->dr_wait,
+			   atomic_read(&iobuf->dr_numreqs) == 0);
+		if (!rc)
+			rc = iobuf->dr_error;
+		osd_brw_stats_update(osd, iobuf);
+		osd_fini_iobuf(osd, iobuf);
+		osd_iobuf_free(iobuf);
+	}
+
+	return rc;
+}
+
+/* Give the pages of a deferred write to its iobuf, they stay locked until
+ * the IO is complete. Pages of the DIO pool are replaced in the pool.
+ */
+static void osd_iobuf_handoff(struct osd_thread_info *oti,
+			      struct niobuf_local *lnb, int npages)
+{
+	struct osd_iobuf *iobuf = oti->oti_iobuf_deferred;
+	int i;
+
+	oti->oti_iobuf_deferred = NULL;
+
+	LASSERT(npages <= iobuf->dr_max_pages);
+	for (i = 0; i < npages; i++) {
+		struct page *page = lnb[i].lnb_page;
+
+		if (page == NULL)
+			continue;
+
+		lnb[i].lnb_page = NULL;
+		if (!PagePrivate2(page) && !lnb[i].lnb_locked) {
+			put_page(page);
+			continue;
+		}
+		iobuf->dr_held_pages[iobuf->dr_held_npages++] = page;
+	}
+
+	/* the pool pages in use are exactly those of this write */
+	for (i = 0; i < oti->oti_dio_pages_used; i++)
+		oti->oti_dio_pages[i] = NULL;
+	oti->oti_dio_pages_used = 0;
+
+	if (atomic_dec_and_test(&iobuf->dr_numreqs))
+		osd_iobuf_complete(iobuf);
+}
+
 static void record_start_io(struct osd_iobuf *iobuf, int size)
 {
 	struct osd_device *osd = iobuf->dr_dev;
@@ -558,6 +986,7 @@ static int osd_map_remote_to_local(loff_t offset, ssize_t len, int *nrpages,
 		lnb->lnb_guard_rpc = 0;
 		lnb->lnb_guard_disk = 0;
 		lnb->lnb_locked = 0;
+		lnb->lnb_pooled = 0;
 
 		LASSERTF(plen <= len, "plen %u, len %lld\n", plen,
 			 (long long) len);
@@ -662,17 +1091,22 @@ static int osd_bufs_put(const struct lu_env *env, struct dt_object *dt,
 {
 	struct osd_device *osd = osd_obj2dev(osd_dt_obj(dt));
 	struct osd_thread_info *oti = osd_oti_get(env);
-	struct osd_iobuf *iobuf = &oti->oti_iobuf;
+	struct osd_iobuf *iobuf = oti->oti_iobuf;
 	struct pagevec pvec;
 	int i;
 
+	if (unlikely(oti->oti_iobuf_deferred != NULL)) {
+		osd_iobuf_handoff(oti, lnb, npages);
+		RETURN(0);
+	}
+
 	osd_brw_stats_update(osd, iobuf);
 	ll_pagevec_init(&pvec, 0);
 
 	for (i = 0; i < npages; i++) {
 		struct page *page = lnb[i].lnb_page;
 
-		if (page == NULL)
+		if (page == NULL || lnb[i].lnb_pooled)
 			continue;
 
 		/* if the page isn't cached, then reset uptodate
@@ -695,6 +1129,8 @@ static int osd_bufs_put(const struct lu_env *env, struct dt_object *dt,
 	/* Release any partial pagevec */
 	pagevec_release(&pvec);
 
+	osd_bulk_pages_put(lnb, npages);
+
 	RETURN(0);
 }
 
@@ -781,6 +1217,19 @@ static int osd_bufs_get(const struct lu_env *env, struct dt_object *dt,
 		break;
 	}
 
+	/* Large reads which don't use the page cache, of the objects not in
+	 * it, take all their pages from the bulk pool at once and skip the
+	 * per-page lookup. */
+	if (!cache && !write && osd->od_bulk_read_min_iosize &&
+	    iosize >= osd->od_bulk_read_min_iosize &&
+	    obj->oo_inode->i_mapping->nrpages == 0) {
+		rc = osd_bulk_pages_get(lnb, npages, GFP_HIGHUSER);
+		if (rc > 0)
+			lprocfs_counter_add(osd->od_stats, LPROC_OSD_BULK_READ,
+					    npages);
+		RETURN(rc);
+	}
+
 bypass_checks:
 	if (!cache && unlikely(!oti->oti_dio_pages)) {
 		OBD_ALLOC_PTR_ARRAY_LARGE(oti->oti_dio_pages,
@@ -912,6 +1361,196 @@ static void osd_decay_extent_bytes(struct osd_device *osd,
 		 EXTENT_BYTES_DECAY - 1) / EXTENT_BYTES_DECAY;
 }
 
+/* Account an extent allocated for a write. It is discontiguous when it
+ * doesn't follow the block before it in the object, \a prev if known.
+ */
+static void osd_alloc_stats_update(struct osd_device *osd,
+				   struct inode *inode,
+				   struct ldiskfs_map_blocks *map,
+				   sector_t prev)
+{
+	atomic64_inc(&osd->od_alloc_extents);
+
+	if (prev == 0 && map->m_lblk > 0) {
+		struct ldiskfs_map_blocks pmap = {
+			.m_lblk = map->m_lblk - 1,
+			.m_len = 1,
+		};
+
+		if (ldiskfs_map_blocks(NULL, inode, &pmap, 0) > 0)
+			prev = pmap.m_pblk;
+	}
+
+	if (prev != 0 && prev + 1 != map->m_pblk)
+		atomic64_inc(&osd->od_alloc_discontig);
+}
+
+/*
+ * Allocate unwritten blocks after a write which extends the object, for
+ * the data the client is going to send next. Those writes then land right
+ * after this one on disk, whatever is allocated to other objects meanwhile.
+ * This is only an optimization, so errors are ignored.
+ */
+static void osd_ldiskfs_reserve_blocks(struct inode *inode,
+				       struct osd_device *osd,
+				       struct thandle *thandle,
+				       ldiskfs_lblk_t lblk, int check_credits)
+{
+	struct osd_thandle *oh = container_of(thandle, struct osd_thandle,
+					      ot_super);
+	struct ldiskfs_map_blocks map = { 0 };
+	int flags = LDISKFS_GET_BLOCKS_CREATE_UNWRIT_EXT |
+		    LDISKFS_GET_BLOCKS_NO_NORMALIZE;
+	int rc;
+
+	if (oh->oh_reserve_blocks == 0)
+		return;
+
+	/* credits left from a restarted transaction are for the write */
+	if (check_credits) {
+		if (oh->oh_declared_ext <= 0)
+			return;
+		oh->oh_declared_ext--;
+	}
+#ifdef LDISKFS_GET_BLOCKS_KEEP_SIZE
+	flags |= LDISKFS_GET_BLOCKS_KEEP_SIZE;
+#endif
+	map.m_lblk = lblk;
+	map.m_len = min_t(unsigned int, oh->oh_reserve_blocks,
+			  EXT_UNWRITTEN_MAX_LEN);
+	oh->oh_reserve_blocks = 0;
+
+	rc = ldiskfs_map_blocks(oh->ot_handle, inode, &map, flags);
+	/* the blocks may be left from a previous reservation */
+	if (rc <= 0 || !(map.m_flags & LDISKFS_MAP_NEW)) {
+		CDEBUG(D_INODE, "inode #%lu: reserve %u at %u: rc = %d\n",
+		       inode->i_ino, map.m_len, map.m_lblk, rc);
+		return;
+	}
+
+	atomic64_add(rc, &osd->od_alloc_reserved);
+#ifdef LDISKFS_EOFBLOCKS_FL
+	ldiskfs_set_inode_flag(inode, LDISKFS_INODE_EOFBLOCKS);
+	ldiskfs_mark_inode_dirty(oh->ot_handle, inode);
+#endif
+}
+
+/* reserved blocks not written for this long are freed */
+#define OSD_RESERVE_TRIM_AGE	30
+/* objects tracked at most, the reservation is skipped past this */
+#define OSD_RESERVE_OBJS_MAX	4096
+
+/*
+ * Track \a obj whose blocks past EOF are about to be reserved. When it is
+ * not written again for OSD_RESERVE_TRIM_AGE seconds, osd_reserve_work()
+ * frees the blocks left. The list holds a reference on the object.
+ *
+ * \retval false	too many objects tracked, don't reserve
+ */
+static bool osd_reserve_track(struct osd_device *osd, struct osd_object *obj)
+{
+	bool track = true;
+
+	spin_lock(&osd->od_reserve_lock);
+	if (list_empty(&obj->oo_reserve_link)) {
+		if (osd->od_reserve_count >= OSD_RESERVE_OBJS_MAX) {
+			track = false;
+		} else {
+			lu_object_get(&obj->oo_dt.do_lu);
+			osd->od_reserve_count++;
+			if (list_empty(&osd->od_reserve_list))
+				schedule_delayed_work(&osd->od_reserve_work,
+					cfs_time_seconds(OSD_RESERVE_TRIM_AGE));
+		}
+	}
+	if (track) {
+		obj->oo_reserve_time = ktime_get_seconds();
+		list_move_tail(&obj->oo_reserve_link, &osd->od_reserve_list);
+	}
+	spin_unlock(&osd->od_reserve_lock);
+
+	return track;
+}
+
+/*
+ * Free the blocks past EOF of the tracked objects not written for
+ * OSD_RESERVE_TRIM_AGE seconds, or of all of them if \a all is set.
+ * An object is taken off the list before it is trimmed, so a write can
+ * track it again meanwhile, it then keeps its blocks.
+ */
+static void osd_reserve_trim(const struct lu_env *env, struct osd_device *osd,
+			     bool all)
+{
+	struct osd_object *obj;
+	time64_t old;
+
+	for (;;) {
+		old = ktime_get_seconds() - OSD_RESERVE_TRIM_AGE;
+
+		spin_lock(&osd->od_reserve_lock);
+		/* the list is in the order of the last reservation */
+		obj = list_first_entry_or_null(&osd->od_reserve_list,
+					       struct osd_object,
+					       oo_reserve_link);
+		if (obj != NULL && !all && obj->oo_reserve_time > old)
+			obj = NULL;
+		if (obj != NULL) {
+			list_del_init(&obj->oo_reserve_link);
+			osd->od_reserve_count--;
+		}
+		spin_unlock(&osd->od_reserve_lock);
+		if (obj == NULL)
+			break;
+
+		down_write(&obj->oo_ext_idx_sem);
+		if (!obj->oo_destroyed && obj->oo_inode != NULL &&
+		    dt_object_exists(&obj->oo_dt) &&
+		    (all || obj->oo_reserve_time <= old))
+			osd_execute_truncate(obj);
+		up_write(&obj->oo_ext_idx_sem);
+
+		osd_object_put(env, obj);
+	}
+}
+
+static void osd_reserve_work(struct work_struct *work)
+{
+	struct osd_device *osd = container_of(to_delayed_work(work),
+					      struct osd_device,
+					      od_reserve_work);
+	struct lu_env env;
+	int rc;
+
+	rc = lu_env_init(&env, LCT_LOCAL | LCT_DT_THREAD);
+	if (rc != 0) {
+		CWARN("%s: cannot init env to trim reserved blocks: rc = %d\n",
+		      osd_name(osd), rc);
+	} else {
+		osd_reserve_trim(&env, osd, false);
+		lu_env_fini(&env);
+	}
+
+	spin_lock(&osd->od_reserve_lock);
+	if (!list_empty(&osd->od_reserve_list))
+		schedule_delayed_work(&osd->od_reserve_work,
+				      cfs_time_seconds(OSD_RESERVE_TRIM_AGE));
+	spin_unlock(&osd->od_reserve_lock);
+}
+
+void osd_reserve_init(struct osd_device *osd)
+{
+	spin_lock_init(&osd->od_reserve_lock);
+	INIT_LIST_HEAD(&osd->od_reserve_list);
+	INIT_DELAYED_WORK(&osd->od_reserve_work, osd_reserve_work);
+}
+
+/* Free the blocks reserved past EOF of all objects at device shutdown. */
+void osd_reserve_fini(const struct lu_env *env, struct osd_device *osd)
+{
+	cancel_delayed_work_sync(&osd->od_reserve_work);
+	osd_reserve_trim(env, osd, true);
+}
+
 static int osd_ldiskfs_map_inode_pages(struct inode *inode,
 				       struct osd_iobuf *iobuf,
 				       struct osd_device *osd,
@@ -1046,6 +1685,9 @@ cont_map:
 				BRW_ALLOC_TIME : BRW_MAP_TIME;
 			lprocfs_oh_tally_log2_pcpu(&h->bs_hist[idx],
 						   ktime_to_ms(time));
+			if (create && rc > 0 && (map.m_flags & LDISKFS_MAP_NEW))
+				osd_alloc_stats_update(osd, inode, &map,
+					total > 0 ? *(blocks + total - 1) : 0);
 
 			for (; total < blen && c < map.m_len; c++, total++) {
 				if (rc == 0) {
@@ -1117,6 +1759,10 @@ cont_map:
 		fp = NULL;
 		blocks += blocks_per_page * clen;
 	}
+	if (create && thandle != NULL)
+		osd_ldiskfs_reserve_blocks(inode, osd, thandle,
+			(iobuf->dr_lnbs[pages - 1]->lnb_page->index + 1) *
+			blocks_per_page, check_credits);
 cleanup:
 	if (rc == 0 && create &&
 	    start_blocks < pages * blocks_per_page) {
@@ -1131,7 +1777,7 @@ static int osd_write_prep(const struct lu_env *env, struct dt_object *dt,
 			  struct niobuf_local *lnb, int npages)
 {
 	struct osd_thread_info *oti   = osd_oti_get(env);
-	struct osd_iobuf       *iobuf = &oti->oti_iobuf;
+	struct osd_iobuf       *iobuf = oti->oti_iobuf;
 	struct inode           *inode = osd_dt_obj(dt)->oo_inode;
 	struct osd_device      *osd   = osd_obj2dev(osd_dt_obj(dt));
 	ktime_t start, end;
@@ -1241,6 +1887,23 @@ static int osd_is_mapped(struct dt_object *dt, __u64 offset,
 	return map->m_flags & LDISKFS_MAP_MAPPED;
 }
 
+/* Whether the quota of an ID of the transaction is enforced. */
+static bool osd_quota_enforced(struct osd_thandle *oh)
+{
+	struct lquota_trans *qtrans = oh->ot_quota_trans;
+	int i;
+
+	if (qtrans == NULL)
+		return false;
+
+	/* qsd_op_begin() only attaches the entries of enforced IDs */
+	for (i = 0; i < qtrans->lqt_id_cnt; i++)
+		if (qtrans->lqt_ids[i].lqi_qentry != NULL)
+			return true;
+
+	return false;
+}
+
 #define MAX_EXTENTS_PER_WRITE 100
 static int osd_declare_write_commit(const struct lu_env *env,
 				    struct dt_object *dt,
@@ -1342,6 +2005,19 @@ static int osd_declare_write_commit(const struct lu_env *env,
 	if (extents > MAX_EXTENTS_PER_WRITE)
 		extents = MAX_EXTENTS_PER_WRITE;
 
+	/* the write extends the object, one more extent to reserve space
+	 * after it, see osd_ldiskfs_reserve_blocks()
+	 */
+	if (handle->th_write_reserve >= PAGE_SIZE &&
+	    extent_end == lnb[npages - 1].lnb_file_offset +
+			  lnb[npages - 1].lnb_len &&
+	    extent_end >= i_size_read(inode) &&
+	    ldiskfs_test_inode_flag(inode, LDISKFS_INODE_EXTENTS)) {
+		oh->oh_reserve_blocks = handle->th_write_reserve >>
+					inode->i_blkbits;
+		extents++;
+	}
+
 	/**
 	 * If we add a single extent, then in the worse case, each tree
 	 * level index/leaf need to be changed in case of the tree split.
@@ -1374,7 +2050,8 @@ static int osd_declare_write_commit(const struct lu_env *env,
 	}
 	dirty_groups += (extents + new_meta);
 
-	oh->oh_declared_ext = extents;
+	/* several objects may be written in the same transaction */
+	oh->oh_declared_ext += extents;
 
 	/* quota space for metadata blocks */
 	quota_space += new_meta * LDISKFS_BLOCK_SIZE(osd_sb(osd));
@@ -1424,9 +2101,19 @@ out_declare:
 	if (local_flags & QUOTA_FL_ROOT_PRJQUOTA)
 		lnb[0].lnb_flags |= OBD_BRW_ROOT_PRJQUOTA;
 
+	/* the reserved blocks aren't declared to quota, don't reserve for
+	 * an ID whose quota is enforced
+	 */
+	if (oh->oh_reserve_blocks > 0 && osd_quota_enforced(oh))
+		oh->oh_reserve_blocks = 0;
+
 	if (rc == 0)
 		rc = osd_trunc_lock(osd_dt_obj(dt), oh, true);
 
+	if (rc == 0 && oh->oh_reserve_blocks > 0 &&
+	    !osd_reserve_track(osd_obj2dev(osd_dt_obj(dt)), osd_dt_obj(dt)))
+		oh->oh_reserve_blocks = 0;
+
 	RETURN(rc);
 }
 
@@ -1436,16 +2123,45 @@ static int osd_write_commit(const struct lu_env *env, struct dt_object *dt,
 			    struct thandle *thandle, __u64 user_size)
 {
 	struct osd_thread_info *oti = osd_oti_get(env);
-	struct osd_iobuf *iobuf = &oti->oti_iobuf;
+	struct osd_iobuf *iobuf = oti->oti_iobuf;
 	struct inode *inode = osd_dt_obj(dt)->oo_inode;
 	struct osd_device  *osd = osd_obj2dev(osd_dt_obj(dt));
+	struct osd_thandle *oh;
+	struct osd_iobuf *next;
 	int rc = 0, i, check_credits = 0;
+	int error = 0;
 
 	LASSERT(inode);
+	oh = container_of(thandle, struct osd_thandle, ot_super);
+
+	/* the transaction may write several objects, the thread switches to
+	 * a new iobuf and the IO of the previous one is waited for by
+	 * osd_trans_stop() once the journal handle is stopped. If no iobuf
+	 * can be allocated, the IO is waited for here and its error is kept
+	 * for osd_trans_stop() like a single write would.
+	 */
+	if (oh->ot_iobuf_write) {
+		OBD_ALLOC_PTR(next);
+		if (next != NULL) {
+			list_add_tail(&iobuf->dr_link, &oh->ot_iobufs);
+			oti->oti_iobuf = iobuf = next;
+		} else {
+			wait_event(iobuf->dr_wait,
+				   atomic_read(&iobuf->dr_numreqs) == 0);
+			error = iobuf->dr_error;
+			osd_fini_iobuf(osd, iobuf);
+		}
+		oh->ot_iobuf_write = 0;
+	}
+	/* the restart point is only valid to retry the same write */
+	if (iobuf->dr_inode != inode)
+		iobuf->dr_start_pg_wblks = 0;
 
 	rc = osd_init_iobuf(osd, iobuf, inode, 1, npages);
 	if (unlikely(rc != 0))
 		RETURN(rc);
+	iobuf->dr_error = error;
+	oh->ot_iobuf_write = 1;
 
 	dquot_initialize(inode);
 
@@ -1502,8 +2218,10 @@ static int osd_write_commit(const struct lu_env *env, struct dt_object *dt,
 		thandle->th_local = 1;
 	}
 
-	if (rc != 0 && !thandle->th_restart_tran)
+	if (rc != 0 && !thandle->th_restart_tran) {
 		osd_fini_iobuf(osd, iobuf);
+		oh->ot_iobuf_write = 0;
+	}
 
 	osd_trans_exec_check(env, thandle, OSD_OT_WRITE);
 
@@ -1527,7 +2245,7 @@ static int osd_read_prep(const struct lu_env *env, struct dt_object *dt,
 			 struct niobuf_local *lnb, int npages)
 {
 	struct osd_thread_info *oti = osd_oti_get(env);
-	struct osd_iobuf *iobuf = &oti->oti_iobuf;
+	struct osd_iobuf *iobuf = oti->oti_iobuf;
 	struct inode *inode = osd_dt_obj(dt)->oo_inode;
 	struct osd_device *osd = osd_obj2dev(osd_dt_obj(dt));
 	int rc = 0, i, cache_hits = 0, cache_misses = 0;
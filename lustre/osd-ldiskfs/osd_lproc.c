@@ -91,6 +91,13 @@ static int osd_stats_init(struct osd_device *osd)
 		lprocfs_counter_init(osd->od_stats, LPROC_OSD_TOO_MANY_CREDITS,
 				     LPROCFS_CNTR_AVGMINMAX|LPROCFS_TYPE_REQS,
 				     "many_credits");
+		lprocfs_counter_init(osd->od_stats, LPROC_OSD_OI_CACHE_HIT,
+				     LPROCFS_TYPE_REQS, "oi_cache_hit");
+		lprocfs_counter_init(osd->od_stats, LPROC_OSD_OI_CACHE_MISS,
+				     LPROCFS_TYPE_REQS, "oi_cache_miss");
+		lprocfs_counter_init(osd->od_stats, LPROC_OSD_BULK_READ,
+				     LPROCFS_CNTR_AVGMINMAX|LPROCFS_TYPE_PAGES,
+				     "bulk_read");
 		result = 0;
 	}
 
@@ -609,6 +616,54 @@ ldiskfs_osd_readcache_max_io_seq_write(struct file *file,
 
 LDEBUGFS_SEQ_FOPS(ldiskfs_osd_readcache_max_io);
 
+static int ldiskfs_osd_bulk_read_min_io_seq_show(struct seq_file *m,
+						 void *data)
+{
+	struct osd_device *osd = osd_dt_dev((struct dt_device *)m->private);
+
+	LASSERT(osd != NULL);
+	if (unlikely(osd->od_mnt == NULL))
+		return -EINPROGRESS;
+
+	seq_printf(m, "%lu\n", osd->od_bulk_read_min_iosize >> 20);
+	return 0;
+}
+
+static ssize_t
+ldiskfs_osd_bulk_read_min_io_seq_write(struct file *file,
+				       const char __user *buffer,
+				       size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct dt_device *dt = m->private;
+	struct osd_device *osd = osd_dt_dev(dt);
+	char kernbuf[22] = "";
+	u64 val;
+	int rc;
+
+	LASSERT(osd != NULL);
+	if (unlikely(osd->od_mnt == NULL))
+		return -EINPROGRESS;
+
+	if (count >= sizeof(kernbuf))
+		return -EINVAL;
+
+	if (copy_from_user(kernbuf, buffer, count))
+		return -EFAULT;
+	kernbuf[count] = 0;
+
+	rc = sysfs_memparse(kernbuf, count, &val, "MiB");
+	if (rc < 0)
+		return rc;
+
+	if (val > PTLRPC_MAX_BRW_SIZE)
+		return -ERANGE;
+	osd->od_bulk_read_min_iosize = val;
+	return count;
+}
+
+LDEBUGFS_SEQ_FOPS(ldiskfs_osd_bulk_read_min_io);
+
 static int ldiskfs_osd_writethrough_max_io_seq_show(struct seq_file *m,
 						    void *data)
 {
@@ -657,6 +712,39 @@ ldiskfs_osd_writethrough_max_io_seq_write(struct file *file,
 
 LDEBUGFS_SEQ_FOPS(ldiskfs_osd_writethrough_max_io);
 
+/* How contiguous the blocks allocated for writes are. Writing anything
+ * to the file resets the counters.
+ */
+static int ldiskfs_osd_alloc_stats_seq_show(struct seq_file *m, void *data)
+{
+	struct osd_device *osd = osd_dt_dev((struct dt_device *)m->private);
+	s64 extents = atomic64_read(&osd->od_alloc_extents);
+	s64 discontig = atomic64_read(&osd->od_alloc_discontig);
+
+	seq_printf(m, "extents: %lld\n", extents);
+	seq_printf(m, "discontiguous: %lld\n", discontig);
+	seq_printf(m, "fragmentation_pct: %lld\n",
+		   extents ? div64_s64(discontig * 100, extents) : 0);
+	seq_printf(m, "reserved_blocks: %lld\n",
+		   (s64)atomic64_read(&osd->od_alloc_reserved));
+	return 0;
+}
+
+static ssize_t
+ldiskfs_osd_alloc_stats_seq_write(struct file *file, const char __user *buffer,
+				  size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct osd_device *osd = osd_dt_dev((struct dt_device *)m->private);
+
+	atomic64_set(&osd->od_alloc_extents, 0);
+	atomic64_set(&osd->od_alloc_discontig, 0);
+	atomic64_set(&osd->od_alloc_reserved, 0);
+	return count;
+}
+
+LDEBUGFS_SEQ_FOPS(ldiskfs_osd_alloc_stats);
+
 #if LUSTRE_VERSION_CODE < OBD_OCD_VERSION(3, 0, 52, 0)
 static ssize_t index_in_idif_show(struct kobject *kobj, struct attribute *attr,
 				  char *buf)
@@ -776,6 +864,10 @@ struct ldebugfs_vars ldebugfs_osd_obd_vars[] = {
 	  .fops =	&ldiskfs_osd_readcache_max_io_fops      },
 	{ .name =	"writethrough_max_io_mb",
 	  .fops =	&ldiskfs_osd_writethrough_max_io_fops   },
+	{ .name =	"bulk_read_min_io_mb",
+	  .fops =	&ldiskfs_osd_bulk_read_min_io_fops	},
+	{ .name =	"alloc_stats",
+	  .fops =	&ldiskfs_osd_alloc_stats_fops	},
 	{ NULL }
 };
 
@@ -38,6 +38,7 @@
 #define DEBUG_SUBSYSTEM S_OSD
 
 #include <linux/module.h>
+#include <linux/kthread.h>
 
 /*
  * struct OBD_{ALLOC,FREE}*()
@@ -59,6 +60,14 @@ unsigned int osd_oi_count = OSD_OI_FID_NR;
 module_param(osd_oi_count, int, 0444);
 MODULE_PARM_DESC(osd_oi_count, "Number of Object Index containers to be created, it's only valid for new filesystem.");
 
+static unsigned int osd_oi_cache_size = 262144;
+module_param(osd_oi_cache_size, uint, 0444);
+MODULE_PARM_DESC(osd_oi_cache_size, "Number of OI mappings cached per MDT, 0 to disable the cache");
+
+static bool osd_oi_cache_warmup;
+module_param(osd_oi_cache_warmup, bool, 0644);
+MODULE_PARM_DESC(osd_oi_cache_warmup, "Preload at mount the OI mappings cached at the last umount");
+
 static struct dt_index_features oi_feat = {
 	.dif_flags       = DT_IND_UPDATE,
 	.dif_recsize_min = sizeof(struct osd_inode_id),
@@ -387,6 +396,392 @@ static int osd_remove_ois(struct osd_thread_info *info, struct osd_device *osd)
 	return rc;
 }
 
+static const char osd_oi_cache_name[] = "OI_cache";
+
+#define OSD_OI_CACHE_MAGIC	0x0C1CAC4E
+/* FIDs read or written at once in OI_cache */
+#define OSD_OI_CACHE_BATCH	256
+
+/* OI_cache file: the header, then the little-endian FIDs */
+struct osd_oi_cache_header {
+	__u32	ooch_magic;
+	__u32	ooch_count;
+};
+
+static inline unsigned int osd_oi_cache_slot(struct osd_oi_cache *ooc,
+					     const struct lu_fid *fid)
+{
+	return fid_hash(fid, ooc->ooc_bits);
+}
+
+static inline spinlock_t *osd_oi_cache_lock(struct osd_oi_cache *ooc,
+					    unsigned int slot)
+{
+	return &ooc->ooc_locks[slot & (OSD_OI_CACHE_LOCKS - 1)];
+}
+
+static inline void osd_oi_cache_entry_free(struct osd_oi_cache_entry *ooce)
+{
+	OBD_FREE_PRE(ooce, sizeof(*ooce), "kfree_rcu");
+	kfree_rcu(ooce, ooce_rcu);
+}
+
+static bool osd_oi_cache_lookup(struct osd_device *osd,
+				const struct lu_fid *fid,
+				struct osd_inode_id *id)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	struct osd_oi_cache_entry *ooce;
+	bool found = false;
+
+	rcu_read_lock();
+	ooce = rcu_dereference(ooc->ooc_slots[osd_oi_cache_slot(ooc, fid)]);
+	if (ooce != NULL && lu_fid_eq(&ooce->ooce_fid, fid)) {
+		*id = ooce->ooce_id;
+		found = true;
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+
+/* to be sampled before looking the FID up in the OI */
+static inline unsigned int osd_oi_cache_gen(struct osd_oi_cache *ooc,
+					    const struct lu_fid *fid)
+{
+	unsigned int gen;
+
+	gen = READ_ONCE(ooc->ooc_gens[osd_oi_cache_slot(ooc, fid)]);
+	smp_rmb();
+	return gen;
+}
+
+static void osd_oi_cache_insert(struct osd_device *osd,
+				const struct lu_fid *fid,
+				const struct osd_inode_id *id, unsigned int gen)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	unsigned int slot = osd_oi_cache_slot(ooc, fid);
+	struct osd_oi_cache_entry *ooce;
+	struct osd_oi_cache_entry *old;
+
+	OBD_ALLOC_PTR(ooce);
+	if (ooce == NULL)
+		return;
+
+	ooce->ooce_fid = *fid;
+	ooce->ooce_id = *id;
+
+	spin_lock(osd_oi_cache_lock(ooc, slot));
+	/* the mapping changed since it was looked up */
+	if (ooc->ooc_gens[slot] != gen) {
+		spin_unlock(osd_oi_cache_lock(ooc, slot));
+		OBD_FREE_PTR(ooce);
+		return;
+	}
+	old = rcu_dereference_protected(ooc->ooc_slots[slot], 1);
+	rcu_assign_pointer(ooc->ooc_slots[slot], ooce);
+	spin_unlock(osd_oi_cache_lock(ooc, slot));
+
+	if (old != NULL)
+		osd_oi_cache_entry_free(old);
+}
+
+/* called once the OI mapping of \a fid was changed */
+static void osd_oi_cache_invalidate(struct osd_device *osd,
+				    const struct lu_fid *fid)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	struct osd_oi_cache_entry *old;
+	unsigned int slot;
+
+	if (ooc == NULL)
+		return;
+
+	slot = osd_oi_cache_slot(ooc, fid);
+	spin_lock(osd_oi_cache_lock(ooc, slot));
+	ooc->ooc_gens[slot]++;
+	old = rcu_dereference_protected(ooc->ooc_slots[slot], 1);
+	if (old != NULL && lu_fid_eq(&old->ooce_fid, fid))
+		RCU_INIT_POINTER(ooc->ooc_slots[slot], NULL);
+	else
+		old = NULL;
+	spin_unlock(osd_oi_cache_lock(ooc, slot));
+
+	if (old != NULL)
+		osd_oi_cache_entry_free(old);
+}
+
+static int osd_oi_cache_init(struct osd_device *osd)
+{
+	struct osd_oi_cache *ooc;
+	unsigned int nr;
+	int i;
+
+	/* OST objects are not in the OI files */
+	if (osd_oi_cache_size == 0 || osd->od_is_ost)
+		return 0;
+
+	OBD_ALLOC_PTR(ooc);
+	if (ooc == NULL)
+		return -ENOMEM;
+
+	ooc->ooc_bits = ilog2(size_roundup_power2(osd_oi_cache_size));
+	nr = 1U << ooc->ooc_bits;
+	OBD_ALLOC_PTR_ARRAY_LARGE(ooc->ooc_slots, nr);
+	OBD_ALLOC_PTR_ARRAY_LARGE(ooc->ooc_gens, nr);
+	if (ooc->ooc_slots == NULL || ooc->ooc_gens == NULL) {
+		if (ooc->ooc_slots != NULL)
+			OBD_FREE_PTR_ARRAY_LARGE(ooc->ooc_slots, nr);
+		if (ooc->ooc_gens != NULL)
+			OBD_FREE_PTR_ARRAY_LARGE(ooc->ooc_gens, nr);
+		OBD_FREE_PTR(ooc);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < OSD_OI_CACHE_LOCKS; i++)
+		spin_lock_init(&ooc->ooc_locks[i]);
+
+	osd->od_oi_cache = ooc;
+	return 0;
+}
+
+static void osd_oi_cache_fini(struct osd_device *osd)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	unsigned int nr;
+	unsigned int i;
+
+	if (ooc == NULL)
+		return;
+
+	osd_oi_cache_stop(osd);
+	osd->od_oi_cache = NULL;
+
+	nr = 1U << ooc->ooc_bits;
+	for (i = 0; i < nr; i++) {
+		struct osd_oi_cache_entry *ooce;
+
+		ooce = rcu_dereference_protected(ooc->ooc_slots[i], 1);
+		if (ooce != NULL)
+			osd_oi_cache_entry_free(ooce);
+	}
+	/* wait for the lookups which may still see the cache */
+	synchronize_rcu();
+
+	OBD_FREE_PTR_ARRAY_LARGE(ooc->ooc_slots, nr);
+	OBD_FREE_PTR_ARRAY_LARGE(ooc->ooc_gens, nr);
+	OBD_FREE_PTR(ooc);
+}
+
+/*
+ * Save the FIDs in the cache to OI_cache, those are the objects most recently
+ * used. osd_oi_cache_warmup_main() looks them up again at the next mount.
+ */
+static void osd_oi_cache_save(struct osd_thread_info *info,
+			      struct osd_device *osd)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	struct lvfs_run_ctxt *ctxt = &osd->od_scrub.os_ctxt;
+	struct osd_oi_cache_header hdr = { 0 };
+	struct lu_fid *fid = &info->oti_fid3;
+	struct lvfs_run_ctxt saved;
+	struct lu_fid *fids;
+	struct file *filp;
+	unsigned int nr = 1U << ooc->ooc_bits;
+	unsigned int slot = 0;
+	loff_t pos = sizeof(hdr);
+	ssize_t rc = 0;
+
+	if (osd->od_dt_dev.dd_rdonly || ctxt->pwdmnt == NULL)
+		return;
+
+	/* keep the last list if nothing was cached, e.g. failed mount */
+	while (slot < nr && rcu_access_pointer(ooc->ooc_slots[slot]) == NULL)
+		slot++;
+	if (slot == nr)
+		return;
+
+	OBD_ALLOC_PTR_ARRAY(fids, OSD_OI_CACHE_BATCH);
+	if (fids == NULL)
+		return;
+
+	push_ctxt(&saved, ctxt);
+	filp = filp_open(osd_oi_cache_name, O_WRONLY | O_CREAT | O_TRUNC,
+			 0644);
+	pop_ctxt(&saved, ctxt);
+	if (IS_ERR(filp)) {
+		rc = PTR_ERR(filp);
+		goto out;
+	}
+
+	/* like OI_scrub, the file is only visible inside the OSD */
+	lu_igif_build(fid, file_inode(filp)->i_ino,
+		      file_inode(filp)->i_generation);
+	rc = osd_ea_fid_set(info, file_inode(filp), fid, LMAC_NOT_IN_OI, 0);
+
+	while (rc >= 0 && slot < nr) {
+		unsigned int count = 0;
+
+		rcu_read_lock();
+		for (; slot < nr && count < OSD_OI_CACHE_BATCH; slot++) {
+			struct osd_oi_cache_entry *ooce;
+
+			ooce = rcu_dereference(ooc->ooc_slots[slot]);
+			if (ooce != NULL)
+				fid_cpu_to_le(&fids[count++],
+					      &ooce->ooce_fid);
+		}
+		rcu_read_unlock();
+
+		if (count == 0)
+			continue;
+
+		rc = cfs_kernel_write(filp, fids, count * sizeof(*fids), &pos);
+		hdr.ooch_count += count;
+	}
+
+	if (rc >= 0) {
+		hdr.ooch_magic = cpu_to_le32(OSD_OI_CACHE_MAGIC);
+		hdr.ooch_count = cpu_to_le32(hdr.ooch_count);
+		pos = 0;
+		rc = cfs_kernel_write(filp, &hdr, sizeof(hdr), &pos);
+	}
+	filp_close(filp, NULL);
+out:
+	if (rc < 0)
+		CDEBUG(D_INODE, "%s: cannot save %s: rc = %zd\n",
+		       osd_dev2name(osd), osd_oi_cache_name, rc);
+	OBD_FREE_PTR_ARRAY(fids, OSD_OI_CACHE_BATCH);
+}
+
+static int osd_oi_iam_lookup_fid(struct osd_thread_info *info,
+				 struct osd_device *osd,
+				 const struct lu_fid *fid,
+				 struct osd_inode_id *id);
+
+/*
+ * Look the FIDs saved in OI_cache up, so that the OI blocks on their path
+ * are read and the mappings cached before the clients need them.
+ */
+static int osd_oi_cache_warmup_main(void *args)
+{
+	struct osd_device *osd = args;
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	struct lvfs_run_ctxt *ctxt = &osd->od_scrub.os_ctxt;
+	struct osd_oi_cache_header hdr;
+	struct osd_thread_info *info;
+	struct lvfs_run_ctxt saved;
+	struct lu_fid *fids = NULL;
+	struct file *filp;
+	struct lu_env env;
+	unsigned int loaded = 0;
+	unsigned int count;
+	loff_t pos = 0;
+	ssize_t rc;
+
+	rc = lu_env_init(&env, LCT_LOCAL | LCT_DT_THREAD);
+	if (rc != 0)
+		goto out;
+
+	info = osd_oti_get(&env);
+	push_ctxt(&saved, ctxt);
+	filp = filp_open(osd_oi_cache_name, O_RDONLY, 0);
+	pop_ctxt(&saved, ctxt);
+	if (IS_ERR(filp)) {
+		rc = PTR_ERR(filp);
+		goto out_env;
+	}
+
+	rc = cfs_kernel_read(filp, &hdr, sizeof(hdr), &pos);
+	if (rc != sizeof(hdr) ||
+	    le32_to_cpu(hdr.ooch_magic) != OSD_OI_CACHE_MAGIC)
+		GOTO(out_close, rc = rc < 0 ? rc : -EINVAL);
+
+	OBD_ALLOC_PTR_ARRAY(fids, OSD_OI_CACHE_BATCH);
+	if (fids == NULL)
+		GOTO(out_close, rc = -ENOMEM);
+
+	count = min(le32_to_cpu(hdr.ooch_count), 1U << ooc->ooc_bits);
+	while (loaded < count && !kthread_should_stop()) {
+		int nr = min_t(unsigned int, count - loaded,
+			       OSD_OI_CACHE_BATCH);
+		int i;
+
+		rc = cfs_kernel_read(filp, fids, nr * sizeof(*fids), &pos);
+		if (rc < (ssize_t)sizeof(*fids))
+			break;
+
+		nr = rc / sizeof(*fids);
+		for (i = 0; i < nr && !kthread_should_stop(); i++) {
+			struct lu_fid *fid = &info->oti_fid3;
+			struct osd_inode_id *id = &info->oti_id3;
+			unsigned int gen;
+
+			fid_le_to_cpu(fid, &fids[i]);
+			if (!fid_is_sane(fid) || osd_oi_cache_lookup(osd, fid,
+								     id))
+				continue;
+
+			gen = osd_oi_cache_gen(ooc, fid);
+			if (osd_oi_iam_lookup_fid(info, osd, fid, id) == 0)
+				osd_oi_cache_insert(osd, fid, id, gen);
+			cond_resched();
+		}
+		loaded += nr;
+	}
+	rc = 0;
+	CDEBUG(D_INODE, "%s: preloaded %u/%u OI mappings\n",
+	       osd_dev2name(osd), loaded, count);
+
+out_close:
+	if (fids != NULL)
+		OBD_FREE_PTR_ARRAY(fids, OSD_OI_CACHE_BATCH);
+	filp_close(filp, NULL);
+out_env:
+	lu_env_fini(&env);
+out:
+	if (rc < 0 && rc != -ENOENT)
+		CDEBUG(D_INODE, "%s: cannot load %s: rc = %zd\n",
+		       osd_dev2name(osd), osd_oi_cache_name, rc);
+	/* osd_oi_cache_stop() releases the task */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static void osd_oi_cache_warmup_start(struct osd_device *osd)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	struct task_struct *task;
+
+	if (ooc == NULL || !osd_oi_cache_warmup)
+		return;
+
+	task = kthread_run(osd_oi_cache_warmup_main, osd, "oi_warmup-%s",
+			   osd_dev2name(osd));
+	if (IS_ERR(task)) {
+		CWARN("%s: cannot start OI cache warmup: rc = %ld\n",
+		      osd_dev2name(osd), PTR_ERR(task));
+		return;
+	}
+	ooc->ooc_warmup_task = task;
+}
+
+void osd_oi_cache_stop(struct osd_device *osd)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+
+	if (ooc != NULL && ooc->ooc_warmup_task != NULL) {
+		kthread_stop(ooc->ooc_warmup_task);
+		ooc->ooc_warmup_task = NULL;
+	}
+}
+
 int osd_oi_init(struct osd_thread_info *info, struct osd_device *osd,
 		bool restored)
 {
@@ -512,6 +907,10 @@ out:
 		}
 	}
 
+	/* the cache is only an optimization, run without it */
+	if (rc == 0 && osd_oi_cache_init(osd) == 0)
+		osd_oi_cache_warmup_start(osd);
+
 	return rc;
 }
 
@@ -520,6 +919,12 @@ void osd_oi_fini(struct osd_thread_info *info, struct osd_device *osd)
 	if (unlikely(!osd->od_oi_table))
 		return;
 
+	if (osd->od_oi_cache != NULL) {
+		osd_oi_cache_stop(osd);
+		osd_oi_cache_save(info, osd);
+		osd_oi_cache_fini(osd);
+	}
+
 	osd_oi_table_put(info, osd->od_oi_table, osd->od_oi_count);
 
 	OBD_FREE_PTR_ARRAY(osd->od_oi_table, OSD_OI_FID_NR_MAX);
@@ -613,8 +1018,10 @@ int fid_is_on_ost(struct osd_thread_info *info, struct osd_device *osd,
 	RETURN(0);
 }
 
-static int __osd_oi_lookup(struct osd_thread_info *info, struct osd_device *osd,
-			   const struct lu_fid *fid, struct osd_inode_id *id)
+static int osd_oi_iam_lookup_fid(struct osd_thread_info *info,
+				 struct osd_device *osd,
+				 const struct lu_fid *fid,
+				 struct osd_inode_id *id)
 {
 	struct lu_fid *oi_fid = &info->oti_fid2;
 	int rc;
@@ -631,6 +1038,29 @@ static int __osd_oi_lookup(struct osd_thread_info *info, struct osd_device *osd,
 	return rc;
 }
 
+static int __osd_oi_lookup(struct osd_thread_info *info, struct osd_device *osd,
+			   const struct lu_fid *fid, struct osd_inode_id *id)
+{
+	struct osd_oi_cache *ooc = osd->od_oi_cache;
+	unsigned int gen;
+	int rc;
+
+	if (ooc == NULL)
+		return osd_oi_iam_lookup_fid(info, osd, fid, id);
+
+	if (osd_oi_cache_lookup(osd, fid, id)) {
+		lprocfs_counter_incr(osd->od_stats, LPROC_OSD_OI_CACHE_HIT);
+		return 0;
+	}
+
+	lprocfs_counter_incr(osd->od_stats, LPROC_OSD_OI_CACHE_MISS);
+	gen = osd_oi_cache_gen(ooc, fid);
+	rc = osd_oi_iam_lookup_fid(info, osd, fid, id);
+	if (rc == 0)
+		osd_oi_cache_insert(osd, fid, id, gen);
+	return rc;
+}
+
 int osd_oi_lookup(struct osd_thread_info *info, struct osd_device *osd,
 		  const struct lu_fid *fid, struct osd_inode_id *id,
 		  enum oi_check_flags flags)
@@ -719,6 +1149,7 @@ int osd_oi_insert(struct osd_thread_info *info, struct osd_device *osd,
 	rc = osd_oi_iam_refresh(info, osd_fid2oi(osd, fid),
 			       (const struct dt_rec *)oi_id,
 			       (const struct dt_key *)oi_fid, th, true);
+	osd_oi_cache_invalidate(osd, fid);
 	if (rc != 0) {
 		struct inode *inode;
 		struct lustre_mdt_attrs *lma = &info->oti_ost_attrs.loa_lma;
@@ -766,6 +1197,7 @@ update:
 					(const struct dt_rec *)oi_id,
 					(const struct dt_key *)oi_fid, th,
 					false);
+		osd_oi_cache_invalidate(osd, fid);
 		if (rc != 0)
 			return rc;
 
@@ -809,6 +1241,7 @@ int osd_oi_delete(struct osd_thread_info *info,
 		  handle_t *th, enum oi_check_flags flags)
 {
 	struct lu_fid *oi_fid = &info->oti_fid2;
+	int rc;
 
 	CDEBUG(D_INODE, "delete OI for "DFID"\n", PFID(fid));
 
@@ -823,8 +1256,10 @@ int osd_oi_delete(struct osd_thread_info *info,
 		return osd_obj_map_delete(info, osd, fid, th);
 
 	fid_cpu_to_be(oi_fid, fid);
-	return osd_oi_iam_delete(info, osd_fid2oi(osd, fid),
-				 (const struct dt_key *)oi_fid, th);
+	rc = osd_oi_iam_delete(info, osd_fid2oi(osd, fid),
+			       (const struct dt_key *)oi_fid, th);
+	osd_oi_cache_invalidate(osd, fid);
+	return rc;
 }
 
 int osd_oi_update(struct osd_thread_info *info, struct osd_device *osd,
@@ -848,6 +1283,7 @@ int osd_oi_update(struct osd_thread_info *info, struct osd_device *osd,
 	rc = osd_oi_iam_refresh(info, osd_fid2oi(osd, fid),
 			       (const struct dt_rec *)oi_id,
 			       (const struct dt_key *)oi_fid, th, false);
+	osd_oi_cache_invalidate(osd, fid);
 	if (rc != 0)
 		return rc;
 
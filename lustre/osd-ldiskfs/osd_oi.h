@@ -127,6 +127,30 @@ static inline int osd_id_eq_strict(const struct osd_inode_id *id0,
 	return (id0->oii_ino == id1->oii_ino && id0->oii_gen == id1->oii_gen);
 }
 
+/*
+ * FID to inode mappings found in the OI files, shared by all the threads of
+ * the device. The cache is direct mapped with a bounded number of slots, a
+ * new mapping replaces the one in its slot. Lookups are lockless under RCU.
+ */
+struct osd_oi_cache_entry {
+	struct lu_fid		ooce_fid;
+	struct osd_inode_id	ooce_id;
+	struct rcu_head		ooce_rcu;
+};
+
+#define OSD_OI_CACHE_LOCKS	64
+
+struct osd_oi_cache {
+	struct osd_oi_cache_entry __rcu	**ooc_slots;
+	/* bumped when the OI changes for a FID of the slot, so that a racing
+	 * lookup doesn't cache the old mapping */
+	unsigned int			 *ooc_gens;
+	unsigned int			  ooc_bits;
+	spinlock_t			  ooc_locks[OSD_OI_CACHE_LOCKS];
+	/* preloads the FIDs cached at the last umount */
+	struct task_struct		 *ooc_warmup_task;
+};
+
 enum oi_check_flags {
 	OI_CHECK_FLD	= 0x00000001,
 	OI_KNOWN_ON_OST	= 0x00000002,
@@ -139,6 +163,7 @@ int osd_oi_mod_init(void);
 int osd_oi_init(struct osd_thread_info *info, struct osd_device *osd,
 		bool restored);
 void osd_oi_fini(struct osd_thread_info *info, struct osd_device *osd);
+void osd_oi_cache_stop(struct osd_device *osd);
 int  osd_oi_lookup(struct osd_thread_info *info, struct osd_device *osd,
 		   const struct lu_fid *fid, struct osd_inode_id *id,
 		   enum oi_check_flags flags);
@@ -38,6 +38,7 @@
 #define DEBUG_SUBSYSTEM S_LFSCK
 
 #include <linux/kthread.h>
+#include <linux/sort.h>
 #include <uapi/linux/lustre/lustre_idl.h>
 #include <lustre_disk.h>
 #include <dt_object.h>
@@ -51,6 +52,10 @@
 
 #define OSD_OTABLE_MAX_HASH		0x00000000ffffffffULL
 
+static unsigned int osd_scrub_bulk_threads = 4;
+module_param(osd_scrub_bulk_threads, uint, 0644);
+MODULE_PARM_DESC(osd_scrub_bulk_threads, "Number of threads to rebuild the recreated OI files in parallel, 0 to scan inodes by the OI scrub thread only");
+
 /* high priority inconsistent items list APIs */
 #define SCRUB_BAD_OIMAP_DECAY_INTERVAL	60
 
@@ -1197,6 +1202,460 @@ static int osd_otable_it_preload(const struct lu_env *env,
 	RETURN(rc < 0 ? rc : ooc->ooc_cached_items);
 }
 
+/* parallel OI rebuild */
+
+static int osd_scrub_pair_cmp(const void *a, const void *b)
+{
+	const struct osd_scrub_pair *p1 = a;
+	const struct osd_scrub_pair *p2 = b;
+
+	return lu_fid_cmp(&p1->osp_fid, &p2->osp_fid);
+}
+
+static void osd_scrub_bulk_fail(struct osd_scrub_worker *osw, __u32 ino)
+{
+	osw->osw_failed++;
+	if (osw->osw_first_inconsistent == 0 ||
+	    osw->osw_first_inconsistent > ino)
+		osw->osw_first_inconsistent = ino;
+}
+
+/**
+ * Insert the collected OI mappings, then merge the thread statistics
+ * into the scrub file.
+ *
+ * The pairs are sorted by FID, that groups them per OI file and inserts
+ * them in the key order, so consecutive inserts hit the same IAM leaf and
+ * index blocks, and the journal handle is shared by several inserts.
+ *
+ * \param[in] pos	the position the thread has scanned up to
+ */
+static int osd_scrub_bulk_flush(struct osd_thread_info *info,
+				struct osd_scrub_worker *osw, __u64 pos)
+{
+	struct osd_device *dev = osw->osw_bulk->osb_dev;
+	struct osd_scrub *oscrub = &dev->od_scrub;
+	struct lustre_scrub *scrub = &oscrub->os_scrub;
+	struct scrub_file *sf = &scrub->os_file;
+	handle_t *th = NULL;
+	__u32 inserted = 0;
+	__u32 nr = 0;
+	__u32 i;
+	int rc = 0;
+
+	if (osw->osw_count > 1)
+		sort(osw->osw_pairs, osw->osw_count, sizeof(*osw->osw_pairs),
+		     osd_scrub_pair_cmp, NULL);
+
+	for (i = 0; i < osw->osw_count; i++) {
+		struct osd_scrub_pair *osp = &osw->osw_pairs[i];
+		bool exist = false;
+
+		if (th == NULL) {
+			th = osd_journal_start_sb(osd_sb(dev), LDISKFS_HT_MISC,
+				osd_dto_credits_noquota[DTO_INDEX_INSERT] *
+				OSD_SCRUB_BULK_TXN);
+			if (IS_ERR(th)) {
+				rc = PTR_ERR(th);
+				th = NULL;
+				CDEBUG(D_LFSCK, "%s: fail to start trans for OI rebuild: rc = %d\n",
+				       osd_dev2name(dev), rc);
+				break;
+			}
+		}
+
+		rc = osd_oi_insert(info, dev, &osp->osp_fid, &osp->osp_id, th,
+				   0, &exist);
+		if (rc == 0) {
+			osw->osw_updated++;
+			inserted++;
+			if (!exist) {
+				int idx = osd_oi_fid2idx(dev, &osp->osp_fid);
+
+				ldiskfs_set_bit(idx, osw->osw_oi_bitmap);
+			}
+		} else if (rc < 0) {
+			CDEBUG(D_LFSCK, "%s: fail to insert OI "DFID" -> %u/%u: rc = %d\n",
+			       osd_dev2name(dev), PFID(&osp->osp_fid),
+			       osp->osp_id.oii_ino, osp->osp_id.oii_gen, rc);
+			osd_scrub_bulk_fail(osw, osp->osp_id.oii_ino);
+			if (sf->sf_param & SP_FAILOUT)
+				break;
+		}
+		rc = 0;
+
+		if (++nr == OSD_SCRUB_BULK_TXN) {
+			ldiskfs_journal_stop(th);
+			th = NULL;
+			nr = 0;
+		}
+	}
+
+	if (th != NULL)
+		ldiskfs_journal_stop(th);
+
+	down_write(&scrub->os_rwsem);
+	scrub->os_new_checked += osw->osw_checked;
+	sf->sf_items_noscrub += osw->osw_noscrub;
+	sf->sf_items_updated += osw->osw_updated;
+	sf->sf_items_failed += osw->osw_failed;
+	if (osw->osw_first_inconsistent != 0 &&
+	    (sf->sf_pos_first_inconsistent == 0 ||
+	     sf->sf_pos_first_inconsistent > osw->osw_first_inconsistent))
+		sf->sf_pos_first_inconsistent = osw->osw_first_inconsistent;
+	for (i = 0; i < SCRUB_OI_BITMAP_SIZE; i++)
+		sf->sf_oi_bitmap[i] |= osw->osw_oi_bitmap[i];
+	up_write(&scrub->os_rwsem);
+
+	if (osw->osw_count > 0)
+		atomic64_inc(&oscrub->os_bulk_batches);
+	atomic64_add(inserted, &oscrub->os_bulk_inserted);
+	osw->osw_checked = 0;
+	osw->osw_noscrub = 0;
+	osw->osw_updated = 0;
+	osw->osw_failed = 0;
+	osw->osw_first_inconsistent = 0;
+	memset(osw->osw_oi_bitmap, 0, sizeof(osw->osw_oi_bitmap));
+
+	if (rc == 0) {
+		osw->osw_count = 0;
+		WRITE_ONCE(osw->osw_pos, pos);
+	}
+
+	return rc;
+}
+
+/**
+ * Scan the inodes of the given block group, collect the (FID, ino#) pairs
+ * for the objects only missing the OI mapping, and let the objects need to
+ * be converted or verified go through the regular OI scrub checks.
+ */
+static int osd_scrub_bulk_group(struct osd_thread_info *info,
+				struct osd_scrub_worker *osw,
+				ldiskfs_group_t bg)
+{
+	struct osd_scrub_bulk *osb = osw->osw_bulk;
+	struct osd_device *dev = osb->osb_dev;
+	struct lustre_scrub *scrub = &dev->od_scrub.os_scrub;
+	struct super_block *sb = osd_sb(dev);
+	__u32 ipg = LDISKFS_INODES_PER_GROUP(sb);
+	__u32 gbase = 1 + bg * ipg;
+	struct ldiskfs_group_desc *desc;
+	struct buffer_head *bitmap;
+	__u32 offset = 0;
+	__u32 end;
+	int rc = 0;
+
+	if (gbase < osb->osb_start)
+		offset = osb->osb_start - gbase;
+	if (osw->osw_count == 0)
+		WRITE_ONCE(osw->osw_pos, gbase + offset);
+
+	desc = ldiskfs_get_group_desc(sb, bg, NULL);
+	if (!desc)
+		return -EIO;
+
+	if (desc->bg_flags & cpu_to_le16(LDISKFS_BG_INODE_UNINIT))
+		goto out;
+
+	bitmap = ldiskfs_read_inode_bitmap(sb, bg);
+	if (IS_ERR_OR_NULL(bitmap)) {
+		rc = bitmap ? PTR_ERR(bitmap) : -EIO;
+		CERROR("%s: fail to read bitmap for %u, OI rebuild will stop: rc = %d\n",
+		       osd_scrub2name(scrub), (__u32)bg, rc);
+		return rc;
+	}
+
+	end = ipg - ldiskfs_itable_unused_count(sb, desc);
+	while (!kthread_should_stop() && !READ_ONCE(osb->osb_rc)) {
+		struct osd_scrub_pair *osp = &osw->osw_pairs[osw->osw_count];
+		__u32 pos;
+
+		offset = ldiskfs_find_next_bit(bitmap->b_data, end, offset);
+		if (offset >= end)
+			break;
+
+		pos = gbase + offset++;
+		rc = osd_iit_iget(info, dev, &osp->osp_fid, &osp->osp_id, pos,
+				  sb, true);
+		switch (rc) {
+		case SCRUB_NEXT_CONTINUE:
+			rc = 0;
+			continue;
+		case SCRUB_NEXT_NOSCRUB:
+			osw->osw_checked++;
+			osw->osw_noscrub++;
+			rc = 0;
+			continue;
+		case 0:
+			osw->osw_checked++;
+			if (osw->osw_count++ == 0)
+				WRITE_ONCE(osw->osw_pos, pos);
+			if (osw->osw_count == OSD_SCRUB_BULK_BATCH)
+				rc = osd_scrub_bulk_flush(info, osw, pos + 1);
+			break;
+		default:
+			osw->osw_oic.oic_fid = osp->osp_fid;
+			osw->osw_oic.oic_lid = osp->osp_id;
+			osw->osw_oic.oic_dev = dev;
+			mutex_lock(&osb->osb_update_mutex);
+			rc = osd_scrub_check_update(info, dev, &osw->osw_oic,
+						    rc);
+			mutex_unlock(&osb->osb_update_mutex);
+			break;
+		}
+		if (rc)
+			break;
+	}
+	brelse(bitmap);
+
+	/* stopped in the middle of the group */
+	if (rc || offset < end)
+		return rc;
+
+out:
+	if (osw->osw_count == 0)
+		WRITE_ONCE(osw->osw_pos, gbase + ipg);
+	atomic_inc(&dev->od_scrub.os_bulk_groups_done);
+
+	return 0;
+}
+
+static int osd_scrub_bulk_main(void *args)
+{
+	struct osd_scrub_worker *osw = args;
+	struct osd_scrub_bulk *osb = osw->osw_bulk;
+	struct osd_thread_info *info;
+	struct lu_env env;
+	bool all = false;
+	int rc;
+
+	rc = lu_env_init(&env, LCT_LOCAL | LCT_DT_THREAD);
+	if (rc != 0)
+		GOTO(out, rc);
+
+	info = osd_oti_get(&env);
+	while (!kthread_should_stop() && !READ_ONCE(osb->osb_rc)) {
+		ldiskfs_group_t bg = atomic_inc_return(&osb->osb_next_bg) - 1;
+
+		if (bg >= osb->osb_groups) {
+			all = true;
+			break;
+		}
+
+		rc = osd_scrub_bulk_group(info, osw, bg);
+		if (rc != 0)
+			break;
+	}
+
+	/* Keep osw_pos if stopped, the pairs will be collected again by the
+	 * next run from the checkpoint. */
+	if (all && !kthread_should_stop()) {
+		rc = osd_scrub_bulk_flush(info, osw, ~0ULL);
+		if (rc == 0)
+			WRITE_ONCE(osw->osw_pos, ~0ULL);
+	}
+	lu_env_fini(&env);
+
+out:
+	if (rc < 0)
+		cmpxchg(&osb->osb_rc, 0, rc);
+	atomic_dec(&osb->osb_running);
+	wake_up_var(osb);
+	/* osd_scrub_bulk_rebuild() will stop us */
+	wait_var_event(osb, kthread_should_stop());
+
+	return rc;
+}
+
+/* All inodes before the returned position have been processed. */
+static __u64 osd_scrub_bulk_pos(struct osd_scrub_bulk *osb)
+{
+	__u64 pos = ~0ULL;
+	unsigned int i;
+
+	for (i = 0; i < osb->osb_nr_workers; i++)
+		pos = min_t(__u64, pos, READ_ONCE(osb->osb_workers[i].osw_pos));
+
+	return pos;
+}
+
+/* Fix the inconsistent OI mappings found by others during the rebuild. */
+static void osd_scrub_bulk_prior(struct osd_thread_info *info,
+				 struct osd_scrub_bulk *osb)
+{
+	struct osd_device *dev = osb->osb_dev;
+	struct lustre_scrub *scrub = &dev->od_scrub.os_scrub;
+	struct osd_inconsistent_item *oii;
+
+	while (!list_empty(&scrub->os_inconsistent_items)) {
+		mutex_lock(&osb->osb_update_mutex);
+		spin_lock(&scrub->os_lock);
+		if (list_empty(&scrub->os_inconsistent_items)) {
+			spin_unlock(&scrub->os_lock);
+			mutex_unlock(&osb->osb_update_mutex);
+			break;
+		}
+
+		oii = list_first_entry(&scrub->os_inconsistent_items,
+				       struct osd_inconsistent_item, oii_list);
+		scrub->os_in_prior = 1;
+		spin_unlock(&scrub->os_lock);
+
+		osd_scrub_check_update(info, dev, &oii->oii_cache, 0);
+
+		spin_lock(&scrub->os_lock);
+		scrub->os_in_prior = 0;
+		spin_unlock(&scrub->os_lock);
+		mutex_unlock(&osb->osb_update_mutex);
+	}
+}
+
+static bool osd_scrub_bulk_wanted(struct osd_device *dev)
+{
+	struct lustre_scrub *scrub = &dev->od_scrub.os_scrub;
+	struct scrub_file *sf = &scrub->os_file;
+
+	return osd_scrub_bulk_threads > 0 && scrub->os_full_speed &&
+	       !scrub->os_partial_scan && !dev->od_otable_it &&
+	       sf->sf_flags & SF_RECREATED && !(sf->sf_param & SP_DRYRUN);
+}
+
+/**
+ * Rebuild the recreated OI files with several threads.
+ *
+ * Each thread scans the block groups one by one and inserts the OI mappings
+ * in batches, so that the inode table and xattr reads of the groups are
+ * done in parallel instead of one object after another. The OI scrub
+ * thread itself handles the inconsistent items and the checkpoints, the
+ * position of the checkpoint is the lowest one not yet processed by all
+ * the threads.
+ *
+ * \retval	0 if all the inodes have been processed, or the scrub has
+ *		been stopped
+ * \retval	negative error number on failure
+ */
+static int osd_scrub_bulk_rebuild(struct osd_thread_info *info,
+				  struct osd_device *dev)
+{
+	struct osd_scrub *oscrub = &dev->od_scrub;
+	struct lustre_scrub *scrub = &oscrub->os_scrub;
+	struct super_block *sb = osd_sb(dev);
+	__u32 ipg = LDISKFS_INODES_PER_GROUP(sb);
+	ldiskfs_group_t groups = LDISKFS_SB(sb)->s_groups_count;
+	ldiskfs_group_t start_bg = (scrub->os_pos_current - 1) / ipg;
+	struct osd_scrub_bulk *osb;
+	struct task_struct *task;
+	unsigned int nr;
+	unsigned int i;
+	__u64 pos;
+	int rc = 0;
+	ENTRY;
+
+	if (start_bg >= groups)
+		RETURN(0);
+
+	nr = min_t(unsigned int, osd_scrub_bulk_threads, groups - start_bg);
+	OBD_ALLOC(osb, offsetof(struct osd_scrub_bulk, osb_workers[nr]));
+	if (!osb)
+		RETURN(-ENOMEM);
+
+	osb->osb_dev = dev;
+	mutex_init(&osb->osb_update_mutex);
+	atomic_set(&osb->osb_next_bg, start_bg);
+	atomic_set(&osb->osb_running, 0);
+	osb->osb_groups = groups;
+	osb->osb_start = scrub->os_pos_current;
+	osb->osb_nr_workers = nr;
+
+	oscrub->os_bulk_threads = nr;
+	oscrub->os_bulk_groups = groups;
+	atomic_set(&oscrub->os_bulk_groups_done, start_bg);
+	atomic64_set(&oscrub->os_bulk_inserted, 0);
+	atomic64_set(&oscrub->os_bulk_batches, 0);
+
+	for (i = 0; i < nr; i++) {
+		struct osd_scrub_worker *osw = &osb->osb_workers[i];
+
+		osw->osw_bulk = osb;
+		osw->osw_pos = osb->osb_start;
+	}
+
+	CDEBUG(D_LFSCK, "%s: OI rebuild start with %u threads, pos = %llu\n",
+	       osd_scrub2name(scrub), nr, osb->osb_start);
+
+	for (i = 0; i < nr; i++) {
+		struct osd_scrub_worker *osw = &osb->osb_workers[i];
+
+		OBD_ALLOC_LARGE(osw->osw_pairs,
+				OSD_SCRUB_BULK_BATCH * sizeof(*osw->osw_pairs));
+		if (!osw->osw_pairs)
+			GOTO(stop, rc = -ENOMEM);
+
+		atomic_inc(&osb->osb_running);
+		task = kthread_run(osd_scrub_bulk_main, osw, "OI_rebuild-%u",
+				   i);
+		if (IS_ERR(task)) {
+			atomic_dec(&osb->osb_running);
+			rc = PTR_ERR(task);
+			CERROR("%s: cannot start OI rebuild thread: rc = %d\n",
+			       osd_scrub2name(scrub), rc);
+			GOTO(stop, rc);
+		}
+		osw->osw_task = task;
+	}
+
+	while (atomic_read(&osb->osb_running) > 0) {
+		wait_var_event_timeout(osb,
+				       atomic_read(&osb->osb_running) == 0 ||
+				       kthread_should_stop() ||
+				       !list_empty(&scrub->os_inconsistent_items),
+				       cfs_time_seconds(1));
+		if (kthread_should_stop())
+			break;
+
+		osd_scrub_bulk_prior(info, osb);
+		scrub->os_pos_current = osd_scrub_bulk_pos(osb);
+		rc = scrub_checkpoint(info->oti_env, scrub);
+		if (rc) {
+			CDEBUG(D_LFSCK, "%s: fail to checkpoint, pos = %llu: rc = %d\n",
+			       osd_scrub2name(scrub), scrub->os_pos_current,
+			       rc);
+			/* Continue, as long as the rebuild can go ahead. */
+			rc = 0;
+		}
+	}
+
+	GOTO(stop, rc);
+
+stop:
+	for (i = 0; i < nr; i++) {
+		struct osd_scrub_worker *osw = &osb->osb_workers[i];
+
+		if (osw->osw_task)
+			kthread_stop(osw->osw_task);
+		if (osw->osw_pairs)
+			OBD_FREE_LARGE(osw->osw_pairs, OSD_SCRUB_BULK_BATCH *
+				       sizeof(*osw->osw_pairs));
+	}
+
+	if (rc == 0)
+		rc = osb->osb_rc;
+
+	pos = osd_scrub_bulk_pos(osb);
+	if (pos == ~0ULL)
+		pos = le32_to_cpu(LDISKFS_SB(sb)->s_es->s_inodes_count) + 1;
+	scrub->os_pos_current = pos;
+
+	CDEBUG(D_LFSCK, "%s: OI rebuild stop, inserted %lld, pos = %llu: rc = %d\n",
+	       osd_scrub2name(scrub),
+	       (long long)atomic64_read(&oscrub->os_bulk_inserted), pos, rc);
+
+	OBD_FREE(osb, offsetof(struct osd_scrub_bulk, osb_workers[nr]));
+
+	return rc;
+}
+
 static int osd_scan_ml_file_main(const struct lu_env *env,
 				 struct osd_device *dev);
 
@@ -1239,6 +1698,15 @@ static int osd_scrub_main(void *args)
 	       osd_scrub2name(scrub), scrub->os_start_flags,
 	       scrub->os_pos_current);
 
+	if (osd_scrub_bulk_wanted(dev)) {
+		rc = osd_scrub_bulk_rebuild(osd_oti_get(&env), dev);
+		if (rc < 0)
+			GOTO(post, rc);
+
+		if (kthread_should_stop())
+			GOTO(post, rc = 0);
+	}
+
 	rc = osd_inode_iteration(osd_oti_get(&env), dev, ~0U, false);
 	if (unlikely(rc == SCRUB_IT_CRASH)) {
 		spin_lock(&scrub->os_lock);
@@ -2994,6 +3462,16 @@ void osd_scrub_dump(struct seq_file *m, struct osd_device *dev)
 			"inconsistent" : "repaired",
 		   scrub->os_lf_repaired,
 		   scrub->os_lf_failed);
+	if (scrub->os_bulk_groups != 0)
+		seq_printf(m, "bulk_threads: %u\n"
+			   "bulk_groups: %u/%u\n"
+			   "bulk_inserted: %lld\n"
+			   "bulk_batches: %lld\n",
+			   scrub->os_bulk_threads,
+			   atomic_read(&scrub->os_bulk_groups_done),
+			   scrub->os_bulk_groups,
+			   (long long)atomic64_read(&scrub->os_bulk_inserted),
+			   (long long)atomic64_read(&scrub->os_bulk_batches));
 }
 
 typedef int (*scan_dir_helper_t)(const struct lu_env *env,
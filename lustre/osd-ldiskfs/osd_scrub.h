@@ -69,6 +69,57 @@ struct osd_scrub {
 
 	__u64			os_bad_oimap_count;
 	time64_t		os_bad_oimap_time;
+
+	/* statistics for the parallel OI rebuild, in ram only. */
+	__u32			os_bulk_threads;
+	__u32			os_bulk_groups;
+	atomic_t		os_bulk_groups_done;
+	atomic64_t		os_bulk_inserted;
+	atomic64_t		os_bulk_batches;
+};
+
+/* Max (FID, ino#) pairs collected by one rebuild thread before insert. */
+#define OSD_SCRUB_BULK_BATCH	4096
+/* Max OI inserts done by the rebuild thread under one transaction. */
+#define OSD_SCRUB_BULK_TXN	32
+
+struct osd_scrub_pair {
+	struct lu_fid		osp_fid;
+	struct osd_inode_id	osp_id;
+};
+
+struct osd_scrub_bulk;
+
+/* The thread scanning some block groups for the parallel OI rebuild. */
+struct osd_scrub_worker {
+	struct osd_scrub_bulk	*osw_bulk;
+	struct task_struct	*osw_task;
+	struct osd_scrub_pair	*osw_pairs;
+	__u32			 osw_count;
+	/* All inodes before this position have their OI mapping inserted. */
+	__u64			 osw_pos;
+	/* For the objects going through osd_scrub_check_update(). */
+	struct osd_idmap_cache	 osw_oic;
+	/* Statistics merged into the scrub_file when the batch is flushed. */
+	__u64			 osw_checked;
+	__u64			 osw_noscrub;
+	__u64			 osw_updated;
+	__u64			 osw_failed;
+	__u64			 osw_first_inconsistent;
+	__u8			 osw_oi_bitmap[SCRUB_OI_BITMAP_SIZE];
+};
+
+struct osd_scrub_bulk {
+	struct osd_device	*osb_dev;
+	/* serialize osd_scrub_check_update() among the rebuild threads. */
+	struct mutex		 osb_update_mutex;
+	atomic_t		 osb_next_bg;
+	atomic_t		 osb_running;
+	ldiskfs_group_t		 osb_groups;
+	__u64			 osb_start;
+	int			 osb_rc;
+	unsigned int		 osb_nr_workers;
+	struct osd_scrub_worker	 osb_workers[];
 };
 
 #endif /* _OSD_SCRUB_H */
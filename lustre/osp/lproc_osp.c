@@ -941,6 +941,76 @@ static ssize_t osp_rpc_stats_seq_write(struct file *file,
 }
 LDEBUGFS_SEQ_FOPS(osp_rpc_stats);
 
+/**
+ * Show create rate prediction and waits for precreated objects
+ *
+ * create_rate is the average number of objects reserved per second and
+ * rpc_time the average precreate RPC time, their product gives the objects
+ * to keep precreated, see osp_precreate_demand(). The stalls are the
+ * creations which had to wait for precreated objects.
+ *
+ * \param[in] m		seq_file handle
+ * \param[in] data	unused for single entry
+ *
+ * \retval		0 on success
+ */
+static int osp_prealloc_stats_seq_show(struct seq_file *m, void *data)
+{
+	struct obd_device *obd = m->private;
+	struct osp_device *osp = lu2osp_dev(obd->obd_lu_dev);
+
+	if (osp == NULL || osp->opd_pre == NULL)
+		return -EINVAL;
+
+	spin_lock(&osp->opd_pre_lock);
+	seq_printf(m, "create_rate: %u objs/s\n"
+		   "rpc_time: %u usecs\n"
+		   "demand: %d\n"
+		   "create_count: %d\n"
+		   "stalls: %llu\n"
+		   "stall_time: %llu usecs\n"
+		   "stall_max: %llu usecs\n",
+		   osp->opd_pre_rate, osp->opd_pre_rpc_time,
+		   osp_precreate_demand(osp), osp->opd_pre_create_count,
+		   osp->opd_pre_stalls,
+		   osp->opd_pre_stall_time, osp->opd_pre_stall_max);
+	spin_unlock(&osp->opd_pre_lock);
+
+	return 0;
+}
+
+/**
+ * Clear the stall counters
+ *
+ * \param[in] file	proc file
+ * \param[in] buffer	unused
+ * \param[in] count	\a buffer length
+ * \param[in] off	unused for single entry
+ *
+ * \retval		\a count on success
+ * \retval		negative number on error
+ */
+static ssize_t osp_prealloc_stats_seq_write(struct file *file,
+					    const char __user *buffer,
+					    size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct obd_device *obd = m->private;
+	struct osp_device *osp = lu2osp_dev(obd->obd_lu_dev);
+
+	if (osp == NULL || osp->opd_pre == NULL)
+		return -EINVAL;
+
+	spin_lock(&osp->opd_pre_lock);
+	osp->opd_pre_stalls = 0;
+	osp->opd_pre_stall_time = 0;
+	osp->opd_pre_stall_max = 0;
+	spin_unlock(&osp->opd_pre_lock);
+
+	return count;
+}
+LDEBUGFS_SEQ_FOPS(osp_prealloc_stats);
+
 /**
  * Show high watermark (in megabytes). If available free space at OST is greater
  * than high watermark and object allocation for OST is disabled, enable it.
@@ -1150,6 +1220,8 @@ static struct ldebugfs_vars ldebugfs_osp_obd_vars[] = {
 	  .fops =	&osp_import_fops		},
 	{ .name =	"state",
 	  .fops =	&osp_state_fops			},
+	{ .name =	"prealloc_stats",
+	  .fops =	&osp_prealloc_stats_fops	},
 	{ NULL }
 };
 
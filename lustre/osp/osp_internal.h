@@ -88,8 +88,27 @@ struct osp_precreate {
 					 osp_pre_recovering:1,
 	/* force new seq rollover */
 					 osp_pre_force_new_seq:1;
+
+	/*
+	 * Create rate prediction, see osp_precreate_demand()
+	 */
+
+	/* start of the current rate sample and objects used since */
+	ktime_t				 osp_pre_rate_stamp;
+	unsigned int			 osp_pre_rate_used;
+	/* average objects used per second */
+	unsigned int			 osp_pre_rate;
+	/* average precreate RPC time, in usec */
+	unsigned int			 osp_pre_rpc_time;
+	/* callers which waited for precreated objects, and how long */
+	__u64				 osp_pre_stalls;
+	__u64				 osp_pre_stall_time;
+	__u64				 osp_pre_stall_max;
 };
 
+/* length of a create rate sample */
+#define OSP_PRE_RATE_INTERVAL_MS	250
+
 struct osp_update_request_sub {
 	struct object_update_request	*ours_req; /* may be vmalloc'd */
 	size_t				ours_req_size;
@@ -291,6 +310,13 @@ struct osp_device {
 #define opd_pre_create_slow		opd_pre->osp_pre_create_slow
 #define opd_pre_recovering		opd_pre->osp_pre_recovering
 #define opd_pre_force_new_seq		opd_pre->osp_pre_force_new_seq
+#define opd_pre_rate_stamp		opd_pre->osp_pre_rate_stamp
+#define opd_pre_rate_used		opd_pre->osp_pre_rate_used
+#define opd_pre_rate			opd_pre->osp_pre_rate
+#define opd_pre_rpc_time		opd_pre->osp_pre_rpc_time
+#define opd_pre_stalls			opd_pre->osp_pre_stalls
+#define opd_pre_stall_time		opd_pre->osp_pre_stall_time
+#define opd_pre_stall_max		opd_pre->osp_pre_stall_max
 
 extern struct kmem_cache *osp_object_kmem;
 
@@ -797,6 +823,7 @@ __u64 osp_precreate_get_id(struct osp_device *d);
 int osp_precreate_get_fid(const struct lu_env *env, struct osp_device *d,
 			  struct lu_fid *fid);
 void osp_precreate_fini(struct osp_device *d);
+int osp_precreate_demand(struct osp_device *d);
 int osp_object_truncate(const struct lu_env *env, struct dt_object *dt, __u64);
 void osp_pre_update_status(struct osp_device *d, int rc);
 void osp_statfs_need_now(struct osp_device *d);
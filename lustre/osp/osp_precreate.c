@@ -318,6 +318,59 @@ static inline int osp_objs_precreated(const struct lu_env *env,
 			    &osp->opd_pre_used_fid);
 }
 
+/**
+ * Account objects reserved for new creations in the create rate
+ *
+ * The reservations are counted over OSP_PRE_RATE_INTERVAL_MS samples which
+ * are averaged in opd_pre_rate. The average follows a rising rate at once so
+ * a burst of creates is seen in the next sample, and decays slowly. A long
+ * idle period restarts the average. Notice this function relies on an
+ * external locking.
+ *
+ * \param[in] d		OSP device
+ * \param[in] used	objects reserved
+ */
+static void osp_precreate_rate_update_nolock(struct osp_device *d, int used)
+{
+	ktime_t now = ktime_get();
+	s64 elapsed = ktime_ms_delta(now, d->opd_pre_rate_stamp);
+	unsigned int sample;
+
+	d->opd_pre_rate_used += used;
+	if (elapsed < OSP_PRE_RATE_INTERVAL_MS)
+		return;
+
+	sample = div64_u64((u64)d->opd_pre_rate_used * MSEC_PER_SEC, elapsed);
+	if (sample > d->opd_pre_rate || elapsed > 4 * OSP_PRE_RATE_INTERVAL_MS)
+		d->opd_pre_rate = sample;
+	else
+		d->opd_pre_rate = (d->opd_pre_rate * 3 + sample) / 4;
+
+	d->opd_pre_rate_used = 0;
+	d->opd_pre_rate_stamp = now;
+}
+
+/**
+ * Return number of objects expected to be used during a precreate RPC
+ *
+ * This is twice the number of objects used at the current create rate
+ * during an average precreate RPC, so the pool of precreated objects does
+ * not run dry before the next batch arrives, even if the rate grows. The
+ * precreation is started when the pool gets smaller than that, and the
+ * batches are made big enough to bring it back up.
+ *
+ * \param[in] d		OSP device
+ *
+ * \retval		number of objects
+ */
+int osp_precreate_demand(struct osp_device *d)
+{
+	u64 demand = (u64)d->opd_pre_rate * d->opd_pre_rpc_time * 2;
+
+	return min_t(u64, div64_u64(demand, USEC_PER_SEC),
+		     d->opd_pre_max_create_count);
+}
+
 /**
  * Check pool of precreated objects is nearly empty
  *
@@ -336,10 +389,11 @@ static inline int osp_precreate_near_empty_nolock(const struct lu_env *env,
 						  struct osp_device *d)
 {
 	int window = osp_objs_precreated(env, d);
+	int low = max(d->opd_pre_create_count / 2, osp_precreate_demand(d));
 
 	/* don't consider new precreation till OST is healty and
 	 * has free space */
-	return ((window - d->opd_pre_reserved < d->opd_pre_create_count / 2 ||
+	return ((window - d->opd_pre_reserved < low ||
 		 d->opd_force_creation) && (d->opd_pre_status == 0));
 }
 
@@ -610,8 +664,10 @@ static int osp_precreate_send(const struct lu_env *env, struct osp_device *d)
 	struct ptlrpc_request	*req;
 	struct obd_import	*imp;
 	struct ost_body		*body;
-	int			 rc, grow, diff;
+	int			 rc, grow, diff, demand;
 	struct lu_fid		*fid = &oti->osi_fid;
+	ktime_t			 start;
+	s64			 rpc_time = 0;
 	ENTRY;
 
 	/* don't precreate new objects till OST healthy and has free space */
@@ -651,6 +707,11 @@ static int osp_precreate_send(const struct lu_env *env, struct osp_device *d)
 	}
 
 	spin_lock(&d->opd_pre_lock);
+	/* ask for enough objects to cover the expected creates at once */
+	demand = osp_precreate_demand(d);
+	if (!d->opd_pre_create_slow && d->opd_pre_create_count < demand)
+		d->opd_pre_create_count = roundup_pow_of_two(demand);
+
 	if (d->opd_force_creation)
 		d->opd_pre_create_count = OST_MIN_PRECREATE;
 	else if (d->opd_pre_create_count > d->opd_pre_max_create_count / 2)
@@ -682,7 +743,9 @@ static int osp_precreate_send(const struct lu_env *env, struct osp_device *d)
 	if (CFS_FAIL_CHECK(OBD_FAIL_OSP_FAKE_PRECREATE))
 		GOTO(ready, rc = 0);
 
+	start = ktime_get();
 	rc = ptlrpc_queue_wait(req);
+	rpc_time = ktime_us_delta(ktime_get(), start);
 	if (rc) {
 		CERROR("%s: can't precreate: rc = %d\n", d->opd_obd->obd_name,
 		       rc);
@@ -709,6 +772,14 @@ ready:
 	diff = osp_fid_diff(fid, &d->opd_pre_last_created_fid);
 
 	spin_lock(&d->opd_pre_lock);
+	if (rpc_time > 0) {
+		if (d->opd_pre_rpc_time == 0)
+			d->opd_pre_rpc_time = rpc_time;
+		else
+			d->opd_pre_rpc_time = (d->opd_pre_rpc_time * 3 +
+					       rpc_time) / 4;
+	}
+
 	if (diff < grow) {
 		/* the OST has not managed to create all the
 		 * objects we asked for */
@@ -1467,6 +1538,7 @@ int osp_precreate_reserve(const struct lu_env *env, struct osp_device *d,
 			  bool can_block)
 {
 	time64_t expire = ktime_get_seconds() + obd_timeout;
+	ktime_t stall = 0;
 	int precreated, rc, synced = 0;
 
 	ENTRY;
@@ -1507,6 +1579,7 @@ int osp_precreate_reserve(const struct lu_env *env, struct osp_device *d,
 		if (!d->opd_pre_recovering && !d->opd_force_creation) {
 			if (precreated > d->opd_pre_reserved) {
 				d->opd_pre_reserved++;
+				osp_precreate_rate_update_nolock(d, 1);
 				spin_unlock(&d->opd_pre_lock);
 				rc = 0;
 
@@ -1573,6 +1646,8 @@ int osp_precreate_reserve(const struct lu_env *env, struct osp_device *d,
 
 		CDEBUG(D_INFO, "%s: Sleeping on objects\n",
 		       d->opd_obd->obd_name);
+		if (!stall)
+			stall = ktime_get();
 		if (wait_event_idle_timeout(
 			    d->opd_pre_user_waitq,
 			    osp_precreate_ready_condition(env, d),
@@ -1593,6 +1668,17 @@ int osp_precreate_reserve(const struct lu_env *env, struct osp_device *d,
 		}
 	}
 
+	if (stall) {
+		u64 time = ktime_us_delta(ktime_get(), stall);
+
+		spin_lock(&d->opd_pre_lock);
+		d->opd_pre_stalls++;
+		d->opd_pre_stall_time += time;
+		if (time > d->opd_pre_stall_max)
+			d->opd_pre_stall_max = time;
+		spin_unlock(&d->opd_pre_lock);
+	}
+
 	RETURN(rc);
 }
 
@@ -1804,6 +1890,7 @@ int osp_init_precreate(struct osp_device *d)
 	d->opd_pre_create_count = OST_MIN_PRECREATE;
 	d->opd_pre_min_create_count = OST_MIN_PRECREATE;
 	d->opd_pre_max_create_count = OST_MAX_PRECREATE;
+	d->opd_pre_rate_stamp = ktime_get();
 	d->opd_reserved_mb_high = 0;
 	d->opd_reserved_mb_low = 0;
 	d->opd_cleanup_orphans_done = false;
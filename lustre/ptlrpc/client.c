@@ -537,16 +537,157 @@ __must_hold(&req->rq_lock)
 
 static struct kmem_cache *request_cache;
 
+/*
+ * Request and reply buffers of the null and plain security flavors are
+ * sized to a power of two. Recently freed buffers of the common sizes are
+ * kept on per-CPT free lists, so that getattr, enqueue or BRW RPCs are
+ * packed without going to the allocator. A recycled buffer is cleared
+ * entirely, like a newly allocated one, since packers may leave padding
+ * and unused fields untouched.
+ */
+#define PTLRPC_MSGBUF_MIN_SHIFT	9	/* 512 bytes */
+#define PTLRPC_MSGBUF_MAX_SHIFT	13	/* 8KiB */
+#define PTLRPC_MSGBUF_NR_CLASS	(PTLRPC_MSGBUF_MAX_SHIFT - \
+				 PTLRPC_MSGBUF_MIN_SHIFT + 1)
+
+struct ptlrpc_msgbuf_cache {
+	spinlock_t		mc_lock;
+	unsigned int		mc_count[PTLRPC_MSGBUF_NR_CLASS];
+	struct list_head	mc_free[PTLRPC_MSGBUF_NR_CLASS];
+};
+
+static struct ptlrpc_msgbuf_cache **msgbuf_cache;
+
+static int ptlrpc_msgbuf_class(int size)
+{
+	if (size < (1 << PTLRPC_MSGBUF_MIN_SHIFT) ||
+	    size > (1 << PTLRPC_MSGBUF_MAX_SHIFT) || !is_power_of_2(size))
+		return -1;
+
+	return ilog2(size) - PTLRPC_MSGBUF_MIN_SHIFT;
+}
+
+/**
+ * Allocate a cleared message buffer of \a size bytes. \a size must be
+ * passed to ptlrpc_msgbuf_free() too.
+ */
+void *ptlrpc_msgbuf_alloc(int size)
+{
+	struct ptlrpc_msgbuf_cache *mc;
+	struct list_head *item = NULL;
+	void *buf;
+	int idx;
+
+	idx = ptlrpc_msgbuf_class(size);
+	if (idx >= 0) {
+		mc = msgbuf_cache[cfs_cpt_current(cfs_cpt_tab, 1)];
+		spin_lock(&mc->mc_lock);
+		if (!list_empty(&mc->mc_free[idx])) {
+			item = mc->mc_free[idx].next;
+			list_del(item);
+			mc->mc_count[idx]--;
+		}
+		spin_unlock(&mc->mc_lock);
+	}
+
+	if (item != NULL) {
+		buf = item;
+		memset(buf, 0, size);
+	} else {
+		OBD_ALLOC_LARGE(buf, size);
+	}
+
+	return buf;
+}
+EXPORT_SYMBOL(ptlrpc_msgbuf_alloc);
+
+void ptlrpc_msgbuf_free(void *buf, int size)
+{
+	struct ptlrpc_msgbuf_cache *mc;
+	int idx;
+
+	idx = ptlrpc_msgbuf_class(size);
+	if (idx >= 0) {
+		mc = msgbuf_cache[cfs_cpt_current(cfs_cpt_tab, 1)];
+		spin_lock(&mc->mc_lock);
+		if (mc->mc_count[idx] < PTLRPC_MSGBUF_CACHE_MAX) {
+			list_add(buf, &mc->mc_free[idx]);
+			mc->mc_count[idx]++;
+			buf = NULL;
+		}
+		spin_unlock(&mc->mc_lock);
+	}
+
+	if (buf != NULL)
+		OBD_FREE_LARGE(buf, size);
+}
+EXPORT_SYMBOL(ptlrpc_msgbuf_free);
+
+static void ptlrpc_msgbuf_cache_fini(void)
+{
+	struct ptlrpc_msgbuf_cache *mc;
+	struct list_head *item;
+	int i;
+	int j;
+
+	if (msgbuf_cache == NULL)
+		return;
+
+	cfs_percpt_for_each(mc, i, msgbuf_cache) {
+		for (j = 0; j < PTLRPC_MSGBUF_NR_CLASS; j++) {
+			while (!list_empty(&mc->mc_free[j])) {
+				item = mc->mc_free[j].next;
+				list_del(item);
+				OBD_FREE_LARGE(item,
+					1 << (j + PTLRPC_MSGBUF_MIN_SHIFT));
+			}
+		}
+	}
+	cfs_percpt_free(msgbuf_cache);
+	msgbuf_cache = NULL;
+}
+
+static int ptlrpc_msgbuf_cache_init(void)
+{
+	struct ptlrpc_msgbuf_cache *mc;
+	int i;
+	int j;
+
+	msgbuf_cache = cfs_percpt_alloc(cfs_cpt_tab, sizeof(*mc));
+	if (msgbuf_cache == NULL)
+		return -ENOMEM;
+
+	cfs_percpt_for_each(mc, i, msgbuf_cache) {
+		spin_lock_init(&mc->mc_lock);
+		for (j = 0; j < PTLRPC_MSGBUF_NR_CLASS; j++)
+			INIT_LIST_HEAD(&mc->mc_free[j]);
+	}
+
+	return 0;
+}
+
 int ptlrpc_request_cache_init(void)
 {
+	int rc;
+
 	request_cache = kmem_cache_create("ptlrpc_cache",
 					  sizeof(struct ptlrpc_request),
 					  0, SLAB_HWCACHE_ALIGN, NULL);
-	return request_cache ? 0 : -ENOMEM;
+	if (!request_cache)
+		return -ENOMEM;
+
+	rc = ptlrpc_msgbuf_cache_init();
+	if (rc) {
+		kmem_cache_destroy(request_cache);
+		request_cache = NULL;
+	}
+
+	return rc;
 }
 
 void ptlrpc_request_cache_fini(void)
 {
+	ptlrpc_msgbuf_cache_fini();
 	kmem_cache_destroy(request_cache);
 }
 
@@ -33,6 +33,7 @@
 
 #include <linux/delay.h>
 #include <libcfs/linux/linux-hash.h>
+#include <lnet/lib-lnet.h>
 #include <obd_support.h>
 #include <obd_class.h>
 #include <lustre_net.h>
@@ -75,6 +76,21 @@ static const struct rhashtable_params conn_hash_params = {
 	.obj_cmpfn	= lnet_process_id_cmp,
 };
 
+/* NUMA locality of the local NI, used to steer ptlrpcd work */
+static int ptlrpc_connection_dev_cpt(struct lnet_nid *self)
+{
+	struct lnet_ni *ni;
+	int cpt = CFS_CPT_ANY;
+
+	ni = lnet_nid_to_ni_addref(self);
+	if (ni) {
+		cpt = ni->ni_dev_cpt;
+		lnet_ni_decref(ni);
+	}
+
+	return cpt;
+}
+
 struct ptlrpc_connection *
 ptlrpc_connection_get(struct lnet_processid *peer_orig, struct lnet_nid *self,
 		      struct obd_uuid *uuid)
@@ -96,6 +112,7 @@ ptlrpc_connection_get(struct lnet_processid *peer_orig, struct lnet_nid *self,
 
 	conn->c_peer = peer;
 	conn->c_self = *self;
+	conn->c_dev_cpt = ptlrpc_connection_dev_cpt(self);
 	atomic_set(&conn->c_refcount, 1);
 	if (uuid)
 		obd_str2uuid(&conn->c_remote_uuid, uuid->uuid);
@@ -70,7 +70,10 @@ struct ptlrpcd {
 	int			pd_cpt;
 	int			pd_cursor;
 	int			pd_nthreads;
+	/* number of threads started, grows up to pd_nthreads */
+	int			pd_nactive;
 	int			pd_groupsize;
+	struct work_struct	pd_grow_work;
 	struct ptlrpcd_ctl	pd_threads[0];
 };
 
@@ -105,6 +108,36 @@ module_param(ptlrpcd_per_cpt_max, int, 0644);
 MODULE_PARM_DESC(ptlrpcd_per_cpt_max,
 		 "Max ptlrpcd thread count to be started per CPT.");
 
+/*
+ * ptlrpcd_per_cpt_min: The number of ptlrpcd threads to start in a CPT
+ * at setup, rounded up to whole partner groups. More threads, up to the
+ * per-CPT maximum, are started on demand when the queue of the selected
+ * thread is deeper than ptlrpcd_grow_depth. Zero starts all threads at
+ * setup.
+ */
+static int ptlrpcd_per_cpt_min;
+module_param(ptlrpcd_per_cpt_min, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_per_cpt_min,
+		 "Min ptlrpcd thread count to be started per CPT.");
+
+static int ptlrpcd_grow_depth = 32;
+module_param(ptlrpcd_grow_depth, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_grow_depth,
+		 "Queued RPCs per ptlrpcd thread that start another thread.");
+
+/*
+ * ptlrpcd_numa_steer: Queue a request to the ptlrpcd threads of the CPT
+ * owning its bulk pages or, failing that, the local NI device of its
+ * import, instead of the CPT of the submitting thread. Reply and bulk
+ * completion then run on the NUMA node of the memory they touch.
+ * Off by default: all RPCs of a workload touching one node would be
+ * funnelled to the threads of a single CPT.
+ */
+static int ptlrpcd_numa_steer;
+module_param(ptlrpcd_numa_steer, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_numa_steer,
+		 "Steer RPCs to ptlrpcd threads local to their pages or NI (default 0).");
+
 /*
  * ptlrpcd_partner_group_size: The desired number of threads in each
  * ptlrpcd partner thread group. Default is 2, corresponding to the
@@ -165,30 +198,75 @@ void ptlrpcd_wake(struct ptlrpc_request *req)
 }
 EXPORT_SYMBOL(ptlrpcd_wake);
 
+/*
+ * Pick the CPT whose ptlrpcd threads should handle \a req: the one owning
+ * the bulk pages, which are touched again by the interpret callback, then
+ * the one of the NI device the RPC goes out on.
+ */
+static int ptlrpcd_req_cpt(struct ptlrpc_request *req)
+{
+	struct ptlrpc_bulk_desc *desc;
+	int cpt;
+
+	if (req == NULL || !ptlrpcd_numa_steer ||
+	    cfs_cpt_number(cfs_cpt_tab) == 1)
+		goto out;
+
+	desc = req->rq_bulk;
+	if (desc != NULL && desc->bd_iov_count > 0) {
+		cpt = cfs_cpt_of_node(cfs_cpt_tab,
+				      page_to_nid(desc->bd_vec[0].bv_page));
+		if (cpt >= 0)
+			return cpt;
+	}
+
+	if (req->rq_import != NULL) {
+		cpt = READ_ONCE(req->rq_import->imp_dev_cpt);
+		if (cpt >= 0 && cpt < cfs_cpt_number(cfs_cpt_tab))
+			return cpt;
+	}
+out:
+	return cfs_cpt_current(cfs_cpt_tab, 1);
+}
+
 static struct ptlrpcd_ctl *
 ptlrpcd_select_pc(struct ptlrpc_request *req)
 {
+	struct ptlrpcd_ctl *pc;
+	struct ptlrpc_request_set *set;
 	struct ptlrpcd	*pd;
 	int		cpt;
 	int		idx;
+	int		nactive;
 
 	if (req != NULL && req->rq_send_state != LUSTRE_IMP_FULL)
 		return &ptlrpcd_rcv;
 
-	cpt = cfs_cpt_current(cfs_cpt_tab, 1);
+	cpt = ptlrpcd_req_cpt(req);
 	if (ptlrpcds_cpt_idx == NULL)
 		idx = cpt;
 	else
 		idx = ptlrpcds_cpt_idx[cpt];
 	pd = ptlrpcds[idx];
 
+	/* pairs with smp_store_release() in ptlrpcd_grow() */
+	nactive = smp_load_acquire(&pd->pd_nactive);
+
 	/* We do not care whether it is strict load balance. */
 	idx = pd->pd_cursor;
-	if (++idx == pd->pd_nthreads)
+	if (++idx >= nactive)
 		idx = 0;
 	pd->pd_cursor = idx;
+	pc = &pd->pd_threads[idx];
 
-	return &pd->pd_threads[idx];
+	/* start another thread if even the next one in turn is backed up */
+	set = pc->pc_set;
+	if (nactive < pd->pd_nthreads && set != NULL &&
+	    atomic_read(&set->set_new_count) +
+	    atomic_read(&set->set_remaining) > ptlrpcd_grow_depth)
+		schedule_work(&pd->pd_grow_work);
+
+	return pc;
 }
 
 /**
@@ -229,8 +307,14 @@ void ptlrpcd_add_rqset(struct ptlrpc_request_set *set)
 		 *      guarantee the async RPC can be processed ASAP, we have
 		 *      no other better choice. It maybe fixed in future.
 		 */
-		for (i = 0; i < pc->pc_npartners; i++)
-			wake_up(&pc->pc_partners[i]->pc_set->set_waitq);
+		for (i = 0; i < pc->pc_npartners; i++) {
+			struct ptlrpc_request_set *ps;
+
+			/* partners are not started until the CPT grows */
+			ps = pc->pc_partners[i]->pc_set;
+			if (ps != NULL)
+				wake_up(&ps->set_waitq);
+		}
 	}
 }
 
@@ -676,6 +760,17 @@ out:
 	EXIT;
 }
 
+static void ptlrpcd_partners_free(struct ptlrpcd_ctl *pc)
+{
+	if (pc->pc_npartners > 0) {
+		LASSERT(pc->pc_partners != NULL);
+
+		OBD_FREE_PTR_ARRAY(pc->pc_partners, pc->pc_npartners);
+		pc->pc_partners = NULL;
+	}
+	pc->pc_npartners = 0;
+}
+
 void ptlrpcd_free(struct ptlrpcd_ctl *pc)
 {
 	struct ptlrpc_request_set *set = pc->pc_set;
@@ -699,19 +794,42 @@ void ptlrpcd_free(struct ptlrpcd_ctl *pc)
 	clear_bit(LIOD_FORCE, &pc->pc_flags);
 
 out:
-	if (pc->pc_npartners > 0) {
-		LASSERT(pc->pc_partners != NULL);
-
-		OBD_FREE_PTR_ARRAY(pc->pc_partners, pc->pc_npartners);
-		pc->pc_partners = NULL;
-	}
-	pc->pc_npartners = 0;
+	ptlrpcd_partners_free(pc);
 	pc->pc_error = 0;
 	EXIT;
 }
 
+/*
+ * Start the next ptlrpcd thread of a CPT, once its threads cannot keep up
+ * with the queued RPCs. Like ptlrpc service threads, ptlrpcd threads are
+ * not stopped again until ptlrpcd_fini().
+ */
+static void ptlrpcd_grow(struct work_struct *work)
+{
+	struct ptlrpcd *pd = container_of(work, struct ptlrpcd, pd_grow_work);
+	int idx = pd->pd_nactive;
+	int rc;
+
+	/* work items do not run concurrently, so no lock for pd_nactive */
+	if (idx >= pd->pd_nthreads)
+		return;
+
+	rc = ptlrpcd_start(&pd->pd_threads[idx]);
+	if (rc < 0) {
+		CWARN("%s: cannot start ptlrpcd thread: rc = %d\n",
+		      pd->pd_threads[idx].pc_name, rc);
+		return;
+	}
+
+	smp_store_release(&pd->pd_nactive, idx + 1);
+	CDEBUG(D_RPCTRACE, "CPT %d: started %s, %d/%d threads\n",
+	       pd->pd_cpt, pd->pd_threads[idx].pc_name, idx + 1,
+	       pd->pd_nthreads);
+}
+
 static void ptlrpcd_fini(void)
 {
+	struct ptlrpcd *pd;
 	int	i;
 	int	j;
 	int	ncpts;
@@ -722,10 +840,15 @@ static void ptlrpcd_fini(void)
 		for (i = 0; i < ptlrpcds_num; i++) {
 			if (ptlrpcds[i] == NULL)
 				break;
-			for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
-				ptlrpcd_stop(&ptlrpcds[i]->pd_threads[j], 0);
-			for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
-				ptlrpcd_free(&ptlrpcds[i]->pd_threads[j]);
+			pd = ptlrpcds[i];
+			cancel_work_sync(&pd->pd_grow_work);
+			for (j = 0; j < pd->pd_nactive; j++)
+				ptlrpcd_stop(&pd->pd_threads[j], 0);
+			for (j = 0; j < pd->pd_nactive; j++)
+				ptlrpcd_free(&pd->pd_threads[j]);
+			/* threads never started still own partner arrays */
+			for (; j < pd->pd_nthreads; j++)
+				ptlrpcd_partners_free(&pd->pd_threads[j]);
 			OBD_FREE(ptlrpcds[i], ptlrpcds[i]->pd_size);
 			ptlrpcds[i] = NULL;
 		}
@@ -748,6 +871,7 @@ static void ptlrpcd_fini(void)
 static int ptlrpcd_init(void)
 {
 	int			nthreads;
+	int			nmin;
 	int			groupsize;
 	int			size;
 	int			i;
@@ -910,6 +1034,11 @@ static int ptlrpcd_init(void)
 				nthreads += groupsize - (nthreads % groupsize);
 		}
 
+		nmin = nthreads;
+		if (ptlrpcd_per_cpt_min > 0 && ptlrpcd_per_cpt_min < nthreads)
+			nmin = min(roundup(ptlrpcd_per_cpt_min, groupsize),
+				   nthreads);
+
 		size = offsetof(struct ptlrpcd, pd_threads[nthreads]);
 		OBD_CPT_ALLOC(pd, cptable, cpt, size);
 
@@ -920,7 +1049,9 @@ static int ptlrpcd_init(void)
 		pd->pd_cpt       = cpt;
 		pd->pd_cursor    = 0;
 		pd->pd_nthreads  = nthreads;
+		pd->pd_nactive   = 0;
 		pd->pd_groupsize = groupsize;
+		INIT_WORK(&pd->pd_grow_work, ptlrpcd_grow);
 		ptlrpcds[i] = pd;
 
 		/*
@@ -953,11 +1084,15 @@ static int ptlrpcd_init(void)
 		 *      dependency. But how to distribute async RPCs
 		 *      load among all the ptlrpc daemons becomes
 		 *      another trouble.
+		 *
+		 *      Only nmin of them are started here, the rest are
+		 *      started by ptlrpcd_grow() as the load requires.
 		 */
-		for (j = 0; j < nthreads; j++) {
+		for (j = 0; j < nmin; j++) {
 			rc = ptlrpcd_start(&pd->pd_threads[j]);
 			if (rc < 0)
 				GOTO(out, rc);
+			pd->pd_nactive = j + 1;
 		}
 	}
 out:
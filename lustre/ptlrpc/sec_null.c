@@ -152,7 +152,7 @@ int null_alloc_reqbuf(struct ptlrpc_sec *sec,
 		int alloc_size = size_roundup_power2(msgsize);
 
 		LASSERT(!req->rq_pool);
-		OBD_ALLOC_LARGE(req->rq_reqbuf, alloc_size);
+		req->rq_reqbuf = ptlrpc_msgbuf_alloc(alloc_size);
 		if (!req->rq_reqbuf)
 			return -ENOMEM;
 
@@ -179,7 +179,7 @@ void null_free_reqbuf(struct ptlrpc_sec *sec,
 			 "req %p: reqlen %d should smaller than buflen %d\n",
 			 req, req->rq_reqlen, req->rq_reqbuf_len);
 
-		OBD_FREE_LARGE(req->rq_reqbuf, req->rq_reqbuf_len);
+		ptlrpc_msgbuf_free(req->rq_reqbuf, req->rq_reqbuf_len);
 		req->rq_reqbuf = NULL;
 		req->rq_reqbuf_len = 0;
 	}
@@ -190,16 +190,18 @@ int null_alloc_repbuf(struct ptlrpc_sec *sec,
 		      struct ptlrpc_request *req,
 		      int msgsize)
 {
+	int alloc_size;
+
 	/* add space for early replied */
 	msgsize += lustre_msg_early_size;
 
-	msgsize = size_roundup_power2(msgsize);
+	alloc_size = size_roundup_power2(msgsize);
 
-	OBD_ALLOC_LARGE(req->rq_repbuf, msgsize);
+	req->rq_repbuf = ptlrpc_msgbuf_alloc(alloc_size);
 	if (!req->rq_repbuf)
 		return -ENOMEM;
 
-	req->rq_repbuf_len = msgsize;
+	req->rq_repbuf_len = alloc_size;
 	return 0;
 }
 
@@ -209,7 +211,7 @@ void null_free_repbuf(struct ptlrpc_sec *sec,
 {
 	LASSERT(req->rq_repbuf);
 
-	OBD_FREE_LARGE(req->rq_repbuf, req->rq_repbuf_len);
+	ptlrpc_msgbuf_free(req->rq_repbuf, req->rq_repbuf_len);
 	req->rq_repbuf = NULL;
 	req->rq_repbuf_len = 0;
 }
@@ -240,7 +242,7 @@ int null_enlarge_reqbuf(struct ptlrpc_sec *sec,
 	if (req->rq_reqbuf_len < newmsg_size) {
 		alloc_size = size_roundup_power2(newmsg_size);
 
-		OBD_ALLOC_LARGE(newbuf, alloc_size);
+		newbuf = ptlrpc_msgbuf_alloc(alloc_size);
 		if (newbuf == NULL)
 			return -ENOMEM;
 
@@ -256,7 +258,7 @@ int null_enlarge_reqbuf(struct ptlrpc_sec *sec,
 			spin_lock(&req->rq_import->imp_lock);
 		memcpy(newbuf, req->rq_reqbuf, req->rq_reqlen);
 
-		OBD_FREE_LARGE(req->rq_reqbuf, req->rq_reqbuf_len);
+		ptlrpc_msgbuf_free(req->rq_reqbuf, req->rq_reqbuf_len);
 		req->rq_reqbuf = req->rq_reqmsg = newbuf;
 		req->rq_reqbuf_len = alloc_size;
 
@@ -566,14 +566,15 @@ int plain_alloc_reqbuf(struct ptlrpc_sec *sec,
 	alloc_len = lustre_msg_size_v2(PLAIN_PACK_SEGMENTS, buflens);
 
 	if (!req->rq_reqbuf) {
+		int buf_len = size_roundup_power2(alloc_len);
+
 		LASSERT(!req->rq_pool);
 
-		alloc_len = size_roundup_power2(alloc_len);
-		OBD_ALLOC_LARGE(req->rq_reqbuf, alloc_len);
+		req->rq_reqbuf = ptlrpc_msgbuf_alloc(buf_len);
 		if (!req->rq_reqbuf)
 			RETURN(-ENOMEM);
 
-		req->rq_reqbuf_len = alloc_len;
+		req->rq_reqbuf_len = buf_len;
 	} else {
 		LASSERT(req->rq_pool);
 		LASSERT(req->rq_reqbuf_len >= alloc_len);
@@ -595,7 +596,7 @@ void plain_free_reqbuf(struct ptlrpc_sec *sec,
 {
 	ENTRY;
 	if (!req->rq_pool) {
-		OBD_FREE_LARGE(req->rq_reqbuf, req->rq_reqbuf_len);
+		ptlrpc_msgbuf_free(req->rq_reqbuf, req->rq_reqbuf_len);
 		req->rq_reqbuf = NULL;
 		req->rq_reqbuf_len = 0;
 	}
@@ -609,6 +610,7 @@ int plain_alloc_repbuf(struct ptlrpc_sec *sec,
 {
 	__u32 buflens[PLAIN_PACK_SEGMENTS] = { 0, };
 	int alloc_len;
+	int buf_len;
 
 	ENTRY;
 
@@ -625,13 +627,13 @@ int plain_alloc_repbuf(struct ptlrpc_sec *sec,
 	/* add space for early reply */
 	alloc_len += plain_at_offset;
 
-	alloc_len = size_roundup_power2(alloc_len);
+	buf_len = size_roundup_power2(alloc_len);
 
-	OBD_ALLOC_LARGE(req->rq_repbuf, alloc_len);
+	req->rq_repbuf = ptlrpc_msgbuf_alloc(buf_len);
 	if (!req->rq_repbuf)
 		RETURN(-ENOMEM);
 
-	req->rq_repbuf_len = alloc_len;
+	req->rq_repbuf_len = buf_len;
 	RETURN(0);
 }
 
@@ -640,7 +642,7 @@ void plain_free_repbuf(struct ptlrpc_sec *sec,
 		       struct ptlrpc_request *req)
 {
 	ENTRY;
-	OBD_FREE_LARGE(req->rq_repbuf, req->rq_repbuf_len);
+	ptlrpc_msgbuf_free(req->rq_repbuf, req->rq_repbuf_len);
 	req->rq_repbuf = NULL;
 	req->rq_repbuf_len = 0;
 	EXIT;
@@ -682,7 +684,7 @@ int plain_enlarge_reqbuf(struct ptlrpc_sec *sec,
 	if (req->rq_reqbuf_len < newbuf_size) {
 		newbuf_size = size_roundup_power2(newbuf_size);
 
-		OBD_ALLOC_LARGE(newbuf, newbuf_size);
+		newbuf = ptlrpc_msgbuf_alloc(newbuf_size);
 		if (newbuf == NULL)
 			RETURN(-ENOMEM);
 
@@ -699,7 +701,7 @@ int plain_enlarge_reqbuf(struct ptlrpc_sec *sec,
 
 		memcpy(newbuf, req->rq_reqbuf, req->rq_reqbuf_len);
 
-		OBD_FREE_LARGE(req->rq_reqbuf, req->rq_reqbuf_len);
+		ptlrpc_msgbuf_free(req->rq_reqbuf, req->rq_reqbuf_len);
 		req->rq_reqbuf = newbuf;
 		req->rq_reqbuf_len = newbuf_size;
 		req->rq_reqmsg = lustre_msg_buf(req->rq_reqbuf,
@@ -31,6 +31,8 @@
 
 #define DEBUG_SUBSYSTEM S_CLASS
 
+#include <linux/kthread.h>
+#include <linux/sort.h>
 #include <llog_swab.h>
 #include <lustre_obdo.h>
 #include <lustre_swab.h>
@@ -909,6 +911,290 @@ stop:
 	RETURN(rc);
 }
 
+static int out_prep_threads = 4;
+module_param(out_prep_threads, int, 0444);
+MODULE_PARM_DESC(out_prep_threads,
+		 "threads looking up objects of OUT requests in parallel");
+
+static unsigned int out_prep_min_objects = 8;
+module_param(out_prep_min_objects, uint, 0644);
+MODULE_PARM_DESC(out_prep_min_objects,
+		 "min objects of an OUT request to look up in parallel");
+
+static unsigned long out_prep_batches;
+module_param(out_prep_batches, ulong, 0444);
+MODULE_PARM_DESC(out_prep_batches,
+		 "OUT requests whose objects were given to the prepare threads");
+
+/* Object of an OUT request looked up before the updates are executed */
+struct out_prep_object {
+	struct lu_fid		 opo_fid;
+	struct dt_object	*opo_obj;
+	__u16			 opo_type;
+};
+
+/* Objects of one OUT request shared by the request and prepare threads */
+struct out_prep_batch {
+	struct list_head	 opb_list;
+	struct dt_device	*opb_dt;
+	struct out_prep_object	*opb_objs;
+	int			 opb_count;
+	atomic_t		 opb_next;
+	atomic_t		 opb_users;
+};
+
+struct out_prep_thread {
+	struct task_struct	*opt_task;
+	struct lu_env		 opt_env;
+};
+
+static DEFINE_SPINLOCK(out_prep_lock);
+static LIST_HEAD(out_prep_list);
+static DEFINE_MUTEX(out_prep_mutex);
+static struct out_prep_thread *out_prep_thrs;
+static int out_prep_thrs_size;
+static int out_prep_nthreads;
+static bool out_prep_started;
+
+static int out_prep_cmp(const void *a, const void *b)
+{
+	const struct out_prep_object *o1 = a;
+	const struct out_prep_object *o2 = b;
+
+	return lu_fid_cmp(&o1->opo_fid, &o2->opo_fid);
+}
+
+/**
+ * Find the objects of an OUT request to be looked up in advance.
+ *
+ * The updates are executed in order within the transaction, but the lookup
+ * of their objects (OI lookup and inode read if the object is not cached)
+ * depends on the other updates only if the object is created or destroyed
+ * by this request. All the other objects are independent and can be looked
+ * up in parallel before the execution, each of them once.
+ *
+ * \param[in] update_bufs	update buffers of the request
+ * \param[in] count		number of update buffers
+ * \param[in] updates		number of updates in the request
+ * \param[out] objs		array of \a updates objects, the first entries
+ *				are to be looked up
+ *
+ * \retval			number of objects to look up
+ * \retval			negative errno if the array can't be allocated
+ */
+static int out_prep_collect(void **update_bufs, __u32 count, int updates,
+			    struct out_prep_object **objs)
+{
+	struct out_prep_object *tmp;
+	int nr = 0;
+	int n = 0;
+	int i, j;
+
+	OBD_ALLOC_LARGE(tmp, updates * sizeof(*tmp));
+	if (tmp == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		struct object_update_request *our = update_bufs[i];
+
+		for (j = 0; j < our->ourq_count && n < updates; j++) {
+			struct object_update *update;
+
+			update = object_update_request_get(our, j, NULL);
+			tmp[n].opo_fid = update->ou_fid;
+			tmp[n].opo_type = update->ou_type;
+			n++;
+		}
+	}
+
+	sort(tmp, n, sizeof(*tmp), out_prep_cmp, NULL);
+	for (i = 0; i < n; i = j) {
+		bool depend = false;
+
+		for (j = i; j < n && lu_fid_eq(&tmp[j].opo_fid,
+					       &tmp[i].opo_fid); j++) {
+			if (tmp[j].opo_type == OUT_CREATE ||
+			    tmp[j].opo_type == OUT_DESTROY)
+				depend = true;
+		}
+		if (!depend)
+			tmp[nr++] = tmp[i];
+	}
+	*objs = tmp;
+
+	return nr;
+}
+
+static void out_prep_run(const struct lu_env *env, struct out_prep_batch *opb)
+{
+	struct dt_device *dt = opb->opb_dt;
+	int i;
+
+	while ((i = atomic_inc_return(&opb->opb_next) - 1) < opb->opb_count) {
+		struct out_prep_object *opo = &opb->opb_objs[i];
+		struct lu_object_conf conf = { .loc_flags = 0 };
+		struct dt_object *obj;
+
+		/* errors are reported when the update is executed */
+		obj = dt_locate_at(env, dt, &opo->opo_fid,
+				   dt->dd_lu_dev.ld_site->ls_top_dev, &conf);
+		opo->opo_obj = IS_ERR(obj) ? NULL : obj;
+	}
+}
+
+static int out_prep_main(void *arg)
+{
+	struct out_prep_thread *opt = arg;
+	struct out_prep_batch *opb;
+
+	while (({set_current_state(TASK_IDLE);
+		 !kthread_should_stop(); })) {
+		spin_lock(&out_prep_lock);
+		opb = list_first_entry_or_null(&out_prep_list,
+					       struct out_prep_batch, opb_list);
+		if (opb != NULL)
+			atomic_inc(&opb->opb_users);
+		spin_unlock(&out_prep_lock);
+		if (opb == NULL) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		lu_env_refill(&opt->opt_env);
+		out_prep_run(&opt->opt_env, opb);
+
+		/* all objects are claimed, nothing more to do for others */
+		spin_lock(&out_prep_lock);
+		list_del_init(&opb->opb_list);
+		spin_unlock(&out_prep_lock);
+		if (atomic_dec_and_test(&opb->opb_users))
+			wake_up_var(&opb->opb_users);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static void out_prep_threads_start(void)
+{
+	int nthreads;
+	int i;
+
+	mutex_lock(&out_prep_mutex);
+	if (out_prep_started)
+		goto out;
+
+	nthreads = min_t(int, out_prep_threads, num_online_cpus());
+	if (nthreads <= 0)
+		goto out_started;
+
+	OBD_ALLOC_PTR_ARRAY(out_prep_thrs, nthreads);
+	if (out_prep_thrs == NULL)
+		goto out_started;
+	out_prep_thrs_size = nthreads;
+
+	for (i = 0; i < nthreads; i++) {
+		struct out_prep_thread *opt = &out_prep_thrs[i];
+		struct task_struct *task;
+
+		/* the threads outlive the targets, don't pin the keys of
+		 * the modules so they can be unloaded, like service threads
+		 */
+		if (lu_env_init(&opt->opt_env, LCT_MD_THREAD | LCT_DT_THREAD |
+				LCT_REMEMBER | LCT_NOREF))
+			break;
+
+		task = kthread_run(out_prep_main, opt, "out_prep_%02d", i);
+		if (IS_ERR(task)) {
+			lu_env_fini(&opt->opt_env);
+			break;
+		}
+		opt->opt_task = task;
+	}
+	out_prep_nthreads = i;
+	CDEBUG(D_INFO, "started %d OUT prepare threads\n", i);
+
+out_started:
+	/* do not retry on every request if threads can not start */
+	smp_store_release(&out_prep_started, true);
+out:
+	mutex_unlock(&out_prep_mutex);
+}
+
+void out_prep_fini(void)
+{
+	int i;
+
+	for (i = 0; i < out_prep_nthreads; i++) {
+		kthread_stop(out_prep_thrs[i].opt_task);
+		lu_env_fini(&out_prep_thrs[i].opt_env);
+	}
+	if (out_prep_thrs != NULL)
+		OBD_FREE_PTR_ARRAY(out_prep_thrs, out_prep_thrs_size);
+	out_prep_thrs = NULL;
+	out_prep_thrs_size = 0;
+	out_prep_nthreads = 0;
+	out_prep_started = false;
+}
+
+/**
+ * Look up the objects of an OUT request in parallel.
+ *
+ * The objects are claimed one by one by the prepare threads and by the
+ * request thread itself, which returns once all of them are done. The
+ * objects stay referenced until the request is finished, so they are found
+ * in the cache when the updates are executed in order.
+ */
+static void out_prep_objects(const struct lu_env *env, struct dt_device *dt,
+			     struct out_prep_object *objs, int count)
+{
+	struct out_prep_batch opb = {
+		.opb_dt		= dt,
+		.opb_objs	= objs,
+		.opb_count	= count,
+	};
+	int i;
+
+	if (!smp_load_acquire(&out_prep_started))
+		out_prep_threads_start();
+
+	atomic_set(&opb.opb_next, 0);
+	atomic_set(&opb.opb_users, 0);
+	if (out_prep_nthreads > 0) {
+		spin_lock(&out_prep_lock);
+		list_add_tail(&opb.opb_list, &out_prep_list);
+		out_prep_batches++;
+		spin_unlock(&out_prep_lock);
+
+		for (i = 0; i < min(count - 1, out_prep_nthreads); i++)
+			wake_up_process(out_prep_thrs[i].opt_task);
+	}
+
+	out_prep_run(env, &opb);
+
+	if (out_prep_nthreads > 0) {
+		spin_lock(&out_prep_lock);
+		list_del_init(&opb.opb_list);
+		spin_unlock(&out_prep_lock);
+		wait_var_event(&opb.opb_users,
+			       atomic_read(&opb.opb_users) == 0);
+	}
+}
+
+static void out_prep_release(const struct lu_env *env,
+			     struct out_prep_object *objs, int count,
+			     int updates)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (objs[i].opo_obj != NULL)
+			dt_object_put(env, objs[i].opo_obj);
+	}
+	OBD_FREE_LARGE(objs, updates * sizeof(*objs));
+}
+
 /**
  * Object updates between Targets. Because all the updates has been
  * dis-assemblied into object updates at sender side, so OUT will
@@ -933,6 +1219,8 @@ int out_handle(struct tgt_session_info *tsi)
 	struct object_update_reply	*reply;
 	struct ptlrpc_bulk_desc		*desc = NULL;
 	struct tg_reply_data *trd = NULL;
+	struct out_prep_object		*prep_objs = NULL;
+	int				prep_count = 0;
 	void				**update_bufs;
 	int				current_batchid = -1;
 	__u32				update_buf_count;
@@ -1092,6 +1380,18 @@ int out_handle(struct tgt_session_info *tsi)
 
 	need_reconstruct = tgt_check_resent(pill->rc_req, trd);
 
+	/* look up the independent objects in parallel, the updates are still
+	 * executed in order within the transaction of the request thread */
+	if (!need_reconstruct && out_prep_threads > 0 &&
+	    updates >= max(out_prep_min_objects, 2U)) {
+		prep_count = out_prep_collect(update_bufs, update_buf_count,
+					      updates, &prep_objs);
+		if (prep_count >= max(out_prep_min_objects, 2U))
+			out_prep_objects(env, dt, prep_objs, prep_count);
+		else if (prep_count >= 0)
+			prep_count = 0;
+	}
+
 	/* Walk through updates in the request to execute them */
 	for (i = 0; i < update_buf_count; i++) {
 		struct tgt_handler	*h;
@@ -1220,6 +1520,9 @@ out:
 	}
 
 out_free:
+	if (prep_objs != NULL)
+		out_prep_release(env, prep_objs, prep_count, updates);
+
 	if (update_bufs != NULL) {
 		if (oub != NULL) {
 			for (i = 0; i < update_buf_count; i++, oub++) {
@@ -1502,6 +1502,35 @@ void tgt_grant_commit(struct obd_export *exp, unsigned long pending,
 }
 EXPORT_SYMBOL(tgt_grant_commit);
 
+/**
+ * Compute how much space may be reserved after a write for more data
+ *
+ * The client reported in ted_dirty how much data it still has in its cache,
+ * a sequential writer is likely to send part of it to the same object next.
+ * Space reserved for it is taken from the space which isn't granted, so that
+ * it can't cause granted writes to fail with ENOSPC.
+ *
+ * \param[in] exp	export of the client which sent the write
+ * \param[in] max	upper limit of the reservation in bytes
+ *
+ * \retval		number of bytes which can be reserved, block aligned
+ */
+u64 tgt_grant_write_reserve(struct obd_export *exp, u64 max)
+{
+	struct tg_grants_data *tgd = &obd2obt(exp->exp_obd)->obt_lut->lut_tgd;
+	u64 reserve;
+
+	spin_lock(&tgd->tgd_grant_lock);
+	reserve = min_t(u64, max, max(exp->exp_target_data.ted_dirty, 0L));
+	/* many objects can be written at the same time, so each one only
+	 * takes a small part of the free space */
+	reserve = min(reserve, tgt_grant_space_left(exp) >> 6);
+	spin_unlock(&tgd->tgd_grant_lock);
+
+	return reserve & ~((1ULL << tgd->tgd_blockbits) - 1);
+}
+EXPORT_SYMBOL(tgt_grant_write_reserve);
+
 struct tgt_grant_cb {
 	/* commit callback structure */
 	struct dt_txn_commit_cb	 tgc_cb;
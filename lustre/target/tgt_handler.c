@@ -485,6 +485,10 @@ static int tgt_handle_request0(struct tgt_session_info *tsi,
 		serious = 1;
 	}
 
+	/* the reply is sent when the IO of the request is complete */
+	if (tsi->tsi_reply_deferred)
+		RETURN(0);
+
 	req->rq_status = rc;
 
 	/*
@@ -2640,9 +2644,85 @@ static void tgt_warn_on_cksum(struct ptlrpc_request *req,
 			   client_cksum, server_cksum);
 }
 
+/*
+ * BRW write whose data IO the OSD completes after the handler returns.
+ * The service thread doesn't wait for the disk: the reply is sent by
+ * whichever of the IO completion and the handler finishes last.
+ */
+struct tgt_brw_async {
+	struct dt_io_cb		 tba_cb;
+	atomic_t		 tba_refs;
+	struct lu_target	*tba_tgt;
+	struct ptlrpc_request	*tba_req;
+	struct lustre_handle	 tba_lockh;
+	int			 tba_rc;
+	int			 tba_io_rc;
+	int			 tba_fail_id;
+	/* the handler failed outside the write, reply with an error */
+	bool			 tba_serious;
+};
+
+static void tgt_brw_async_uncount(struct lu_target *lut)
+{
+	if (atomic_dec_and_test(&lut->lut_brw_async_count))
+		wake_up_var(&lut->lut_brw_async_count);
+}
+
+static void tgt_brw_async_put(struct tgt_brw_async *tba)
+{
+	struct ptlrpc_request *req = tba->tba_req;
+	struct lu_target *lut = tba->tba_tgt;
+	int rc;
+
+	if (!atomic_dec_and_test(&tba->tba_refs))
+		return;
+
+	/* the data is on disk, conflicting IO can proceed */
+	if (lustre_handle_is_used(&tba->tba_lockh))
+		tgt_data_unlock(&tba->tba_lockh, LCK_PW);
+
+	/* the reply packed by the handler doesn't know about IO errors,
+	 * which are put in rq_status only, as tgt_handle_request0() does
+	 */
+	rc = tba->tba_rc ?: tba->tba_io_rc;
+	req->rq_status = rc;
+	if (rc > 0 || !tba->tba_serious)
+		rc = 0;
+	if (rc == 0 && req->rq_export != NULL)
+		target_committed_to_req(req);
+	target_send_reply(req, rc, tba->tba_fail_id);
+
+	ptlrpc_server_drop_request(req);
+	OBD_FREE_PTR(tba);
+
+	tgt_brw_async_uncount(lut);
+}
+
+/**
+ * Wait for the BRW writes whose reply waits for their IO. Called when the
+ * target is stopping, so no new write is deferred, and before the target
+ * and its OSD are torn down, while the service can still send replies.
+ */
+void tgt_brw_async_drain(struct lu_target *lut)
+{
+	wait_var_event(&lut->lut_brw_async_count,
+		       atomic_read(&lut->lut_brw_async_count) == 0);
+}
+EXPORT_SYMBOL(tgt_brw_async_drain);
+
+static void tgt_brw_async_done(struct dt_io_cb *cb, int rc)
+{
+	struct tgt_brw_async *tba = container_of(cb, struct tgt_brw_async,
+						 tba_cb);
+
+	tba->tba_io_rc = rc;
+	tgt_brw_async_put(tba);
+}
+
 int tgt_brw_write(struct tgt_session_info *tsi)
 {
 	struct ptlrpc_request	*req = tgt_ses_req(tsi);
+	struct tgt_brw_async	*tba = NULL;
 	struct ptlrpc_bulk_desc	*desc = NULL;
 	struct obd_export	*exp = req->rq_export;
 	struct niobuf_remote	*remote_nb;
@@ -2887,10 +2967,37 @@ out_commitrw:
 	/* multiple transactions can be assigned during write commit */
 	tsi->tsi_mult_trans = 1;
 
+	if (rc == 0 && tsi->tsi_tgt->lut_brw_async_reply) {
+		/* counted before obd_stopping is checked, so that
+		 * tgt_brw_async_drain() can't miss this write
+		 */
+		atomic_inc(&tsi->tsi_tgt->lut_brw_async_count);
+		smp_mb__after_atomic();
+		if (!exp->exp_obd->obd_stopping)
+			OBD_ALLOC_PTR(tba);
+		if (tba != NULL) {
+			tba->tba_cb.dic_done = tgt_brw_async_done;
+			/* one for the IO completion, one for this thread */
+			atomic_set(&tba->tba_refs, 2);
+			tba->tba_tgt = tsi->tsi_tgt;
+			tba->tba_req = req;
+			tba->tba_lockh = lockh;
+			tsi->tsi_brw_cb = &tba->tba_cb;
+		} else {
+			tgt_brw_async_uncount(tsi->tsi_tgt);
+		}
+	}
+
 	/* Must commit after prep above in all cases */
 	rc = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp, &repbody->oa,
 			  objcount, ioo, remote_nb, npages, local_nb, rc, nob,
 			  kstart);
+	tsi->tsi_brw_cb = NULL;
+	if (tba != NULL && !tba->tba_cb.dic_deferred) {
+		OBD_FREE_PTR(tba);
+		tba = NULL;
+		tgt_brw_async_uncount(tsi->tsi_tgt);
+	}
 	if (rc == -ENOTCONN)
 		/* quota acquire process has been given up because
 		 * either the client has been evicted or the client
@@ -2930,7 +3037,9 @@ out_commitrw:
 		ptlrpc_lprocfs_brw(req, nob);
 	}
 out_lock:
-	tgt_brw_unlock(exp, ioo, remote_nb, &lockh, LCK_PW);
+	/* with the IO in flight the lock is dropped on its completion */
+	if (tba == NULL)
+		tgt_brw_unlock(exp, ioo, remote_nb, &lockh, LCK_PW);
 	if (desc)
 		ptlrpc_free_bulk(desc);
 out:
@@ -2946,6 +3055,15 @@ out:
 				      obd_export_nid2str(exp), rc);
 	}
 
+	if (tba != NULL) {
+		tba->tba_serious = is_serious(rc);
+		tba->tba_rc = clear_serious(rc);
+		tba->tba_fail_id = tsi->tsi_reply_fail_id;
+		tsi->tsi_reply_deferred = true;
+		ptlrpc_request_addref(req);
+		tgt_brw_async_put(tba);
+	}
+
 	if (mpflags)
 		memalloc_noreclaim_restore(mpflags);
 
@@ -188,6 +188,7 @@ int out_destroy_add_exec(const struct lu_env *env, struct dt_object *dt_obj,
 
 /* Update handlers */
 int out_handle(struct tgt_session_info *tsi);
+void out_prep_fini(void);
 
 #define out_tx_create(env, obj, attr, fid, dof, ta, th, reply, idx) \
 	out_create_add_exec(env, obj, attr, fid, dof, ta, th, reply, idx, \
@@ -42,16 +42,25 @@
 /** version recovery epoch */
 #define LR_EPOCH_BITS	32
 
-/* Allocate a bitmap for a chunk of reply data slots */
+/* Allocate the bitmaps for a chunk of reply data slots */
 static int tgt_bitmap_chunk_alloc(struct lu_target *lut, int chunk)
 {
 	unsigned long *bm;
+	unsigned long *cm;
 
 	OBD_ALLOC_LARGE(bm, BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
 			sizeof(long));
 	if (bm == NULL)
 		return -ENOMEM;
 
+	OBD_ALLOC_LARGE(cm, BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
+			sizeof(long));
+	if (cm == NULL) {
+		OBD_FREE_LARGE(bm, BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
+			 sizeof(long));
+		return -ENOMEM;
+	}
+
 	spin_lock(&lut->lut_client_bitmap_lock);
 
 	if (lut->lut_reply_bitmap[chunk] != NULL) {
@@ -59,9 +68,13 @@ static int tgt_bitmap_chunk_alloc(struct lu_target *lut, int chunk)
 		spin_unlock(&lut->lut_client_bitmap_lock);
 		OBD_FREE_LARGE(bm, BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
 			 sizeof(long));
+		OBD_FREE_LARGE(cm, BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
+			 sizeof(long));
 		return 0;
 	}
 
+	/* the chunk is used once its bitmap is set */
+	lut->lut_reply_cached[chunk] = cm;
 	lut->lut_reply_bitmap[chunk] = bm;
 
 	spin_unlock(&lut->lut_client_bitmap_lock);
@@ -69,40 +82,159 @@ static int tgt_bitmap_chunk_alloc(struct lu_target *lut, int chunk)
 	return 0;
 }
 
-/* Look for an available reply data slot in the bitmap
- * of the target @lut
+/* Mark the reply data slot @idx as being in a per-CPU cache, return false
+ * if it already was
+ */
+static bool tgt_cache_reply_slot(struct lu_target *lut, int idx)
+{
+	return !test_and_set_bit(idx % LUT_REPLY_SLOTS_PER_CHUNK,
+			lut->lut_reply_cached[idx / LUT_REPLY_SLOTS_PER_CHUNK]);
+}
+
+/* The reply data slot @idx was taken from a per-CPU cache */
+static void tgt_uncache_reply_slot(struct lu_target *lut, int idx)
+{
+	clear_bit(idx % LUT_REPLY_SLOTS_PER_CHUNK,
+		  lut->lut_reply_cached[idx / LUT_REPLY_SLOTS_PER_CHUNK]);
+}
+
+/* Reserve up to @count available reply data slots in the bitmap of the
+ * target @lut into @slots, lowest first, so the slots used at the same time
+ * stay dense in the reply_data file.
  * Allocate bitmap chunk when first used
- * XXX algo could be improved if this routine limits performance
  */
-static int tgt_find_free_reply_slot(struct lu_target *lut)
+static int tgt_reserve_reply_slots(struct lu_target *lut, int *slots,
+				   int count)
 {
 	unsigned long *bmp;
-	int chunk = 0;
-	int rc;
+	int hint;
+	int chunk;
+	int n = 0;
+	int rc = -ENOSPC;
 	int b;
 
-	for (chunk = 0; chunk < LUT_REPLY_SLOTS_MAX_CHUNKS; chunk++) {
+	hint = atomic_read(&lut->lut_reply_slot_hint);
+again:
+	for (chunk = hint / LUT_REPLY_SLOTS_PER_CHUNK;
+	     chunk < LUT_REPLY_SLOTS_MAX_CHUNKS && n < count; chunk++) {
 		/* allocate the bitmap chunk if necessary */
-		if (unlikely(lut->lut_reply_bitmap[chunk] == NULL)) {
-			rc = tgt_bitmap_chunk_alloc(lut, chunk);
-			if (rc != 0)
-				return rc;
+		if (unlikely(lut->lut_reply_bitmap[chunk] == NULL) &&
+		    tgt_bitmap_chunk_alloc(lut, chunk) != 0) {
+			rc = -ENOMEM;
+			break;
 		}
 		bmp = lut->lut_reply_bitmap[chunk];
 
-		/* look for an available slot in this chunk */
-		do {
-			b = find_first_zero_bit(bmp, LUT_REPLY_SLOTS_PER_CHUNK);
+		/* look for available slots in this chunk */
+		b = chunk == hint / LUT_REPLY_SLOTS_PER_CHUNK ?
+		    hint % LUT_REPLY_SLOTS_PER_CHUNK : 0;
+		while (n < count) {
+			b = find_next_zero_bit(bmp, LUT_REPLY_SLOTS_PER_CHUNK,
+					       b);
 			if (b >= LUT_REPLY_SLOTS_PER_CHUNK)
 				break;
 
 			/* found one */
 			if (test_and_set_bit(b, bmp) == 0)
-				return chunk * LUT_REPLY_SLOTS_PER_CHUNK + b;
-		} while (true);
+				slots[n++] = chunk * LUT_REPLY_SLOTS_PER_CHUNK +
+					     b;
+			b++;
+		}
+	}
+
+	if (n == 0 && hint != 0) {
+		/* slots below the hint may have been released meanwhile */
+		hint = 0;
+		goto again;
+	}
+	if (n == 0)
+		return rc;
+
+	/* no need to scan the reserved slots again, unless a slot below was
+	 * released meanwhile and the hint moved back
+	 */
+	atomic_cmpxchg(&lut->lut_reply_slot_hint, hint, slots[n - 1] + 1);
+
+	return n;
+}
+
+/* Release reply data slot @idx in the bitmap of the target @lut */
+static int tgt_release_reply_slot(struct lu_target *lut, int idx)
+{
+	int chunk = idx / LUT_REPLY_SLOTS_PER_CHUNK;
+	int b = idx % LUT_REPLY_SLOTS_PER_CHUNK;
+	int hint;
+
+	if (test_and_clear_bit(b, lut->lut_reply_bitmap[chunk]) == 0) {
+		CERROR("%s: slot %d already clear in bitmap\n",
+		       tgt_name(lut), idx);
+		return -EALREADY;
+	}
+
+	/* lower the hint so the slot is reused first */
+	hint = atomic_read(&lut->lut_reply_slot_hint);
+	while (hint > idx) {
+		int old = atomic_cmpxchg(&lut->lut_reply_slot_hint, hint, idx);
+
+		if (old == hint)
+			break;
+		hint = old;
+	}
+
+	return 0;
+}
+
+/* Look for an available reply data slot of the target @lut
+ *
+ * Slots are taken from the cache of the current CPU, which is refilled
+ * with a batch of adjacent slots reserved in the bitmap, so the bitmap is
+ * not scanned for each allocation, and the reply data written by the
+ * requests handled on one CPU go to the same blocks of reply_data.
+ */
+static int tgt_find_free_reply_slot(struct lu_target *lut)
+{
+	struct tgt_reply_slot_cache *trsc;
+	ktime_t kstart = ktime_get();
+	int slots[LUT_REPLY_SLOTS_CACHE];
+	int idx = -1;
+	int n;
+	int i;
+
+	trsc = raw_cpu_ptr(lut->lut_reply_slot_cache);
+	spin_lock(&trsc->trsc_lock);
+	if (trsc->trsc_count > 0)
+		idx = trsc->trsc_slots[--trsc->trsc_count];
+	trsc->trsc_allocs++;
+	spin_unlock(&trsc->trsc_lock);
+
+	if (idx >= 0) {
+		tgt_uncache_reply_slot(lut, idx);
+		goto out;
+	}
+
+	n = tgt_reserve_reply_slots(lut, slots, LUT_REPLY_SLOTS_CACHE);
+	if (n < 0)
+		return n;
+
+	idx = slots[0];
+	/* keep the rest in the cache, the lowest slot on top */
+	spin_lock(&trsc->trsc_lock);
+	trsc->trsc_refills++;
+	for (i = n - 1; i > 0 && trsc->trsc_count < LUT_REPLY_SLOTS_CACHE;
+	     i--) {
+		tgt_cache_reply_slot(lut, slots[i]);
+		trsc->trsc_slots[trsc->trsc_count++] = slots[i];
 	}
+	spin_unlock(&trsc->trsc_lock);
+
+	/* the cache was refilled concurrently */
+	for (; i > 0; i--)
+		tgt_release_reply_slot(lut, slots[i]);
+out:
+	lprocfs_oh_tally_log2_pcpu(&lut->lut_reply_slot_hist,
+				   ktime_to_ns(ktime_sub(ktime_get(), kstart)));
 
-	return -ENOSPC;
+	return idx;
 }
 
 /* Mark the reply data slot @idx 'used' in the corresponding bitmap chunk
@@ -144,6 +276,7 @@ static int tgt_set_reply_slot(struct lu_target *lut, int idx)
  */
 static int tgt_clear_reply_slot(struct lu_target *lut, int idx)
 {
+	struct tgt_reply_slot_cache *trsc;
 	int chunk;
 	int b;
 
@@ -166,13 +299,38 @@ static int tgt_clear_reply_slot(struct lu_target *lut, int idx)
 		return -ENOENT;
 	}
 
-	if (test_and_clear_bit(b, lut->lut_reply_bitmap[chunk]) == 0) {
+	if (!test_bit(b, lut->lut_reply_bitmap[chunk])) {
 		CERROR("%s: slot %d already clear in bitmap\n",
 		       tgt_name(lut), idx);
 		return -EALREADY;
 	}
 
-	return 0;
+	/* the slot stays set in the bitmap while it is cached, a second
+	 * release would put it in a cache twice
+	 */
+	if (!tgt_cache_reply_slot(lut, idx)) {
+		CERROR("%s: slot %d already released\n",
+		       tgt_name(lut), idx);
+		return -EALREADY;
+	}
+
+	/* recycle the slot through the cache of the current CPU, the slot
+	 * stays reserved in the bitmap
+	 */
+	trsc = raw_cpu_ptr(lut->lut_reply_slot_cache);
+	spin_lock(&trsc->trsc_lock);
+	if (trsc->trsc_count < LUT_REPLY_SLOTS_CACHE) {
+		trsc->trsc_slots[trsc->trsc_count++] = idx;
+		trsc->trsc_recycled++;
+		idx = -1;
+	}
+	spin_unlock(&trsc->trsc_lock);
+
+	if (idx < 0)
+		return 0;
+
+	tgt_uncache_reply_slot(lut, idx);
+	return tgt_release_reply_slot(lut, idx);
 }
 
 
@@ -2136,6 +2294,71 @@ int tgt_txn_stop_cb(const struct lu_env *env, struct thandle *th,
 	return rc;
 }
 
+/**
+ * Declare the last_rcvd update of a request joining a transaction.
+ *
+ * Several requests can be committed in one transaction started by the
+ * thread handling one of them (see ofd_brw_batch_commit()). The transaction
+ * hooks only cover the session of that thread, the other requests declare
+ * their last_rcvd update with this, before the transaction is started.
+ *
+ * \param[in] env	execution environment of the thread doing the updates
+ * \param[in] ses	session of the joining request
+ * \param[in] tgt	target
+ * \param[in] th	transaction handle
+ *
+ * \retval		0 on success
+ * \retval		negative value on error
+ */
+int tgt_txn_join_start(const struct lu_env *env, struct lu_context *ses,
+		       struct lu_target *tgt, struct thandle *th)
+{
+	struct lu_env *jenv = (struct lu_env *)env;
+	struct lu_context *saved = jenv->le_ses;
+	int rc;
+
+	jenv->le_ses = ses;
+	rc = tgt_txn_start_cb(jenv, th, tgt);
+	jenv->le_ses = saved;
+
+	return rc;
+}
+EXPORT_SYMBOL(tgt_txn_join_start);
+
+/**
+ * Update last_rcvd for a request joining a transaction.
+ *
+ * Assigns the transno of the request of \a ses and writes its last_rcvd or
+ * reply data, see tgt_txn_join_start(). Called before the transaction is
+ * stopped.
+ *
+ * \param[in] env	execution environment of the thread doing the updates
+ * \param[in] ses	session of the joining request
+ * \param[in] tgt	target
+ * \param[in] th	transaction handle
+ * \param[in] result	result of the request
+ *
+ * \retval		0 on success
+ * \retval		negative value on error
+ */
+int tgt_txn_join_stop(const struct lu_env *env, struct lu_context *ses,
+		      struct lu_target *tgt, struct thandle *th, int result)
+{
+	struct lu_env *jenv = (struct lu_env *)env;
+	struct lu_context *saved = jenv->le_ses;
+	int saved_result = th->th_result;
+	int rc;
+
+	jenv->le_ses = ses;
+	th->th_result = result;
+	rc = tgt_txn_stop_cb(jenv, th, tgt);
+	th->th_result = saved_result;
+	jenv->le_ses = saved;
+
+	return rc;
+}
+EXPORT_SYMBOL(tgt_txn_join_stop);
+
 int tgt_reply_data_init(const struct lu_env *env, struct lu_target *tgt)
 {
 	struct tgt_thread_info	*tti = tgt_th_info(env);
@@ -494,8 +494,11 @@ int tgt_init(const struct lu_env *env, struct lu_target *lut,
 	lut->lut_client_bitmap = NULL;
 	atomic_set(&lut->lut_num_clients, 0);
 	atomic_set(&lut->lut_client_generation, 0);
+	atomic_set(&lut->lut_brw_async_count, 0);
 	lut->lut_reply_data = NULL;
 	lut->lut_reply_bitmap = NULL;
+	lut->lut_reply_cached = NULL;
+	lut->lut_reply_slot_cache = NULL;
 	obt = obd_obt_init(obd);
 	obt->obt_lut = lut;
 
@@ -604,6 +607,24 @@ int tgt_init(const struct lu_env *env, struct lu_target *lut,
 	if (lut->lut_reply_bitmap == NULL)
 		GOTO(out, rc = -ENOMEM);
 
+	OBD_ALLOC(lut->lut_reply_cached,
+		  LUT_REPLY_SLOTS_MAX_CHUNKS * sizeof(unsigned long *));
+	if (lut->lut_reply_cached == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	lut->lut_reply_slot_cache = alloc_percpu(struct tgt_reply_slot_cache);
+	if (lut->lut_reply_slot_cache == NULL)
+		GOTO(out, rc = -ENOMEM);
+	for_each_possible_cpu(i)
+		spin_lock_init(&per_cpu_ptr(lut->lut_reply_slot_cache,
+					    i)->trsc_lock);
+	atomic_set(&lut->lut_reply_slot_hint, 0);
+
+	rc = lprocfs_oh_alloc_pcpu(&lut->lut_reply_slot_hist);
+	if (rc)
+		GOTO(out, rc);
+	lut->lut_reply_slot_init = ktime_get_real();
+
 	memset(&attr, 0, sizeof(attr));
 	attr.la_valid = LA_MODE;
 	attr.la_mode = S_IFREG | S_IRUGO | S_IWUSR;
@@ -653,6 +674,22 @@ out_put:
 			 LUT_REPLY_SLOTS_MAX_CHUNKS * sizeof(unsigned long *));
 	}
 	lut->lut_reply_bitmap = NULL;
+	if (lut->lut_reply_cached != NULL) {
+		for (i = 0; i < LUT_REPLY_SLOTS_MAX_CHUNKS; i++) {
+			if (lut->lut_reply_cached[i] != NULL)
+				OBD_FREE_LARGE(lut->lut_reply_cached[i],
+				    BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
+				    sizeof(long));
+			lut->lut_reply_cached[i] = NULL;
+		}
+		OBD_FREE(lut->lut_reply_cached,
+			 LUT_REPLY_SLOTS_MAX_CHUNKS * sizeof(unsigned long *));
+	}
+	lut->lut_reply_cached = NULL;
+	if (lut->lut_reply_slot_cache != NULL)
+		free_percpu(lut->lut_reply_slot_cache);
+	lut->lut_reply_slot_cache = NULL;
+	lprocfs_oh_release_pcpu(&lut->lut_reply_slot_hist);
 	return rc;
 }
 EXPORT_SYMBOL(tgt_init);
@@ -692,6 +729,22 @@ void tgt_fini(const struct lu_env *env, struct lu_target *lut)
 			 LUT_REPLY_SLOTS_MAX_CHUNKS * sizeof(unsigned long *));
 	}
 	lut->lut_reply_bitmap = NULL;
+	if (lut->lut_reply_cached != NULL) {
+		for (i = 0; i < LUT_REPLY_SLOTS_MAX_CHUNKS; i++) {
+			if (lut->lut_reply_cached[i] != NULL)
+				OBD_FREE_LARGE(lut->lut_reply_cached[i],
+				    BITS_TO_LONGS(LUT_REPLY_SLOTS_PER_CHUNK) *
+				    sizeof(long));
+			lut->lut_reply_cached[i] = NULL;
+		}
+		OBD_FREE(lut->lut_reply_cached,
+			 LUT_REPLY_SLOTS_MAX_CHUNKS * sizeof(unsigned long *));
+	}
+	lut->lut_reply_cached = NULL;
+	if (lut->lut_reply_slot_cache != NULL)
+		free_percpu(lut->lut_reply_slot_cache);
+	lut->lut_reply_slot_cache = NULL;
+	lprocfs_oh_release_pcpu(&lut->lut_reply_slot_hist);
 	if (lut->lut_client_bitmap) {
 		OBD_FREE(lut->lut_client_bitmap, LR_MAX_CLIENTS >> 3);
 		lut->lut_client_bitmap = NULL;
@@ -807,6 +860,8 @@ static void tgt_ses_key_exit(const struct lu_context *ctx,
 	tsi->tsi_batch_trd = NULL;
 	tsi->tsi_batch_env = false;
 	tsi->tsi_batch_idx = 0;
+	tsi->tsi_brw_cb = NULL;
+	tsi->tsi_reply_deferred = false;
 }
 
 /* context key: tgt_session_key */
@@ -860,6 +915,7 @@ int tgt_mod_init(void)
 
 void tgt_mod_exit(void)
 {
+	out_prep_fini();
 	barrier_fini();
 	if (tgt_page_to_corrupt != NULL)
 		put_page(tgt_page_to_corrupt);
@@ -50,6 +50,7 @@
 #define DEBUG_SUBSYSTEM S_CLASS
 
 #include <linux/kthread.h>
+#include <linux/sort.h>
 #include <lu_target.h>
 #include <lustre_log.h>
 #include <lustre_update.h>
@@ -1266,57 +1267,361 @@ void top_multiple_thandle_destroy(struct kref *kref)
 }
 EXPORT_SYMBOL(top_multiple_thandle_destroy);
 
+/* Update log cookies of committed distribute transactions on one target */
+struct distribute_txn_cancel_group {
+	struct list_head	 dtcg_list;
+	struct obd_device	*dtcg_obd;
+	struct llog_cookie	*dtcg_cookies;
+	int			 dtcg_count;
+	int			 dtcg_size;
+};
+
+struct distribute_txn_cancel_thread {
+	struct target_distribute_txn_data *dtct_tdtd;
+	struct task_struct	*dtct_task;
+	struct lu_env		 dtct_env;
+};
+
+#define DISTRIBUTE_TXN_CANCEL_THREADS	4
+#define DISTRIBUTE_TXN_CANCEL_COOKIES	64
+
+static int distribute_txn_cookie_cmp(const void *a, const void *b)
+{
+	const struct llog_cookie *c1 = a;
+	const struct llog_cookie *c2 = b;
+	int rc;
+
+	rc = lu_fid_cmp(&c1->lgc_lgl.lgl_oi.oi_fid, &c2->lgc_lgl.lgl_oi.oi_fid);
+	if (rc != 0)
+		return rc;
+	if (c1->lgc_lgl.lgl_ogen != c2->lgc_lgl.lgl_ogen)
+		return c1->lgc_lgl.lgl_ogen < c2->lgc_lgl.lgl_ogen ? -1 : 1;
+	if (c1->lgc_index != c2->lgc_index)
+		return c1->lgc_index < c2->lgc_index ? -1 : 1;
+	return 0;
+}
+
+static inline bool distribute_txn_logid_eq(const struct llog_logid *l1,
+					   const struct llog_logid *l2)
+{
+	return lu_fid_eq(&l1->lgl_oi.oi_fid, &l2->lgl_oi.oi_fid) &&
+	       l1->lgl_ogen == l2->lgl_ogen;
+}
+
+/**
+ * Cancel update log records on one MDT
+ *
+ * The records are sorted by llog, so all the records of one plain llog
+ * are cancelled by a single llog transaction. If that fails, e.g. because
+ * one of the records was cancelled already, fall back to cancelling the
+ * records of this llog one by one.
+ *
+ * \param[in] env	execution environment
+ * \param[in] obd	the target where the update logs are
+ * \param[in] cookies	update log records to be cancelled
+ * \param[in] count	number of records
+ */
+static void distribute_txn_cancel_cookies(const struct lu_env *env,
+					  struct obd_device *obd,
+					  struct llog_cookie *cookies,
+					  int count)
+{
+	struct llog_ctxt *ctxt;
+	int *index = NULL;
+	int i, j;
+
+	ctxt = llog_get_context(obd, LLOG_UPDATELOG_ORIG_CTXT);
+	if (ctxt == NULL)
+		return;
+
+	if (count > 1) {
+		sort(cookies, count, sizeof(*cookies),
+		     distribute_txn_cookie_cmp, NULL);
+		OBD_ALLOC_LARGE(index, count * sizeof(*index));
+	}
+
+	for (i = 0; i < count; i = j) {
+		struct llog_logid *lgl = &cookies[i].lgc_lgl;
+		int num = 0;
+		int rc = 1;
+
+		for (j = i; j < count &&
+		     distribute_txn_logid_eq(&cookies[j].lgc_lgl, lgl); j++) {
+			if (index == NULL)
+				continue;
+			/* the same record may be referred twice */
+			if (num > 0 && index[num - 1] == cookies[j].lgc_index)
+				continue;
+			index[num++] = cookies[j].lgc_index;
+		}
+
+		if (num > 1)
+			rc = llog_cat_cancel_arr_rec(env, ctxt->loc_handle, lgl,
+						     num, index);
+		/* single record, no memory for batching or the batch failed */
+		if (rc != 0)
+			rc = llog_cat_cancel_records(env, ctxt->loc_handle,
+						     j - i, &cookies[i]);
+		CDEBUG(D_HA, "%s: cancel %d update log records in "DFID
+		       ": rc = %d\n", obd->obd_name, j - i, PLOGID(lgl), rc);
+	}
+
+	if (index != NULL)
+		OBD_FREE_LARGE(index, count * sizeof(*index));
+	llog_ctxt_put(ctxt);
+}
+
+static struct distribute_txn_cancel_group *
+distribute_txn_cancel_group_find(struct list_head *groups,
+				 struct obd_device *obd)
+{
+	struct distribute_txn_cancel_group *dtcg;
+
+	list_for_each_entry(dtcg, groups, dtcg_list) {
+		if (dtcg->dtcg_obd == obd)
+			return dtcg;
+	}
+
+	OBD_ALLOC_PTR(dtcg);
+	if (dtcg == NULL)
+		return NULL;
+
+	dtcg->dtcg_obd = obd;
+	list_add_tail(&dtcg->dtcg_list, groups);
+
+	return dtcg;
+}
+
+static int
+distribute_txn_cancel_group_add(struct distribute_txn_cancel_group *dtcg,
+				struct llog_cookie *cookie)
+{
+	if (dtcg->dtcg_count == dtcg->dtcg_size) {
+		struct llog_cookie *cookies;
+		int size;
+
+		size = max(dtcg->dtcg_size * 2, DISTRIBUTE_TXN_CANCEL_COOKIES);
+		OBD_ALLOC_LARGE(cookies, size * sizeof(*cookies));
+		if (cookies == NULL)
+			return -ENOMEM;
+
+		if (dtcg->dtcg_cookies != NULL) {
+			memcpy(cookies, dtcg->dtcg_cookies,
+			       dtcg->dtcg_count * sizeof(*cookies));
+			OBD_FREE_LARGE(dtcg->dtcg_cookies,
+				       dtcg->dtcg_size * sizeof(*cookies));
+		}
+		dtcg->dtcg_cookies = cookies;
+		dtcg->dtcg_size = size;
+	}
+	dtcg->dtcg_cookies[dtcg->dtcg_count++] = *cookie;
+
+	return 0;
+}
+
 /**
  * Cancel the update log on MDTs
  *
- * Cancel the update log on MDTs then destroy the thandle.
+ * Collect the update log records of the committed distribute transaction
+ * into \a groups, one group per MDT, so that records of many transactions
+ * can be cancelled together by distribute_txn_cancel_groups(). If there is
+ * no memory to do that, the record is cancelled right away.
  *
  * \param[in] env	execution environment
  * \param[in] tmt	the top multiple thandle whose updates records
  *                      will be cancelled.
- *
- * \retval		0 if cancellation succeeds.
- * \retval		negative errno if cancellation fails.
+ * \param[in] groups	list of per-MDT groups of records to be cancelled
  */
-static int distribute_txn_cancel_records(const struct lu_env *env,
-					 struct top_multiple_thandle *tmt)
+static void distribute_txn_cancel_records(const struct lu_env *env,
+					  struct top_multiple_thandle *tmt,
+					  struct list_head *groups)
 {
 	struct sub_thandle *st;
 	ENTRY;
 
 	if (CFS_FAIL_CHECK(OBD_FAIL_TGT_TXN_NO_CANCEL))
-		RETURN(0);
+		RETURN_EXIT;
 
 	top_multiple_thandle_dump(tmt, D_INFO);
 	/* Cancel update logs on other MDTs */
 	list_for_each_entry(st, &tmt->tmt_sub_thandle_list, st_sub_list) {
-		struct llog_ctxt	*ctxt;
+		struct distribute_txn_cancel_group *dtcg = NULL;
 		struct obd_device	*obd;
 		struct llog_cookie	*cookie;
 		struct sub_thandle_cookie *stc;
-		int rc;
 
 		obd = st->st_dt->dd_lu_dev.ld_obd;
-		ctxt = llog_get_context(obd, LLOG_UPDATELOG_ORIG_CTXT);
-		if (ctxt == NULL)
-			continue;
 		list_for_each_entry(stc, &st->st_cookie_list, stc_list) {
 			cookie = &stc->stc_cookie;
 			if (fid_is_zero(&cookie->lgc_lgl.lgl_oi.oi_fid))
 				continue;
 
-			rc = llog_cat_cancel_records(env, ctxt->loc_handle, 1,
-						     cookie);
+			if (dtcg == NULL)
+				dtcg = distribute_txn_cancel_group_find(groups,
+									obd);
+			if (dtcg != NULL &&
+			    distribute_txn_cancel_group_add(dtcg, cookie) == 0)
+				continue;
+
 			CDEBUG(D_HA, "%s: batchid %llu cancel update log "
-			       DFID".%u: rc = %d\n", obd->obd_name,
-			       tmt->tmt_batchid, PLOGID(&cookie->lgc_lgl),
-			       cookie->lgc_index, rc);
+			       DFID".%u\n", obd->obd_name, tmt->tmt_batchid,
+			       PLOGID(&cookie->lgc_lgl), cookie->lgc_index);
+			distribute_txn_cancel_cookies(env, obd, cookie, 1);
+		}
+	}
+
+	EXIT;
+}
+
+static struct distribute_txn_cancel_group *
+distribute_txn_cancel_group_get(struct target_distribute_txn_data *tdtd)
+{
+	struct distribute_txn_cancel_group *dtcg;
+
+	spin_lock(&tdtd->tdtd_cancel_lock);
+	dtcg = list_first_entry_or_null(&tdtd->tdtd_cancel_list,
+					struct distribute_txn_cancel_group,
+					dtcg_list);
+	if (dtcg != NULL)
+		list_del_init(&dtcg->dtcg_list);
+	spin_unlock(&tdtd->tdtd_cancel_lock);
+
+	return dtcg;
+}
+
+static void distribute_txn_cancel_group(const struct lu_env *env,
+					struct target_distribute_txn_data *tdtd,
+					struct distribute_txn_cancel_group *dtcg)
+{
+	distribute_txn_cancel_cookies(env, dtcg->dtcg_obd, dtcg->dtcg_cookies,
+				      dtcg->dtcg_count);
+	if (dtcg->dtcg_cookies != NULL)
+		OBD_FREE_LARGE(dtcg->dtcg_cookies,
+			       dtcg->dtcg_size * sizeof(*dtcg->dtcg_cookies));
+	OBD_FREE_PTR(dtcg);
+
+	if (atomic_dec_and_test(&tdtd->tdtd_cancel_pending))
+		wake_up_var(&tdtd->tdtd_cancel_pending);
+}
+
+/**
+ * Cancel the collected update log records
+ *
+ * Each group holds the records on one MDT, and the groups are handed to the
+ * cancel threads, so that the records on different MDTs are cancelled in
+ * parallel. The commit thread handles groups itself as well, and returns
+ * once all of them are done, so the transactions can be released.
+ *
+ * \param[in] env	execution environment
+ * \param[in] tdtd	distribute transaction data
+ * \param[in] groups	list of per-MDT groups of records to be cancelled
+ */
+static void distribute_txn_cancel_groups(const struct lu_env *env,
+					struct target_distribute_txn_data *tdtd,
+					struct list_head *groups)
+{
+	struct distribute_txn_cancel_group *dtcg;
+	int count = 0;
+	int i;
+
+	list_for_each_entry(dtcg, groups, dtcg_list)
+		count++;
+	if (count == 0)
+		return;
+
+	atomic_add(count, &tdtd->tdtd_cancel_pending);
+	spin_lock(&tdtd->tdtd_cancel_lock);
+	list_splice_tail_init(groups, &tdtd->tdtd_cancel_list);
+	spin_unlock(&tdtd->tdtd_cancel_lock);
+
+	for (i = 0; i < min(count - 1, tdtd->tdtd_cancel_nthreads); i++)
+		wake_up_process(tdtd->tdtd_cancel_threads[i].dtct_task);
+
+	while ((dtcg = distribute_txn_cancel_group_get(tdtd)) != NULL)
+		distribute_txn_cancel_group(env, tdtd, dtcg);
+
+	wait_var_event(&tdtd->tdtd_cancel_pending,
+		       atomic_read(&tdtd->tdtd_cancel_pending) == 0);
+}
+
+static int distribute_txn_cancel_thread(void *_arg)
+{
+	struct distribute_txn_cancel_thread *dtct = _arg;
+	struct target_distribute_txn_data *tdtd = dtct->dtct_tdtd;
+	struct distribute_txn_cancel_group *dtcg;
+
+	while (({set_current_state(TASK_IDLE);
+		 !kthread_should_stop(); })) {
+		dtcg = distribute_txn_cancel_group_get(tdtd);
+		if (dtcg == NULL) {
+			schedule();
+			continue;
 		}
+		__set_current_state(TASK_RUNNING);
+		distribute_txn_cancel_group(&dtct->dtct_env, tdtd, dtcg);
+	}
+	__set_current_state(TASK_RUNNING);
 
-		llog_ctxt_put(ctxt);
+	return 0;
+}
+
+static void distribute_txn_cancel_threads_stop(
+				struct target_distribute_txn_data *tdtd)
+{
+	int i;
+
+	if (tdtd->tdtd_cancel_threads == NULL)
+		return;
+
+	for (i = 0; i < tdtd->tdtd_cancel_nthreads; i++) {
+		kthread_stop(tdtd->tdtd_cancel_threads[i].dtct_task);
+		lu_env_fini(&tdtd->tdtd_cancel_threads[i].dtct_env);
 	}
+	OBD_FREE_PTR_ARRAY(tdtd->tdtd_cancel_threads,
+			   DISTRIBUTE_TXN_CANCEL_THREADS);
+	tdtd->tdtd_cancel_threads = NULL;
+	tdtd->tdtd_cancel_nthreads = 0;
+}
 
-	RETURN(0);
+/* The commit thread cancels records itself if no cancel thread could start */
+static void distribute_txn_cancel_threads_start(
+				struct target_distribute_txn_data *tdtd,
+				__u32 index)
+{
+	int nthreads = min_t(int, DISTRIBUTE_TXN_CANCEL_THREADS,
+			     num_online_cpus() - 1);
+	int i;
+
+	if (nthreads <= 0)
+		return;
+
+	OBD_ALLOC_PTR_ARRAY(tdtd->tdtd_cancel_threads,
+			    DISTRIBUTE_TXN_CANCEL_THREADS);
+	if (tdtd->tdtd_cancel_threads == NULL)
+		return;
+
+	for (i = 0; i < nthreads; i++) {
+		struct distribute_txn_cancel_thread *dtct;
+		struct task_struct *task;
+
+		dtct = &tdtd->tdtd_cancel_threads[i];
+		dtct->dtct_tdtd = tdtd;
+		if (lu_env_init(&dtct->dtct_env, LCT_LOCAL | LCT_MD_THREAD))
+			break;
+
+		task = kthread_create(distribute_txn_cancel_thread, dtct,
+				      "dist_cancel-%u_%d", index, i);
+		if (IS_ERR(task)) {
+			lu_env_fini(&dtct->dtct_env);
+			break;
+		}
+		dtct->dtct_task = task;
+		tdtd->tdtd_cancel_nthreads++;
+		wake_up_process(task);
+	}
+
+	if (tdtd->tdtd_cancel_nthreads == 0)
+		distribute_txn_cancel_threads_stop(tdtd);
 }
 
 struct distribute_txn_bid_data {
@@ -1525,6 +1830,8 @@ static int distribute_txn_commit_thread(void *_arg)
 	struct target_distribute_txn_data *tdtd = _arg;
 	struct lu_env		*env = &tdtd->tdtd_env;
 	LIST_HEAD(list);
+	LIST_HEAD(cancel_list);
+	LIST_HEAD(groups);
 	int			 rc;
 	struct top_multiple_thandle *tmt;
 	struct top_multiple_thandle *tmp;
@@ -1602,9 +1909,16 @@ static int distribute_txn_commit_thread(void *_arg)
 			if (tmt->tmt_batchid > committed)
 				break;
 			__set_current_state(TASK_RUNNING);
-			list_del_init(&tmt->tmt_commit_list);
+			list_move_tail(&tmt->tmt_commit_list, &cancel_list);
 			if (tmt->tmt_result <= 0)
-				distribute_txn_cancel_records(env, tmt);
+				distribute_txn_cancel_records(env, tmt,
+							      &groups);
+		}
+		/* cancel records of all these transactions per MDT at once */
+		distribute_txn_cancel_groups(env, tdtd, &groups);
+		list_for_each_entry_safe(tmt, tmp, &cancel_list,
+					 tmt_commit_list) {
+			list_del_init(&tmt->tmt_commit_list);
 			top_multiple_thandle_put(tmt);
 		}
 
@@ -1671,6 +1985,11 @@ int distribute_txn_init(const struct lu_env *env,
 	init_waitqueue_head(&tdtd->tdtd_recovery_threads_waitq);
 	atomic_set(&tdtd->tdtd_refcount, 0);
 	atomic_set(&tdtd->tdtd_recovery_threads_count, 0);
+	spin_lock_init(&tdtd->tdtd_cancel_lock);
+	INIT_LIST_HEAD(&tdtd->tdtd_cancel_list);
+	atomic_set(&tdtd->tdtd_cancel_pending, 0);
+	tdtd->tdtd_cancel_threads = NULL;
+	tdtd->tdtd_cancel_nthreads = 0;
 
 	tdtd->tdtd_lut = lut;
 	if (lut->lut_bottom->dd_rdonly)
@@ -1684,9 +2003,12 @@ int distribute_txn_init(const struct lu_env *env,
 	if (rc)
 		RETURN(rc);
 
+	distribute_txn_cancel_threads_start(tdtd, index);
+
 	task = kthread_create(distribute_txn_commit_thread, tdtd, "dist_txn-%u",
 			      index);
 	if (IS_ERR(task)) {
+		distribute_txn_cancel_threads_stop(tdtd);
 		lu_env_fini(&tdtd->tdtd_env);
 		RETURN(PTR_ERR(task));
 	}
@@ -1717,6 +2039,7 @@ void distribute_txn_fini(const struct lu_env *env,
 
 	kthread_stop(tdtd->tdtd_commit_task);
 	tdtd->tdtd_commit_task = NULL;
+	distribute_txn_cancel_threads_stop(tdtd);
 
 	spin_lock(&tdtd->tdtd_batchid_lock);
 	list_splice_init(&tdtd->tdtd_list, &list);
@@ -3041,6 +3041,68 @@ test_225() {
 }
 run_test 225 "Check avoid_asym_router_failure=0 w/DD disabled"
 
+test_226() {
+	[[ ${NETTYPE} == kfi* ]] && skip "kfi doesn't support delay rules"
+
+	local param=/sys/module/lnet/parameters/lnet_latency_select
+
+	reinit_dlc || return $?
+
+	[[ -e $param ]] || skip "no lnet_latency_select support"
+
+	add_net "${NETTYPE}1" "${INTERFACES[0]}" || return $?
+	add_net "${NETTYPE}2" "${INTERFACES[0]}" || return $?
+
+	local nid1=$($LCTL list_nids | head -n 1)
+	local nid2=$($LCTL list_nids | tail --lines 1)
+
+	do_lnetctl peer add --prim $nid1 --nid $nid2 ||
+		error "Failed to add peer"
+
+	echo 1 > $param
+	stack_trap "echo 0 > $param"
+
+	# make the second rail slow
+	$LCTL net_delay_add -s "*@${NETTYPE}2" -d "*@${NETTYPE}2" -r 1 -l 1 ||
+		error "Failed to add delay rule"
+	stack_trap "$LCTL net_delay_del -a"
+
+	# round-robin over both rails until each has been measured
+	local i
+
+	for i in {1..8}; do
+		$LNETCTL ping $nid1 &>/dev/null ||
+			error "$LNETCTL ping $nid1 failed"
+	done
+
+	# rtt_usec is part of the health stats, shown from verbose level 3
+	local rtt1=$($LNETCTL net show -v 3 --net ${NETTYPE}1 |
+		     awk '/rtt_usec:/{print $NF; exit}')
+	local rtt2=$($LNETCTL net show -v 3 --net ${NETTYPE}2 |
+		     awk '/rtt_usec:/{print $NF; exit}')
+
+	echo "rtt_usec $nid1: $rtt1 $nid2: $rtt2"
+	(( rtt1 > 0 && rtt2 > rtt1 )) ||
+		error "rtt of the delayed rail not measured"
+
+	ni_stats_pre
+
+	for i in {1..10}; do
+		$LNETCTL ping $nid1 &>/dev/null ||
+			error "$LNETCTL ping $nid1 failed"
+	done
+
+	ni_stats_post
+
+	ni_stat_changed nid1 send_count ||
+		error "send_count unchanged for $nid1"
+	ni_stat_changed nid2 send_count &&
+		error "delayed rail $nid2 still selected"
+
+	return 0
+}
+run_test 226 "Multi-Rail selection prefers the faster rail"
+
 test_230() {
 	[[ ${NETTYPE} == tcp* ]] ||
 		skip "Need tcp NETTYPE"
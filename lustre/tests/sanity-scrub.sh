@@ -1483,6 +1483,29 @@ test_21() {
 }
 run_test 21 "don't hang MDS recovery when failed to get update log"
 
+test_22() {
+	[ "$mds1_FSTYPE" == "ldiskfs" ] || skip "ldiskfs only test"
+
+	local opts=$(csa_add "$MOUNT_OPTS_SCRUB" -o resetoi)
+	local groups
+	local n
+
+	scrub_prep 100
+	scrub_start_mds 1 "$opts"
+	scrub_check_status 2 completed
+	for n in $(seq $MDSCOUNT); do
+		scrub_status $n | grep "^bulk_"
+		groups=$(scrub_status $n | awk '/^bulk_groups:/ { print $2 }')
+		[ -n "$groups" ] ||
+			error "(3) OI files not rebuilt in parallel on mds$n"
+		[ "${groups%/*}" == "${groups#*/}" ] ||
+			error "(4) OI rebuild on mds$n scanned $groups groups"
+	done
+	mount_client $MOUNT || error "(5) Fail to start client!"
+	scrub_check_data 6
+}
+run_test 22 "OI scrub rebuilds recreated OI files in parallel"
+
 
 # restore MDS/OST size
 MDSSIZE=${SAVED_MDSSIZE}
@@ -3549,6 +3549,38 @@ test_27V() {
 }
 run_test 27V "creating widely striped file races with deactivating OST"
 
+test_27W() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run"
+	remote_mds_nodsh && skip "remote MDS with nodsh"
+
+	local param=osp.$FSNAME-OST0000-osc-MDT0000.prealloc_stats
+
+	do_facet mds1 $LCTL get_param $param > /dev/null 2>&1 ||
+		skip "MDS does not support prealloc_stats"
+
+	do_facet mds1 $LCTL set_param $param=clear
+
+	test_mkdir -i 0 -c 1 $DIR/$tdir
+	$LFS setstripe -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+	createmany -o $DIR/$tdir/f- 5000 || error "createmany failed"
+	stack_trap "unlinkmany $DIR/$tdir/f- 5000"
+
+	do_facet mds1 $LCTL get_param $param
+	local rate=$(do_facet mds1 $LCTL get_param -n $param |
+		     awk '/create_rate:/ { print $2 }')
+	local rpc=$(do_facet mds1 $LCTL get_param -n $param |
+		    awk '/rpc_time:/ { print $2 }')
+
+	(( rate > 0 )) || error "create rate not tracked"
+	(( rpc > 0 )) || error "precreate RPC time not tracked"
+
+	do_facet mds1 $LCTL set_param $param=clear
+	(( $(do_facet mds1 $LCTL get_param -n $param |
+	     awk '/stalls:/ { print $2 }') == 0 )) ||
+		error "stalls not cleared"
+}
+run_test 27W "precreate follows the create rate"
+
 # createtest also checks that device nodes are created and
 # then visible correctly (#2091)
 test_28() { # bug 2091
@@ -6424,6 +6456,19 @@ test_55b() {
 }
 run_test 55b "Load and unload max OBD devices"
 
+test_55c() {
+	load_module ptlrpc/pack_test iterations=20000 ||
+		error "load_module failed"
+
+	dmesg | tail -n 25 | grep "Lustre: pack_test:"
+	dmesg | tail -n 25 | grep "Lustre: pack_test:.*FAIL" &&
+		error "RPC packing unit test failed"
+
+	rmmod -v pack_test ||
+		error "rmmod failed (may trigger a failure in a later test)"
+}
+run_test 55c "RPC message packing microbenchmark"
+
 test_56a() {
 	local numfiles=3
 	local numdirs=2
@@ -9881,6 +9926,50 @@ test_64i() {
 }
 run_test 64i "shrink on reconnect"
 
+test_64j() {
+	[ "$ost1_FSTYPE" == "ldiskfs" ] || skip "ldiskfs only test"
+	remote_ost_nodsh && skip "remote OSTs with nodsh"
+	[ $PARALLEL == "yes" ] && skip "skip parallel run"
+
+	local max=$(do_facet ost1 $LCTL get_param -n \
+		    obdfilter.$FSNAME-OST0000.alloc_reserve_max 2>/dev/null)
+
+	[[ -n "$max" ]] || skip "OST does not support alloc_reserve_max"
+
+	do_facet ost1 $LCTL set_param \
+		obdfilter.$FSNAME-OST0000.alloc_reserve_max=4M
+	stack_trap "do_facet ost1 $LCTL set_param \
+		obdfilter.$FSNAME-OST0000.alloc_reserve_max=$max"
+	do_facet ost1 $LCTL set_param osd-ldiskfs.$FSNAME-OST0000.alloc_stats=0
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile
+	stack_trap "rm -f $DIR/$tfile"
+
+	dd if=/dev/urandom of=$TMP/$tfile bs=1M count=16 ||
+		error "dd to $TMP/$tfile failed"
+	stack_trap "rm -f $TMP/$tfile"
+	dd if=$TMP/$tfile of=$DIR/$tfile bs=1M || error "dd failed"
+	sync
+
+	do_facet ost1 $LCTL get_param osd-ldiskfs.$FSNAME-OST0000.alloc_stats
+	local reserved=$(do_facet ost1 $LCTL get_param -n \
+		osd-ldiskfs.$FSNAME-OST0000.alloc_stats |
+		awk '/reserved_blocks:/ { print $2 }')
+
+	(( reserved > 0 )) || error "no blocks reserved for sequential write"
+
+	cancel_lru_locks osc
+	cmp $TMP/$tfile $DIR/$tfile || error "data mismatch"
+	(( $(stat -c %s $DIR/$tfile) == 16 * 1048576 )) ||
+		error "wrong size $(stat -c %s $DIR/$tfile)"
+
+	# the reservation past EOF goes away with truncate
+	$TRUNCATE $DIR/$tfile 1048576 || error "truncate failed"
+	cancel_lru_locks osc
+	cmp -n 1048576 $TMP/$tfile $DIR/$tfile || error "data mismatch"
+}
+run_test 64j "reserve blocks after sequential writes"
+
 # bug 1414 - set/get directories' stripe info
 test_65a() {
 	[ $PARALLEL == "yes" ] && skip "skip parallel run"
@@ -13501,6 +13590,99 @@ test_118n()
 }
 run_test 118n "statfs() sends OST_STATFS requests in parallel"
 
+test_118o()
+{
+	remote_ost_nodsh && skip "remote OSTs with nodsh"
+
+	local osts=$(comma_list $(osts_nodes))
+	local param="obdfilter.$FSNAME-OST*.brw_async_reply"
+	local old=$(do_facet ost1 $LCTL get_param -n $param | head -n1)
+
+	[[ -n "$old" ]] || skip "no brw_async_reply support"
+
+	do_nodes $osts $LCTL set_param $param=1
+	stack_trap "do_nodes $osts $LCTL set_param -n $param=$old"
+
+	$LFS setstripe -c -1 $DIR/$tfile || error "setstripe failed"
+	dd if=/dev/urandom of=$TMP/$tfile bs=1M count=32 ||
+		error "dd to $TMP/$tfile failed"
+	stack_trap "rm -f $TMP/$tfile"
+
+	# buffered writes of several RPCs in flight, and O_DIRECT
+	dd if=$TMP/$tfile of=$DIR/$tfile bs=1M conv=fsync ||
+		error "buffered write failed"
+	cancel_lru_locks osc
+	cmp $TMP/$tfile $DIR/$tfile || error "data mismatch after write"
+
+	dd if=$TMP/$tfile of=$DIR/$tfile bs=4M oflag=direct ||
+		error "direct write failed"
+	cancel_lru_locks osc
+	cmp $TMP/$tfile $DIR/$tfile || error "data mismatch after dio"
+
+	#define OBD_FAIL_OST_BRW_PAUSE_BULK2     0x227
+	do_nodes $osts $LCTL set_param fail_loc=0x227 fail_val=1
+	dd if=$TMP/$tfile of=$DIR/$tfile bs=1M oflag=direct ||
+		error "direct write with delayed commit failed"
+	do_nodes $osts $LCTL set_param fail_loc=0 fail_val=0
+	cancel_lru_locks osc
+	cmp $TMP/$tfile $DIR/$tfile || error "data mismatch after delay"
+}
+run_test 118o "BRW write replies sent on IO completion"
+
+test_118p()
+{
+	remote_ost_nodsh && skip "remote OSTs with nodsh"
+	[ $PARALLEL == "yes" ] && skip "skip parallel run"
+
+	local param="obdfilter.$FSNAME-OST0000.brw_batch_pages"
+	local old=$(do_facet ost1 $LCTL get_param -n $param 2>/dev/null)
+
+	[[ -n "$old" ]] || skip "no brw_batch_pages support"
+
+	do_facet ost1 $LCTL set_param $param=16
+	stack_trap "do_facet ost1 $LCTL set_param -n $param=$old"
+
+	local before=$(do_facet ost1 $LCTL get_param -n \
+		       obdfilter.$FSNAME-OST0000.brw_batched)
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -c 1 -i 0 $DIR/$tdir || error "setstripe failed"
+	dd if=/dev/urandom of=$TMP/$tfile bs=4k count=4 ||
+		error "dd to $TMP/$tfile failed"
+	stack_trap "rm -f $TMP/$tfile"
+
+	# many small writes to different objects in parallel
+	local i j
+	local pids=()
+
+	for ((i = 0; i < 32; i++)); do
+		(
+			for ((j = 0; j < 16; j++)); do
+				cp $TMP/$tfile $DIR/$tdir/$tfile.$i.$j ||
+					exit 1
+				$MULTIOP $DIR/$tdir/$tfile.$i.$j oyc ||
+					exit 1
+			done
+		) &
+		pids+=($!)
+	done
+	for i in ${pids[@]}; do
+		wait $i || error "small writes failed"
+	done
+
+	local after=$(do_facet ost1 $LCTL get_param -n \
+		      obdfilter.$FSNAME-OST0000.brw_batched)
+
+	echo "writes committed in shared transactions: $((after - before))"
+	(( after > before )) || error "no write was batched"
+
+	cancel_lru_locks osc
+	for f in $DIR/$tdir/$tfile.*; do
+		cmp $TMP/$tfile $f || error "data mismatch in $f"
+	done
+}
+run_test 118p "small writes to different objects share transactions"
+
 test_119a() # bug 11737
 {
         BSIZE=$((512 * 1024))
@@ -14731,6 +14913,37 @@ test_124d() {
 }
 run_test 124d "cancel very aged locks if lru-resize disabled"
 
+test_124e() {
+	local nsdir="ldlm.namespaces.*-MDT0000-mdc-*"
+	local policy=$($LCTL get_param -n $nsdir.lru_reuse_policy | head -n1)
+	local hits
+
+	[[ -n "$policy" ]] || skip "no lru_reuse_policy support"
+
+	$LCTL set_param $nsdir.lru_reuse_policy=1
+	stack_trap "$LCTL set_param -n $nsdir.lru_reuse_policy $policy" EXIT
+	$LCTL set_param -n $nsdir.lru_reuse_stats=clear
+
+	test_mkdir $DIR/$tdir
+	touch $DIR/$tdir/$tfile || error "touch $DIR/$tdir/$tfile failed"
+	cancel_lru_locks mdc
+	for i in {1..10}; do
+		stat $DIR/$tdir/$tfile > /dev/null || error "stat failed"
+		sleep 0.1
+	done
+
+	$LCTL get_param $nsdir.lru_reuse_stats
+	hits=$($LCTL get_param -n $nsdir.lru_reuse_stats |
+		awk '/^lru_hits:/ { sum += $2 } END { print sum }')
+	(( hits > 0 )) || error "no LRU lock reuse accounted"
+
+	# reused locks must still be cancelled on LRU cleanup
+	cancel_lru_locks mdc
+	(( $($LCTL get_param -n $nsdir.lock_unused_count) == 0 )) ||
+		error "locks left in LRU after cleanup"
+}
+run_test 124e "LRU lock reuse statistics and reuse policy"
+
 test_125() { # 13358
 	$LCTL get_param -n llite.*.client_type | grep -q local ||
 		skip "must run as local client"
@@ -15881,6 +16094,31 @@ test_133h() {
 }
 run_test 133h "Proc files should end with newlines"
 
+test_133i() {
+	remote_mds_nodsh && skip "remote MDS with nodsh"
+
+	local param="mdt.$FSNAME-MDT0000.reply_slot_stats"
+	local allocs
+	local samples
+
+	do_facet mds1 $LCTL get_param -n $param &> /dev/null ||
+		skip "MDS does not support reply_slot_stats"
+
+	test_mkdir -i 0 -c 1 $DIR/$tdir || error "mkdir $tdir failed"
+	do_facet mds1 $LCTL set_param $param=clear
+	createmany -o $DIR/$tdir/f 200 || error "create files failed"
+	unlinkmany $DIR/$tdir/f 200 || error "unlink files failed"
+
+	do_facet mds1 $LCTL get_param $param
+	allocs=$(do_facet mds1 $LCTL get_param -n $param |
+		 awk '/allocs:/ { print $3 }')
+	samples=$(do_facet mds1 $LCTL get_param -n $param |
+		  awk '/latency_ns:/ { print $5 }')
+	(( allocs >= 400 )) || error "$allocs reply slots allocated, not 400"
+	(( samples >= 400 )) || error "$samples latency samples, not 400"
+}
+run_test 133i "Verifying reply_slot_stats"
+
 test_134a() {
 	remote_mds_nodsh && skip "remote MDS with nodsh"
 	[[ $MDS1_VERSION -lt $(version_code 2.7.54) ]] &&
@@ -17179,6 +17417,49 @@ test_155h() {
 }
 run_test 155h "Verify big file correctness: read cache:off write_cache:off"
 
+test_155i() {
+	[ $PARALLEL == "yes" ] && skip "skip parallel run"
+	remote_ost_nodsh && skip "remote OST with nodsh"
+	[ "$ost1_FSTYPE" == "ldiskfs" ] || skip "ldiskfs only test"
+
+	local p="$TMP/$TESTSUITE-$TESTNAME.parameters"
+	local param="osd-ldiskfs.$(facet_svc ost1)"
+	local temp=$TMP/$tfile
+	local file=$DIR/$tfile
+	local before
+	local after
+
+	save_writethrough $p
+	save_lustre_params ost1 "$param.read_cache_enable" >> $p
+	save_lustre_params ost1 "$param.bulk_read_min_io_mb" >> $p
+	# the bulk pool is only used by the reads bypassing the page cache
+	set_cache read off
+	set_cache writethrough off
+	do_facet ost1 $LCTL set_param $param.bulk_read_min_io_mb=1
+
+	$LFS setstripe -c 1 -i 0 $file || error "setstripe $file failed"
+	dd if=/dev/urandom of=$temp bs=4M count=4 || error "dd $temp failed"
+	dd if=$temp of=$file bs=4M oflag=direct || error "write $file failed"
+	cancel_lru_locks osc
+
+	before=$(do_facet ost1 $LCTL get_param -n $param.stats |
+		 awk '/^bulk_read/ { print $2 }')
+	dd if=$file of=/dev/null bs=4M iflag=direct ||
+		error "read $file failed"
+	after=$(do_facet ost1 $LCTL get_param -n $param.stats |
+		awk '/^bulk_read/ { print $2 }')
+	echo "bulk reads: before ${before:-0}, after ${after:-0}"
+
+	cancel_lru_locks osc
+	cmp $temp $file || error "$temp $file differ"
+	restore_lustre_params < $p
+	rm -f $p $temp $file
+
+	(( ${after:-0} > ${before:-0} )) ||
+		error "large uncached reads did not use the bulk pool"
+}
+run_test 155i "Large uncached reads use the OSD bulk page pool"
+
 test_156() {
 	[ $PARALLEL == "yes" ] && skip "skip parallel run"
 	remote_ost_nodsh && skip "remote OST with nodsh"
@@ -18874,6 +19155,37 @@ test_162c() {
 }
 run_test 162c "fid2path works with paths 100 or more directories deep"
 
+test_162d() {
+	[[ "$mds1_FSTYPE" == "ldiskfs" ]] || skip "ldiskfs only test"
+	remote_mds_nodsh && skip "remote MDS with nodsh"
+
+	local size=$(do_facet mds1 \
+		cat /sys/module/osd_ldiskfs/parameters/osd_oi_cache_size)
+
+	[[ -n "$size" ]] || skip "MDS does not have the OI cache"
+	(( size > 0 )) || skip "OI cache disabled on MDS"
+
+	local mdt=$(facet_svc mds1)
+	local stats="osd-ldiskfs.$mdt.stats"
+
+	test_mkdir -i 0 $DIR/$tdir
+	createmany -o $DIR/$tdir/f 100 || error "create failed"
+	ls -l $DIR/$tdir > /dev/null
+
+	cancel_lru_locks mdc
+	do_facet mds1 "$LCTL set_param -n $stats=clear"
+	# drop the MDT objects, they are then found through the OI again
+	do_facet mds1 "echo 3 > /proc/sys/vm/drop_caches"
+	ls -l $DIR/$tdir > /dev/null
+
+	do_facet mds1 "$LCTL get_param $stats" | grep oi_cache
+	local hits=$(do_facet mds1 "$LCTL get_param -n $stats" |
+		     awk '/oi_cache_hit/ { print $2 }')
+
+	(( ${hits:-0} > 0 )) || error "OI lookups are not cached"
+}
+run_test 162d "OI lookups are cached"
+
 oalr_event_count() {
 	local event="${1}"
 	local trace="${2}"
@@ -26128,6 +26440,98 @@ test_300t() {
 }
 run_test 300t "test max_mdt_stripecount"
 
+test_300u() {
+	(( MDSCOUNT >= 2 )) || skip "needs >= 2 MDTs"
+
+	local mdt
+	local devname
+	local before=()
+	local after
+	local i
+
+	for ((i = 0; i < MDSCOUNT; i++)); do
+		mdt=mds$((i + 1))
+		devname=$(mdtname_from_index $i)
+		before[$i]=$(do_facet $mdt "$LCTL --device $devname \
+			llog_print update_log | grep -c index")
+	done
+
+	test_mkdir -c $MDSCOUNT $DIR/$tdir || error "mkdir $tdir failed"
+	$LFS setdirstripe -D -i -1 -c $MDSCOUNT $DIR/$tdir ||
+		error "set $tdir default LMV failed"
+	createmany -d $DIR/$tdir/s 1000 || error "create subdirs failed"
+	unlinkmany -d $DIR/$tdir/s 1000 || error "unlink subdirs failed"
+	sync_all_data
+
+	# records of all the committed transactions are cancelled, so the
+	# plain llogs filled meanwhile are destroyed
+	for ((i = 0; i < MDSCOUNT; i++)); do
+		mdt=mds$((i + 1))
+		devname=$(mdtname_from_index $i)
+		wait_update_cond $(facet_active_host $mdt) \
+			"$LCTL --device $devname llog_print update_log |
+			 grep -c index" "-le" $((before[i] + 1)) 60 ||
+			error "update logs on $devname not cancelled"
+	done
+}
+run_test 300u "DNE: update logs of striped dirs are cancelled"
+
+test_300v() {
+	(( MDSCOUNT >= 2 )) || skip "needs >= 2 MDTs"
+
+	local mdts=$(comma_list $(mdts_nodes))
+	local param=/sys/module/ptlrpc/parameters/out_prep_min_objects
+	local counter=/sys/module/ptlrpc/parameters/out_prep_batches
+	local old=$(do_facet mds1 "cat $param 2>/dev/null")
+	local count=2000
+	local min
+	local start
+	local elapsed
+	local before
+	local after
+	local i=0
+
+	[[ -n "$old" ]] || skip "MDS does not support out_prep_min_objects"
+	stack_trap "do_nodes $mdts 'echo $old > $param'"
+
+	# the same synthetic batches of index updates LOD sends to the other
+	# MDTs on migration, with and without looking up objects in parallel
+	for min in 1000000 2; do
+		do_nodes $mdts "echo $min > $param"
+		test_mkdir -i 0 -c 1 $DIR/$tdir.$i || error "mkdir failed"
+		createmany -o $DIR/$tdir.$i/f $count ||
+			error "create $DIR/$tdir.$i failed"
+		cancel_lru_locks mdc
+		do_nodes $mdts "$LCTL set_param -n osd*.*MDT*.force_sync=1;
+			echo 3 > /proc/sys/vm/drop_caches"
+
+		before=$(do_nodes $mdts "cat $counter" |
+			 awk '{ sum += $NF } END { print sum }')
+		start=$SECONDS
+		$LFS migrate -m 1 -c $MDSCOUNT $DIR/$tdir.$i ||
+			error "migrate $DIR/$tdir.$i failed"
+		elapsed=$((SECONDS - start))
+		after=$(do_nodes $mdts "cat $counter" |
+			awk '{ sum += $NF } END { print sum }')
+		echo "out_prep_min_objects=$min: migrate $count files in" \
+			"${elapsed}s, $((after - before)) parallel batches"
+
+		if (( min == 2 )); then
+			(( after > before )) ||
+				error "objects were not looked up in parallel"
+		else
+			(( after == before )) ||
+				error "objects were looked up in parallel"
+		fi
+
+		(( $(ls $DIR/$tdir.$i | wc -l) == count )) ||
+			error "wrong entries in $DIR/$tdir.$i"
+		rm -rf $DIR/$tdir.$i || error "rm $DIR/$tdir.$i failed"
+		i=$((i + 1))
+	done
+}
+run_test 300v "DNE: OUT updates with objects looked up in parallel"
+
 prepare_remote_file() {
 	mkdir $DIR/$tdir/src_dir ||
 		error "create remote source failed"
@@ -6581,6 +6581,37 @@ test_115() {
 }
 run_test 115 "ldiskfs doesn't check direntry for uniqueness"
 
+test_116() {
+	local ns="filter-$FSNAME-OST0000_UUID"
+	local param="ldlm.namespaces.$ns.contention_sample"
+	local sample
+	local out
+
+	sample=$(do_facet ost1 $LCTL get_param -n $param) ||
+		skip "no DLM contention tracking support"
+
+	# account every lock so a few conflicting writes are enough
+	do_facet ost1 $LCTL set_param $param=1
+	stack_trap "do_facet ost1 $LCTL set_param $param=$sample"
+
+	do_facet ost1 $LCTL dlm_contention --reset $ns ||
+		error "cannot reset contention table"
+
+	$LFS setstripe -c 1 -i 0 $DIR/$tfile || error "setstripe failed"
+	for i in {1..20}; do
+		dd if=/dev/zero of=$DIR/$tfile bs=4k count=1 conv=notrunc \
+			2>/dev/null || error "write from $DIR failed"
+		dd if=/dev/zero of=$DIR2/$tfile bs=4k count=1 conv=notrunc \
+			2>/dev/null || error "write from $DIR2 failed"
+	done
+
+	out=$(do_facet ost1 $LCTL dlm_contention $ns)
+	echo "$out"
+	echo "$out" | grep -q "waits:" || error "no contended resource listed"
+	echo "$out" | grep -q "bl_asts:" || error "no blocking AST count"
+}
+run_test 116 "DLM resource contention table"
+
 log "cleanup: ======================================================"
 
 # kill and wait in each test only guarentee script finish, but command in script
@@ -224,6 +224,10 @@ command_t cmdlist[] = {
 	{"del_ost", jt_del_ost, 0, "permanently delete OST records\n"
 	 "usage: del_ost [--dryrun] --target <$fsname-OSTxxxx>\n"
 	 "Cancel the config records for a specific OST to forget about it.\n"},
+	{"dlm_contention", jt_dlm_contention, 0,
+	 "show the most contended DLM resources of server namespaces\n"
+	 "usage: dlm_contention [--reset] [namespace ...]\n"
+	 "  --reset  clear the contention statistics.\n"},
 
 	/* Debug commands */
 	{"==== debugging control ====", NULL, 0, "debug"},
@@ -1446,6 +1446,53 @@ int jt_lcfg_getparam(int argc, char **argv)
 	return rc;
 }
 
+/* show or reset the DLM resource contention table of server namespaces */
+int jt_dlm_contention(int argc, char **argv)
+{
+	static const struct option long_opts[] = {
+		{ .name = "reset",	.has_arg = no_argument,	.val = 'r' },
+		{ .name = NULL }
+	};
+	struct param_opts popt;
+	char pattern[PATH_MAX];
+	bool reset = false;
+	int rc = 0, c, i;
+
+	memset(&popt, 0, sizeof(popt));
+	popt.po_show_path = 1;
+
+	while ((c = getopt_long(argc, argv, "r", long_opts, NULL)) != -1) {
+		switch (c) {
+		case 'r':
+			reset = true;
+			break;
+		default:
+			optind = 1;
+			return CMD_HELP;
+		}
+	}
+
+	i = optind;
+	optind = 1;
+	do {
+		int rc2;
+
+		snprintf(pattern, sizeof(pattern),
+			 "ldlm.namespaces.%s.contention",
+			 i < argc ? argv[i] : "*");
+
+		rc2 = clean_path(&popt, pattern);
+		if (rc2 == 0)
+			rc2 = do_param_op(&popt, pattern,
+					  reset ? "clear" : NULL,
+					  reset ? SET_PARAM : GET_PARAM, NULL);
+		if (rc2 < 0 && rc == 0)
+			rc = rc2;
+	} while (++i < argc);
+
+	return rc;
+}
+
 /* get device list by netlink or debugfs */
 int jt_device_list(int argc, char **argv)
 {
@@ -156,6 +156,7 @@ int jt_lcfg_getparam(int argc, char **argv);
 int jt_lcfg_setparam(int argc, char **argv);
 int jt_lcfg_applyyaml(int argc, char **argv);
 int jt_lcfg_listparam(int argc, char **argv);
+int jt_dlm_contention(int argc, char **argv);
 
 int jt_pool_cmd(int argc, char **argv);
 int jt_del_ost(int argc, char **argv);